@@ -23,11 +23,13 @@
  */
 
 #include <boost/algorithm/string/case_conv.hpp>
+#include <boost/filesystem.hpp>
 #include <libdevcore/CommonJS.h>
 #include <libethcore/BasicAuthority.h>
 #include <libethcore/Exceptions.h>
 #include <libethashseal/Ethash.h>
 #include <libethashseal/EthashCPUMiner.h>
+#include <libethashseal/EthashEpochManager.h>
 
 // TODO - having using derivatives in header files is very poor style, and we need to fix these up.
 //
@@ -142,6 +144,10 @@ public:
                 BOOST_THROW_EXCEPTION(BadArgument());
             }
         }
+        else if (arg == "--pin-mining-threads")
+            m_pinMiningThreads = true;
+        else if (arg == "--dag-dir" && i + 1 < argc)
+            m_dagDir = argv[++i];
         else
             return false;
         return true;
@@ -150,7 +156,15 @@ public:
     void execute()
     {
         if (m_minerType == "cpu")
+        {
             EthashCPUMiner::setNumInstances(m_miningThreads);
+            EthashCPUMiner::setPinThreads(m_pinMiningThreads);
+            if (!m_dagDir.empty())
+            {
+                boost::filesystem::create_directories(m_dagDir);
+                EthashEpochManager::get().setDatasetDirectory(m_dagDir);
+            }
+        }
         else if (mode == OperationMode::Benchmark)
             doBenchmark(m_minerType, m_benchmarkWarmup, m_benchmarkTrial, m_benchmarkTrials);
     }
@@ -170,6 +184,9 @@ public:
              << "  -C,--cpu                   When mining, use the CPU\n"
              << "  -t, --mining-threads <n>   Limit number of CPU/GPU miners to n (default: use "
                 "everything available on selected platform)\n"
+             << "  --pin-mining-threads       Bind each CPU miner to its own core\n"
+             << "  --dag-dir <path>           Keep the CPU mining DAG in files in <path>, so it "
+                "survives restarts (default: in memory)\n"
              << "  --current-block            Let the miner know the current block number at "
                 "configuration time. Will help determine DAG size and required GPU memory\n"
              << "  --disable-submit-hashrate  When mining, don't submit hashrate to node\n\n";
@@ -235,6 +252,8 @@ private:
     /// Mining options
     std::string m_minerType = "cpu";
     unsigned m_miningThreads = UINT_MAX;
+    bool m_pinMiningThreads = false;
+    std::string m_dagDir;
     uint64_t m_currentBlock = 0;
 
     /// Benchmarking params
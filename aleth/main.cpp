@@ -38,6 +38,7 @@
 #include <libethashseal/GenesisInfo.h>
 #include <libethcore/KeyManager.h>
 #include <libethereum/Defaults.h>
+#include <libethereum/GasPriceOracle.h>
 #include <libethereum/SnapshotImporter.h>
 #include <libethereum/SnapshotStorage.h>
 #include <libevm/VM.h>
@@ -239,6 +240,7 @@ int main(int argc, char** argv)
 //  double blockFees = 15.0;
     u256 askPrice = 0;
     u256 bidPrice = DefaultGasPrice;
+    bool fixedBidPrice = false;
     bool alwaysConfirm = true;
 
     /// Wallet password stuff
@@ -296,7 +298,13 @@ int main(int argc, char** argv)
         "start-up)");
     addClientOption("kill,K", "Kill the blockchain first");
     addClientOption("rebuild,R", "Rebuild the blockchain from the existing database");
-    addClientOption("rescue", "Attempt to rescue a corrupt database\n");
+    addClientOption("rescue", "Attempt to rescue a corrupt database");
+    addClientOption("sample-seals", po::value<unsigned>()->value_name("<n>"),
+        "Only check the proof of work of every n-th block downloaded by sync and the last one of "
+        "each batch; blocks propagated by peers are always checked; UNSAFE for n > 1 (default: 1)");
+    addClientOption("no-tx-index",
+        "Don't index mined transactions by hash; lookups of mined transactions and their "
+        "receipts by hash will fail\n");
     addClientOption("import-presale", po::value<string>()->value_name("<file>"),
         "Import a pre-sale key; you'll need to specify the password to this key");
     addClientOption("import-secret,s", po::value<string>()->value_name("<secret>"),
@@ -315,8 +323,9 @@ int main(int argc, char** argv)
             toString(DefaultGasPrice) + ")")
             .c_str());
     addTransactingOption("bid", po::value<u256>()->value_name("<wei>"),
-        ("Set the bid gas price to pay for transactions (default: " + toString(DefaultGasPrice) +
-            ")")
+        ("Set a fixed bid gas price to pay for transactions (default: the median of recent blocks "
+         "and pending transactions, or " +
+            toString(DefaultGasPrice) + " until there are any)")
             .c_str());
     addTransactingOption("unsafe-transactions",
         "Allow all transactions to proceed without verification; EXTREMELY UNSAFE\n");
@@ -361,6 +370,24 @@ int main(int argc, char** argv)
         "Types:\n        default     Attempt connection when no other peers are available and "
         "pinning is disabled\n        required    Keep connected at all times\n");
     addNetworkingOption("no-discovery", "Disable node discovery; implies --no-bootstrap");
+    addNetworkingOption("announce-transactions",
+        "Relay transactions to most eth/65 peers as hash announcements they fetch on demand");
+    addNetworkingOption("network-threads", po::value<unsigned>()->value_name("<n>"),
+        "Run network I/O on n threads; messages of each peer are still handled in order "
+        "(default: 1)");
+    addNetworkingOption("handshake-threads", po::value<unsigned>()->value_name("<n>"),
+        "Do the key exchange of new connections on n threads (default: 2)");
+    addNetworkingOption("upload-limit", po::value<unsigned>()->value_name("<KB/s>"),
+        "Send at most this much to all peers together (default: no limit)");
+    addNetworkingOption("peer-upload-limit", po::value<unsigned>()->value_name("<KB/s>"),
+        "Send at most this much to each peer (default: no limit)");
+    addNetworkingOption("tx-gossip-limit", po::value<unsigned>()->value_name("<KB/s>"),
+        "Spend at most this much upload on relaying transactions (default: no limit)");
+    addNetworkingOption("sync-serving-limit", po::value<unsigned>()->value_name("<KB/s>"),
+        "Spend at most this much upload on serving blocks, receipts and state to syncing peers "
+        "(default: no limit)");
+    addNetworkingOption("snapshot-serving-limit", po::value<unsigned>()->value_name("<KB/s>"),
+        "Spend at most this much upload on serving snapshots (default: no limit)");
     addNetworkingOption("pin", "Only accept or connect to trusted peers\n");
 
     std::string snapshotPath;
@@ -616,6 +643,7 @@ int main(int argc, char** argv)
         try
         {
             bidPrice = vm["bid"].as<u256>();
+            fixedBidPrice = true;
         }
         catch (...)
         {
@@ -852,10 +880,30 @@ int main(int argc, char** argv)
     auto netPrefs = publicIP.empty() ? NetworkPreferences(listenIP, listenPort, upnp) : NetworkPreferences(publicIP, listenIP ,listenPort, upnp);
     netPrefs.discovery = (privateChain.empty() && !disableDiscovery) || enableDiscovery;
     netPrefs.pin = vm.count("pin") != 0;
+    if (vm.count("network-threads"))
+        netPrefs.ioThreads = max(vm["network-threads"].as<unsigned>(), 1u);
+    if (vm.count("handshake-threads"))
+        netPrefs.handshakeThreads = max(vm["handshake-threads"].as<unsigned>(), 1u);
+    if (vm.count("upload-limit"))
+        netPrefs.uploadLimit = vm["upload-limit"].as<unsigned>() * 1024;
+    if (vm.count("peer-upload-limit"))
+        netPrefs.peerUploadLimit = vm["peer-upload-limit"].as<unsigned>() * 1024;
+    if (vm.count("tx-gossip-limit"))
+        netPrefs.classUploadLimits[unsigned(TrafficClass::TxGossip)] =
+            vm["tx-gossip-limit"].as<unsigned>() * 1024;
+    if (vm.count("sync-serving-limit"))
+        netPrefs.classUploadLimits[unsigned(TrafficClass::SyncServing)] =
+            vm["sync-serving-limit"].as<unsigned>() * 1024;
+    if (vm.count("snapshot-serving-limit"))
+        netPrefs.classUploadLimits[unsigned(TrafficClass::SnapshotServing)] =
+            vm["snapshot-serving-limit"].as<unsigned>() * 1024;
 
     auto nodesState = contents(getDataDir() / fs::path("network.rlp"));
     auto caps = set<string>{"eth"};
 
+    if (vm.count("no-tx-index"))
+        chainParams.secondaryIndexes = false;
+
     if (testingMode)
     {
         chainParams.sealEngineName = "NoProof";
@@ -905,6 +953,25 @@ int main(int argc, char** argv)
         return 0;
     }
 
+    if (mode == OperationMode::Import && !filename.empty() && filename != "--")
+    {
+        // A file on disk is imported in bulk: blocks are verified on all cores and executed in
+        // order, bypassing the block queue.
+        double last = 0;
+        unsigned lastProcessed = 0;
+        auto const progress = web3.ethereum()->importBlockFile(filename, [&](BulkImportProgress const& _p) {
+            if (_p.elapsed < last + 10 && _p.processed != _p.total)
+                return;
+            auto i = _p.processed - lastProcessed;
+            auto d = _p.elapsed - last;
+            cout << _p.processed << "/" << _p.total << " blocks processed in " << _p.elapsed << " seconds at " << (d > 0 ? round(i * 10 / d) / 10 : 0) << " blocks/s (#" << web3.ethereum()->blockChain().number() << "), ETA " << round(_p.eta()) << " seconds\n";
+            last = _p.elapsed;
+            lastProcessed = _p.processed;
+        });
+        cout << progress.imported << " imported, " << progress.alreadyKnown << " already known, " << progress.unknownParent << " with unknown parent, " << progress.futureTime << " from the future, " << progress.bad << " bad in " << progress.elapsed << " seconds at " << (round(progress.imported * 10 / max(progress.elapsed, 0.1)) / 10) << " blocks/s (#" << web3.ethereum()->number() << ")\n";
+        return 0;
+    }
+
     if (mode == OperationMode::Import)
     {
         ifstream fin(filename, std::ifstream::binary);
@@ -1023,7 +1090,8 @@ int main(int argc, char** argv)
     web3.setIdealPeerCount(peers);
     web3.setPeerStretch(peerStretch);
     std::shared_ptr<eth::TrivialGasPricer> gasPricer =
-        make_shared<eth::TrivialGasPricer>(askPrice, bidPrice);
+        fixedBidPrice ? make_shared<eth::TrivialGasPricer>(askPrice, bidPrice) :
+                        make_shared<eth::GasPriceOracle>(askPrice, bidPrice);
     eth::Client* c = nodeMode == NodeMode::Full ? web3.ethereum() : nullptr;
     if (c)
     {
@@ -1032,6 +1100,10 @@ int main(int argc, char** argv)
         c->setAuthor(author);
         if (networkID != NoNetworkID)
             c->setNetworkId(networkID);
+        if (vm.count("announce-transactions"))
+            c->setTransactionAnnouncements(true);
+        if (vm.count("sample-seals"))
+            c->setSealSampling(vm["sample-seals"].as<unsigned>());
     }
 
     auto renderFullAddress = [&](Address const& _a) -> std::string
@@ -0,0 +1,79 @@
+// Copyright 2018 cpp-ethereum Authors.
+// Licensed under the GNU General Public License v3. See the LICENSE file.
+
+#include "RollingBloom.h"
+
+#include <algorithm>
+
+using namespace std;
+using namespace dev;
+
+namespace
+{
+/// Filter bits per entry; with 7 hash functions this gives a false positive rate of about 0.1%.
+unsigned const c_bitsPerEntry = 16;
+}
+
+RollingBloom::RollingBloom(unsigned _capacity): m_capacity(max(_capacity, 1u))
+{
+    uint64_t bits = 64;
+    while (bits < uint64_t(m_capacity) * c_bitsPerEntry)
+        bits <<= 1;
+    m_mask = bits - 1;
+    m_current.assign(bits / 64, 0);
+    m_previous.assign(bits / 64, 0);
+
+    uniform_int_distribution<uint32_t> dist;
+    for (auto& salt: m_salts)
+        salt = dist(s_fixedHashEngine);
+}
+
+uint64_t RollingBloom::bit(h256 const& _h, unsigned _i) const
+{
+    byte const* p = _h.data() + _i * 4;
+    uint32_t const word = uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 | uint32_t(p[3]) << 24;
+    return (word ^ m_salts[_i]) & m_mask;
+}
+
+bool RollingBloom::test(vector<uint64_t> const& _filter, h256 const& _h) const
+{
+    for (unsigned i = 0; i < c_hashCount; ++i)
+    {
+        uint64_t const b = bit(_h, i);
+        if (!(_filter[b / 64] & (uint64_t(1) << (b % 64))))
+            return false;
+    }
+    return true;
+}
+
+void RollingBloom::insert(h256 const& _h)
+{
+    if (test(m_current, _h))
+        return;
+
+    if (m_currentCount >= m_capacity)
+    {
+        swap(m_current, m_previous);
+        fill(m_current.begin(), m_current.end(), 0);
+        m_currentCount = 0;
+    }
+
+    for (unsigned i = 0; i < c_hashCount; ++i)
+    {
+        uint64_t const b = bit(_h, i);
+        m_current[b / 64] |= uint64_t(1) << (b % 64);
+    }
+    ++m_currentCount;
+}
+
+bool RollingBloom::contains(h256 const& _h) const
+{
+    return test(m_current, _h) || test(m_previous, _h);
+}
+
+void RollingBloom::clear()
+{
+    fill(m_current.begin(), m_current.end(), 0);
+    fill(m_previous.begin(), m_previous.end(), 0);
+    m_currentCount = 0;
+}
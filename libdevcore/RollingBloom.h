@@ -0,0 +1,49 @@
+// Copyright 2018 cpp-ethereum Authors.
+// Licensed under the GNU General Public License v3. See the LICENSE file.
+
+#pragma once
+
+#include "FixedHash.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace dev
+{
+/**
+ * @brief Approximate set of recently inserted hashes in fixed memory.
+ *
+ * Keeps two generations of bloom filters. Inserts go to the current one, which replaces the
+ * previous one once it holds @a _capacity entries, so at least the last @a _capacity hashes are
+ * always remembered. False positives occur at a rate of about 0.1%, false negatives never happen
+ * for remembered hashes. The hashes are expected to be uniformly distributed, like Keccak outputs.
+ * @not threadsafe
+ */
+class RollingBloom
+{
+public:
+    explicit RollingBloom(unsigned _capacity);
+
+    void insert(h256 const& _h);
+    bool contains(h256 const& _h) const;
+    void clear();
+
+    /// @returns the memory taken by the filters in bytes.
+    size_t byteSize() const { return (m_current.size() + m_previous.size()) * sizeof(uint64_t); }
+
+private:
+    static unsigned const c_hashCount = 7;
+
+    bool test(std::vector<uint64_t> const& _filter, h256 const& _h) const;
+    uint64_t bit(h256 const& _h, unsigned _i) const;
+
+    unsigned m_capacity;
+    uint64_t m_mask;                             ///< Filter size in bits minus one.
+    std::array<uint32_t, c_hashCount> m_salts;  ///< Per instance, so crafted hashes can't target every node.
+    std::vector<uint64_t> m_current;
+    std::vector<uint64_t> m_previous;
+    unsigned m_currentCount = 0;
+};
+
+}  // namespace dev
@@ -17,6 +17,7 @@
 
 #include "Ethash.h"
 #include "EthashCPUMiner.h"
+#include "EthashEpochManager.h"
 
 #include <libethcore/ChainOperationParams.h>
 #include <libethcore/CommonJS.h>
@@ -136,9 +137,10 @@ void Ethash::verify(Strictness _s, BlockHeader const& _bi, BlockHeader const& _p
     // check it hashes according to proof of work or that it's the genesis block.
     if (_s == CheckEverything && _bi.parentHash() && !verifySeal(_bi))
     {
+        auto const context =
+            EthashEpochManager::get().light(ethash::get_epoch_number(static_cast<int>(_bi.number())));
         ethash::result result =
-            ethash::hash(ethash::get_global_epoch_context(ethash::get_epoch_number(_bi.number())),
-                toEthash(_bi.hash(WithoutSeal)), toEthash(nonce(_bi)));
+            ethash::hash(*context, toEthash(_bi.hash(WithoutSeal)), toEthash(nonce(_bi)));
 
         h256 mix{result.mix_hash.bytes, h256::ConstructFromPointer};
         h256 final{result.final_hash.bytes, h256::ConstructFromPointer};
@@ -163,6 +165,26 @@ void Ethash::verify(Strictness _s, BlockHeader const& _bi, BlockHeader const& _p
     }
 }
 
+void Ethash::verifySeals(std::vector<BlockHeader> const& _headers, unsigned _sampleEvery) const
+{
+    // Headers of a batch mostly share an epoch, so its light cache is only looked up when it changes.
+    EthashEpochManager::LightContext context;
+    for (size_t i = 0; i < _headers.size(); ++i)
+    {
+        BlockHeader const& bi = _headers[i];
+        if (!bi.parentHash() || !isSampled(_headers, i, _sampleEvery))
+            continue;
+
+        int const epoch = ethash::get_epoch_number(static_cast<int>(bi.number()));
+        if (!context || context->epoch_number != epoch)
+            context = EthashEpochManager::get().light(epoch);
+        if (!ethash::verify(*context, toEthash(bi.hash(WithoutSeal)), toEthash(mixHash(bi)),
+                toEthash(nonce(bi)), toEthash(boundary(bi))))
+            // Throws with the details of what was wrong.
+            verify(CheckEverything, bi, BlockHeader(), bytesConstRef());
+    }
+}
+
 void Ethash::verifyTransaction(ImportRequirements::value _ir, TransactionBase const& _t, BlockHeader const& _header, u256 const& _startGasUsed) const
 {
     SealEngineFace::verifyTransaction(_ir, _t, _header, _startGasUsed);
@@ -263,9 +285,9 @@ bool Ethash::verifySeal(BlockHeader const& _blockHeader) const
     Nonce const n = nonce(_blockHeader);
     h256 const m = mixHash(_blockHeader);
 
-    auto& context =
-        ethash::get_global_epoch_context(ethash::get_epoch_number(_blockHeader.number()));
-    return ethash::verify(context, toEthash(h), toEthash(m), toEthash(n), toEthash(b));
+    auto const context = EthashEpochManager::get().light(
+        ethash::get_epoch_number(static_cast<int>(_blockHeader.number())));
+    return ethash::verify(*context, toEthash(h), toEthash(m), toEthash(n), toEthash(b));
 }
 
 void Ethash::generateSeal(BlockHeader const& _bi)
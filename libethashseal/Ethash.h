@@ -54,6 +54,7 @@ public:
 
     StringHashMap jsInfo(BlockHeader const& _bi) const override;
     void verify(Strictness _s, BlockHeader const& _bi, BlockHeader const& _parent, bytesConstRef _block) const override;
+    void verifySeals(std::vector<BlockHeader> const& _headers, unsigned _sampleEvery = 1) const override;
     void verifyTransaction(ImportRequirements::value _ir, TransactionBase const& _t, BlockHeader const& _header, u256 const& _startGasUsed) const override;
     void populateFromParent(BlockHeader& _bi, BlockHeader const& _parent) const override;
 
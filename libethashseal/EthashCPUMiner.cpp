@@ -23,6 +23,7 @@
 
 #include "EthashCPUMiner.h"
 #include "Ethash.h"
+#include "EthashEpochManager.h"
 
 #include <ethash/ethash.hpp>
 
@@ -30,12 +31,29 @@
 #include <chrono>
 #include <random>
 
+#if defined(__linux__)
+#include <pthread.h>
+#endif
+
 using namespace std;
 using namespace dev;
 using namespace eth;
 
 unsigned EthashCPUMiner::s_numInstances = 0;
+bool EthashCPUMiner::s_pinThreads = false;
+
+namespace
+{
+/// Nonces each miner tries before moving on to the next range; the miners take turns over them.
+unsigned const c_batchSize = 256;
 
+/// Mixed into the start nonce, so that separate processes mining the same header diverge.
+uint64_t nonceSalt()
+{
+    static uint64_t const s_salt = std::random_device{}() ^ (uint64_t(std::random_device{}()) << 32);
+    return s_salt;
+}
+}  // namespace
 
 EthashCPUMiner::EthashCPUMiner(GenericMiner<EthashProofOfWork>::ConstructionInfo const& _ci)
   : GenericMiner<EthashProofOfWork>(_ci)
@@ -82,27 +100,40 @@ void EthashCPUMiner::minerBody()
 {
     setThreadName("miner" + toString(index()));
 
-    auto tid = std::this_thread::get_id();
-    static std::mt19937_64 s_eng((utcTime() + std::hash<decltype(tid)>()(tid)));
-
-    uint64_t tryNonce = s_eng();
+#if defined(__linux__)
+    if (s_pinThreads && std::thread::hardware_concurrency())
+    {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(index() % std::thread::hardware_concurrency(), &cpus);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    }
+#endif
 
     // FIXME: Use epoch number, not seed hash in the work package.
     WorkPackage w = work();
 
     int epoch = ethash::find_epoch_number(toEthash(w.seedHash));
-    auto& ethashContext = ethash::get_global_epoch_context_full(epoch);
+    if (!m_dataset || m_dataset->epoch() != epoch)
+    {
+        m_dataset.reset();
+        m_dataset = EthashEpochManager::get().dataset(epoch);
+    }
+
+    // All miners derive the same start from the header and interleave their batches from there.
+    h256 const headerHash = w.headerHash();
+    uint64_t start = nonceSalt();
+    for (unsigned i = 0; i < sizeof(start); ++i)
+        start ^= uint64_t(headerHash[i]) << (8 * i);
+    uint64_t const stride = uint64_t(c_batchSize) * instances();
 
-    h256 boundary = w.boundary;
-    for (unsigned hashCount = 1; !m_shouldStop; tryNonce++, hashCount++)
+    for (uint64_t batch = start + uint64_t(c_batchSize) * index(); !m_shouldStop; batch += stride)
     {
-        auto result = ethash::hash(ethashContext, toEthash(w.headerHash()), tryNonce);
-        h256 value = h256(result.final_hash.bytes, h256::ConstructFromPointer);
-        if (value <= boundary && submitProof(EthashProofOfWork::Solution{(h64)(u64)tryNonce,
-                                     h256(result.mix_hash.bytes, h256::ConstructFromPointer)}))
+        unsigned tried = 0;
+        auto solution = m_dataset->search(headerHash, w.boundary, batch, c_batchSize, &tried);
+        accumulateHashes(tried);
+        if (solution && submitProof(*solution))
             break;
-        if (!(hashCount % 100))
-            accumulateHashes(100);
     }
 }
 
@@ -20,6 +20,7 @@
 
 #pragma once
 
+#include "EthashDataset.h"
 #include "EthashProofOfWork.h"
 
 #include <libethereum/GenericMiner.h>
@@ -43,6 +44,8 @@ public:
     {
         s_numInstances = std::min<unsigned>(_instances, std::thread::hardware_concurrency());
     }
+    /// Binds each miner thread to its own core.
+    static void setPinThreads(bool _pin) { s_pinThreads = _pin; }
 
 protected:
     void kickOff() override;
@@ -50,6 +53,7 @@ protected:
 
 private:
     static unsigned s_numInstances;
+    static bool s_pinThreads;
 
     void startWorking();
     void stopWorking();
@@ -57,6 +61,9 @@ private:
 
     std::unique_ptr<std::thread> m_thread;
     std::atomic<bool> m_shouldStop;
+
+    /// Kept across work packages so the dataset is only rebuilt when the epoch changes.
+    std::shared_ptr<EthashDataset> m_dataset;
 };
 }  // namespace eth
 }  // namespace dev
@@ -0,0 +1,308 @@
+// Copyright 2018 cpp-ethereum Authors.
+// Licensed under the GNU General Public License v3. See the LICENSE file.
+
+#include "EthashDataset.h"
+
+#include <libdevcore/Exceptions.h>
+#include <libdevcore/Log.h>
+
+#include <ethash/keccak.hpp>
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+namespace
+{
+uint32_t const c_fnvPrime = 0x01000193;
+unsigned const c_datasetAccesses = 64;
+unsigned const c_itemParents = 256;
+unsigned const c_mixWords = 32;
+unsigned const c_seedWords = 16;
+
+/// Nonces hashed in lock step by search().
+unsigned const c_lanes = 4;
+
+size_t const c_hugePageSize = 2 * 1024 * 1024;
+
+uint64_t const c_fileMagic = 0x7465736174616468;  // "hdataset"
+uint32_t const c_fileVersion = 1;
+/// The items start a page after the header, which keeps them page aligned.
+size_t const c_fileHeaderSize = 4096;
+
+// Hashes are read as arrays of 32-bit words in host order, which Ethash defines as little-endian.
+
+inline uint32_t fnv(uint32_t _u, uint32_t _v)
+{
+    return (_u * c_fnvPrime) ^ _v;
+}
+
+/// Computes the 512-bit half @a _index of the dataset items from the light cache.
+void halfItem(ethash::epoch_context const& _light, uint32_t _index, uint32_t* o_words)
+{
+    uint32_t const cacheItems = static_cast<uint32_t>(_light.light_cache_num_items);
+    uint32_t mix[c_seedWords];
+    uint32_t parent[c_seedWords];
+
+    memcpy(mix, _light.light_cache[_index % cacheItems].bytes, sizeof(mix));
+    mix[0] ^= _index;
+    ethash::hash512 h = ethash::keccak512(reinterpret_cast<uint8_t const*>(mix), sizeof(mix));
+    memcpy(mix, h.bytes, sizeof(mix));
+    for (uint32_t j = 0; j < c_itemParents; ++j)
+    {
+        memcpy(parent, _light.light_cache[fnv(_index ^ j, mix[j % c_seedWords]) % cacheItems].bytes,
+            sizeof(parent));
+        for (unsigned w = 0; w < c_seedWords; ++w)
+            mix[w] = fnv(mix[w], parent[w]);
+    }
+    h = ethash::keccak512(reinterpret_cast<uint8_t const*>(mix), sizeof(mix));
+    memcpy(o_words, h.bytes, sizeof(mix));
+}
+
+struct Lane
+{
+    ethash::hash512 seed;
+    uint32_t seed0;
+    uint32_t mix[c_mixWords];
+};
+
+void seedLane(Lane& _lane, h256 const& _headerHash, uint64_t _nonce)
+{
+    uint8_t data[h256::size + sizeof(_nonce)];
+    memcpy(data, _headerHash.data(), h256::size);
+    for (unsigned i = 0; i < sizeof(_nonce); ++i)
+        data[h256::size + i] = static_cast<uint8_t>(_nonce >> (8 * i));
+    _lane.seed = ethash::keccak512(data, sizeof(data));
+    memcpy(_lane.mix, _lane.seed.bytes, sizeof(ethash::hash512));
+    memcpy(_lane.mix + c_seedWords, _lane.seed.bytes, sizeof(ethash::hash512));
+    _lane.seed0 = _lane.mix[0];
+}
+
+ethash::result finishLane(Lane const& _lane)
+{
+    uint32_t compressed[c_mixWords / 4];
+    for (unsigned w = 0; w < c_mixWords; w += 4)
+        compressed[w / 4] =
+            fnv(fnv(fnv(_lane.mix[w], _lane.mix[w + 1]), _lane.mix[w + 2]), _lane.mix[w + 3]);
+
+    ethash::result ret;
+    memcpy(ret.mix_hash.bytes, compressed, sizeof(compressed));
+    uint8_t data[sizeof(ethash::hash512) + sizeof(ethash::hash256)];
+    memcpy(data, _lane.seed.bytes, sizeof(ethash::hash512));
+    memcpy(data + sizeof(ethash::hash512), compressed, sizeof(compressed));
+    ret.final_hash = ethash::keccak256(data, sizeof(data));
+    return ret;
+}
+}  // namespace
+
+struct EthashDataset::FileHeader
+{
+    uint64_t magic;
+    uint32_t version;
+    int32_t epoch;
+    uint64_t items;
+    /// Set once the items have been flushed on close, cleared while the file is mapped.
+    uint64_t clean;
+};
+
+EthashDataset::EthashDataset(
+    shared_ptr<ethash::epoch_context const> _light, boost::filesystem::path const& _file)
+  : m_light(move(_light))
+{
+    size_t const size = size_t(m_light->full_dataset_num_items) * sizeof(Item);
+    if (!_file.empty())
+    {
+        mapFile(_file, size);
+        cnote << "Mapped the Ethash dataset of epoch " << epoch() << " from " << _file;
+        return;
+    }
+
+#if defined(__linux__)
+    // Reserved huge pages if there are enough, otherwise transparent ones on an aligned range.
+    size_t const pages = (size + c_hugePageSize - 1) / c_hugePageSize * c_hugePageSize;
+    m_mapped = mmap(nullptr, pages, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (m_mapped != MAP_FAILED)
+    {
+        m_mappedSize = pages;
+        m_items = static_cast<Item*>(m_mapped);
+        m_hugePages = true;
+    }
+    else
+    {
+        m_mappedSize = pages + c_hugePageSize;
+        m_mapped = mmap(nullptr, m_mappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+            -1, 0);
+        if (m_mapped == MAP_FAILED)
+            throw std::bad_alloc();
+        uintptr_t const aligned = (reinterpret_cast<uintptr_t>(m_mapped) + c_hugePageSize - 1) &
+                                  ~uintptr_t(c_hugePageSize - 1);
+        m_items = reinterpret_cast<Item*>(aligned);
+        m_hugePages = madvise(m_items, pages, MADV_HUGEPAGE) == 0;
+    }
+#else
+    m_mapped = calloc(size, 1);
+    if (!m_mapped)
+        throw std::bad_alloc();
+    m_items = static_cast<Item*>(m_mapped);
+#endif
+
+    cnote << "Mapped the Ethash dataset of epoch " << epoch() << ": " << size / (1024 * 1024)
+          << " MB, " << (m_hugePages ? "huge" : "normal") << " pages";
+}
+
+EthashDataset::~EthashDataset()
+{
+#if defined(__unix__) || defined(__APPLE__)
+    if (m_fileHeader)
+    {
+        // Every item written so far reaches the file before it is marked clean.
+        if (msync(m_mapped, m_mappedSize, MS_SYNC) == 0)
+        {
+            m_fileHeader->clean = 1;
+            msync(m_mapped, c_fileHeaderSize, MS_SYNC);
+        }
+    }
+    if (m_mappedSize)
+    {
+        munmap(m_mapped, m_mappedSize);
+        return;
+    }
+#endif
+    free(m_mapped);
+}
+
+void EthashDataset::mapFile(boost::filesystem::path const& _file, size_t _size)
+{
+#if defined(__unix__) || defined(__APPLE__)
+    // Items not generated yet read as zeros, which is what a sparse file extended by ftruncate holds.
+    int fd = open(_file.string().c_str(), O_RDWR | O_CREAT, 0600);
+    if (fd < 0)
+        BOOST_THROW_EXCEPTION(FileError() << errinfo_path(_file.string()));
+    ScopeGuard closeFile([fd]() { close(fd); });
+
+    static_assert(sizeof(FileHeader) <= c_fileHeaderSize, "Ethash dataset file header too large");
+    size_t const fileSize = c_fileHeaderSize + _size;
+    FileHeader const expected{c_fileMagic, c_fileVersion, epoch(), _size / sizeof(Item), 1};
+    FileHeader header;
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+        BOOST_THROW_EXCEPTION(FileError() << errinfo_path(_file.string()));
+    bool const valid = size_t(st.st_size) == fileSize &&
+                       pread(fd, &header, sizeof(header), 0) == ssize_t(sizeof(header)) &&
+                       memcmp(&header, &expected, sizeof(header)) == 0;
+    if (!valid)
+    {
+        if (st.st_size)
+            cnote << "Rebuilding the Ethash dataset file " << _file;
+        if (ftruncate(fd, 0) != 0 || ftruncate(fd, fileSize) != 0)
+            BOOST_THROW_EXCEPTION(FileError() << errinfo_path(_file.string()));
+    }
+
+    m_mapped = mmap(nullptr, fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (m_mapped == MAP_FAILED)
+    {
+        m_mapped = nullptr;
+        BOOST_THROW_EXCEPTION(FileError() << errinfo_path(_file.string()));
+    }
+    m_mappedSize = fileSize;
+    m_fileHeader = static_cast<FileHeader*>(m_mapped);
+    m_items = reinterpret_cast<Item*>(static_cast<uint8_t*>(m_mapped) + c_fileHeaderSize);
+
+    // Until it is closed cleanly, a crash may leave items half written.
+    *m_fileHeader = expected;
+    m_fileHeader->clean = 0;
+    if (msync(m_mapped, c_fileHeaderSize, MS_SYNC) != 0)
+        BOOST_THROW_EXCEPTION(FileError() << errinfo_path(_file.string()));
+#else
+    (void)_size;
+    BOOST_THROW_EXCEPTION(FileError() << errinfo_path(_file.string()));
+#endif
+}
+
+EthashDataset::Item const& EthashDataset::item(uint32_t _index)
+{
+    // The items live in plain (possibly file-backed) memory, so the first word is only viewed as
+    // an atomic, which has to be a plain lock-free word for that.
+    static_assert(sizeof(atomic<uint64_t>) == sizeof(uint64_t) && ATOMIC_LLONG_LOCK_FREE == 2,
+        "Dataset item words can't be used as atomics");
+
+    Item& ret = m_items[_index];
+    auto& first = *reinterpret_cast<atomic<uint64_t>*>(&ret.word64s[0]);
+    // Miners may race to fill the same item. They write the same bytes, and the first word goes
+    // last, so a non-zero first word means the rest is there.
+    if (first.load(memory_order_acquire) == 0)
+    {
+        Item computed;
+        halfItem(*m_light, _index * 2, computed.word32s);
+        halfItem(*m_light, _index * 2 + 1, computed.word32s + c_seedWords);
+        memcpy(&ret.word64s[1], &computed.word64s[1], sizeof(ret) - sizeof(uint64_t));
+        first.store(computed.word64s[0], memory_order_release);
+    }
+    return ret;
+}
+
+boost::optional<EthashProofOfWork::Solution> EthashDataset::search(
+    h256 const& _headerHash, h256 const& _boundary, uint64_t _start, unsigned _count,
+    unsigned* o_tried)
+{
+    uint32_t const items = static_cast<uint32_t>(m_light->full_dataset_num_items);
+    Lane lanes[c_lanes];
+    Item const* data[c_lanes];
+
+    for (unsigned done = 0; done < _count; done += c_lanes)
+    {
+        unsigned const n = min(c_lanes, _count - done);
+        if (o_tried)
+            *o_tried = done + n;
+        for (unsigned l = 0; l < n; ++l)
+            seedLane(lanes[l], _headerHash, _start + done + l);
+
+        for (uint32_t i = 0; i < c_datasetAccesses; ++i)
+        {
+            // Look up the items of all lanes before mixing any, so their reads overlap.
+            for (unsigned l = 0; l < n; ++l)
+                data[l] = &item(fnv(i ^ lanes[l].seed0, lanes[l].mix[i % c_mixWords]) % items);
+            for (unsigned l = 0; l < n; ++l)
+                for (unsigned w = 0; w < c_mixWords; ++w)
+                    lanes[l].mix[w] = fnv(lanes[l].mix[w], data[l]->word32s[w]);
+        }
+
+        for (unsigned l = 0; l < n; ++l)
+        {
+            ethash::result const r = finishLane(lanes[l]);
+            if (h256(r.final_hash.bytes, h256::ConstructFromPointer) <= _boundary)
+                return EthashProofOfWork::Solution{(h64)(u64)(_start + done + l),
+                    h256(r.mix_hash.bytes, h256::ConstructFromPointer)};
+        }
+    }
+    if (o_tried)
+        *o_tried = _count;
+    return boost::none;
+}
+
+ethash::result EthashDataset::hash(h256 const& _headerHash, uint64_t _nonce)
+{
+    uint32_t const items = static_cast<uint32_t>(m_light->full_dataset_num_items);
+    Lane lane;
+    seedLane(lane, _headerHash, _nonce);
+    for (uint32_t i = 0; i < c_datasetAccesses; ++i)
+    {
+        Item const& d =
+            item(fnv(i ^ lane.seed0, lane.mix[i % c_mixWords]) % items);
+        for (unsigned w = 0; w < c_mixWords; ++w)
+            lane.mix[w] = fnv(lane.mix[w], d.word32s[w]);
+    }
+    return finishLane(lane);
+}
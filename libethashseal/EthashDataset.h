@@ -0,0 +1,80 @@
+// Copyright 2018 cpp-ethereum Authors.
+// Licensed under the GNU General Public License v3. See the LICENSE file.
+
+#pragma once
+
+#include "EthashProofOfWork.h"
+
+#include <ethash/ethash.hpp>
+
+#include <boost/filesystem/path.hpp>
+#include <boost/optional.hpp>
+
+#include <memory>
+
+namespace dev
+{
+namespace eth
+{
+/**
+ * @brief The full Ethash dataset of one epoch, for hashing on the CPU.
+ *
+ * The dataset lives in memory mapped with 2 MB pages where the system allows it, which saves the
+ * TLB misses of its random reads. Items are generated from the light cache the first time they are
+ * read, so miners can start at once and share the work of filling it in. A dataset mapped from a
+ * file keeps the items generated so far for the next run. The file starts with a header naming the
+ * epoch and size, and is only trusted if it was flushed and marked clean when it was last closed;
+ * otherwise it is rebuilt, as items of a crashed run may be torn.
+ *
+ * search() runs several nonces through the hash in lock step, so that the dataset reads of one can
+ * wait on memory while the others are being mixed.
+ */
+class EthashDataset
+{
+public:
+    /// Maps the dataset of the epoch of @a _light from @a _file, or from memory if it is empty.
+    explicit EthashDataset(std::shared_ptr<ethash::epoch_context const> _light,
+        boost::filesystem::path const& _file = {});
+    ~EthashDataset();
+
+    EthashDataset(EthashDataset const&) = delete;
+    EthashDataset& operator=(EthashDataset const&) = delete;
+
+    int epoch() const { return m_light->epoch_number; }
+
+    /// @returns true if the dataset is backed by huge pages.
+    bool hugePages() const { return m_hugePages; }
+
+    /// Tries the nonces from @a _start to @a _start + @a _count, setting @a o_tried, if given, to
+    /// the number of nonces hashed.
+    /// @returns the first solution whose hash is no greater than @a _boundary.
+    boost::optional<EthashProofOfWork::Solution> search(h256 const& _headerHash,
+        h256 const& _boundary, uint64_t _start, unsigned _count, unsigned* o_tried = nullptr);
+
+    /// Computes the hash of a single nonce.
+    ethash::result hash(h256 const& _headerHash, uint64_t _nonce);
+
+private:
+    /// A 1024-bit item of the dataset.
+    union Item
+    {
+        uint64_t word64s[16];
+        uint32_t word32s[32];
+        uint8_t bytes[128];
+    };
+
+    struct FileHeader;
+
+    Item const& item(uint32_t _index);
+    void mapFile(boost::filesystem::path const& _file, size_t _size);
+
+    std::shared_ptr<ethash::epoch_context const> m_light;
+    Item* m_items = nullptr;
+    FileHeader* m_fileHeader = nullptr;  ///< Start of the mapped file, null if not mapped from one.
+    size_t m_mappedSize = 0;
+    void* m_mapped = nullptr;
+    bool m_hugePages = false;
+};
+
+}  // namespace eth
+}  // namespace dev
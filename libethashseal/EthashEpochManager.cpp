@@ -0,0 +1,155 @@
+// Copyright 2018 cpp-ethereum Authors.
+// Licensed under the GNU General Public License v3. See the LICENSE file.
+
+#include "EthashEpochManager.h"
+
+#include <libdevcore/Log.h>
+
+#include <boost/filesystem.hpp>
+
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+namespace
+{
+string const c_datasetFilePrefix = "full-";
+
+EthashEpochManager::LightContext generate(int _epoch)
+{
+    auto context = ethash::create_epoch_context(_epoch);
+    if (!context)
+        throw std::bad_alloc();
+    return EthashEpochManager::LightContext{move(context)};
+}
+}  // namespace
+
+EthashEpochManager& EthashEpochManager::get()
+{
+    static EthashEpochManager s_this;
+    return s_this;
+}
+
+EthashEpochManager::~EthashEpochManager()
+{
+    if (m_prefetcher.joinable())
+        m_prefetcher.join();
+}
+
+EthashEpochManager::LightContext EthashEpochManager::light(int _epoch)
+{
+    packaged_task<LightContext()> task;
+    shared_future<LightContext> ret;
+    DEV_GUARDED(x_light)
+    {
+        ret = lookup_WITH_LOCK(_epoch, task);
+        for (auto it = m_light.begin(); it != m_light.end();)
+            if (it->first < _epoch - 1 || it->first > _epoch + 1)
+                it = m_light.erase(it);
+            else
+                ++it;
+    }
+
+    if (task.valid())
+        task();
+    prefetch(_epoch + 1);
+
+    try
+    {
+        return ret.get();
+    }
+    catch (...)
+    {
+        // Let the next caller try again.
+        DEV_GUARDED(x_light)
+        {
+            auto it = m_light.find(_epoch);
+            if (it != m_light.end() && it->second.wait_for(chrono::seconds(0)) == future_status::ready)
+                m_light.erase(it);
+        }
+        throw;
+    }
+}
+
+shared_future<EthashEpochManager::LightContext> EthashEpochManager::lookup_WITH_LOCK(
+    int _epoch, packaged_task<LightContext()>& o_task)
+{
+    auto it = m_light.find(_epoch);
+    if (it != m_light.end())
+        return it->second;
+
+    o_task = packaged_task<LightContext()>([_epoch]() { return generate(_epoch); });
+    return m_light[_epoch] = o_task.get_future().share();
+}
+
+void EthashEpochManager::prefetch(int _epoch)
+{
+    if (m_prefetching.exchange(true))
+        return;
+
+    packaged_task<LightContext()> task;
+    DEV_GUARDED(x_light)
+        lookup_WITH_LOCK(_epoch, task);
+    if (!task.valid())
+    {
+        m_prefetching = false;
+        return;
+    }
+
+    // The previous prefetcher has cleared m_prefetching, so it is done or about to be.
+    if (m_prefetcher.joinable())
+        m_prefetcher.join();
+    m_prefetcher = thread([this, _epoch](packaged_task<LightContext()> _task) {
+        setThreadName("ethash");
+        cnote << "Generating the Ethash light cache of epoch " << _epoch;
+        _task();
+        m_prefetching = false;
+    }, move(task));
+}
+
+shared_ptr<EthashDataset> EthashEpochManager::dataset(int _epoch)
+{
+    Guard l(x_dataset);
+    auto ret = m_dataset.lock();
+    if (!ret || ret->epoch() != _epoch)
+    {
+        ret.reset();
+        boost::filesystem::path file;
+        if (!m_datasetDir.empty())
+        {
+            file = m_datasetDir / (c_datasetFilePrefix + toString(_epoch));
+            pruneDatasetFiles_WITH_LOCK(_epoch);
+        }
+        ret = make_shared<EthashDataset>(light(_epoch), file);
+        m_dataset = ret;
+    }
+    return ret;
+}
+
+void EthashEpochManager::pruneDatasetFiles_WITH_LOCK(int _epoch)
+{
+    boost::system::error_code ec;
+    for (boost::filesystem::directory_iterator it(m_datasetDir, ec), end; !ec && it != end;
+         it.increment(ec))
+    {
+        string const name = it->path().filename().string();
+        if (name.compare(0, c_datasetFilePrefix.size(), c_datasetFilePrefix) != 0)
+            continue;
+        string const number = name.substr(c_datasetFilePrefix.size());
+        if (number.empty() || number.find_first_not_of("0123456789") != string::npos ||
+            number.size() > 9 || stoi(number) >= _epoch - 1)
+            continue;
+
+        boost::system::error_code removeError;
+        if (boost::filesystem::remove(it->path(), removeError))
+            cnote << "Deleted the Ethash dataset file " << it->path();
+        else if (removeError)
+            cwarn << "Cannot delete " << it->path() << ": " << removeError.message();
+    }
+}
+
+void EthashEpochManager::setDatasetDirectory(boost::filesystem::path const& _dir)
+{
+    Guard l(x_dataset);
+    m_datasetDir = _dir;
+}
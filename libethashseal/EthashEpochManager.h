@@ -0,0 +1,80 @@
+// Copyright 2018 cpp-ethereum Authors.
+// Licensed under the GNU General Public License v3. See the LICENSE file.
+
+#pragma once
+
+#include "EthashDataset.h"
+
+#include <libdevcore/Guards.h>
+
+#include <ethash/ethash.hpp>
+
+#include <boost/filesystem/path.hpp>
+
+#include <atomic>
+#include <future>
+#include <map>
+#include <memory>
+#include <thread>
+
+namespace dev
+{
+namespace eth
+{
+/**
+ * @brief Owns the Ethash light caches and datasets shared by all verifiers and miners.
+ *
+ * A light cache is generated once, by the first thread to ask for it, while the others wait for
+ * the same result. Whenever an epoch is asked for, the light cache of the one after it is
+ * generated in the background, so crossing an epoch boundary finds it ready. The caches of the
+ * epochs next to the last one asked for are kept.
+ *
+ * If a dataset directory is set, datasets are mapped from files in it, and the items generated
+ * by earlier runs are found there on restart.
+ */
+class EthashEpochManager
+{
+public:
+    using LightContext = std::shared_ptr<ethash::epoch_context const>;
+
+    static EthashEpochManager& get();
+
+    ~EthashEpochManager();
+
+    /// @returns the light cache of @a _epoch.
+    LightContext light(int _epoch);
+
+    /// @returns the dataset of @a _epoch. All callers share one instance for the latest epoch asked
+    /// for; the dataset of an earlier one is freed once nobody uses it.
+    std::shared_ptr<EthashDataset> dataset(int _epoch);
+
+    /// Keeps datasets in files in @a _dir from now on. An empty path keeps them in memory.
+    /// Files of epochs before the previous one are deleted as later epochs are mapped.
+    void setDatasetDirectory(boost::filesystem::path const& _dir);
+
+private:
+    EthashEpochManager() = default;
+
+    /// Starts generating the light cache of @a _epoch on the background thread unless it is known.
+    void prefetch(int _epoch);
+
+    /// @returns the pending or ready light cache of @a _epoch, and a task to run if it is neither.
+    std::shared_future<LightContext> lookup_WITH_LOCK(
+        int _epoch, std::packaged_task<LightContext()>& o_task);
+
+    /// Deletes the dataset files of the epochs before @a _epoch - 1.
+    void pruneDatasetFiles_WITH_LOCK(int _epoch);
+
+    Mutex x_light;
+    std::map<int, std::shared_future<LightContext>> m_light;
+
+    std::thread m_prefetcher;
+    std::atomic<bool> m_prefetching{false};
+
+    Mutex x_dataset;
+    std::weak_ptr<EthashDataset> m_dataset;
+    boost::filesystem::path m_datasetDir;
+};
+
+}  // namespace eth
+}  // namespace dev
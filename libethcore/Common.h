@@ -226,7 +226,9 @@ struct WorkingProgress
 //	MiningProgress& operator+=(MiningProgress const& _mp) { hashes += _mp.hashes; ms = std::max(ms, _mp.ms); return *this; }
 	uint64_t hashes = 0;		///< Total number of hashes computed.
 	uint64_t ms = 0;			///< Total number of milliseconds of mining thus far.
+	std::vector<uint64_t> minerHashes;	///< Number of hashes computed by each miner.
 	u256 rate() const { return ms == 0 ? 0 : hashes * 1000 / ms; }
+	u256 minerRate(unsigned _i) const { return ms == 0 ? 0 : minerHashes[_i] * 1000 / ms; }
 };
 
 /// Import transaction policy
@@ -34,6 +34,13 @@ void SealEngineFace::verify(Strictness _s, BlockHeader const& _bi, BlockHeader c
 	_bi.verify(_s, _parent, _block);
 }
 
+void SealEngineFace::verifySeals(std::vector<BlockHeader> const& _headers, unsigned _sampleEvery) const
+{
+	for (size_t i = 0; i < _headers.size(); ++i)
+		if (isSampled(_headers, i, _sampleEvery))
+			verify(CheckEverything, _headers[i]);
+}
+
 void SealEngineFace::populateFromParent(BlockHeader& _bi, BlockHeader const& _parent) const
 {
 	_bi.populateFromParent(_parent);
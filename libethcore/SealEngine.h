@@ -55,6 +55,10 @@ public:
 
 	/// Don't forget to call Super::verify when subclassing & overriding.
 	virtual void verify(Strictness _s, BlockHeader const& _bi, BlockHeader const& _parent = BlockHeader(), bytesConstRef _block = bytesConstRef()) const;
+	/// Checks the seals of @a _headers, which are given in chain order, throwing on the first invalid one.
+	/// With @a _sampleEvery above 1, only headers whose number is a multiple of it and the last one are checked.
+	/// By default every checked header goes through a full verify().
+	virtual void verifySeals(std::vector<BlockHeader> const& _headers, unsigned _sampleEvery = 1) const;
 	/// Additional verification for transactions in blocks.
 	virtual void verifyTransaction(ImportRequirements::value _ir, TransactionBase const& _t, BlockHeader const& _header, u256 const& _startGasUsed) const;
 	/// Don't forget to call Super::populateFromParent when subclassing & overriding.
@@ -88,6 +92,12 @@ public:
 protected:
 	virtual bool onOptionChanging(std::string const&, bytes const&) { return true; }
 
+	/// @returns true if verifySeals() with @a _sampleEvery has to check the seal of header @a _i.
+	static bool isSampled(std::vector<BlockHeader> const& _headers, size_t _i, unsigned _sampleEvery)
+	{
+		return _sampleEvery <= 1 || _i + 1 == _headers.size() || _headers[_i].number() % _sampleEvery == 0;
+	}
+
 private:
 	mutable Mutex x_options;
 	std::unordered_map<std::string, bytes> m_options;
@@ -46,13 +46,12 @@ void BasicGasPricer::update(BlockChain const& _bc)
 		BlockHeader bi = _bc.info(p);
 		if (bi.transactionsRoot() != EmptyTrie)
 		{
-			auto bb = _bc.block(p);
-			RLP r(bb);
+			auto const block = _bc.cachedBlock(p);
 			BlockReceipts brs(_bc.receipts(bi.hash()));
 			size_t i = 0;
-			for (auto const& tr: r[1])
+			for (auto const& tr: block->transactionRefs())
 			{
-				Transaction tx(tr.data(), CheckTransaction::None);
+				Transaction tx(tr, CheckTransaction::None);
 				u256 gu = brs.receipts[i].cumulativeGasUsed();
 				dist[tx.gasPrice()] += gu;
 				total += gu;
@@ -35,6 +35,7 @@
 #include "ExtVM.h"
 #include "Executive.h"
 #include "TransactionQueue.h"
+#include "SpeculativeExecution.h"
 #include "GenesisInfo.h"
 using namespace std;
 using namespace dev;
@@ -44,6 +45,8 @@ namespace fs = boost::filesystem;
 #define ETH_TIMED_ENACTMENTS 0
 
 static const unsigned c_maxSyncTransactions = 1024;
+/// Fewer pending transactions than this are just executed one by one.
+static const unsigned c_minSpeculativeTransactions = 8;
 
 namespace
 {
@@ -86,6 +89,7 @@ Block::Block(Block const& _s):
     m_transactions(_s.m_transactions),
     m_receipts(_s.m_receipts),
     m_transactionSet(_s.m_transactionSet),
+    m_footprints(_s.m_footprints),
     m_precommit(_s.m_state),
     m_previousBlock(_s.m_previousBlock),
     m_currentBlock(_s.m_currentBlock),
@@ -105,6 +109,7 @@ Block& Block::operator=(Block const& _s)
     m_transactions = _s.m_transactions;
     m_receipts = _s.m_receipts;
     m_transactionSet = _s.m_transactionSet;
+    m_footprints = _s.m_footprints;
     m_previousBlock = _s.m_previousBlock;
     m_currentBlock = _s.m_currentBlock;
     m_currentBytes = _s.m_currentBytes;
@@ -121,6 +126,7 @@ void Block::resetCurrent(int64_t _timestamp)
     m_transactions.clear();
     m_receipts.clear();
     m_transactionSet.clear();
+    m_footprints.clear();
     m_currentBlock = BlockHeader();
     m_currentBlock.setAuthor(m_author);
     m_currentBlock.setTimestamp(max(m_previousBlock.timestamp() + 1, _timestamp));
@@ -315,102 +321,174 @@ pair<TransactionReceipts, bool> Block::sync(BlockChain const& _bc, TransactionQu
     // TRANSACTIONS
     pair<TransactionReceipts, bool> ret;
 
-    auto ts = _tq.topTransactions(c_maxSyncTransactions, m_transactionSet);
+    // The snapshot stays valid while the loop below drops transactions from the queue.
+    auto pending = _tq.snapshot();
+    vector<TransactionQueue::PendingTransaction const*> ts;
+    for (auto const& p: pending->transactions)
+    {
+        if (ts.size() == c_maxSyncTransactions)
+            break;
+        if (!m_transactionSet.count(p.hash))
+            ts.push_back(&p);
+    }
     ret.second = (ts.size() == c_maxSyncTransactions);	// say there's more to the caller if we hit the limit
 
     assert(_bc.currentHash() == m_currentBlock.parentHash());
     auto deadline =  chrono::steady_clock::now() + chrono::milliseconds(msTimeout);
 
+    // Executes a transaction for real. @returns true if it went into the block.
+    auto tryExecute = [&](Transaction const& t) {
+        try
+        {
+            if (t.gasPrice() >= _gp.ask(*this))
+            {
+                executePending(_bc.lastBlockHashes(), t);
+                ret.first.push_back(m_receipts.back());
+                return true;
+            }
+            else if (t.gasPrice() < _gp.ask(*this) * 9 / 10)
+            {
+                LOG(m_logger)
+                    << t.sha3() << " Dropping El Cheapo transaction (<90% of ask price)";
+                _tq.drop(t.sha3());
+            }
+        }
+        catch (InvalidNonce const& in)
+        {
+            bigint const& req = *boost::get_error_info<errinfo_required>(in);
+            bigint const& got = *boost::get_error_info<errinfo_got>(in);
+
+            if (req > got)
+            {
+                // too old
+                LOG(m_logger) << t.sha3() << " Dropping old transaction (nonce too low)";
+                _tq.drop(t.sha3());
+            }
+            else if (got > req + _tq.waiting(t.sender()))
+            {
+                // too new
+                LOG(m_logger)
+                    << t.sha3() << " Dropping new transaction (too many nonces ahead)";
+                _tq.drop(t.sha3());
+            }
+            else
+                _tq.setFuture(t.sha3());
+        }
+        catch (BlockGasLimitReached const& e)
+        {
+            bigint const& got = *boost::get_error_info<errinfo_got>(e);
+            if (got > m_currentBlock.gasLimit())
+            {
+                LOG(m_logger)
+                    << t.sha3()
+                    << " Dropping over-gassy transaction (gas > block's gas limit)";
+                LOG(m_logger)
+                    << "got: " << got << " required: " << m_currentBlock.gasLimit();
+                _tq.drop(t.sha3());
+            }
+            else
+            {
+                LOG(m_logger) << t.sha3()
+                              << " Temporarily no gas left in current block (txs gas > "
+                                 "block's gas limit)";
+                //_tq.drop(t.sha3());
+                // Temporarily no gas left in current block.
+                // OPTIMISE: could note this and then we don't evaluate until a block that does have the gas left.
+                // for now, just leave alone.
+            }
+        }
+        catch (Exception const& _e)
+        {
+            // Something else went wrong - drop it.
+            LOG(m_logger) << t.sha3() << " Dropping invalid transaction: "
+                          << diagnostic_information(_e);
+            _tq.drop(t.sha3());
+        }
+        catch (std::exception const&)
+        {
+            // Something else went wrong - drop it.
+            _tq.drop(t.sha3());
+            cwarn << t.sha3() << "Transaction caused low-level exception :(";
+        }
+        return false;
+    };
+
+    // Pre-execute the next transaction of every sender in parallel and start the block with the
+    // best paying ones that don't interfere with each other. The rest go through the loop below.
+    if (ts.size() >= c_minSpeculativeTransactions)
+    {
+        uncommitToSeal();
+        vector<Transaction const*> heads;
+        AddressHash senders;
+        for (auto const* p: ts)
+            if (senders.insert(p->transaction->sender()).second)
+                heads.push_back(p->transaction.get());
+
+        EnvInfo const envInfo(info(), _bc.lastBlockHashes(), gasUsed());
+        SpeculativeBlockBuilder const builder(max(thread::hardware_concurrency(), 1u));
+        auto const results = builder.execute(m_state, envInfo, *m_sealEngine, heads, deadline);
+        for (size_t i: SpeculativeBlockBuilder::pack(heads, results, author(), gasLimitRemaining()))
+        {
+            if (chrono::steady_clock::now() > deadline)
+                break;
+            tryExecute(*heads[i]);
+        }
+    }
+
     for (int goodTxs = max(0, (int)ts.size() - 1); goodTxs < (int)ts.size(); )
     {
         goodTxs = 0;
-        for (auto const& t: ts)
-            if (!m_transactionSet.count(t.sha3()))
-            {
-                try
-                {
-                    if (t.gasPrice() >= _gp.ask(*this))
-                    {
-//						Timer t;
-                        execute(_bc.lastBlockHashes(), t);
-                        ret.first.push_back(m_receipts.back());
-                        ++goodTxs;
-//						cnote << "TX took:" << t.elapsed() * 1000;
-                    }
-                    else if (t.gasPrice() < _gp.ask(*this) * 9 / 10)
-                    {
-                        LOG(m_logger)
-                            << t.sha3() << " Dropping El Cheapo transaction (<90% of ask price)";
-                        _tq.drop(t.sha3());
-                    }
-                }
-                catch (InvalidNonce const& in)
-                {
-                    bigint const& req = *boost::get_error_info<errinfo_required>(in);
-                    bigint const& got = *boost::get_error_info<errinfo_got>(in);
-
-                    if (req > got)
-                    {
-                        // too old
-                        LOG(m_logger) << t.sha3() << " Dropping old transaction (nonce too low)";
-                        _tq.drop(t.sha3());
-                    }
-                    else if (got > req + _tq.waiting(t.sender()))
-                    {
-                        // too new
-                        LOG(m_logger)
-                            << t.sha3() << " Dropping new transaction (too many nonces ahead)";
-                        _tq.drop(t.sha3());
-                    }
-                    else
-                        _tq.setFuture(t.sha3());
-                }
-                catch (BlockGasLimitReached const& e)
-                {
-                    bigint const& got = *boost::get_error_info<errinfo_got>(e);
-                    if (got > m_currentBlock.gasLimit())
-                    {
-                        LOG(m_logger)
-                            << t.sha3()
-                            << " Dropping over-gassy transaction (gas > block's gas limit)";
-                        LOG(m_logger)
-                            << "got: " << got << " required: " << m_currentBlock.gasLimit();
-                        _tq.drop(t.sha3());
-                    }
-                    else
-                    {
-                        LOG(m_logger) << t.sha3()
-                                      << " Temporarily no gas left in current block (txs gas > "
-                                         "block's gas limit)";
-                        //_tq.drop(t.sha3());
-                        // Temporarily no gas left in current block.
-                        // OPTIMISE: could note this and then we don't evaluate until a block that does have the gas left.
-                        // for now, just leave alone.
-                    }
-                }
-                catch (Exception const& _e)
-                {
-                    // Something else went wrong - drop it.
-                    LOG(m_logger) << t.sha3() << " Dropping invalid transaction: "
-                                  << diagnostic_information(_e);
-                    _tq.drop(t.sha3());
-                }
-                catch (std::exception const&)
-                {
-                    // Something else went wrong - drop it.
-                    _tq.drop(t.sha3());
-                    cwarn << t.sha3() << "Transaction caused low-level exception :(";
-                }
-            }
+        for (auto const* p: ts)
+            if (!m_transactionSet.count(p->hash) && tryExecute(*p->transaction))
+                ++goodTxs;
         if (chrono::steady_clock::now() > deadline)
         {
             ret.second = true;	// say there's more to the caller if we ended up crossing the deadline.
             break;
         }
+        // Nothing changed, so another pass would fail the same way.
+        if (!goodTxs)
+            break;
     }
     return ret;
 }
 
+bool Block::rebase(BlockChain const& _bc)
+{
+    noteChain(_bc);
+
+    BlockHeader const bi = _bc.info();
+    if (bi == m_previousBlock || bi == m_currentBlock || m_transactions.empty())
+        return sync(_bc, bi.hash(), bi);
+
+    Transactions transactions;
+    TransactionReceipts receipts;
+    vector<shared_ptr<Footprint const>> footprints;
+    swap(transactions, m_transactions);
+    swap(receipts, m_receipts);
+    swap(footprints, m_footprints);
+    EVMSchedule const& schedule = sealEngine()->evmSchedule(m_currentBlock.number());
+
+    sync(_bc, bi.hash(), bi);
+
+    // Crossing a fork changes the rules the transactions ran under.
+    if (&sealEngine()->evmSchedule(m_currentBlock.number()) != &schedule)
+        return true;
+
+    unsigned carried = 0;
+    u256 cumulativeGasUsed = 0;
+    for (size_t i = 0; i < transactions.size(); ++i)
+    {
+        u256 const gasUsed = receipts[i].cumulativeGasUsed() - cumulativeGasUsed;
+        cumulativeGasUsed = receipts[i].cumulativeGasUsed();
+        if (footprints[i] && carryOver(transactions[i], receipts[i], gasUsed, footprints[i]))
+            ++carried;
+    }
+    LOG(m_loggerDetailed) << "Carried " << carried << " of " << transactions.size()
+                          << " pending transactions over to " << bi.hash();
+    return true;
+}
+
 u256 Block::enactOn(VerifiedBlockRef const& _block, BlockChain const& _bc)
 {
     noteChain(_bc);
@@ -671,11 +749,77 @@ ExecutionResult Block::execute(LastBlockHashesFace const& _lh, Transaction const
         m_transactions.push_back(_t);
         m_receipts.push_back(resultReceipt.second);
         m_transactionSet.insert(_t.sha3());
+        m_footprints.emplace_back();
     }
 
     return resultReceipt.first;
 }
 
+void Block::executePending(LastBlockHashesFace const& _lh, Transaction const& _t)
+{
+    // Code may read the block number, time or hashes, which all change with the parent, so only
+    // transactions that run none are worth a footprint. Touching the author ties a transaction to
+    // the fees of all those before it.
+    uncommitToSeal();
+    Address const& to = _t.receiveAddress();
+    if (_t.isCreation() || _t.sender() == author() || to == author() || m_state.addressHasCode(to))
+    {
+        execute(_lh, _t);
+        return;
+    }
+
+    auto footprint = make_shared<Footprint>();
+    for (Address const& a: {_t.sender(), to})
+        footprint->before.emplace_back(a, m_state.committedAccount(a));
+
+    AddressHash accessed;
+    m_state.recordAccess(&accessed);
+    {
+        ScopeGuard stopRecording([&]() { m_state.recordAccess(nullptr); });
+        execute(_lh, _t);
+    }
+
+    for (auto const& a: footprint->before)
+        accessed.erase(a.first);
+    accessed.erase(author());
+    if (!accessed.empty())
+        return;
+
+    for (auto const& a: footprint->before)
+        footprint->after.emplace_back(a.first, m_state.committedAccount(a.first));
+    m_footprints.back() = footprint;
+}
+
+bool Block::carryOver(Transaction const& _t, TransactionReceipt const& _receipt,
+    u256 const& _gasUsed, shared_ptr<Footprint const> const& _footprint)
+{
+    if (gasUsed() + _t.gas() > m_currentBlock.gasLimit())
+        return false;
+    for (auto const& a: _footprint->before)
+        if (m_state.committedAccount(a.first) != a.second)
+            return false;
+
+    // Same accounts and same rules, so the same outcome. Only the fee goes to the author on top of
+    // whatever the account holds now.
+    uncommitToSeal();
+    for (auto const& a: _footprint->after)
+        m_state.setCommittedAccount(a.first, a.second);
+    m_state.addBalance(author(), _gasUsed * _t.gasPrice());
+    ChainOperationParams const& params = m_sealEngine->chainParams();
+    m_state.commit(info().number() >= params.EIP158ForkBlock ?
+        State::CommitBehaviour::RemoveEmptyAccounts :
+        State::CommitBehaviour::KeepEmptyAccounts);
+
+    u256 const cumulativeGasUsed = gasUsed() + _gasUsed;
+    m_transactions.push_back(_t);
+    m_receipts.push_back(info().number() >= params.byzantiumForkBlock ?
+        TransactionReceipt(_receipt.statusCode(), cumulativeGasUsed, _receipt.log()) :
+        TransactionReceipt(rootHash(), cumulativeGasUsed, _receipt.log()));
+    m_transactionSet.insert(_t.sha3());
+    m_footprints.push_back(_footprint);
+    return true;
+}
+
 void Block::applyRewards(vector<BlockHeader> const& _uncleBlockHeaders, u256 const& _blockReward)
 {
     u256 r = _blockReward;
@@ -223,6 +223,13 @@ public:
     /// Sync with the block chain, but rather than synching to the latest block, instead sync to the given block.
     bool sync(BlockChain const& _bc, h256 const& _blockHash, BlockHeader const& _bi = BlockHeader());
 
+    /// Sync with the block chain, keeping what we can of the pending transactions.
+    /// A transaction that ran no code and finds its accounts as it left them on the old parent is
+    /// carried over without being executed again. The others, and those that depend on them, are
+    /// dropped from the block for a later sync with the transaction queue to execute afresh.
+    /// @returns true if the block changed, as sync() does.
+    bool rebase(BlockChain const& _bc);
+
     /// Execute all transactions within a given block.
     /// @returns the additional total difficulty.
     u256 enactOn(VerifiedBlockRef const& _block, BlockChain const& _bc);
@@ -282,6 +289,22 @@ private:
     /// Throws on failure.
     u256 enact(VerifiedBlockRef const& _block, BlockChain const& _bc);
 
+    /// Trie entries of the accounts a pending transaction touched, before and after it ran.
+    struct Footprint
+    {
+        std::vector<std::pair<Address, std::string>> before;
+        std::vector<std::pair<Address, std::string>> after;
+    };
+
+    /// Executes a transaction from the queue, noting its footprint if it could be carried over to
+    /// another parent.
+    void executePending(LastBlockHashesFace const& _lh, Transaction const& _t);
+
+    /// Applies a transaction of the previous parent from its footprint instead of executing it.
+    /// @returns false if the accounts it touched are not as it found them.
+    bool carryOver(Transaction const& _t, TransactionReceipt const& _receipt, u256 const& _gasUsed,
+        std::shared_ptr<Footprint const> const& _footprint);
+
     /// Finalise the block, applying the earned rewards.
     void applyRewards(std::vector<BlockHeader> const& _uncleBlockHeaders, u256 const& _blockReward);
 
@@ -298,6 +321,7 @@ private:
     Transactions m_transactions;				///< The current list of transactions that we've included in the state.
     TransactionReceipts m_receipts;				///< The corresponding list of transaction receipts.
     h256Hash m_transactionSet;					///< The set of transaction hashes that we've included in the state.
+    std::vector<std::shared_ptr<Footprint const>> m_footprints;	///< Parallel to m_transactions; null if a transaction can't be carried over.
     State m_precommit;							///< State at the point immediately prior to rewards.
 
     BlockHeader m_previousBlock;				///< The previous block's information.
@@ -22,6 +22,7 @@
 #include "BlockChain.h"
 
 #include "Block.h"
+#include "BulkImport.h"
 #include "Defaults.h"
 #include "GenesisInfo.h"
 #include "ImportPerformanceLogger.h"
@@ -169,6 +170,9 @@ static const unsigned c_maxCacheSize = 1024 * 1024 * 64;
 /// Min size, below which we don't bother flushing it.
 static const unsigned c_minCacheSize = 1024 * 1024 * 32;
 
+/// Longest a transaction lookup waits for the background indexer before reporting a miss.
+static const chrono::milliseconds c_indexerWait = chrono::milliseconds(500);
+
 
 BlockChain::BlockChain(ChainParams const& _p, fs::path const& _dbPath, WithExisting _we, ProgressCallback const& _pc):
     m_lastBlockHashes(new LastBlockHashes(*this)),
@@ -193,6 +197,7 @@ BlockHeader const& BlockChain::genesis() const
         m_genesis = BlockHeader(gb);
         m_genesisHeaderBytes = BlockHeader::extractHeader(&gb).data().toBytes();
         m_genesisHash = m_genesis.hash();
+        m_genesisBlock = make_shared<CachedBlock const>(move(gb));
     }
     return m_genesis;
 }
@@ -287,6 +292,14 @@ unsigned BlockChain::open(fs::path const& _path, WithExisting _we)
 
     m_lastBlockNumber = number(m_lastBlockHash);
 
+    if (m_params.secondaryIndexes)
+    {
+        m_indexer.reset(new ChainIndexer(*this, *m_blocksDB, *m_extrasDB));
+        m_indexer->start();
+    }
+    else
+        ChainIndexer::invalidate(*m_extrasDB);
+
     ctrace << "Opened blockchain DB. Latest: " << currentHash() << (lastMinor == c_minorProtocolVersion ? "(rebuild not needed)" : "*** REBUILD NEEDED ***");
     return lastMinor;
 }
@@ -308,6 +321,7 @@ void BlockChain::close()
 {
     ctrace << "Closing blockchain DB";
     // Not thread safe...
+    m_indexer.reset();
     m_extrasDB.reset();
     m_blocksDB.reset();
     DEV_WRITE_GUARDED(x_lastBlockHash)
@@ -342,6 +356,7 @@ void BlockChain::rebuild(fs::path const& _path, std::function<void(unsigned, uns
     ///////////////////////////////
 
     // Keep extras DB around, but under a temp name
+    m_indexer.reset();
     m_extrasDB.reset();
     fs::rename(extrasPath / fs::path("extras"), extrasPath / fs::path("extras.old"));
     std::unique_ptr<db::DatabaseFace> oldExtrasDB(
@@ -367,39 +382,72 @@ void BlockChain::rebuild(fs::path const& _path, std::function<void(unsigned, uns
     m_extrasDB->insert(toSlice(m_lastBlockHash, ExtraDetails),
         (db::Slice)dev::ref(m_details[m_lastBlockHash].rlp()));
 
+    // Secondary indexes are built in bulk once all blocks are re-imported.
+    if (m_params.secondaryIndexes)
+        m_indexer.reset(new ChainIndexer(*this, *m_blocksDB, *m_extrasDB));
+    else
+        ChainIndexer::invalidate(*m_extrasDB);
+
+    // Blocks are verified on all cores and then executed in order. They are read straight from
+    // the database; going through the block cache would only evict everything else from it.
     h256 lastHash = m_lastBlockHash;
+    bool disjoint = false;
     Timer t;
-    for (unsigned d = 1; d <= originalNumber; ++d)
-    {
-        if (!(d % 1000))
-        {
-            cerr << "\n1000 blocks in " << t.elapsed() << "s = " << (1000.0 / t.elapsed()) << "b/s" << endl;
-            t.restart();
-        }
-        try
-        {
-            bytes b = block(queryExtras<BlockHash, uint64_t, ExtraBlockHash>(
-                d, m_blockHashes, x_blockHashes, NullBlockHash, oldExtrasDB.get())
-                                .value);
-
-            BlockHeader bi(&b);
+    BlockVerificationPipeline pipeline(*this, max(thread::hardware_concurrency(), 1u));
+    pipeline.run(originalNumber,
+        [&](unsigned _index, bytes& o_storage) {
+            h256 const hash =
+                BlockHash(RLP(oldExtrasDB->lookup(toSlice(h256(_index + 1), ExtraBlockHash))))
+                    .value;
+            std::string const b = m_blocksDB->lookup(toSlice(hash));
+            o_storage.assign(b.begin(), b.end());
+            return bytesConstRef(&o_storage);
+        },
+        [&](unsigned _index, VerifiedBlockRef const& _block, std::exception_ptr const& _error) {
+            unsigned const d = _index + 1;
+            if (!(d % 1000))
+            {
+                cerr << "\n1000 blocks in " << t.elapsed() << "s = " << (1000.0 / t.elapsed()) << "b/s" << endl;
+                t.restart();
+            }
+            if (_error)
+                // Failed to verify - stop here.
+                return false;
 
-            if (bi.parentHash() != lastHash)
+            if (_block.info.parentHash() != lastHash)
             {
-                cwarn << "DISJOINT CHAIN DETECTED; " << bi.hash() << "#" << d << " -> parent is" << bi.parentHash() << "; expected" << lastHash << "#" << (d - 1);
-                return;
+                cwarn << "DISJOINT CHAIN DETECTED; " << _block.info.hash() << "#" << d << " -> parent is" << _block.info.parentHash() << "; expected" << lastHash << "#" << (d - 1);
+                disjoint = true;
+                return false;
             }
-            lastHash = bi.hash();
-            import(b, s.db(), 0);
-        }
-        catch (...)
-        {
-            // Failed to import - stop here.
-            break;
-        }
+            lastHash = _block.info.hash();
+            try
+            {
+                import(_block, s.db(), 0);
+            }
+            catch (...)
+            {
+                // Failed to import - stop here.
+                return false;
+            }
+
+            if (_progress)
+                _progress(d, originalNumber);
+            return true;
+        });
+
+    if (disjoint)
+    {
+        if (m_indexer)
+            m_indexer->start();
+        return;
+    }
 
-        if (_progress)
-            _progress(d, originalNumber);
+    if (m_indexer)
+    {
+        cnote << "Rebuilding transaction indexes...";
+        m_indexer->catchUp(max(thread::hardware_concurrency(), 1u));
+        m_indexer->start();
     }
 
     fs::remove_all(path / fs::path("extras.old"));
@@ -719,6 +767,44 @@ ImportRoute BlockChain::insertWithoutParent(bytes const& _block, bytesConstRef _
     return insertBlockAndExtras(block, _receipts, _totalDifficulty, performanceLogger);
 }
 
+BlockLogBlooms BlockChain::logBlooms(h256 const& _hash) const
+{
+    BlockLogBlooms blb = queryExtras<BlockLogBlooms, ExtraLogBlooms>(_hash, m_logBlooms, x_logBlooms, NullBlockLogBlooms);
+    if (blb.blooms.empty())
+        // Not indexed (yet), e.g. the block isn't canonical or indexing is disabled.
+        for (auto const& r: receipts(_hash).receipts)
+            blb.blooms.push_back(r.bloom());
+    return blb;
+}
+
+TransactionAddress BlockChain::transactionAddress(h256 const& _transactionHash) const
+{
+    auto const canonicalAddress = [&]() {
+        TransactionAddress ta = queryExtras<TransactionAddress, ExtraTransactionAddress>(_transactionHash, m_transactionAddresses, x_transactionAddresses, NullTransactionAddress);
+        if (ta && numberHash(number(ta.blockHash)) != ta.blockHash)
+        {
+            // Left over from a branch that was reorganised away and that the indexer hasn't
+            // rewritten yet.
+            DEV_WRITE_GUARDED(x_transactionAddresses)
+                m_transactionAddresses.erase(_transactionHash);
+            return NullTransactionAddress;
+        }
+        return ta;
+    };
+
+    TransactionAddress ta = canonicalAddress();
+    if (ta || !m_indexer)
+        return ta;
+
+    // The transaction might be in a block the indexer hasn't got to yet. Give it a moment rather
+    // than indexing the whole backlog on the caller's thread, but only up to the current head, so
+    // that lookups of pending transactions aren't held up by blocks imported meanwhile.
+    unsigned const head = number();
+    if (m_indexer->nextNumber() <= head && m_indexer->waitUntilIndexed(head, c_indexerWait))
+        ta = canonicalAddress();
+    return ta;
+}
+
 void BlockChain::checkBlockIsNew(VerifiedBlockRef const& _block) const
 {
     if (isKnown(_block.info.hash()))
@@ -769,12 +855,7 @@ ImportRoute BlockChain::insertBlockAndExtras(VerifiedBlockRef const& _block, byt
         extrasWriteBatch->insert(
             toSlice(_block.info.hash(), ExtraDetails), (db::Slice)dev::ref(details.rlp()));
 
-        BlockLogBlooms blb;
-        for (auto i: RLP(_receipts))
-            blb.blooms.push_back(TransactionReceipt(i.data()).bloom());
-        extrasWriteBatch->insert(
-            toSlice(_block.info.hash(), ExtraLogBlooms), (db::Slice)dev::ref(blb.rlp()));
-
+        // Log blooms and transaction addresses are written by the indexer.
         extrasWriteBatch->insert(toSlice(_block.info.hash(), ExtraReceipts), (db::Slice)_receipts);
 
         _performanceLogger.onStageFinished("writing");
@@ -812,7 +893,7 @@ ImportRoute BlockChain::insertBlockAndExtras(VerifiedBlockRef const& _block, byt
             if (*i == _block.info.hash())
                 tbi = _block.info;
             else
-                tbi = BlockHeader(block(*i));
+                tbi = BlockHeader(cachedBlock(*i)->ref());
 
             // Collate logs into blooms.
             h256s alteredBlooms;
@@ -833,19 +914,6 @@ ImportRoute BlockChain::insertBlockAndExtras(VerifiedBlockRef const& _block, byt
                     m_blocksBlooms[alteredBlooms.back()].blooms[o] |= blockBloom;
                 }
             }
-            // Collate transaction hashes and remember who they were.
-            //h256s newTransactionAddresses;
-            {
-                bytes blockBytes;
-                RLP blockRLP(*i == _block.info.hash() ? _block.block : &(blockBytes = block(*i)));
-                TransactionAddress ta;
-                ta.blockHash = tbi.hash();
-                for (ta.index = 0; ta.index < blockRLP[1].itemCount(); ++ta.index)
-                    extrasWriteBatch->insert(
-                        toSlice(sha3(blockRLP[1][ta.index].data()), ExtraTransactionAddress),
-                        (db::Slice)dev::ref(ta.rlp()));
-            }
-
             // Update database with them.
             ReadGuard l1(x_blocksBlooms);
             for (auto const& h: alteredBlooms)
@@ -942,6 +1010,10 @@ ImportRoute BlockChain::insertBlockAndExtras(VerifiedBlockRef const& _block, byt
     checkConsistency();
 #endif // ETH_PARANOIA
 
+    // Blocks replaced by the new branch have to be indexed again.
+    if (isImportedAndBest && common != last && m_indexer)
+        m_indexer->noteCanonChanged(number(common) + 1);
+
     _performanceLogger.onStageFinished("checkBest");
 
     unsigned const gasPerSecond = static_cast<double>(_block.info.gasUsed()) / _performanceLogger.stageDuration("enactment");
@@ -1071,6 +1143,8 @@ void BlockChain::rewind(unsigned _newHead)
         if (_newHead >= m_lastBlockNumber)
             return;
         clearCachesDuringChainReversion(_newHead + 1);
+        if (m_indexer)
+            m_indexer->noteCanonChanged(_newHead + 1);
         m_lastBlockHash = numberHash(_newHead);
         m_lastBlockNumber = _newHead;
         try
@@ -1166,7 +1240,7 @@ void BlockChain::updateStats() const
     m_lastStats.memBlocks = 0;
     DEV_READ_GUARDED(x_blocks)
         for (auto const& i: m_blocks)
-            m_lastStats.memBlocks += i.second.size() + 64;
+            m_lastStats.memBlocks += i.second->size() + 64;
     DEV_READ_GUARDED(x_details)
         m_lastStats.memDetails = getHashSize(m_details);
     size_t logBloomsSize = 0;
@@ -1370,9 +1444,8 @@ h256Hash BlockChain::allKinFrom(h256 const& _parent, unsigned _generations) cons
     for (unsigned i = 0; i < _generations && p != m_genesisHash; ++i, p = details(p).parent)
     {
         ret.insert(details(p).parent);
-        auto b = block(p);
-        for (auto i: RLP(b)[2])
-            ret.insert(sha3(i.data()));
+        for (auto const& h: cachedBlock(p)->uncleHashes())
+            ret.insert(h);
     }
     return ret;
 }
@@ -1396,10 +1469,11 @@ bool BlockChain::isKnown(h256 const& _hash, bool _isCurrent) const
     return !_isCurrent || details(_hash).number <= m_lastBlockNumber;       // to allow rewind functionality.
 }
 
-bytes BlockChain::block(h256 const& _hash) const
+CachedBlockPtr BlockChain::cachedBlock(h256 const& _hash) const
 {
     if (_hash == m_genesisHash)
-        return m_params.genesisBlock();
+        DEV_READ_GUARDED(x_genesis)
+            return m_genesisBlock;
 
     {
         ReadGuard l(x_blocks);
@@ -1412,16 +1486,14 @@ bytes BlockChain::block(h256 const& _hash) const
     if (d.empty())
     {
         cwarn << "Couldn't find requested block:" << _hash;
-        return bytes();
+        return make_shared<CachedBlock const>(bytes());
     }
 
     noteUsed(_hash);
 
+    auto block = make_shared<CachedBlock const>(bytesConstRef(d));
     WriteGuard l(x_blocks);
-    m_blocks[_hash].resize(d.size());
-    memcpy(m_blocks[_hash].data(), d.data(), d.size());
-
-    return m_blocks[_hash];
+    return m_blocks.emplace(_hash, move(block)).first->second;
 }
 
 bytes BlockChain::headerData(h256 const& _hash) const
@@ -1429,27 +1501,7 @@ bytes BlockChain::headerData(h256 const& _hash) const
     if (_hash == m_genesisHash)
         return m_genesisHeaderBytes;
 
-    {
-        ReadGuard l(x_blocks);
-        auto it = m_blocks.find(_hash);
-        if (it != m_blocks.end())
-            return BlockHeader::extractHeader(&it->second).data().toBytes();
-    }
-
-    string const d = m_blocksDB->lookup(toSlice(_hash));
-    if (d.empty())
-    {
-        cwarn << "Couldn't find requested block:" << _hash;
-        return bytes();
-    }
-
-    noteUsed(_hash);
-
-    WriteGuard l(x_blocks);
-    m_blocks[_hash].resize(d.size());
-    memcpy(m_blocks[_hash].data(), d.data(), d.size());
-
-    return BlockHeader::extractHeader(&m_blocks[_hash]).data().toBytes();
+    return cachedBlock(_hash)->header().toBytes();
 }
 
 Block BlockChain::genesisBlock(OverlayDB const& _db) const
@@ -24,6 +24,8 @@
 #include "Account.h"
 #include "BlockDetails.h"
 #include "BlockQueue.h"
+#include "CachedBlock.h"
+#include "ChainIndexer.h"
 #include "ChainParams.h"
 #include "LastBlockHashesFace.h"
 #include "State.h"
@@ -76,7 +78,7 @@ std::unordered_map<Address, Account> const& genesisState();
 db::Slice toSlice(h256 const& _h, unsigned _sub = 0);
 db::Slice toSlice(uint64_t _n, unsigned _sub = 0);
 
-using BlocksHash = std::unordered_map<h256, bytes>;
+using BlocksHash = std::unordered_map<h256, CachedBlockPtr>;
 using TransactionHashes = h256s;
 using UncleHashes = h256s;
 
@@ -146,9 +148,13 @@ public:
     BlockHeader info() const { return info(currentHash()); }
 
     /// Get a block (RLP format) for the given hash (or the most recent mined if none given). Thread-safe.
-    bytes block(h256 const& _hash) const;
+    bytes block(h256 const& _hash) const { return cachedBlock(_hash)->block(); }
     bytes block() const { return block(currentHash()); }
 
+    /// Get a shared, immutable handle to the block for the given hash without copying it. For an
+    /// unknown block the handle points to an empty block (CachedBlock::empty()). Thread-safe.
+    CachedBlockPtr cachedBlock(h256 const& _hash) const;
+
     /// Get a block (RLP format) for the given hash (or the most recent mined if none given). Thread-safe.
     bytes headerData(h256 const& _hash) const;
     bytes headerData() const { return headerData(currentHash()); }
@@ -158,7 +164,7 @@ public:
     BlockDetails details() const { return details(currentHash()); }
 
     /// Get the transactions' log blooms of a block (or the most recent mined if none given). Thread-safe.
-    BlockLogBlooms logBlooms(h256 const& _hash) const { return queryExtras<BlockLogBlooms, ExtraLogBlooms>(_hash, m_logBlooms, x_logBlooms, NullBlockLogBlooms); }
+    BlockLogBlooms logBlooms(h256 const& _hash) const;
     BlockLogBlooms logBlooms() const { return logBlooms(currentHash()); }
 
     /// Get the transactions' receipts of a block (or the most recent mined if none given). Thread-safe.
@@ -170,14 +176,14 @@ public:
     TransactionReceipt transactionReceipt(h256 const& _blockHash, unsigned _i) const { return receipts(_blockHash).receipts[_i]; }
 
     /// Get the transaction receipt by transaction hash. Thread-safe.
-    TransactionReceipt transactionReceipt(h256 const& _transactionHash) const { TransactionAddress ta = queryExtras<TransactionAddress, ExtraTransactionAddress>(_transactionHash, m_transactionAddresses, x_transactionAddresses, NullTransactionAddress); if (!ta) return bytesConstRef(); return transactionReceipt(ta.blockHash, ta.index); }
+    TransactionReceipt transactionReceipt(h256 const& _transactionHash) const { TransactionAddress ta = transactionAddress(_transactionHash); if (!ta) return bytesConstRef(); return transactionReceipt(ta.blockHash, ta.index); }
 
     /// Get a list of transaction hashes for a given block. Thread-safe.
-    TransactionHashes transactionHashes(h256 const& _hash) const { auto b = block(_hash); RLP rlp(b); h256s ret; for (auto t: rlp[1]) ret.push_back(sha3(t.data())); return ret; }
+    TransactionHashes transactionHashes(h256 const& _hash) const { return cachedBlock(_hash)->transactionHashes(); }
     TransactionHashes transactionHashes() const { return transactionHashes(currentHash()); }
 
     /// Get a list of uncle hashes for a given block. Thread-safe.
-    UncleHashes uncleHashes(h256 const& _hash) const { auto b = block(_hash); RLP rlp(b); h256s ret; for (auto t: rlp[2]) ret.push_back(sha3(t.data())); return ret; }
+    UncleHashes uncleHashes(h256 const& _hash) const { return cachedBlock(_hash)->uncleHashes(); }
     UncleHashes uncleHashes() const { return uncleHashes(currentHash()); }
     
     /// Get the hash for a given block's number.
@@ -206,18 +212,18 @@ public:
     std::vector<unsigned> withBlockBloom(LogBloom const& _b, unsigned _earliest, unsigned _latest, unsigned _topLevel, unsigned _index) const;
 
     /// Returns true if transaction is known. Thread-safe
-    bool isKnownTransaction(h256 const& _transactionHash) const { TransactionAddress ta = queryExtras<TransactionAddress, ExtraTransactionAddress>(_transactionHash, m_transactionAddresses, x_transactionAddresses, NullTransactionAddress); return !!ta; }
+    bool isKnownTransaction(h256 const& _transactionHash) const { return !!transactionAddress(_transactionHash); }
 
     /// Get a transaction from its hash. Thread-safe.
-    bytes transaction(h256 const& _transactionHash) const { TransactionAddress ta = queryExtras<TransactionAddress, ExtraTransactionAddress>(_transactionHash, m_transactionAddresses, x_transactionAddresses, NullTransactionAddress); if (!ta) return bytes(); return transaction(ta.blockHash, ta.index); }
-    std::pair<h256, unsigned> transactionLocation(h256 const& _transactionHash) const { TransactionAddress ta = queryExtras<TransactionAddress, ExtraTransactionAddress>(_transactionHash, m_transactionAddresses, x_transactionAddresses, NullTransactionAddress); if (!ta) return std::pair<h256, unsigned>(h256(), 0); return std::make_pair(ta.blockHash, ta.index); }
+    bytes transaction(h256 const& _transactionHash) const { TransactionAddress ta = transactionAddress(_transactionHash); if (!ta) return bytes(); return transaction(ta.blockHash, ta.index); }
+    std::pair<h256, unsigned> transactionLocation(h256 const& _transactionHash) const { TransactionAddress ta = transactionAddress(_transactionHash); if (!ta) return std::pair<h256, unsigned>(h256(), 0); return std::make_pair(ta.blockHash, ta.index); }
 
     /// Get a block's transaction (RLP format) for the given block hash (or the most recent mined if none given) & index. Thread-safe.
-    bytes transaction(h256 const& _blockHash, unsigned _i) const { bytes b = block(_blockHash); return RLP(b)[1][_i].data().toBytes(); }
+    bytes transaction(h256 const& _blockHash, unsigned _i) const { return cachedBlock(_blockHash)->transaction(_i).toBytes(); }
     bytes transaction(unsigned _i) const { return transaction(currentHash(), _i); }
 
     /// Get all transactions from a block.
-    std::vector<bytes> transactions(h256 const& _blockHash) const { bytes b = block(_blockHash); std::vector<bytes> ret; for (auto const& i: RLP(b)[1]) ret.push_back(i.data().toBytes()); return ret; }
+    std::vector<bytes> transactions(h256 const& _blockHash) const { auto b = cachedBlock(_blockHash); std::vector<bytes> ret; for (auto const& i: b->transactionRefs()) ret.push_back(i.toBytes()); return ret; }
     std::vector<bytes> transactions() const { return transactions(currentHash()); }
 
     /// Get a number for the given hash (or the most recent mined if none given). Thread-safe.
@@ -330,6 +336,9 @@ private:
     void checkBlockIsNew(VerifiedBlockRef const& _block) const;
     void checkBlockTimestamp(BlockHeader const& _header) const;
 
+    /// Looks up where a transaction was mined, waiting for the indexer if it is behind.
+    TransactionAddress transactionAddress(h256 const& _transactionHash) const;
+
     template <class T, class K, unsigned N>
     T queryExtras(K const& _h, std::unordered_map<K, T>& _m, boost::shared_mutex& _x, T const& _n,
         db::DatabaseFace* _extrasDB = nullptr) const
@@ -400,6 +409,9 @@ private:
     std::unique_ptr<db::DatabaseFace> m_blocksDB;
     std::unique_ptr<db::DatabaseFace> m_extrasDB;
 
+    /// Maintains the transaction and log bloom indexes; null if they're disabled.
+    std::unique_ptr<ChainIndexer> m_indexer;
+
     /// Hash of the last (valid) block on the longest chain.
     mutable boost::shared_mutex x_lastBlockHash; // should protect both m_lastBlockHash and m_lastBlockNumber
     h256 m_lastBlockHash;
@@ -411,6 +423,7 @@ private:
     mutable BlockHeader m_genesis;  // mutable because they're effectively memos.
     mutable bytes m_genesisHeaderBytes; // mutable because they're effectively memos.
     mutable h256 m_genesisHash;     // mutable because they're effectively memos.
+    mutable CachedBlockPtr m_genesisBlock;  // mutable because they're effectively memos.
 
     std::function<void(Exception&)> m_onBad;                                    ///< Called if we have a block that doesn't verify.
     std::function<void(BlockHeader const&)> m_onBlockImport;                                        ///< Called if we have imported a new block into the db
@@ -40,6 +40,14 @@ using namespace p2p;
 unsigned const c_maxPeerUknownNewBlocks = 1024; /// Max number of unknown new blocks peer can give us
 unsigned const c_maxRequestHeaders = 1024;
 unsigned const c_maxRequestBodies = 1024;
+unsigned const c_initialRequestHeaders = 192; ///< Headers asked from a peer we have no measurements for
+unsigned const c_minRequestHeaders = 32;
+unsigned const c_initialRequestBodies = 64; ///< Bodies asked from a peer we have no measurements for
+unsigned const c_minRequestBodies = 8;
+double const c_targetResponseTime = 2.0; ///< Seconds a request should take given the peer's rate
+double const c_minRequestTimeout = 2.0;
+double const c_maxRequestTimeout = 8.0; ///< Below the time after which EthereumPeer disconnects
+double const c_slowPeerRatio = 0.25; ///< Peers slower than this fraction of the fastest peer are slow
 
 
 std::ostream& dev::eth::operator<<(std::ostream& _out, SyncStatus const& _sync)
@@ -188,6 +196,7 @@ void BlockChainSync::onBlockImported(BlockHeader const& _info)
         m_lastImportedBlock = static_cast<unsigned>(_info.number());
         m_lastImportedBlockHash = _info.hash();
         m_highestBlock = max(m_lastImportedBlock, m_highestBlock);
+        m_skeleton.prune(m_lastImportedBlock);
     }
 }
 
@@ -211,7 +220,7 @@ void BlockChainSync::onPeerStatus(std::shared_ptr<EthereumPeer> _peer)
         return; // Expired
     if (_peer->m_genesisHash != host().chain().genesisHash())
         _peer->disable("Invalid genesis hash");
-    else if (_peer->m_protocolVersion != host().protocolVersion() && _peer->m_protocolVersion != EthereumHost::c_oldProtocolVersion)
+    else if (_peer->m_protocolVersion != host().protocolVersion() && _peer->m_protocolVersion != EthereumHost::c_oldProtocolVersion && _peer->m_protocolVersion != c_pooledTransactionsVersion)
         _peer->disable("Invalid protocol version.");
     else if (_peer->m_networkId != host().networkId())
         _peer->disable("Invalid network identifier.");
@@ -308,14 +317,22 @@ void BlockChainSync::requestBlocks(std::shared_ptr<EthereumPeer> _peer)
     unsigned index = 0;
     if (m_haveCommonHeader && !m_headers.empty() && m_headers.begin()->first == m_lastImportedBlock + 1)
     {
-        while (header != m_headers.end() && neededBodies.size() < c_maxRequestBodies && index < header->second.size())
+        unsigned const batch = bodyBatchSize(_peer);
+        // Blocks at the front are needed first, leave them to peers that deliver quicker.
+        unsigned skip = slowPeerOffset(_peer);
+        while (header != m_headers.end() && neededBodies.size() < batch && index < header->second.size())
         {
             unsigned block = header->first + index;
             if (m_downloadingBodies.count(block) == 0 && !haveItem(m_bodies, block))
             {
-                neededBodies.push_back(header->second[index].hash);
-                neededNumbers.push_back(block);
-                m_downloadingBodies.insert(block);
+                if (skip > 0)
+                    --skip;
+                else
+                {
+                    neededBodies.push_back(header->second[index].hash);
+                    neededNumbers.push_back(block);
+                    m_downloadingBodies.insert(block);
+                }
             }
 
             ++index;
@@ -346,6 +363,9 @@ void BlockChainSync::requestBlocks(std::shared_ptr<EthereumPeer> _peer)
         }
         if (m_haveCommonHeader)
         {
+            if (requestSkeleton(_peer))
+                return;
+
             start = m_lastImportedBlock + 1;
             auto next = m_headers.begin();
             unsigned count = 0;
@@ -357,7 +377,10 @@ void BlockChainSync::requestBlocks(std::shared_ptr<EthereumPeer> _peer)
 
             while (count == 0 && next != m_headers.end())
             {
-                count = std::min(c_maxRequestHeaders, next->first - start);
+                // Far from the top, only fill gaps anchored by the skeleton.
+                if (start > m_skeleton.end() && m_highestBlock > start + HeaderSkeleton::c_stride * 2)
+                    break;
+                count = std::min(headerBatchSize(_peer), next->first - start);
                 while(count > 0 && m_downloadingHeaders.count(start) != 0)
                 {
                     start++;
@@ -390,6 +413,12 @@ void BlockChainSync::requestBlocks(std::shared_ptr<EthereumPeer> _peer)
 }
 
 void BlockChainSync::clearPeerDownload(std::shared_ptr<EthereumPeer> _peer)
+{
+    releasePeerRequests(_peer);
+    m_daoChallengedPeers.erase(_peer);
+}
+
+void BlockChainSync::releasePeerRequests(std::weak_ptr<EthereumPeer> const& _peer)
 {
     auto syncPeer = m_headerSyncPeers.find(_peer);
     if (syncPeer != m_headerSyncPeers.end())
@@ -405,7 +434,6 @@ void BlockChainSync::clearPeerDownload(std::shared_ptr<EthereumPeer> _peer)
             m_downloadingBodies.erase(block);
         m_bodySyncPeers.erase(syncPeer);
     }
-    m_daoChallengedPeers.erase(_peer);
 }
 
 void BlockChainSync::clearPeerDownload()
@@ -441,6 +469,177 @@ void BlockChainSync::clearPeerDownload()
     }
 }
 
+void BlockChainSync::tick()
+{
+    RecursiveGuard l(x_sync);
+    if (m_state != SyncState::Blocks)
+        return;
+
+    bool released = false;
+    host().foreachPeer([&](std::shared_ptr<EthereumPeer> _p)
+    {
+        bool const skeleton = m_skeletonPeer.lock() == _p;
+        if (!skeleton && !m_headerSyncPeers.count(_p) && !m_bodySyncPeers.count(_p))
+            return true;
+        double const timeout = std::min(c_maxRequestTimeout, std::max(c_minRequestTimeout, _p->requestStats().rtt * 4));
+        if (_p->askDuration() < timeout)
+            return true;
+
+        // Let other peers download the ranges. A late response is still accepted.
+        LOG(m_loggerDetail) << "Request timed out after " << timeout << "s, reassigning";
+        releasePeerRequests(_p);
+        if (skeleton)
+        {
+            // Its answer is still told apart from gap fills when it comes.
+            m_skeleton.noteTimedOut();
+            m_lateSkeletonPeer = m_skeletonPeer;
+            m_skeletonPeer.reset();
+        }
+        _p->noteRequestTimeout();
+        released = true;
+        return true;
+    });
+    if (released)
+        continueSync();
+    DEV_INVARIANT_CHECK_HERE;
+}
+
+unsigned BlockChainSync::headerBatchSize(std::shared_ptr<EthereumPeer> _peer) const
+{
+    double const rate = _peer->requestStats().headersPerSecond;
+    if (!rate)
+        return c_initialRequestHeaders;
+    auto const batch = static_cast<unsigned>(rate * c_targetResponseTime);
+    return std::min(c_maxRequestHeaders, std::max(c_minRequestHeaders, batch));
+}
+
+unsigned BlockChainSync::bodyBatchSize(std::shared_ptr<EthereumPeer> _peer) const
+{
+    double const rate = _peer->requestStats().bodiesPerSecond;
+    if (!rate)
+        return c_initialRequestBodies;
+    auto const batch = static_cast<unsigned>(rate * c_targetResponseTime);
+    return std::min(c_maxRequestBodies, std::max(c_minRequestBodies, batch));
+}
+
+unsigned BlockChainSync::slowPeerOffset(std::shared_ptr<EthereumPeer> _peer) const
+{
+    double fastest = 0;
+    host().foreachPeer([&](std::shared_ptr<EthereumPeer> _p)
+    {
+        fastest = std::max(fastest, _p->requestStats().bodiesPerSecond);
+        return true;
+    });
+
+    double const rate = _peer->requestStats().bodiesPerSecond;
+    if (!rate || rate >= fastest * c_slowPeerRatio)
+        return 0;
+    // Skip what the fastest peer would fetch in one request.
+    return std::min(c_maxRequestBodies, static_cast<unsigned>(fastest * c_targetResponseTime));
+}
+
+bool BlockChainSync::isBestPeer(std::shared_ptr<EthereumPeer> _peer) const
+{
+    bool best = true;
+    host().foreachPeer([&](std::shared_ptr<EthereumPeer> _p)
+    {
+        if (_p->m_totalDifficulty > _peer->m_totalDifficulty)
+            best = false;
+        return best;
+    });
+    return best;
+}
+
+bool BlockChainSync::requestSkeleton(std::shared_ptr<EthereumPeer> _peer)
+{
+    if (!m_skeletonPeer.expired())
+        return false;
+
+    // Skeleton headers go after the headers that are already linked to our chain.
+    unsigned base = m_lastImportedBlock;
+    if (!m_headers.empty() && m_headers.begin()->first == m_lastImportedBlock + 1)
+        base += m_headers.begin()->second.size();
+    HeaderSkeleton::Request const request = m_skeleton.nextRequest(base, m_highestBlock);
+    if (!request || !isBestPeer(_peer))
+        return false;
+
+    m_skeletonPeer = _peer;
+    m_skeleton.noteRequested(request);
+    LOG(m_logger) << "Requesting " << request.count << " skeleton headers from " << request.from;
+    _peer->requestBlockHeaders(request.from, request.count, HeaderSkeleton::c_stride - 1, false);
+    return true;
+}
+
+void BlockChainSync::onPeerSkeletonHeaders(std::shared_ptr<EthereumPeer> _peer, RLP const& _r, HeaderSkeleton::Request const& _request)
+{
+    size_t const itemCount = _r.itemCount();
+    for (unsigned i = 0; i < itemCount; i++)
+    {
+        BlockHeader info(_r[i].data(), HeaderData);
+        unsigned const blockNumber = static_cast<unsigned>(info.number());
+        if (i >= _request.count || !HeaderSkeleton::isInPlace(_request, i, blockNumber))
+        {
+            LOG(m_loggerDetail) << "Unexpected skeleton header " << blockNumber;
+            _peer->addRating(-1);
+            return;
+        }
+        if (blockNumber <= m_lastImportedBlock || haveItem(m_headers, blockNumber))
+            continue;
+
+        Header const* prevBlock = findItem(m_headers, blockNumber - 1);
+        Header const* nextBlock = findItem(m_headers, blockNumber + 1);
+        if ((prevBlock && prevBlock->hash != info.parentHash()) || (nextBlock && nextBlock->parent != info.hash()))
+        {
+            // Leave the range to the regular linking checks.
+            LOG(m_loggerDetail) << "Skeleton header " << blockNumber << " conflicts with downloaded headers";
+            continue;
+        }
+
+        m_highestBlock = std::max(m_highestBlock, blockNumber);
+        addHeader(blockNumber, info, _r[i].data());
+        m_skeleton.add(blockNumber);
+    }
+}
+
+bool BlockChainSync::checkSkeletonLink(std::shared_ptr<EthereumPeer> _peer, RLP const& _r)
+{
+    size_t const itemCount = _r.itemCount();
+    if (m_skeleton.empty() || itemCount == 0)
+        return true;
+
+    h256 last;
+    unsigned lastNumber = 0;
+    for (unsigned i = 0; i < itemCount; i++)
+    {
+        BlockHeader info(_r[i].data(), HeaderData);
+        if (i > 0 && (info.number() != lastNumber + 1 || info.parentHash() != last))
+        {
+            LOG(m_loggerDetail) << "Ignoring headers that don't form a chain";
+            return false;
+        }
+        last = info.hash();
+        lastNumber = static_cast<unsigned>(info.number());
+    }
+
+    if (!m_skeleton.isAnchor(lastNumber + 1))
+        return true;
+    Header const* anchor = findItem(m_headers, lastNumber + 1);
+    if (!anchor || anchor->parent == last)
+    {
+        m_skeleton.noteLinked();
+        return true;
+    }
+
+    LOG(m_loggerDetail) << "Headers up to " << lastNumber << " don't link to the skeleton";
+    _peer->addRating(-1);
+    if (m_skeleton.noteMismatch())
+    {
+        clog(VerbosityWarning, "sync") << "Skeleton headers are not confirmed by other peers, restarting sync";
+        restartSync();
+    }
+    return false;
+}
+
 void BlockChainSync::logNewBlock(h256 const& _h)
 {
     m_knownNewHashes.erase(_h);
@@ -466,6 +665,14 @@ void BlockChainSync::onPeerBlockHeaders(std::shared_ptr<EthereumPeer> _peer, RLP
     }
 
     clearPeerDownload(_peer);
+    bool const skeleton = m_skeletonPeer.lock() == _peer;
+    bool const lateSkeleton = !skeleton && m_lateSkeletonPeer.lock() == _peer;
+    if (skeleton)
+        m_skeletonPeer.reset();
+    if (lateSkeleton)
+        m_lateSkeletonPeer.reset();
+    // Take the request even if the reply is ignored, so the next headers aren't mistaken for it.
+    HeaderSkeleton::Request const skeletonRequest = (skeleton || lateSkeleton) ? m_skeleton.takeRequest(lateSkeleton) : HeaderSkeleton::Request{};
     if (m_state != SyncState::Blocks && m_state != SyncState::Waiting)
     {
         LOG(m_logger) << "Ignoring unexpected blocks";
@@ -481,6 +688,17 @@ void BlockChainSync::onPeerBlockHeaders(std::shared_ptr<EthereumPeer> _peer, RLP
         LOG(m_loggerDetail) << "Peer does not have the blocks requested";
         _peer->addRating(-1);
     }
+    if (skeleton || lateSkeleton)
+    {
+        onPeerSkeletonHeaders(_peer, _r, skeletonRequest);
+        continueSync();
+        return;
+    }
+    if (!checkSkeletonLink(_peer, _r))
+    {
+        continueSync();
+        return;
+    }
     for (unsigned i = 0; i < itemCount; i++)
     {
         BlockHeader info(_r[i].data(), HeaderData);
@@ -523,8 +741,6 @@ void BlockChainSync::onPeerBlockHeaders(std::shared_ptr<EthereumPeer> _peer, RLP
         }
         else
         {
-            Header hdr { _r[i].data().toBytes(), info.hash(), info.parentHash() };
-
             // validate chain
             HeaderId headerId { info.transactionsRoot(), info.sha3Uncles() };
             if (m_haveCommonHeader)
@@ -557,29 +773,37 @@ void BlockChainSync::onPeerBlockHeaders(std::shared_ptr<EthereumPeer> _peer, RLP
                         ++n;
                     }
                     removeAllStartingWith(m_headers, blockNumber + 1);
+                    m_skeleton.truncate(blockNumber);
                     removeAllStartingWith(m_bodies, blockNumber + 1);
                 }
             }
 
-            mergeInto(m_headers, blockNumber, std::move(hdr));
-            if (headerId.transactionsRoot == EmptyTrie && headerId.uncles == EmptyListSHA3)
-            {
-                //empty body, just mark as downloaded
-                RLPStream r(2);
-                r.appendRaw(RLPEmptyList);
-                r.appendRaw(RLPEmptyList);
-                bytes body;
-                r.swapOut(body);
-                mergeInto(m_bodies, blockNumber, std::move(body));
-            }
-            else
-                m_headerIdToNumber[headerId] = blockNumber;
+            addHeader(blockNumber, info, _r[i].data());
         }
     }
     collectBlocks();
     continueSync();
 }
 
+void BlockChainSync::addHeader(unsigned _number, BlockHeader const& _info, bytesConstRef _data)
+{
+    mergeInto(m_headers, _number, Header{_data.toBytes(), _info.hash(), _info.parentHash()});
+
+    HeaderId headerId { _info.transactionsRoot(), _info.sha3Uncles() };
+    if (headerId.transactionsRoot == EmptyTrie && headerId.uncles == EmptyListSHA3)
+    {
+        //empty body, just mark as downloaded
+        RLPStream r(2);
+        r.appendRaw(RLPEmptyList);
+        r.appendRaw(RLPEmptyList);
+        bytes body;
+        r.swapOut(body);
+        mergeInto(m_bodies, _number, std::move(body));
+    }
+    else
+        m_headerIdToNumber[headerId] = _number;
+}
+
 bool BlockChainSync::verifyDaoChallengeResponse(RLP const& _r)
 {
     if (_r.itemCount() != 1)
@@ -664,7 +888,7 @@ void BlockChainSync::collectBlocks()
         blockStream.appendRaw(body[1].data());
         bytes block;
         blockStream.swapOut(block);
-        switch (host().bq().import(&block))
+        switch (host().bq().import(&block, false, true))
         {
         case ImportResult::Success:
             success++;
@@ -720,6 +944,7 @@ void BlockChainSync::collectBlocks()
         m_headers[newHeaderHead] = newHeaders;
     if (!newBodies.empty())
         m_bodies[newBodiesHead] = newBodies;
+    m_skeleton.prune(m_lastImportedBlock);
 
     if (m_headers.empty())
     {
@@ -833,6 +1058,9 @@ void BlockChainSync::resetSync()
     m_headerSyncPeers.clear();
     m_bodySyncPeers.clear();
     m_headerIdToNumber.clear();
+    m_skeleton.reset();
+    m_skeletonPeer.reset();
+    m_lateSkeletonPeer.reset();
     m_syncingTotalDifficulty = 0;
     m_state = SyncState::NotSynced;
 }
@@ -29,6 +29,7 @@
 #include <libethcore/BlockHeader.h>
 #include <libp2p/Common.h>
 #include "CommonNet.h"
+#include "HeaderSkeleton.h"
 
 namespace dev
 {
@@ -83,6 +84,9 @@ public:
     /// Called when a blockchain has imported a new block onto the DB
     void onBlockImported(BlockHeader const& _info);
 
+    /// Called periodically to hand requests that peers are too slow to answer to other peers
+    void tick();
+
     /// @returns Synchonization status
     SyncStatus status() const;
 
@@ -104,6 +108,15 @@ private:
     void clearPeerDownload(std::shared_ptr<EthereumPeer> _peer);
     void clearPeerDownload();
     void collectBlocks();
+    void addHeader(unsigned _number, BlockHeader const& _info, bytesConstRef _data);
+    bool requestSkeleton(std::shared_ptr<EthereumPeer> _peer);
+    void onPeerSkeletonHeaders(std::shared_ptr<EthereumPeer> _peer, RLP const& _r, HeaderSkeleton::Request const& _request);
+    bool checkSkeletonLink(std::shared_ptr<EthereumPeer> _peer, RLP const& _r);
+    bool isBestPeer(std::shared_ptr<EthereumPeer> _peer) const;
+    void releasePeerRequests(std::weak_ptr<EthereumPeer> const& _peer);
+    unsigned headerBatchSize(std::shared_ptr<EthereumPeer> _peer) const;
+    unsigned bodyBatchSize(std::shared_ptr<EthereumPeer> _peer) const;
+    unsigned slowPeerOffset(std::shared_ptr<EthereumPeer> _peer) const;
     bool requestDaoForkBlockHeader(std::shared_ptr<EthereumPeer> _peer);
     bool verifyDaoChallengeResponse(RLP const& _r);
 
@@ -155,6 +168,9 @@ private:
     std::map<std::weak_ptr<EthereumPeer>, std::vector<unsigned>, std::owner_less<std::weak_ptr<EthereumPeer>>> m_headerSyncPeers; ///< Peers to m_downloadingSubchain number map
     std::map<std::weak_ptr<EthereumPeer>, std::vector<unsigned>, std::owner_less<std::weak_ptr<EthereumPeer>>> m_bodySyncPeers; ///< Peers to m_downloadingSubchain number map
     std::unordered_map<HeaderId, unsigned, HeaderIdHash> m_headerIdToNumber;
+    HeaderSkeleton m_skeleton;					///< Skeleton headers and requests
+    std::weak_ptr<EthereumPeer> m_skeletonPeer;	///< Peer asked for the skeleton, if any
+    std::weak_ptr<EthereumPeer> m_lateSkeletonPeer;	///< Peer whose skeleton request timed out, if any
     bool m_haveCommonHeader = false;			///< True if common block for our and remote chain has been found
     unsigned m_lastImportedBlock = 0; 			///< Last imported block number
     h256 m_lastImportedBlockHash;				///< Last imported block hash
@@ -36,6 +36,22 @@ size_t const c_maxKnownCount = 100000;
 size_t const c_maxKnownSize = 128 * 1024 * 1024;
 size_t const c_maxUnknownCount = 100000;
 size_t const c_maxUnknownSize = 512 * 1024 * 1024; // Block size can be ~50kb
+size_t const c_maxVerifierBatch = 32;
+
+namespace
+{
+string what(exception_ptr const& _e)
+{
+    try
+    {
+        rethrow_exception(_e);
+    }
+    catch (std::exception const& _ex)
+    {
+        return _ex.what();
+    }
+}
+}
 
 BlockQueue::BlockQueue()
 {
@@ -85,63 +101,67 @@ void BlockQueue::verifierBody()
 {
     while (!m_deleting)
     {
-        UnverifiedBlock work;
+        vector<UnverifiedBlock> work;
 
         {
             unique_lock<Mutex> l(m_verification);
             m_moreToVerify.wait(l, [&](){ return !m_unverified.isEmpty() || m_deleting; });
             if (m_deleting)
                 return;
-            work = m_unverified.dequeue();
 
-            BlockHeader bi;
-            bi.setSha3Uncles(work.hash);
-            bi.setParentHash(work.parentHash);
-            m_verifying.enqueue(move(bi));
-        }
+            // Take a share of the queue so that the other verifiers get theirs.
+            size_t const batch = min(c_maxVerifierBatch, max<size_t>(1, m_unverified.count() / m_verifiers.size()));
+            while (work.size() < batch && !m_unverified.isEmpty())
+            {
+                work.push_back(m_unverified.dequeue());
 
-        VerifiedBlock res;
-        swap(work.blockData, res.blockData);
-        try
-        {
-            res.verified = m_bc->verifyBlock(&res.blockData, m_onBad, ImportRequirements::OutOfOrderChecks);
-        }
-        catch (std::exception const& _ex)
-        {
-            // bad block.
-            // has to be this order as that's how invariants() assumes.
-            WriteGuard l2(m_lock);
-            unique_lock<Mutex> l(m_verification);
-            m_readySet.erase(work.hash);
-            m_knownBad.insert(work.hash);
-            if (!m_verifying.remove(work.hash))
-                cwarn << "Unexpected exception when verifying block: " << _ex.what();
-            drainVerified_WITH_BOTH_LOCKS();
-            continue;
+                BlockHeader bi;
+                bi.setSha3Uncles(work.back().hash);
+                bi.setParentHash(work.back().parentHash);
+                m_verifying.enqueue(move(bi));
+            }
         }
 
+        vector<VerifiedBlock> res;
+        vector<exception_ptr> errors = verifyBatch(work, res);
+
         bool ready = false;
+        for (size_t i = 0; i < work.size(); ++i)
         {
+            if (errors[i])
+            {
+                // bad block.
+                // has to be this order as that's how invariants() assumes.
+                WriteGuard l2(m_lock);
+                unique_lock<Mutex> l(m_verification);
+                m_readySet.erase(work[i].hash);
+                m_knownBad.insert(work[i].hash);
+                if (!m_verifying.remove(work[i].hash))
+                    cwarn << "Unexpected exception when verifying block: " << what(errors[i]);
+                drainVerified_WITH_BOTH_LOCKS();
+                continue;
+            }
+
             WriteGuard l2(m_lock);
             unique_lock<Mutex> l(m_verification);
-            if (!m_verifying.isEmpty() && m_verifying.nextHash() == work.hash)
+            if (!m_verifying.isEmpty() && m_verifying.nextHash() == work[i].hash)
             {
                 // we're next!
                 m_verifying.dequeue();
-                if (m_knownBad.count(res.verified.info.parentHash()))
+                if (m_knownBad.count(res[i].verified.info.parentHash()))
                 {
-                    m_readySet.erase(res.verified.info.hash());
-                    m_knownBad.insert(res.verified.info.hash());
+                    m_readySet.erase(res[i].verified.info.hash());
+                    m_knownBad.insert(res[i].verified.info.hash());
                 }
                 else
-                    m_verified.enqueue(move(res));
+                    m_verified.enqueue(move(res[i]));
 
                 drainVerified_WITH_BOTH_LOCKS();
                 ready = true;
             }
             else
             {
-                if (!m_verifying.replace(work.hash, move(res)))
+                if (!m_verifying.replace(work[i].hash, move(res[i])))
                     cwarn << "BlockQueue missing our job: was there a GM?";
             }
         }
@@ -150,6 +170,54 @@ void BlockQueue::verifierBody()
     }
 }
 
+vector<exception_ptr> BlockQueue::verifyBatch(vector<UnverifiedBlock>& _work, vector<VerifiedBlock>& o_verified) const
+{
+    vector<exception_ptr> ret(_work.size());
+    o_verified.resize(_work.size());
+
+    // Everything but the seals first; those of the blocks that pass are checked in one go. Only
+    // blocks from sync are sampled: BlockChain::sync() doesn't check seals again, and a propagated
+    // block may well be the one that ends up at the head.
+    vector<BlockHeader> sampledHeaders;
+    vector<BlockHeader> headers;
+    for (size_t i = 0; i < _work.size(); ++i)
+    {
+        swap(_work[i].blockData, o_verified[i].blockData);
+        try
+        {
+            o_verified[i].verified = m_bc->verifyBlock(&o_verified[i].blockData, m_onBad, ImportRequirements::OutOfOrderChecks & ~ImportRequirements::ValidSeal);
+            (_work[i].sampleSeal ? sampledHeaders : headers).push_back(o_verified[i].verified.info);
+        }
+        catch (std::exception const&)
+        {
+            ret[i] = current_exception();
+        }
+    }
+
+    try
+    {
+        if (!sampledHeaders.empty())
+            m_bc->sealEngine()->verifySeals(sampledHeaders, m_sealSampling);
+        if (!headers.empty())
+            m_bc->sealEngine()->verifySeals(headers);
+    }
+    catch (std::exception const&)
+    {
+        // Find out which are bad, and report them as if verified on their own.
+        for (size_t i = 0; i < _work.size(); ++i)
+            if (!ret[i])
+                try
+                {
+                    m_bc->verifyBlock(&o_verified[i].blockData, m_onBad, ImportRequirements::OutOfOrderChecks);
+                }
+                catch (std::exception const&)
+                {
+                    ret[i] = current_exception();
+                }
+    }
+    return ret;
+}
+
 void BlockQueue::drainVerified_WITH_BOTH_LOCKS()
 {
     while (!m_verifying.isEmpty() && !m_verifying.next().blockData.empty())
@@ -165,7 +233,7 @@ void BlockQueue::drainVerified_WITH_BOTH_LOCKS()
     }
 }
 
-ImportResult BlockQueue::import(bytesConstRef _block, bool _isOurs)
+ImportResult BlockQueue::import(bytesConstRef _block, bool _isOurs, bool _synced)
 {
     // Check if we already know this block.
     h256 h = BlockHeader::headerHashFromBlock(_block);
@@ -245,7 +313,7 @@ ImportResult BlockQueue::import(bytesConstRef _block, bool _isOurs)
             // If valid, append to blocks.
             LOG(m_loggerDetail) << "OK - ready for chain insertion.";
             DEV_GUARDED(m_verification)
-                m_unverified.enqueue(UnverifiedBlock { h, bi.parentHash(), _block.toBytes() });
+                m_unverified.enqueue(UnverifiedBlock { h, bi.parentHash(), _block.toBytes(), _synced });
             m_moreToVerify.notify_one();
             m_readySet.insert(h);
             m_difficulty += bi.difficulty();
@@ -475,7 +543,7 @@ void BlockQueue::noteReady_WITH_LOCK(h256 const& _good)
         for (auto& newReady: removed)
         {
             DEV_GUARDED(m_verification)
-                m_unverified.enqueue(UnverifiedBlock { newReady.first, parent, move(newReady.second) });
+                m_unverified.enqueue(UnverifiedBlock { newReady.first, parent, move(newReady.second), false });
             m_unknownSet.erase(newReady.first);
             m_readySet.insert(newReady.first);
             goodQueue.push_back(newReady.first);
@@ -497,7 +565,7 @@ void BlockQueue::retryAllUnknown()
         for (auto& newReady: removed)
         {
             DEV_GUARDED(m_verification)
-                m_unverified.enqueue(UnverifiedBlock{ newReady.first, parent, move(newReady.second) });
+                m_unverified.enqueue(UnverifiedBlock{ newReady.first, parent, move(newReady.second), false });
             m_unknownSet.erase(newReady.first);
             m_readySet.insert(newReady.first);
             m_moreToVerify.notify_one();
@@ -225,8 +225,9 @@ public:
 
     void setChain(BlockChain const& _bc) { m_bc = &_bc; }
 
-    /// Import a block into the queue.
-    ImportResult import(bytesConstRef _block, bool _isOurs = false);
+    /// Import a block into the queue. @a _synced marks a block downloaded by sync, whose seal may
+    /// be left unchecked by setSealSampling(); the seals of all other blocks are checked.
+    ImportResult import(bytesConstRef _block, bool _isOurs = false, bool _synced = false);
 
     /// Notes that time has moved on and some blocks that used to be "in the future" may no be valid.
     void tick();
@@ -268,6 +269,10 @@ public:
 
     template <class T> void setOnBad(T const& _t) { m_onBad = _t; }
 
+    /// Only checks the seals of every @a _every-th block downloaded by sync and of the last one of
+    /// each batch verified together; 1, the default, checks them all.
+    void setSealSampling(unsigned _every) { m_sealSampling = std::max(_every, 1u); }
+
     bool knownFull() const;
     bool unknownFull() const;
     u256 difficulty() const;	// Total difficulty of queueud blocks
@@ -279,6 +284,7 @@ private:
         h256 hash;
         h256 parentHash;
         bytes blockData;
+        bool sampleSeal;	///< Imported by sync straight away, so its seal may be skipped by sampling.
     };
 
     void noteReady_WITH_LOCK(h256 const& _b);
@@ -286,6 +292,10 @@ private:
     bool invariants() const override;
 
     void verifierBody();
+    /// Verifies @a _work into @a o_verified, checking the seals of all the blocks together.
+    /// @returns the exceptions of the blocks that failed, null for those that passed.
+    std::vector<std::exception_ptr> verifyBatch(
+        std::vector<UnverifiedBlock>& _work, std::vector<VerifiedBlock>& o_verified) const;
     void collectUnknownBad_WITH_BOTH_LOCKS(h256 const& _bad);
     void updateBad_WITH_LOCK(h256 const& _bad);
     void drainVerified_WITH_BOTH_LOCKS();
@@ -315,6 +325,7 @@ private:
 
     std::vector<std::thread> m_verifiers;								///< Threads who only verify.
     std::atomic<bool> m_deleting = {false};								///< Exit condition for verifiers.
+    std::atomic<unsigned> m_sealSampling = {1};							///< Check the seal of every this many blocks.
 
     std::function<void(Exception&)> m_onBad;							///< Called if we have a block that doesn't verify.
     u256 m_difficulty;													///< Total difficulty of blocks in the queue
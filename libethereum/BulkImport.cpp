@@ -0,0 +1,215 @@
+// Copyright 2018 cpp-ethereum Authors.
+// Licensed under the GNU General Public License v3. See the LICENSE file.
+
+#include "BulkImport.h"
+
+#include "BlockChain.h"
+
+#include <libdevcore/Guards.h>
+#include <libdevcore/Log.h>
+#include <libdevcore/OverlayDB.h>
+#include <libdevcore/RLP.h>
+#include <libethcore/Exceptions.h>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <thread>
+
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+namespace fs = boost::filesystem;
+
+namespace
+{
+/// Blocks each verifier thread may run ahead of the sink.
+unsigned const c_windowPerThread = 64;
+unsigned const c_minWindow = 256;
+
+struct Slot
+{
+    bytes storage;
+    VerifiedBlockRef block;
+    std::exception_ptr error;
+    bool ready = false;
+};
+}  // namespace
+
+BlockVerificationPipeline::BlockVerificationPipeline(BlockChain const& _bc, unsigned _threads)
+  : m_bc(_bc), m_threads(max(_threads, 1u))
+{}
+
+unsigned BlockVerificationPipeline::run(unsigned _count, Source const& _source, Sink const& _sink)
+{
+    if (!_count)
+        return 0;
+
+    unsigned const threads = min(m_threads, _count);
+    unsigned const window = max(c_minWindow, threads * c_windowPerThread);
+    vector<Slot> slots(window);
+
+    Mutex x_slots;
+    condition_variable cvReady;
+    condition_variable cvFree;
+    unsigned consumed = 0;  ///< Blocks passed to the sink, guarded by x_slots.
+    bool stopped = false;   ///< Guarded by x_slots.
+    atomic<unsigned> next{0};
+
+    auto verify = [&]() {
+        setThreadName("verify");
+        while (true)
+        {
+            unsigned const i = next++;
+            if (i >= _count)
+                return;
+            {
+                unique_lock<Mutex> l(x_slots);
+                cvFree.wait(l, [&]() { return stopped || i < consumed + window; });
+                if (stopped)
+                    return;
+            }
+
+            // The slot belongs to this thread until it is marked ready.
+            Slot& slot = slots[i % window];
+            try
+            {
+                bytesConstRef const data = _source(i, slot.storage);
+                slot.block = m_bc.verifyBlock(data, {}, ImportRequirements::OutOfOrderChecks);
+            }
+            catch (...)
+            {
+                slot.error = current_exception();
+            }
+
+            DEV_GUARDED(x_slots)
+                slot.ready = true;
+            cvReady.notify_all();
+        }
+    };
+
+    vector<thread> workers;
+    for (unsigned t = 0; t < threads; ++t)
+        workers.emplace_back(verify);
+
+    auto stopWorkers = [&]() {
+        DEV_GUARDED(x_slots)
+            stopped = true;
+        cvFree.notify_all();
+        for (auto& w : workers)
+            w.join();
+    };
+
+    unsigned i = 0;
+    try
+    {
+        while (i < _count)
+        {
+            Slot& slot = slots[i % window];
+            {
+                unique_lock<Mutex> l(x_slots);
+                cvReady.wait(l, [&]() { return slot.ready; });
+            }
+
+            bool const more = _sink(i, slot.block, slot.error);
+
+            slot.block = VerifiedBlockRef();
+            slot.error = nullptr;
+            slot.storage.clear();
+            DEV_GUARDED(x_slots)
+            {
+                slot.ready = false;
+                ++consumed;
+            }
+            cvFree.notify_all();
+            ++i;
+
+            if (!more)
+                break;
+        }
+    }
+    catch (...)
+    {
+        stopWorkers();
+        throw;
+    }
+
+    stopWorkers();
+    return i;
+}
+
+BulkImportProgress dev::eth::importBlockFile(BlockChain& _bc, OverlayDB const& _db,
+    fs::path const& _file, unsigned _threads,
+    std::function<void(BulkImportProgress const&)> const& _progress)
+{
+    namespace bip = boost::interprocess;
+
+    BulkImportProgress progress;
+    if (fs::file_size(_file) == 0)
+        return progress;
+
+    bip::file_mapping const file(_file.string().c_str(), bip::read_only);
+    bip::mapped_region region(file, bip::read_only);
+    region.advise(bip::mapped_region::advice_sequential);
+    bytesConstRef data(static_cast<byte const*>(region.get_address()), region.get_size());
+
+    // Split the file at the top-level items; only the length prefixes are read here.
+    vector<bytesConstRef> blocks;
+    while (!data.empty())
+    {
+        size_t const size = RLP(data, RLP::LaissezFaire).actualSize();
+        if (!size || size > data.size())
+        {
+            cwarn << "Ignoring " << data.size() << " bytes of truncated block data at the end of "
+                  << _file.string();
+            break;
+        }
+        blocks.push_back(data.cropped(0, size));
+        data = data.cropped(size);
+    }
+    progress.total = blocks.size();
+
+    Timer timer;
+    BlockVerificationPipeline pipeline(_bc, _threads);
+    pipeline.run(progress.total, [&](unsigned _index, bytes&) { return blocks[_index]; },
+        [&](unsigned _index, VerifiedBlockRef const& _block, std::exception_ptr const& _error) {
+            try
+            {
+                if (_error)
+                    rethrow_exception(_error);
+                _bc.import(_block, _db);
+                ++progress.imported;
+            }
+            catch (AlreadyHaveBlock&)
+            {
+                ++progress.alreadyKnown;
+            }
+            catch (UnknownParent&)
+            {
+                ++progress.unknownParent;
+            }
+            catch (FutureTime&)
+            {
+                ++progress.futureTime;
+            }
+            catch (std::exception const& _e)
+            {
+                // Not only dev::Exception: anything else thrown for one block, such as an RLP or
+                // allocation error, shouldn't leave the rest of the file unimported.
+                cwarn << "Bad block at index " << _index << " of " << _file.string() << ": "
+                      << _e.what();
+                ++progress.bad;
+            }
+
+            ++progress.processed;
+            progress.elapsed = timer.elapsed();
+            if (_progress)
+                _progress(progress);
+            return true;
+        });
+
+    return progress;
+}
@@ -0,0 +1,80 @@
+// Copyright 2018 cpp-ethereum Authors.
+// Licensed under the GNU General Public License v3. See the LICENSE file.
+
+#pragma once
+
+#include "VerifiedBlock.h"
+
+#include <libdevcore/Common.h>
+#include <libdevcore/Exceptions.h>
+#include <boost/filesystem/path.hpp>
+#include <exception>
+#include <functional>
+
+namespace dev
+{
+class OverlayDB;
+
+namespace eth
+{
+class BlockChain;
+
+/// Counters reported while importing a block file.
+struct BulkImportProgress
+{
+    unsigned processed = 0;      ///< Blocks handled so far, whatever the outcome.
+    unsigned total = 0;          ///< Blocks in the file.
+    unsigned imported = 0;
+    unsigned alreadyKnown = 0;
+    unsigned unknownParent = 0;
+    unsigned futureTime = 0;
+    unsigned bad = 0;
+    double elapsed = 0;          ///< Seconds since the import started.
+
+    /// @returns the estimated number of seconds left, based on the rate so far.
+    double eta() const
+    {
+        return processed ? elapsed * (total - processed) / processed : 0;
+    }
+};
+
+/**
+ * @brief Verifies a sequence of blocks on a pool of threads and hands them out in order.
+ *
+ * Verification covers everything that doesn't depend on the chain: the seal, the uncles and the
+ * transaction signatures, which recovers and caches the senders. Blocks are passed to the sink on
+ * the calling thread in their original order, so it can execute them against the chain one after
+ * another. Workers run at most a fixed window ahead of the sink to bound memory use.
+ */
+class BlockVerificationPipeline
+{
+public:
+    /// Provides block @a _index. Returns a reference to data that stays valid until the block has
+    /// been passed to the sink, either external or copied into @a o_storage.
+    using Source = std::function<bytesConstRef(unsigned _index, bytes& o_storage)>;
+
+    /// Receives block @a _index in order. @a _error is set if the block could not be read or
+    /// verified, in which case @a _block is not populated. @returns false to stop the pipeline.
+    using Sink = std::function<bool(
+        unsigned _index, VerifiedBlockRef const& _block, std::exception_ptr const& _error)>;
+
+    BlockVerificationPipeline(BlockChain const& _bc, unsigned _threads);
+
+    /// Runs blocks [0, @a _count) through the pipeline.
+    /// @returns the number of blocks passed to the sink.
+    unsigned run(unsigned _count, Source const& _source, Sink const& _sink);
+
+private:
+    BlockChain const& m_bc;
+    unsigned m_threads;
+};
+
+/// Imports the blocks of @a _file, written by `aleth --export` in binary format, into @a _bc.
+/// The file is memory-mapped and trusted to contain a chain segment in order, so the blocks are
+/// verified in parallel and then executed one by one. @a _progress is called after every block.
+BulkImportProgress importBlockFile(BlockChain& _bc, OverlayDB const& _db,
+    boost::filesystem::path const& _file, unsigned _threads,
+    std::function<void(BulkImportProgress const&)> const& _progress = {});
+
+}  // namespace eth
+}  // namespace dev
@@ -0,0 +1,93 @@
+// Copyright 2018 cpp-ethereum Authors.
+// Licensed under the GNU General Public License v3. See the LICENSE file.
+
+#include "CachedBlock.h"
+
+#include <libdevcore/RLP.h>
+#include <libdevcore/SHA3.h>
+
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+namespace
+{
+h256s hashAll(vector<bytesConstRef> const& _items)
+{
+    h256s ret;
+    ret.reserve(_items.size());
+    for (auto const& item : _items)
+        ret.push_back(sha3(item));
+    return ret;
+}
+}  // namespace
+
+void CachedBlock::ensureIndexed() const
+{
+    Guard l(x_index);
+    if (m_indexed)
+        return;
+
+    RLP const block(m_block);
+    if (block.isList() && block.itemCount() >= 3)
+    {
+        m_header = block[0].data();
+
+        RLP const transactions = block[1];
+        m_transactions.reserve(transactions.itemCount());
+        for (auto const& tr : transactions)
+            m_transactions.push_back(tr.data());
+
+        for (auto const& uncle : block[2])
+            m_uncles.push_back(uncle.data());
+    }
+    m_indexed = true;
+}
+
+bytesConstRef CachedBlock::header() const
+{
+    ensureIndexed();
+    return m_header;
+}
+
+bytesConstRef CachedBlock::transaction(unsigned _i) const
+{
+    auto const& transactions = transactionRefs();
+    return _i < transactions.size() ? transactions[_i] : bytesConstRef();
+}
+
+vector<bytesConstRef> const& CachedBlock::transactionRefs() const
+{
+    ensureIndexed();
+    return m_transactions;
+}
+
+vector<bytesConstRef> const& CachedBlock::uncleRefs() const
+{
+    ensureIndexed();
+    return m_uncles;
+}
+
+h256s const& CachedBlock::transactionHashes() const
+{
+    auto const& transactions = transactionRefs();
+    Guard l(x_hashes);
+    if (!m_transactionsHashed)
+    {
+        m_transactionHashes = hashAll(transactions);
+        m_transactionsHashed = true;
+    }
+    return m_transactionHashes;
+}
+
+h256s const& CachedBlock::uncleHashes() const
+{
+    auto const& uncles = uncleRefs();
+    Guard l(x_hashes);
+    if (!m_unclesHashed)
+    {
+        m_uncleHashes = hashAll(uncles);
+        m_unclesHashed = true;
+    }
+    return m_uncleHashes;
+}
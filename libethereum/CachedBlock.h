@@ -0,0 +1,80 @@
+// Copyright 2018 cpp-ethereum Authors.
+// Licensed under the GNU General Public License v3. See the LICENSE file.
+
+#pragma once
+
+#include <libdevcore/Common.h>
+#include <libdevcore/FixedHash.h>
+#include <libdevcore/Guards.h>
+
+#include <memory>
+
+namespace dev
+{
+namespace eth
+{
+/// Immutable block RLP shared between the BlockChain cache and its readers.
+/// Transaction offsets, transaction hashes and uncle hashes are computed on first use and then
+/// remembered for the lifetime of the object, so repeated queries about the same block neither
+/// copy the block nor re-hash its contents.
+/// @threadsafe
+class CachedBlock
+{
+public:
+    explicit CachedBlock(bytes&& _block) noexcept : m_block(std::move(_block)) {}
+    explicit CachedBlock(bytesConstRef _block) : m_block(_block.toBytes()) {}
+
+    CachedBlock(CachedBlock const&) = delete;
+    CachedBlock& operator=(CachedBlock const&) = delete;
+
+    /// @returns the full RLP of the block.
+    bytes const& block() const { return m_block; }
+    bytesConstRef ref() const { return bytesConstRef(&m_block); }
+    size_t size() const { return m_block.size(); }
+    bool empty() const { return m_block.empty(); }
+
+    /// @returns the RLP of the block header.
+    bytesConstRef header() const;
+
+    /// @returns the number of transactions in the block.
+    size_t transactionCount() const { return transactionRefs().size(); }
+
+    /// @returns the RLP of the @a _i th transaction or an empty reference if there's no such
+    /// transaction. Valid as long as this object is alive.
+    bytesConstRef transaction(unsigned _i) const;
+
+    /// @returns the RLPs of all transactions in block order.
+    std::vector<bytesConstRef> const& transactionRefs() const;
+
+    /// @returns the hashes of all transactions in block order.
+    h256s const& transactionHashes() const;
+
+    /// @returns the RLPs of the uncle headers.
+    std::vector<bytesConstRef> const& uncleRefs() const;
+
+    /// @returns the hashes of the uncle headers.
+    h256s const& uncleHashes() const;
+
+private:
+    /// Splits the block into its header, transactions and uncles if not done yet.
+    void ensureIndexed() const;
+
+    bytes const m_block;
+
+    mutable Mutex x_index;
+    mutable bool m_indexed = false;
+    mutable bytesConstRef m_header;
+    mutable std::vector<bytesConstRef> m_transactions;
+    mutable std::vector<bytesConstRef> m_uncles;
+
+    mutable Mutex x_hashes;
+    mutable bool m_transactionsHashed = false;
+    mutable h256s m_transactionHashes;
+    mutable bool m_unclesHashed = false;
+    mutable h256s m_uncleHashes;
+};
+
+using CachedBlockPtr = std::shared_ptr<CachedBlock const>;
+
+}  // namespace eth
+}  // namespace dev
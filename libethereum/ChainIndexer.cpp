@@ -0,0 +1,219 @@
+// Copyright 2018 cpp-ethereum Authors.
+// Licensed under the GNU General Public License v3. See the LICENSE file.
+
+#include "ChainIndexer.h"
+
+#include "BlockChain.h"
+#include "BlockDetails.h"
+
+#include <libdevcore/RLP.h>
+#include <libdevcore/SHA3.h>
+
+#include <thread>
+
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+namespace
+{
+std::string const c_indexed{"indexed"};
+db::Slice const c_sliceIndexed{c_indexed};
+
+/// Number of blocks written to the database in one batch.
+unsigned const c_batchSize = 1024;
+
+bytes checkpointRLP(unsigned _number, h256 const& _hash)
+{
+    RLPStream s(2);
+    s << _number << _hash;
+    return s.out();
+}
+}  // namespace
+
+ChainIndexer::ChainIndexer(BlockChain const& _bc, db::DatabaseFace& _blocksDB, db::DatabaseFace& _extrasDB)
+  : Worker("chainidx", 100), m_bc(_bc), m_blocksDB(_blocksDB), m_extrasDB(_extrasDB)
+{
+    unsigned const head = m_bc.number();
+    std::string const checkpoint = m_extrasDB.lookup(c_sliceIndexed);
+    if (checkpoint.empty())
+    {
+        // Databases written before indexing moved to the background have the canonical chain
+        // indexed up to the head.
+        m_next = head + 1;
+        m_extrasDB.insert(
+            c_sliceIndexed, db::Slice(dev::ref(checkpointRLP(head, m_bc.numberHash(head)))));
+        return;
+    }
+
+    RLP const r(checkpoint);
+    unsigned number = r[0].toInt<unsigned>();
+    h256 hash = r[1].toHash<h256>();
+    // The chain might have been reorganised or rewound after the checkpoint was written, so find
+    // the last checkpointed block that is still canonical.
+    while (number > 0 && (number > head || m_bc.numberHash(number) != hash))
+    {
+        hash = m_bc.details(hash).parent;
+        if (!hash)
+            number = 0;
+        else
+            --number;
+    }
+    m_next = number + 1;
+    LOG(m_logger) << "Indexes complete up to #" << number << " (head #" << head << ")";
+}
+
+ChainIndexer::~ChainIndexer()
+{
+    terminate();
+}
+
+void ChainIndexer::invalidate(db::DatabaseFace& _extrasDB)
+{
+    _extrasDB.insert(c_sliceIndexed, db::Slice(dev::ref(checkpointRLP(0, h256()))));
+}
+
+void ChainIndexer::noteCanonChanged(unsigned _firstChanged)
+{
+    Guard l(x_progress);
+    m_next = min(m_next, _firstChanged);
+    m_dirtyFrom = min(m_dirtyFrom, _firstChanged);
+}
+
+bool ChainIndexer::isUpToDate() const
+{
+    return nextNumber() > m_bc.number();
+}
+
+bool ChainIndexer::waitUntilIndexed(unsigned _number, chrono::milliseconds _timeout) const
+{
+    // Doesn't ask m_bc for the head here: BlockChain notes reorganisations while holding its own
+    // lock, which would then be taken in the opposite order.
+    unique_lock<Mutex> l(x_progress);
+    return m_progressed.wait_for(l, _timeout, [&]() { return m_next > _number; });
+}
+
+unsigned ChainIndexer::nextNumber() const
+{
+    Guard l(x_progress);
+    return m_next;
+}
+
+void ChainIndexer::catchUp(unsigned _threads)
+{
+    Guard l(x_indexing);
+
+    unsigned const end = m_bc.number() + 1;
+    unsigned begin;
+    DEV_GUARDED(x_progress)
+    {
+        begin = m_next;
+        m_dirtyFrom = (unsigned)-1;
+    }
+
+    unsigned const batches = begin < end ? (end - begin + c_batchSize - 1) / c_batchSize : 0;
+    unsigned const threads = min(_threads, batches);
+    if (threads > 1)
+    {
+        // Split the backlog into one contiguous range per thread. Entries are keyed by
+        // transaction or block hash, so the ranges don't interfere with each other.
+        LOG(m_logger) << "Indexing #" << begin << "..#" << (end - 1) << " on " << threads
+                      << " threads";
+        unsigned const perThread = (batches + threads - 1) / threads * c_batchSize;
+        vector<thread> workers;
+        for (unsigned from = begin; from < end; from += perThread)
+        {
+            unsigned const to = min(from + perThread, end);
+            workers.emplace_back([this, from, to]() {
+                setThreadName("chainidx");
+                for (unsigned b = from; b < to; b += c_batchSize)
+                    indexRange(b, min(b + c_batchSize, to));
+            });
+        }
+        for (auto& w : workers)
+            w.join();
+        advance(end);
+    }
+
+    while (indexNextBatch())
+    {
+    }
+}
+
+void ChainIndexer::doWork()
+{
+    while (!shouldStop() && !isUpToDate())
+    {
+        Guard l(x_indexing);
+        if (!indexNextBatch())
+            break;
+    }
+}
+
+bool ChainIndexer::indexNextBatch()
+{
+    unsigned const head = m_bc.number();
+    unsigned begin;
+    DEV_GUARDED(x_progress)
+    {
+        begin = m_next;
+        m_dirtyFrom = (unsigned)-1;
+    }
+    if (begin > head)
+        return false;
+
+    unsigned const end = min(begin + c_batchSize, head + 1);
+    indexRange(begin, end);
+    advance(end);
+    return true;
+}
+
+void ChainIndexer::indexRange(unsigned _begin, unsigned _end) const
+{
+    auto batch = m_extrasDB.createWriteBatch();
+    for (unsigned n = _begin; n < _end; ++n)
+    {
+        std::string const blockHash = m_extrasDB.lookup(toSlice(h256(n), ExtraBlockHash));
+        if (blockHash.empty())
+            // Below the start of a chain restored from a snapshot.
+            continue;
+        h256 const hash = BlockHash(RLP(blockHash)).value;
+
+        // Read the databases directly, bulk indexing would only evict useful entries from the
+        // BlockChain caches.
+        std::string const block = m_blocksDB.lookup(toSlice(hash));
+        TransactionAddress ta;
+        ta.blockHash = hash;
+        ta.index = 0;
+        for (auto const& tr : RLP(block)[1])
+        {
+            batch->insert(
+                toSlice(sha3(tr.data()), ExtraTransactionAddress), (db::Slice)dev::ref(ta.rlp()));
+            ++ta.index;
+        }
+
+        std::string const receipts = m_extrasDB.lookup(toSlice(hash, ExtraReceipts));
+        BlockLogBlooms blb;
+        for (auto const& receipt : RLP(receipts))
+            blb.blooms.push_back(TransactionReceipt(receipt.data()).bloom());
+        batch->insert(toSlice(hash, ExtraLogBlooms), (db::Slice)dev::ref(blb.rlp()));
+    }
+    m_extrasDB.commit(move(batch));
+}
+
+void ChainIndexer::advance(unsigned _end)
+{
+    unsigned next;
+    DEV_GUARDED(x_progress)
+    {
+        // If the chain was reorganised while the batch was written, the blocks from the first
+        // replaced one on may have been indexed from the old branch.
+        m_next = min(_end, m_dirtyFrom);
+        next = m_next;
+    }
+    m_progressed.notify_all();
+
+    unsigned const number = next - 1;
+    m_extrasDB.insert(
+        c_sliceIndexed, db::Slice(dev::ref(checkpointRLP(number, m_bc.numberHash(number)))));
+}
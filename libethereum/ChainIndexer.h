@@ -0,0 +1,89 @@
+// Copyright 2018 cpp-ethereum Authors.
+// Licensed under the GNU General Public License v3. See the LICENSE file.
+
+#pragma once
+
+#include <libdevcore/Guards.h>
+#include <libdevcore/Log.h>
+#include <libdevcore/Worker.h>
+#include <libdevcore/db.h>
+
+#include <chrono>
+#include <condition_variable>
+
+namespace dev
+{
+namespace eth
+{
+class BlockChain;
+
+/**
+ * @brief Maintains the secondary indexes of the canonical chain in the background.
+ *
+ * The indexes are the transaction hash to location map and the per-block log blooms. They are
+ * derived from blocks and receipts that are already in the databases, so block import doesn't wait
+ * for them. Progress is persisted as a checkpoint in the extras database and checked against the
+ * canonical chain when reopened.
+ * @threadsafe
+ */
+class ChainIndexer: public Worker
+{
+public:
+    ChainIndexer(BlockChain const& _bc, db::DatabaseFace& _blocksDB, db::DatabaseFace& _extrasDB);
+    ~ChainIndexer();
+
+    /// Marks the indexes stored in @a _extrasDB as incomplete, so that they are rebuilt from the
+    /// genesis once indexing is enabled again.
+    static void invalidate(db::DatabaseFace& _extrasDB);
+
+    /// Start indexing new canonical blocks in the background.
+    void start() { startWorking(); }
+
+    /// Notes that the canonical chain was replaced starting at block @a _firstChanged, so that
+    /// blocks from that number on have to be indexed again.
+    void noteCanonChanged(unsigned _firstChanged);
+
+    /// Indexes every canonical block up to the current head on the calling thread, spreading the
+    /// work across @a _threads threads.
+    void catchUp(unsigned _threads = 1);
+
+    /// @returns true if every canonical block has been indexed.
+    bool isUpToDate() const;
+
+    /// Waits until the canonical blocks up to @a _number have been indexed or @a _timeout has
+    /// passed. @returns true if they have.
+    bool waitUntilIndexed(unsigned _number, std::chrono::milliseconds _timeout) const;
+
+    /// @returns the number of the first canonical block that is not indexed yet.
+    unsigned nextNumber() const;
+
+private:
+    void doWork() override;
+
+    /// Indexes the next batch of canonical blocks. Requires x_indexing.
+    /// @returns false if there was nothing left to index.
+    bool indexNextBatch();
+
+    /// Writes the indexes of canonical blocks in [@a _begin, @a _end) to the database.
+    void indexRange(unsigned _begin, unsigned _end) const;
+
+    /// Records that the blocks up to (excluding) @a _end are indexed unless the chain changed
+    /// meanwhile.
+    void advance(unsigned _end);
+
+    BlockChain const& m_bc;
+    db::DatabaseFace& m_blocksDB;
+    db::DatabaseFace& m_extrasDB;
+
+    Mutex x_indexing;  ///< Serialises catching up between the worker and callers.
+
+    mutable Mutex x_progress;
+    unsigned m_next = 1;                   ///< First canonical block number not indexed yet.
+    unsigned m_dirtyFrom = (unsigned)-1;   ///< Lowest block number replaced while a batch ran.
+    mutable std::condition_variable m_progressed;  ///< Notified whenever m_next advances.
+
+    Logger m_logger{createLogger(VerbosityDebug, "chainidx")};
+};
+
+}  // namespace eth
+}  // namespace dev
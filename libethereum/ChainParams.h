@@ -58,6 +58,9 @@ struct ChainParams: public ChainOperationParams
 	unsigned sealFields = 0;
 	bytes sealRLP;
 
+	/// Maintain the transaction hash and log bloom indexes. A local setting, not part of the chain spec.
+	bool secondaryIndexes = true;
+
 	h256 calculateStateRoot(bool _force = false) const;
 
 	/// Genesis block info.
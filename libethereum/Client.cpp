@@ -122,6 +122,7 @@ void Client::init(p2p::Host* _extNet, fs::path const& _dbPath, fs::path const& _
     bc().setOnBlockImport([=](BlockHeader const& _info) {
         if (auto h = m_host.lock())
             h->onBlockImported(_info);
+        m_gp->onBlockImported(bc(), _info);
     });
 
     if (_forceAction == WithExisting::Rescue)
@@ -138,6 +139,8 @@ void Client::init(p2p::Host* _extNet, fs::path const& _dbPath, fs::path const& _
 
         _extNet->addCapability(host, EthereumHost::staticName(),
             EthereumHost::c_oldProtocolVersion);  // TODO: remove this once v61+ protocol is common
+        // Peers only get the pooled transaction packets if they negotiated eth/65.
+        _extNet->addCapability(host, EthereumHost::staticName(), c_pooledTransactionsVersion);
     }
 
     // create Warp capability if we either download snapshot or can give out snapshot
@@ -169,6 +172,20 @@ tuple<ImportRoute, bool, unsigned> Client::syncQueue(unsigned _max)
     return bc().sync(m_bq, m_stateDB, _max);
 }
 
+BulkImportProgress Client::importBlockFile(
+    boost::filesystem::path const& _file, std::function<void(BulkImportProgress const&)> const& _progress)
+{
+    stopWorking();
+    BulkImportProgress const progress = dev::eth::importBlockFile(
+        bc(), m_stateDB, _file, max(thread::hardware_concurrency(), 1u), _progress);
+
+    // The pending block was built on top of the old head.
+    DEV_WRITE_GUARDED(x_preSeal)
+        m_preSeal.sync(bc());
+    resetState();
+    return progress;
+}
+
 void Client::onBadBlock(Exception& _ex) const
 {
     // BAD BLOCK!!!
@@ -214,6 +231,12 @@ void Client::setNetworkId(u256 const& _n)
         h->setNetworkId(_n);
 }
 
+void Client::setTransactionAnnouncements(bool _enable)
+{
+    if (auto h = m_host.lock())
+        h->setTransactionAnnouncements(_enable);
+}
+
 bool Client::isSyncing() const
 {
     if (auto h = m_host.lock())
@@ -427,6 +450,7 @@ void Client::syncTransactionQueue()
 
         tie(newPendingReceipts, m_syncTransactionQueue) = m_working.sync(bc(), m_tq, *m_gp);
     }
+    m_gp->notePending(m_tq);
 
     if (newPendingReceipts.empty())
     {
@@ -508,12 +532,25 @@ void Client::resyncStateFromChain()
     {
         DEV_WRITE_GUARDED(x_preSeal)
             m_preSeal = newPreMine;
+
+        // Carry the pending transactions over to the new head rather than executing them all again;
+        // only those the new blocks may have affected go back through the queue.
+        Block newWorking(chainParams().accountStartNonce);
+        DEV_READ_GUARDED(x_working)
+            newWorking = m_working;
+        if (newWorking.author() == newPreMine.author())
+            newWorking.rebase(bc());
+        else
+            newWorking = newPreMine;
         DEV_WRITE_GUARDED(x_working)
-            m_working = newPreMine;
+            m_working = newWorking;
+
         DEV_READ_GUARDED(x_postSeal)
             if (!m_postSeal.isSealed() || m_postSeal.info().hash() != newPreMine.info().parentHash())
                 for (auto const& t: m_postSeal.pending())
                 {
+                    if (newWorking.pendingHashes().count(t.sha3()))
+                        continue;
                     LOG(m_loggerDetail) << "Resubmitting post-seal transaction " << t;
                     //                      ctrace << "Resubmitting post-seal transaction " << t;
                     auto ir = m_tq.import(t, IfDropped::Retry);
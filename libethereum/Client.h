@@ -24,6 +24,7 @@
 #include "Block.h"
 #include "BlockChain.h"
 #include "BlockChainImporter.h"
+#include "BulkImport.h"
 #include "ClientBase.h"
 #include "CommonNet.h"
 #include "StateImporter.h"
@@ -94,7 +95,7 @@ public:
     ImportResult injectTransaction(bytes const& _rlp, IfDropped _id = IfDropped::Ignore) override { prepareForTransaction(); return m_tq.import(_rlp, _id); }
 
     /// Resets the gas pricer to some other object.
-    void setGasPricer(std::shared_ptr<GasPricer> _gp) { m_gp = _gp; }
+    void setGasPricer(std::shared_ptr<GasPricer> _gp) { m_gp = _gp; m_gp->update(bc()); }
     std::shared_ptr<GasPricer> gasPricer() const { return m_gp; }
 
     /// Submits the given transaction.
@@ -141,6 +142,11 @@ public:
     /// Freeze worker thread and sync some of the block queue.
     std::tuple<ImportRoute, bool, unsigned> syncQueue(unsigned _max = 1);
 
+    /// Freeze worker thread and import a trusted block file directly into the chain, verifying
+    /// blocks on all cores.
+    BulkImportProgress importBlockFile(boost::filesystem::path const& _file,
+        std::function<void(BulkImportProgress const&)> const& _progress = {});
+
     // Sealing stuff:
     // Note: "mining"/"miner" is deprecated. Use "sealing"/"sealer".
 
@@ -174,6 +180,11 @@ public:
     u256 networkId() const override;
     /// Sets the network id.
     void setNetworkId(u256 const& _n) override;
+    /// Announces transaction hashes to most peers instead of relaying the full transactions.
+    void setTransactionAnnouncements(bool _enable);
+    /// Only checks the seals of every @a _every-th block downloaded by sync; see
+    /// BlockQueue::setSealSampling.
+    void setSealSampling(unsigned _every) { m_bq.setSealSampling(_every); }
 
     /// Get the seal engine.
     SealEngineFace* sealEngine() const override { return bc().sealEngine(); }
@@ -308,7 +308,7 @@ BlockHeader ClientBase::blockInfo(h256 _hash) const
 {
     if (_hash == PendingBlockHash)
         return preSeal().info();
-    return BlockHeader(bc().block(_hash));
+    return BlockHeader(bc().cachedBlock(_hash)->ref());
 }
 
 BlockDetails ClientBase::blockDetails(h256 _hash) const
@@ -329,17 +329,16 @@ LocalisedTransaction ClientBase::localisedTransaction(h256 const& _transactionHa
 
 Transaction ClientBase::transaction(h256 _blockHash, unsigned _i) const
 {
-    auto bl = bc().block(_blockHash);
-    RLP b(bl);
-    if (_i < b[1].itemCount())
-        return Transaction(b[1][_i].data(), CheckTransaction::Cheap);
+    auto const block = bc().cachedBlock(_blockHash);
+    if (_i < block->transactionCount())
+        return Transaction(block->transaction(_i), CheckTransaction::Cheap);
     else
         return Transaction();
 }
 
 LocalisedTransaction ClientBase::localisedTransaction(h256 const& _blockHash, unsigned _i) const
 {
-    Transaction t = Transaction(bc().transaction(_blockHash, _i), CheckTransaction::Cheap);
+    Transaction t = Transaction(bc().cachedBlock(_blockHash)->transaction(_i), CheckTransaction::Cheap);
     return LocalisedTransaction(t, _blockHash, _i, numberFromHash(_blockHash));
 }
 
@@ -351,7 +350,7 @@ TransactionReceipt ClientBase::transactionReceipt(h256 const& _transactionHash)
 LocalisedTransactionReceipt ClientBase::localisedTransactionReceipt(h256 const& _transactionHash) const
 {
     std::pair<h256, unsigned> tl = bc().transactionLocation(_transactionHash);
-    Transaction t = Transaction(bc().transaction(tl.first, tl.second), CheckTransaction::Cheap);
+    Transaction t = Transaction(bc().cachedBlock(tl.first)->transaction(tl.second), CheckTransaction::Cheap);
     TransactionReceipt tr = bc().transactionReceipt(tl.first, tl.second);
     u256 gasUsed = tr.cumulativeGasUsed();
     if (tl.second > 0)
@@ -373,11 +372,11 @@ pair<h256, unsigned> ClientBase::transactionLocation(h256 const& _transactionHas
 
 Transactions ClientBase::transactions(h256 _blockHash) const
 {
-    auto bl = bc().block(_blockHash);
-    RLP b(bl);
+    auto const block = bc().cachedBlock(_blockHash);
     Transactions res;
-    for (unsigned i = 0; i < b[1].itemCount(); i++)
-        res.emplace_back(b[1][i].data(), CheckTransaction::Cheap);
+    res.reserve(block->transactionCount());
+    for (auto const& t: block->transactionRefs())
+        res.emplace_back(t, CheckTransaction::Cheap);
     return res;
 }
 
@@ -388,10 +387,9 @@ TransactionHashes ClientBase::transactionHashes(h256 _blockHash) const
 
 BlockHeader ClientBase::uncle(h256 _blockHash, unsigned _i) const
 {
-    auto bl = bc().block(_blockHash);
-    RLP b(bl);
-    if (_i < b[2].itemCount())
-        return BlockHeader(b[2][_i].data(), HeaderData);
+    auto const block = bc().cachedBlock(_blockHash);
+    if (_i < block->uncleRefs().size())
+        return BlockHeader(block->uncleRefs()[_i], HeaderData);
     else
         return BlockHeader();
 }
@@ -403,16 +401,12 @@ UncleHashes ClientBase::uncleHashes(h256 _blockHash) const
 
 unsigned ClientBase::transactionCount(h256 _blockHash) const
 {
-    auto bl = bc().block(_blockHash);
-    RLP b(bl);
-    return b[1].itemCount();
+    return bc().cachedBlock(_blockHash)->transactionCount();
 }
 
 unsigned ClientBase::uncleCount(h256 _blockHash) const
 {
-    auto bl = bc().block(_blockHash);
-    RLP b(bl);
-    return b[2].itemCount();
+    return bc().cachedBlock(_blockHash)->uncleRefs().size();
 }
 
 unsigned ClientBase::number() const
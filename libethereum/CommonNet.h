@@ -43,6 +43,11 @@ static const unsigned c_maxBlocksAsk = 128;     ///< Maximum number of blocks we
 static const unsigned c_maxPayload = 262144;    ///< Maximum size of packet for us to send.
 static const unsigned c_maxNodes = c_maxBlocks; ///< Maximum number of nodes will ever send.
 static const unsigned c_maxReceipts = c_maxBlocks; ///< Maximum number of receipts will ever send.
+static const unsigned c_pooledTransactionsVersion = 65;  ///< First eth protocol version with the pooled transaction packets.
+static const unsigned c_maxTransactionHashes = 4096;    ///< Maximum number of transaction hashes we accept in one announcement.
+static const unsigned c_maxTransactionsAsk = 256;       ///< Maximum number of transactions we ask to receive in PooledTransactions.
+static const unsigned c_maxKnownTransactions = 32768;   ///< Transactions per generation of a peer's known-transactions filter.
+static const unsigned c_maxTransactionRequests = 32;     ///< Maximum number of PooledTransactions requests outstanding to one peer.
 
 class BlockChain;
 class TransactionQueue;
@@ -59,6 +64,9 @@ enum SubprotocolPacketType: byte
     GetBlockBodiesPacket = 0x05,
     BlockBodiesPacket = 0x06,
     NewBlockPacket = 0x07,
+    NewPooledTransactionHashesPacket = 0x08,
+    GetPooledTransactionsPacket = 0x09,
+    PooledTransactionsPacket = 0x0a,
 
     GetNodeDataPacket = 0x0d,
     NodeDataPacket = 0x0e,
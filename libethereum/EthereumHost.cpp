@@ -22,6 +22,7 @@
 #include "EthereumHost.h"
 
 #include <chrono>
+#include <cmath>
 #include <thread>
 #include <libdevcore/Common.h>
 #include <libp2p/Host.h>
@@ -40,6 +41,8 @@ using namespace p2p;
 
 unsigned const EthereumHost::c_oldProtocolVersion = 62; //TODO: remove this once v63+ is common
 static unsigned const c_maxSendTransactions = 256;
+/// After this long an announced transaction that hasn't arrived may be requested from another peer.
+static chrono::seconds const c_transactionRequestTimeout{5};
 
 char const* const EthereumHost::s_stateNames[static_cast<int>(SyncState::Size)] = {"NotSynced", "Idle", "Waiting", "Blocks", "State"};
 
@@ -71,6 +74,44 @@ public:
         m_tq.enqueue(_r, _peer->id());
     }
 
+    void onPeerTransactionHashes(std::shared_ptr<EthereumPeer> _peer, h256s const& _hashes) override
+    {
+        _peer->markTransactionsKnown(_hashes);
+
+        // Fetch only what we don't have and nobody else is already sending us.
+        h256s wanted;
+        auto const now = chrono::steady_clock::now();
+        DEV_GUARDED(x_requested)
+        {
+            for (auto const& h: _hashes)
+            {
+                auto r = m_requested.find(h);
+                if ((r != m_requested.end() && now - r->second < c_transactionRequestTimeout) || m_tq.isKnown(h))
+                    continue;
+                m_requested[h] = now;
+                wanted.push_back(h);
+            }
+
+            if (m_requested.size() > c_maxTransactionHashes)
+                for (auto r = m_requested.begin(); r != m_requested.end();)
+                    r = now - r->second < c_transactionRequestTimeout ? next(r) : m_requested.erase(r);
+        }
+
+        for (size_t i = 0; i < wanted.size(); i += c_maxTransactionsAsk)
+            _peer->requestPooledTransactions(h256s(wanted.begin() + i,
+                wanted.begin() + min<size_t>(i + c_maxTransactionsAsk, wanted.size())));
+    }
+
+    void onPeerPooledTransactions(std::shared_ptr<EthereumPeer> _peer, RLP const& _r) override
+    {
+        unsigned itemCount = _r.itemCount();
+        LOG(m_logger) << "PooledTransactions (" << dec << itemCount << " entries)";
+        DEV_GUARDED(x_requested)
+            for (auto const& tx: _r)
+                m_requested.erase(sha3(tx.data()));
+        m_tq.enqueue(_r, _peer->id());
+    }
+
     void onPeerAborting() override
     {
         try
@@ -155,13 +196,18 @@ private:
     shared_ptr<BlockChainSync> m_sync;
     TransactionQueue& m_tq;
 
+    Mutex x_requested;
+    unordered_map<h256, chrono::steady_clock::time_point> m_requested;  ///< Announced transactions we asked for and when.
+
     Logger m_logger{createLogger(VerbosityDebug, "host")};
 };
 
 class EthereumHostData: public EthereumHostDataFace
 {
 public:
-    EthereumHostData(BlockChain const& _chain, OverlayDB const& _db): m_chain(_chain), m_db(_db) {}
+    EthereumHostData(BlockChain const& _chain, OverlayDB const& _db, TransactionQueue const& _tq)
+      : m_chain(_chain), m_db(_db), m_tq(_tq)
+    {}
 
     pair<bytes, unsigned> blockHeaders(RLP const& _blockId, unsigned _maxHeaders, u256 _skip, bool _reverse) const override
     {
@@ -291,8 +337,8 @@ public:
             auto h = _blockHashes[i].toHash<h256>();
             if (m_chain.isKnown(h))
             {
-                bytes blockBytes = m_chain.block(h);
-                RLP block{blockBytes};
+                auto const cachedBlock = m_chain.cachedBlock(h);
+                RLP block{cachedBlock->ref()};
                 RLPStream body;
                 body.appendList(2);
                 body.appendRaw(block[1].data()); // transactions
@@ -360,9 +406,30 @@ public:
         return make_pair(rlp, n);
     }
 
+    pair<bytes, unsigned> pooledTransactions(RLP const& _transactionHashes) const override
+    {
+        unsigned const count = static_cast<unsigned>(_transactionHashes.itemCount());
+
+        bytes rlp;
+        unsigned n = 0;
+        auto numItemsToSend = std::min(count, c_maxTransactionsAsk);
+        for (unsigned i = 0; i < numItemsToSend && rlp.size() < c_maxPayload; ++i)
+            if (auto t = m_tq.transaction(_transactionHashes[i].toHash<h256>()))
+            {
+                rlp += t->rlp();
+                ++n;
+            }
+        cnetlog << n << " pooled transactions known and returned; " << (numItemsToSend - n)
+                << " unknown; " << (count > c_maxTransactionsAsk ? count - c_maxTransactionsAsk : 0)
+                << " ignored";
+
+        return make_pair(rlp, n);
+    }
+
 private:
     BlockChain const& m_chain;
     OverlayDB const& m_db;
+    TransactionQueue const& m_tq;
 };
 
 }
@@ -375,14 +442,16 @@ EthereumHost::EthereumHost(BlockChain const& _ch, OverlayDB const& _db, Transact
     m_tq		(_tq),
     m_bq		(_bq),
     m_networkId	(_networkId),
-    m_hostData(make_shared<EthereumHostData>(m_chain, m_db))
+    m_hostData(make_shared<EthereumHostData>(m_chain, m_db, m_tq))
 {
     // TODO: Composition would be better. Left like that to avoid initialization
     //       issues as BlockChainSync accesses other EthereumHost members.
     m_sync.reset(new BlockChainSync(*this));
     m_peerObserver = make_shared<EthereumPeerObserver>(m_sync, m_tq);
     m_latestBlockSent = _ch.currentHash();
-    m_tq.onImport([this](ImportResult _ir, h256 const& _h, h512 const& _nodeId) { onTransactionImported(_ir, _h, _nodeId); });
+    m_tq.onImport([this](TransactionQueue::ImportResults const& _results, h512 const& _nodeId) {
+        onTransactionsImported(_results, _nodeId);
+    });
 }
 
 EthereumHost::~EthereumHost()
@@ -399,7 +468,9 @@ bool EthereumHost::ensureInitialised()
         LOG(m_logger) << "Initialising: latest=" << m_latestBlockSent;
 
         Guard l(x_transactions);
-        m_transactionsSent = m_tq.knownTransactions();
+        m_transactionsSent.clear();
+        for (auto const& h: m_tq.knownTransactions())
+            m_transactionsSent.insert(h);
         return true;
     }
     return false;
@@ -443,6 +514,7 @@ void EthereumHost::doWork()
     {
         m_lastTick = now;
         foreachPeer([](std::shared_ptr<EthereumPeer> _p) { _p->tick(); return true; });
+        m_sync->tick();
     }
 
 //	return netChange;
@@ -454,33 +526,64 @@ void EthereumHost::maintainTransactions()
 {
     // Send any new transactions.
     unordered_map<std::shared_ptr<EthereumPeer>, std::vector<size_t>> peerTransactions;
-    auto ts = m_tq.topTransactions(c_maxSendTransactions);
+    unordered_map<std::shared_ptr<EthereumPeer>, std::vector<size_t>> peerAnnouncements;
+    auto pending = m_tq.snapshot();
+    auto const& ts = pending->transactions;
+    size_t const count = min<size_t>(ts.size(), c_maxSendTransactions);
+
+    // When announcing, push the full transactions to the square root of the peers that lack them
+    // and only send the hashes to the rest, which fetch what they are still missing.
+    unsigned pushPercent = 0;
+    if (m_announceTransactions)
+    {
+        size_t peerCount = 0;
+        foreachPeer([&](std::shared_ptr<EthereumPeer>) { ++peerCount; return true; });
+        pushPercent = peerCount ? static_cast<unsigned>(100 / sqrt(double(peerCount))) : 100;
+    }
+
     {
         Guard l(x_transactions);
-        for (size_t i = 0; i < ts.size(); ++i)
+        for (size_t i = 0; i < count; ++i)
         {
-            auto const& t = ts[i];
-            bool unsent = !m_transactionsSent.count(t.sha3());
-            auto peers = get<1>(randomSelection(0, [&](EthereumPeer* p) { return p->m_requireTransactions || (unsent && !p->m_knownTransactions.count(t.sha3())); }));
-            for (auto const& p: peers)
+            h256 const& h = ts[i].hash;
+            bool unsent = !m_transactionsSent.contains(h);
+            auto peers = randomSelection(pushPercent, [&](EthereumPeer* p) {
+                // Gossip is what backed-up peers can do without.
+                if (p->isEgressFull())
+                    return false;
+                if (p->m_requireTransactions)
+                    return true;
+                Guard lk(p->x_knownTransactions);
+                return unsent && !p->m_knownTransactions.contains(h);
+            });
+            for (auto const& p: get<0>(peers))
                 peerTransactions[p].push_back(i);
+            for (auto const& p: get<1>(peers))
+                if (m_announceTransactions && !p->m_requireTransactions && p->supportsPooledTransactions())
+                    peerAnnouncements[p].push_back(i);
+                else
+                    peerTransactions[p].push_back(i);
         }
-        for (auto const& t: ts)
-            m_transactionsSent.insert(t.sha3());
+        for (size_t i = 0; i < count; ++i)
+            m_transactionsSent.insert(ts[i].hash);
     }
     foreachPeer([&](shared_ptr<EthereumPeer> _p)
     {
         bytes b;
         unsigned n = 0;
-        for (auto const& i: peerTransactions[_p])
+        auto const& announced = peerAnnouncements[_p];
+        DEV_GUARDED(_p->x_knownTransactions)
         {
-            _p->m_knownTransactions.insert(ts[i].sha3());
-            b += ts[i].rlp();
-            ++n;
+            for (auto const& i: peerTransactions[_p])
+            {
+                _p->m_knownTransactions.insert(ts[i].hash);
+                b += ts[i].transaction->rlp();
+                ++n;
+            }
+            for (auto const& i: announced)
+                _p->m_knownTransactions.insert(ts[i].hash);
         }
 
-        _p->clearKnownTransactions();
-
         if (n || _p->m_requireTransactions)
         {
             RLPStream ts;
@@ -489,6 +592,16 @@ void EthereumHost::maintainTransactions()
             LOG(m_logger) << "Sent " << n << " transactions to "
                           << _p->session()->info().clientVersion;
         }
+        if (!announced.empty())
+        {
+            RLPStream s;
+            _p->prep(s, NewPooledTransactionHashesPacket, announced.size());
+            for (auto const& i: announced)
+                s << ts[i].hash;
+            _p->sealAndSend(s);
+            LOG(m_logger) << "Announced " << announced.size() << " transactions to "
+                          << _p->session()->info().clientVersion;
+        }
         _p->m_requireTransactions = false;
         return true;
     });
@@ -497,10 +610,16 @@ void EthereumHost::maintainTransactions()
 void EthereumHost::foreachPeer(std::function<bool(std::shared_ptr<EthereumPeer>)> const& _f) const
 {
     //order peers by protocol, rating, connection age
-    auto sessions = peerSessions();
     auto sessionLess = [](std::pair<std::shared_ptr<SessionFace>, std::shared_ptr<Peer>> const& _left, std::pair<std::shared_ptr<SessionFace>, std::shared_ptr<Peer>> const& _right)
         { return _left.first->rating() == _right.first->rating() ? _left.first->connectionTime() < _right.first->connectionTime() : _left.first->rating() > _right.first->rating(); };
 
+    auto sessions = peerSessions(c_pooledTransactionsVersion);
+    std::sort(sessions.begin(), sessions.end(), sessionLess);
+    for (auto s: sessions)
+        if (!_f(capabilityFromSession<EthereumPeer>(*s.first, c_pooledTransactionsVersion)))
+            return;
+
+    sessions = peerSessions();
     std::sort(sessions.begin(), sessions.end(), sessionLess);
     for (auto s: sessions)
         if (!_f(capabilityFromSession<EthereumPeer>(*s.first)))
@@ -602,36 +721,50 @@ SyncStatus EthereumHost::status() const
     return m_sync->status();
 }
 
-void EthereumHost::onTransactionImported(ImportResult _ir, h256 const& _h, h512 const& _nodeId)
+void EthereumHost::onTransactionsImported(
+    TransactionQueue::ImportResults const& _results, h512 const& _nodeId)
 {
     auto session = host()->peerSession(_nodeId);
     if (!session)
         return;
 
     std::shared_ptr<EthereumPeer> peer = capabilityFromSession<EthereumPeer>(*session);
+    if (!peer)
+        peer = capabilityFromSession<EthereumPeer>(*session, c_pooledTransactionsVersion);
     if (!peer)
         peer = capabilityFromSession<EthereumPeer>(*session, c_oldProtocolVersion);
     if (!peer)
         return;
 
-    Guard l(peer->x_knownTransactions);
-    peer->m_knownTransactions.insert(_h);
-    switch (_ir)
+    h256s alreadyKnown;
     {
-    case ImportResult::Malformed:
-        peer->addRating(-100);
-        break;
-    case ImportResult::AlreadyKnown:
-        // if we already had the transaction, then don't bother sending it on.
-        DEV_GUARDED(x_transactions)
-            m_transactionsSent.insert(_h);
-        peer->addRating(0);
-        break;
-    case ImportResult::Success:
-        peer->addRating(100);
-        break;
-    default:;
+        Guard l(peer->x_knownTransactions);
+        for (auto const& result: _results)
+        {
+            h256 const& h = result.first;
+            peer->m_knownTransactions.insert(h);
+            switch (result.second)
+            {
+            case ImportResult::Malformed:
+                peer->addRating(-100);
+                break;
+            case ImportResult::AlreadyKnown:
+                alreadyKnown.push_back(h);
+                peer->addRating(0);
+                break;
+            case ImportResult::Success:
+                peer->addRating(100);
+                break;
+            default:;
+            }
+        }
     }
+
+    // if we already had the transactions, then don't bother sending them on.
+    if (!alreadyKnown.empty())
+        DEV_GUARDED(x_transactions)
+            for (auto const& h: alreadyKnown)
+                m_transactionsSent.insert(h);
 }
 
 shared_ptr<Capability> EthereumHost::newPeerCapability(shared_ptr<SessionFace> const& _s, unsigned _idOffset, p2p::CapDesc const& _cap)
@@ -652,3 +785,21 @@ shared_ptr<Capability> EthereumHost::newPeerCapability(shared_ptr<SessionFace> c
 
     return ret;
 }
+
+p2p::TrafficClass EthereumHost::trafficClass(unsigned _packetType) const
+{
+    switch (_packetType)
+    {
+    case TransactionsPacket:
+    case NewPooledTransactionHashesPacket:
+    case PooledTransactionsPacket:
+        return p2p::TrafficClass::TxGossip;
+    case BlockHeadersPacket:
+    case BlockBodiesPacket:
+    case NodeDataPacket:
+    case ReceiptsPacket:
+        return p2p::TrafficClass::SyncServing;
+    default:
+        return p2p::TrafficClass::Propagation;
+    }
+}
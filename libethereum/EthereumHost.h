@@ -38,6 +38,7 @@
 #include <libethereum/BlockChainSync.h>
 #include "CommonNet.h"
 #include "EthereumPeer.h"
+#include "TransactionQueue.h"
 
 namespace dev
 {
@@ -47,7 +48,6 @@ class RLPStream;
 namespace eth
 {
 
-class TransactionQueue;
 class BlockQueue;
 class BlockChainSync;
 
@@ -69,6 +69,10 @@ public:
     u256 networkId() const { return m_networkId; }
     void setNetworkId(u256 _n) { m_networkId = _n; }
 
+    /// Announce transaction hashes to most eth/65 peers instead of sending them the full
+    /// transactions. Older peers keep getting the full transactions.
+    void setTransactionAnnouncements(bool _enable) { m_announceTransactions = _enable; }
+
     void reset();
     /// Don't sync further - used only in test mode
     void completeSync();
@@ -94,6 +98,9 @@ public:
 protected:
     std::shared_ptr<p2p::Capability> newPeerCapability(std::shared_ptr<p2p::SessionFace> const& _s, unsigned _idOffset, p2p::CapDesc const& _cap) override;
 
+    /// Transactions give way to new blocks, and serving other peers' sync to both.
+    p2p::TrafficClass trafficClass(unsigned _packetType) const override;
+
 private:
     static char const* const s_stateNames[static_cast<int>(SyncState::Size)];
 
@@ -104,7 +111,7 @@ private:
 
     void maintainTransactions();
     void maintainBlocks(h256 const& _currentBlock);
-    void onTransactionImported(ImportResult _ir, h256 const& _h, h512 const& _nodeId);
+    void onTransactionsImported(TransactionQueue::ImportResults const& _results, h512 const& _nodeId);
 
     ///	Check to see if the network peer-state initialisation has happened.
     bool isInitialised() const { return (bool)m_latestBlockSent; }
@@ -123,7 +130,8 @@ private:
     u256 m_networkId;
 
     h256 m_latestBlockSent;
-    h256Hash m_transactionsSent;
+    RollingBloom m_transactionsSent{c_maxKnownTransactions};	///< Transactions recently sent or received, guarded by x_transactions.
+    std::atomic<bool> m_announceTransactions{false};
 
     std::unordered_set<p2p::NodeID> m_banned;
 
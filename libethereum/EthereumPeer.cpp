@@ -35,6 +35,21 @@ using namespace p2p;
 
 static const unsigned c_maxIncomingNewHashes = 1024;
 static const unsigned c_maxHeadersToSend = 1024;
+static const unsigned c_minRateSampleItems = 16;	///< Smaller responses measure latency rather than throughput
+static const unsigned c_minRequestsToStall = 4;
+static const double c_maxFailureRate = 0.5;
+static const double c_statsSmoothing = 0.3;
+
+static bool isDataRequest(Asking _a)
+{
+    return _a == Asking::BlockHeaders || _a == Asking::BlockBodies || _a == Asking::NodeData ||
+           _a == Asking::Receipts;
+}
+
+static void smooth(double& _average, double _sample)
+{
+    _average = _average ? _average + (_sample - _average) * c_statsSmoothing : _sample;
+}
 
 static string toString(Asking _a)
 {
@@ -133,9 +148,9 @@ void EthereumPeer::requestStatus(u256 _hostNetworkId, u256 _chainTotalDifficulty
     setAsking(Asking::State);
     m_requireTransactions = true;
     RLPStream s;
-    bool latest = m_peerCapabilityVersion == m_hostProtocolVersion;
+    bool latest = m_peerCapabilityVersion >= m_hostProtocolVersion;
     prep(s, StatusPacket, 5)
-                    << (latest ? m_hostProtocolVersion : EthereumHost::c_oldProtocolVersion)
+                    << (latest ? unsigned(m_peerCapabilityVersion) : EthereumHost::c_oldProtocolVersion)
                     << _hostNetworkId
                     << _chainTotalDifficulty
                     << _chainCurrentHash
@@ -189,15 +204,70 @@ void EthereumPeer::requestReceipts(h256s const& _blocks)
     requestByHashes(_blocks, Asking::Receipts, GetReceiptsPacket);
 }
 
+void EthereumPeer::requestPooledTransactions(h256s const& _hashes)
+{
+    // Not part of the sync state machine, the response is matched by hash.
+    DEV_GUARDED(x_knownTransactions)
+    {
+        m_askedTransactions.emplace_back(_hashes.begin(), _hashes.end());
+        if (m_askedTransactions.size() > c_maxTransactionRequests)
+            m_askedTransactions.pop_front();
+    }
+
+    RLPStream s;
+    prep(s, GetPooledTransactionsPacket, _hashes.size());
+    for (auto const& h: _hashes)
+        s << h;
+    sealAndSend(s);
+}
+
+bytes EthereumPeer::takeRequestedTransactions(RLP const& _r, unsigned& o_unrequested)
+{
+    o_unrequested = 0;
+    vector<bytesConstRef> requested;
+    Guard l(x_knownTransactions);
+    for (auto const& tx: _r)
+    {
+        // Replies come in the order of the requests, but a lost one shouldn't make the next
+        // reply look unrequested, so any outstanding request will do.
+        h256 const h = sha3(tx.data());
+        auto asked = find_if(m_askedTransactions.begin(), m_askedTransactions.end(),
+            [&](h256Hash const& _hashes) { return _hashes.count(h) > 0; });
+        if (asked == m_askedTransactions.end())
+        {
+            ++o_unrequested;
+            continue;
+        }
+        asked->erase(h);
+        m_knownTransactions.insert(h);
+        requested.push_back(tx.data());
+    }
+    // Whatever the peer didn't send of the oldest request it doesn't have.
+    if (!m_askedTransactions.empty())
+        m_askedTransactions.pop_front();
+
+    RLPStream s(requested.size());
+    for (auto const& tx: requested)
+        s.appendRaw(tx);
+    return s.out();
+}
+
+void EthereumPeer::markTransactionsKnown(h256s const& _hashes)
+{
+    Guard l(x_knownTransactions);
+    for (auto const& h: _hashes)
+        m_knownTransactions.insert(h);
+}
+
 void EthereumPeer::requestByHashes(h256s const& _hashes, Asking _asking, SubprotocolPacketType _packetType)
 {
     if (m_asking != Asking::Nothing)
     {
         cnetlog << "Asking " << ::toString(_asking) << " while requesting " << ::toString(m_asking);
     }
-    setAsking(_asking);
     if (_hashes.size())
     {
+        setAsking(_asking);
         RLPStream s;
         prep(s, _packetType, _hashes.size());
         for (auto const& i: _hashes)
@@ -210,6 +280,12 @@ void EthereumPeer::requestByHashes(h256s const& _hashes, Asking _asking, Subprot
 
 void EthereumPeer::setAsking(Asking _a)
 {
+    if (isDataRequest(_a))
+    {
+        Guard l(x_stats);
+        m_askTime = chrono::steady_clock::now();
+        ++m_stats.requests;
+    }
     m_asking = _a;
     m_lastAsk = std::chrono::system_clock::to_time_t(chrono::system_clock::now());
 
@@ -221,6 +297,70 @@ void EthereumPeer::setAsking(Asking _a)
     }
 }
 
+double EthereumPeer::askDuration() const
+{
+    if (!isDataRequest(m_asking))
+        return 0;
+    Guard l(x_stats);
+    return chrono::duration<double>(chrono::steady_clock::now() - m_askTime).count();
+}
+
+void EthereumPeer::noteResponse(RLP const& _r)
+{
+    size_t const items = _r.itemCount();
+    PeerRequestStats stats;
+    DEV_GUARDED(x_stats)
+    {
+        double const elapsed = max(chrono::duration<double>(chrono::steady_clock::now() - m_askTime).count(), 0.001);
+        smooth(m_stats.rtt, elapsed);
+        if (!items)
+            ++m_stats.failures;
+        else if (items >= c_minRateSampleItems)
+        {
+            smooth(m_stats.bytesPerSecond, _r.actualSize() / elapsed);
+            if (m_asking == Asking::BlockHeaders)
+                smooth(m_stats.headersPerSecond, items / elapsed);
+            else if (m_asking == Asking::BlockBodies)
+                smooth(m_stats.bodiesPerSecond, items / elapsed);
+        }
+        stats = m_stats;
+    }
+    updateStatsNotes(stats);
+}
+
+void EthereumPeer::noteRequestTimeout()
+{
+    PeerRequestStats stats;
+    DEV_GUARDED(x_stats)
+    {
+        ++m_stats.failures;
+        m_stats.headersPerSecond /= 2;
+        m_stats.bodiesPerSecond /= 2;
+        m_stats.bytesPerSecond /= 2;
+        stats = m_stats;
+    }
+    updateStatsNotes(stats);
+
+    auto s = session();
+    if (s && stats.requests >= c_minRequestsToStall && stats.failureRate() > c_maxFailureRate)
+    {
+        cnetdetails << "Disconnecting stalled peer, " << stats.failures << " of " << stats.requests << " requests failed";
+        s->disconnect(PingTimeout);
+    }
+}
+
+void EthereumPeer::updateStatsNotes(PeerRequestStats const& _stats)
+{
+    auto s = session();
+    if (!s)
+        return;
+    s->addNote("headersPerSecond", dev::toString(static_cast<unsigned>(_stats.headersPerSecond)));
+    s->addNote("bodiesPerSecond", dev::toString(static_cast<unsigned>(_stats.bodiesPerSecond)));
+    s->addNote("bytesPerSecond", dev::toString(static_cast<unsigned>(_stats.bytesPerSecond)));
+    s->addNote("rttMs", dev::toString(static_cast<unsigned>(_stats.rtt * 1000)));
+    s->addNote("failures", dev::toString(_stats.failures) + "/" + dev::toString(_stats.requests));
+}
+
 void EthereumPeer::tick()
 {
     auto s = session();
@@ -248,6 +388,9 @@ bool EthereumPeer::interpret(unsigned _id, RLP const& _r)
         return false;
 
     m_lastAsk = std::chrono::system_clock::to_time_t(chrono::system_clock::now());
+    // Unknown to peers that negotiated an older version.
+    if (_id >= NewPooledTransactionHashesPacket && _id <= PooledTransactionsPacket && !supportsPooledTransactions())
+        return false;
     try
     {
     switch (_id)
@@ -259,8 +402,8 @@ bool EthereumPeer::interpret(unsigned _id, RLP const& _r)
         m_totalDifficulty = _r[2].toInt<u256>();
         m_latestHash = _r[3].toHash<h256>();
         m_genesisHash = _r[4].toHash<h256>();
-        if (m_peerCapabilityVersion == m_hostProtocolVersion)
-            m_protocolVersion = m_hostProtocolVersion;
+        if (m_peerCapabilityVersion >= m_hostProtocolVersion)
+            m_protocolVersion = unsigned(m_peerCapabilityVersion);
 
         cnetlog << "Status: " << m_protocolVersion << " / " << m_networkId << " / " << m_genesisHash
                 << ", TD: " << m_totalDifficulty << " = " << m_latestHash;
@@ -273,6 +416,55 @@ bool EthereumPeer::interpret(unsigned _id, RLP const& _r)
         observer->onPeerTransactions(dynamic_pointer_cast<EthereumPeer>(dynamic_pointer_cast<EthereumPeer>(shared_from_this())), _r);
         break;
     }
+    case NewPooledTransactionHashesPacket:
+    {
+        unsigned itemCount = _r.itemCount();
+        cnetlog << "NewPooledTransactionHashes (" << dec << itemCount << " entries)";
+
+        if (itemCount > c_maxTransactionHashes)
+        {
+            disable("Too many transaction hashes");
+            break;
+        }
+
+        h256s hashes(itemCount);
+        for (unsigned i = 0; i < itemCount; ++i)
+            hashes[i] = _r[i].toHash<h256>(RLP::VeryStrict);
+
+        observer->onPeerTransactionHashes(dynamic_pointer_cast<EthereumPeer>(shared_from_this()), hashes);
+        break;
+    }
+    case GetPooledTransactionsPacket:
+    {
+        unsigned count = static_cast<unsigned>(_r.itemCount());
+        if (!count)
+        {
+            LOG(m_loggerImpolite) << "Zero-entry GetPooledTransactions: Not replying.";
+            addRating(-10);
+            break;
+        }
+        cnetlog << "GetPooledTransactions (" << dec << count << " entries)";
+
+        pair<bytes, unsigned> const rlpAndItemCount = hostData->pooledTransactions(_r);
+
+        addRating(0);
+        RLPStream s;
+        prep(s, PooledTransactionsPacket, rlpAndItemCount.second).appendRaw(rlpAndItemCount.first, rlpAndItemCount.second);
+        sealAndSend(s);
+        break;
+    }
+    case PooledTransactionsPacket:
+    {
+        unsigned unrequested = 0;
+        bytes const requested = takeRequestedTransactions(_r, unrequested);
+        if (unrequested)
+        {
+            LOG(m_loggerImpolite) << "Unrequested PooledTransactions: " << unrequested << " entries";
+            addRating(-10);
+        }
+        observer->onPeerPooledTransactions(dynamic_pointer_cast<EthereumPeer>(shared_from_this()), RLP(requested));
+        break;
+    }
     case GetBlockHeadersPacket:
     {
         /// Packet layout:
@@ -304,6 +496,7 @@ bool EthereumPeer::interpret(unsigned _id, RLP const& _r)
             LOG(m_loggerImpolite) << "Peer giving us block headers when we didn't ask for them.";
         else
         {
+            noteResponse(_r);
             setIdle();
             observer->onPeerBlockHeaders(dynamic_pointer_cast<EthereumPeer>(shared_from_this()), _r);
         }
@@ -335,6 +528,7 @@ bool EthereumPeer::interpret(unsigned _id, RLP const& _r)
             LOG(m_loggerImpolite) << "Peer giving us block bodies when we didn't ask for them.";
         else
         {
+            noteResponse(_r);
             setIdle();
             observer->onPeerBlockBodies(dynamic_pointer_cast<EthereumPeer>(shared_from_this()), _r);
         }
@@ -411,6 +605,7 @@ bool EthereumPeer::interpret(unsigned _id, RLP const& _r)
             LOG(m_loggerImpolite) << "Peer giving us node data when we didn't ask for them.";
         else
         {
+            noteResponse(_r);
             setIdle();
             observer->onPeerNodeData(dynamic_pointer_cast<EthereumPeer>(shared_from_this()), _r);
         }
@@ -422,6 +617,7 @@ bool EthereumPeer::interpret(unsigned _id, RLP const& _r)
             LOG(m_loggerImpolite) << "Peer giving us receipts when we didn't ask for them.";
         else
         {
+            noteResponse(_r);
             setIdle();
             observer->onPeerReceipts(dynamic_pointer_cast<EthereumPeer>(shared_from_this()), _r);
         }
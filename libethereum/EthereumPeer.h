@@ -23,11 +23,14 @@
 
 #include <mutex>
 #include <array>
+#include <deque>
+#include <chrono>
 #include <memory>
 #include <utility>
 
 #include <libdevcore/RLP.h>
 #include <libdevcore/Guards.h>
+#include <libdevcore/RollingBloom.h>
 #include <libethcore/Common.h>
 #include <libp2p/Capability.h>
 #include "CommonNet.h"
@@ -46,6 +49,10 @@ public:
 
 	virtual void onPeerTransactions(std::shared_ptr<EthereumPeer> _peer, RLP const& _r) = 0;
 
+	virtual void onPeerTransactionHashes(std::shared_ptr<EthereumPeer> _peer, h256s const& _hashes) = 0;
+
+	virtual void onPeerPooledTransactions(std::shared_ptr<EthereumPeer> _peer, RLP const& _r) = 0;
+
 	virtual void onPeerBlockHeaders(std::shared_ptr<EthereumPeer> _peer, RLP const& _headers) = 0;
 
 	virtual void onPeerBlockBodies(std::shared_ptr<EthereumPeer> _peer, RLP const& _r) = 0;
@@ -73,6 +80,21 @@ public:
 	virtual strings nodeData(RLP const& _dataHashes) const = 0;
 
 	virtual std::pair<bytes, unsigned> receipts(RLP const& _blockHashes) const = 0;
+
+	virtual std::pair<bytes, unsigned> pooledTransactions(RLP const& _transactionHashes) const = 0;
+};
+
+/// Throughput and latency of a peer, measured from its responses to our requests.
+struct PeerRequestStats
+{
+	double headersPerSecond = 0;	///< Smoothed header delivery rate, 0 if not measured yet
+	double bodiesPerSecond = 0;		///< Smoothed block body delivery rate, 0 if not measured yet
+	double bytesPerSecond = 0;		///< Smoothed payload rate of all responses, 0 if not measured yet
+	double rtt = 0;					///< Smoothed response time in seconds, 0 if not measured yet
+	unsigned requests = 0;			///< Data requests sent
+	unsigned failures = 0;			///< Requests answered empty or not in time
+
+	double failureRate() const { return requests ? static_cast<double>(failures) / requests : 0; }
 };
 
 /**
@@ -121,6 +143,20 @@ public:
 	/// Request receipts for specified blocks from peer.
 	void requestReceipts(h256s const& _blocks);
 
+	/// Request the bodies of announced transactions from peer.
+	void requestPooledTransactions(h256s const& _hashes);
+
+	/// @returns true if the peer negotiated a protocol version with the pooled transaction packets.
+	bool supportsPooledTransactions() const { return m_peerCapabilityVersion >= c_pooledTransactionsVersion; }
+
+	/// Notes that the peer knows of the given transactions, so they are not sent to it.
+	void markTransactionsKnown(h256s const& _hashes);
+
+	/// @returns the RLP list of the transactions in PooledTransactions reply @a _r that were
+	/// asked of this peer, and forgets the request it answers. @a o_unrequested is set to the
+	/// number of transactions that weren't asked for.
+	bytes takeRequestedTransactions(RLP const& _r, unsigned& o_unrequested);
+
 	/// Check if this node is rude.
 	bool isRude() const;
 
@@ -130,6 +166,16 @@ public:
 	/// Abort the sync operation.
 	void abortSync();
 
+	/// @returns the measured performance of the peer.
+	PeerRequestStats requestStats() const { Guard l(x_stats); return m_stats; }
+
+	/// @returns seconds since the outstanding request was sent, 0 if there is none.
+	double askDuration() const;
+
+	/// Notes that the outstanding request took too long and was given to another peer.
+	/// Disconnects the peer if most of its requests fail.
+	void noteRequestTimeout();
+
 private:
 	using p2p::Capability::sealAndSend;
 
@@ -142,15 +188,18 @@ private:
 	/// Request status. Called from constructor
 	void requestStatus(u256 _hostNetworkId, u256 _chainTotalDifficulty, h256 _chainCurrentHash, h256 _chainGenesisHash);
 
-	/// Clear all known transactions.
-	void clearKnownTransactions() { std::lock_guard<std::mutex> l(x_knownTransactions); m_knownTransactions.clear(); }
-
 	// Request of type _packetType with _hashes as input parameters
 	void requestByHashes(h256s const& _hashes, Asking _asking, SubprotocolPacketType _packetType);
 
 	/// Update our asking state.
 	void setAsking(Asking _g);
 
+	/// Update the measurements with the response @a _r to the outstanding request.
+	void noteResponse(RLP const& _r);
+
+	/// Publish the measurements as session notes.
+	void updateStatsNotes(PeerRequestStats const& _stats);
+
 	/// Do we presently need syncing with this peer?
 	bool needsSyncing() const { return !isRude() && !!m_latestHash; }
 
@@ -176,6 +225,10 @@ private:
 	/// When we asked for it. Allows a time out.
 	std::atomic<time_t> m_lastAsk;
 
+	mutable Mutex x_stats;
+	std::chrono::steady_clock::time_point m_askTime;	///< When the outstanding request was sent, guarded by x_stats
+	PeerRequestStats m_stats;							///< Guarded by x_stats
+
 	/// These are determined through either a Status message or from NewBlock.
 	h256 m_latestHash;						///< Peer's latest block's hash that we know about or default null value if no need to sync.
 	u256 m_totalDifficulty;					///< Peer's latest block's total difficulty.
@@ -188,7 +241,8 @@ private:
 	Mutex x_knownBlocks;
 	h256Hash m_knownBlocks;					///< Blocks that the peer already knows about (that don't need to be sent to them).
 	Mutex x_knownTransactions;
-	h256Hash m_knownTransactions;			///< Transactions that the peer already knows of.
+	RollingBloom m_knownTransactions{c_maxKnownTransactions};	///< Transactions that the peer recently sent, announced or was sent.
+	std::deque<h256Hash> m_askedTransactions;	///< Hashes of each outstanding PooledTransactions request, oldest first, guarded by x_knownTransactions.
 	unsigned m_unknownNewBlocks = 0;		///< Number of unknown NewBlocks received from this peer
 	unsigned m_lastAskedHeaders = 0;		///< Number of hashes asked
 
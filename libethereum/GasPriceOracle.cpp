@@ -0,0 +1,202 @@
+// Copyright 2018 cpp-ethereum Authors.
+// Licensed under the GNU General Public License v3. See the LICENSE file.
+
+#include "GasPriceOracle.h"
+
+#include "BlockChain.h"
+#include "TransactionQueue.h"
+
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+namespace
+{
+unsigned const c_subBucketBits = 4;
+unsigned const c_subBuckets = 1 << c_subBucketBits;
+/// Prices below c_subBuckets have a bucket each; above, every power of two up to 2**64 has
+/// c_subBuckets. Anything higher goes in the last one.
+unsigned const c_buckets = c_subBuckets + (64 - c_subBucketBits) * c_subBuckets;
+
+unsigned bucket(u256 const& _price)
+{
+    if (_price < c_subBuckets)
+        return static_cast<unsigned>(_price);
+    unsigned const e = boost::multiprecision::msb(_price);
+    if (e >= 64)
+        return c_buckets - 1;
+    unsigned const sub = static_cast<unsigned>(_price >> (e - c_subBucketBits)) & (c_subBuckets - 1);
+    return c_subBuckets + (e - c_subBucketBits) * c_subBuckets + sub;
+}
+
+/// @returns the highest price in @a _bucket.
+u256 bucketPrice(unsigned _bucket)
+{
+    if (_bucket < c_subBuckets)
+        return _bucket;
+    unsigned const shift = (_bucket - c_subBuckets) / c_subBuckets;
+    unsigned const sub = (_bucket - c_subBuckets) % c_subBuckets;
+    return (u256(c_subBuckets + sub + 1) << shift) - 1;
+}
+
+vector<u256> gasPrices(BlockChain const& _bc, BlockHeader const& _header)
+{
+    vector<u256> ret;
+    if (_header.transactionsRoot() != EmptyTrie)
+        for (auto const& tr: _bc.cachedBlock(_header.hash())->transactionRefs())
+            ret.push_back(Transaction(tr, CheckTransaction::None).gasPrice());
+    return ret;
+}
+}  // namespace
+
+u256 GasPriceOracle::bid(TransactionPriority _priority) const
+{
+    ReadGuard l(x_percentiles);
+    if (!m_havePercentiles)
+        return TrivialGasPricer::bid(_priority);
+    return m_percentiles[static_cast<unsigned>(_priority) * 100 / 8];
+}
+
+u256 GasPriceOracle::percentile(unsigned _percent) const
+{
+    ReadGuard l(x_percentiles);
+    if (!m_havePercentiles)
+        return TrivialGasPricer::bid();
+    return m_percentiles[min(_percent, 100u)];
+}
+
+void GasPriceOracle::update(BlockChain const& _bc)
+{
+    vector<BlockHeader> headers;
+    for (h256 h = _bc.currentHash(); h && headers.size() < m_blocks; )
+    {
+        headers.push_back(_bc.info(h));
+        h = headers.back().parentHash();
+    }
+
+    Guard l(x_window);
+    m_window.clear();
+    m_counts.assign(c_buckets, 0);
+    m_total = 0;
+    add_WITH_LOCK(m_pending);
+    for (auto it = headers.rbegin(); it != headers.rend(); ++it)
+    {
+        m_window.push_back({it->number(), histogram(gasPrices(_bc, *it))});
+        add_WITH_LOCK(m_window.back().histogram);
+    }
+    publish_WITH_LOCK();
+}
+
+void GasPriceOracle::onBlockImported(BlockChain const& _bc, BlockHeader const& _header)
+{
+    noteBlock(_header.number(), gasPrices(_bc, _header));
+}
+
+void GasPriceOracle::notePending(TransactionQueue const& _tq)
+{
+    auto const snapshot = _tq.snapshot();
+    DEV_GUARDED(x_window)
+        if (snapshot->epoch == m_pendingEpoch)
+            return;
+
+    vector<u256> prices;
+    prices.reserve(snapshot->transactions.size());
+    for (auto const& t: snapshot->transactions)
+        prices.push_back(t.transaction->gasPrice());
+    notePending(prices);
+
+    DEV_GUARDED(x_window)
+        m_pendingEpoch = snapshot->epoch;
+}
+
+void GasPriceOracle::noteBlock(u256 const& _number, vector<u256> const& _gasPrices)
+{
+    Histogram h = histogram(_gasPrices);
+
+    Guard l(x_window);
+    if (m_counts.empty())
+        m_counts.assign(c_buckets, 0);
+    while (!m_window.empty() && m_window.back().number >= _number)
+    {
+        remove_WITH_LOCK(m_window.back().histogram);
+        m_window.pop_back();
+    }
+    add_WITH_LOCK(h);
+    m_window.push_back({_number, move(h)});
+    while (m_window.size() > m_blocks)
+    {
+        remove_WITH_LOCK(m_window.front().histogram);
+        m_window.pop_front();
+    }
+    publish_WITH_LOCK();
+}
+
+void GasPriceOracle::notePending(vector<u256> const& _gasPrices)
+{
+    Histogram h = histogram(_gasPrices);
+
+    Guard l(x_window);
+    if (m_counts.empty())
+        m_counts.assign(c_buckets, 0);
+    remove_WITH_LOCK(m_pending);
+    m_pending = move(h);
+    add_WITH_LOCK(m_pending);
+    publish_WITH_LOCK();
+}
+
+GasPriceOracle::Histogram GasPriceOracle::histogram(vector<u256> const& _gasPrices)
+{
+    vector<unsigned> buckets;
+    buckets.reserve(_gasPrices.size());
+    for (auto const& p: _gasPrices)
+        buckets.push_back(bucket(p));
+    sort(buckets.begin(), buckets.end());
+
+    Histogram ret;
+    for (unsigned b: buckets)
+        if (!ret.empty() && ret.back().first == b)
+            ++ret.back().second;
+        else
+            ret.emplace_back(b, 1);
+    return ret;
+}
+
+void GasPriceOracle::add_WITH_LOCK(Histogram const& _histogram)
+{
+    for (auto const& b: _histogram)
+    {
+        m_counts[b.first] += b.second;
+        m_total += b.second;
+    }
+}
+
+void GasPriceOracle::remove_WITH_LOCK(Histogram const& _histogram)
+{
+    for (auto const& b: _histogram)
+    {
+        m_counts[b.first] -= b.second;
+        m_total -= b.second;
+    }
+}
+
+void GasPriceOracle::publish_WITH_LOCK()
+{
+    array<u256, 101> percentiles;
+    if (m_total)
+    {
+        // The p-th percentile is the first bucket by which p% of the transactions are counted.
+        uint64_t seen = 0;
+        unsigned b = 0;
+        for (unsigned p = 0; p <= 100; ++p)
+        {
+            uint64_t const target = max<uint64_t>(1, (m_total * p + 99) / 100);
+            for (; seen + m_counts[b] < target; ++b)
+                seen += m_counts[b];
+            percentiles[p] = bucketPrice(b);
+        }
+    }
+
+    WriteGuard l(x_percentiles);
+    m_havePercentiles = m_total > 0;
+    m_percentiles = percentiles;
+}
@@ -0,0 +1,87 @@
+// Copyright 2018 cpp-ethereum Authors.
+// Licensed under the GNU General Public License v3. See the LICENSE file.
+
+#pragma once
+
+#include "GasPricer.h"
+
+#include <libdevcore/Guards.h>
+
+#include <array>
+#include <deque>
+#include <vector>
+
+namespace dev
+{
+namespace eth
+{
+/**
+ * @brief Suggests gas prices from those paid in recent blocks and offered by pending transactions.
+ *
+ * Prices are counted per transaction in a histogram with 16 buckets per power of two, so every
+ * answer is within 1/16 of a price actually seen; it is rounded up to the top of its bucket.
+ * Each block in the window keeps its own sparse histogram, which is added when the block is
+ * imported and subtracted when it falls out, so updates never rescan the chain. The percentiles
+ * are recomputed after every update and looked up by bid() and percentile().
+ *
+ * Until a price has been seen, bids are the fixed one of the base class.
+ */
+class GasPriceOracle: public TrivialGasPricer
+{
+public:
+    static unsigned const c_defaultBlocks = 100;
+
+    GasPriceOracle(u256 const& _ask, u256 const& _bid, unsigned _blocks = c_defaultBlocks)
+      : TrivialGasPricer(_ask, _bid), m_blocks(std::max(_blocks, 1u))
+    {}
+
+    /// Maps @a _priority onto the percentiles, Lowest being the cheapest price seen and Highest
+    /// the most expensive one.
+    u256 bid(TransactionPriority _priority = TransactionPriority::Medium) const override;
+
+    /// @returns the gas price that @a _percent percent of the transactions seen pay at most.
+    u256 percentile(unsigned _percent) const;
+
+    /// Refills the window from the last blocks of @a _bc.
+    void update(BlockChain const& _bc) override;
+    void onBlockImported(BlockChain const& _bc, BlockHeader const& _header) override;
+    void notePending(TransactionQueue const& _tq) override;
+
+    /// Adds the prices paid in block @a _number to the window. Blocks at or above that number
+    /// belonged to a branch that has been abandoned and are dropped first.
+    void noteBlock(u256 const& _number, std::vector<u256> const& _gasPrices);
+
+    /// Replaces the prices offered by pending transactions.
+    void notePending(std::vector<u256> const& _gasPrices);
+
+private:
+    /// Non-empty buckets and their counts, ordered by bucket.
+    using Histogram = std::vector<std::pair<unsigned, unsigned>>;
+
+    struct BlockPrices
+    {
+        u256 number;
+        Histogram histogram;
+    };
+
+    static Histogram histogram(std::vector<u256> const& _gasPrices);
+    void add_WITH_LOCK(Histogram const& _histogram);
+    void remove_WITH_LOCK(Histogram const& _histogram);
+    void publish_WITH_LOCK();
+
+    unsigned const m_blocks;
+
+    Mutex x_window;
+    std::deque<BlockPrices> m_window;       ///< Oldest first.
+    Histogram m_pending;
+    uint64_t m_pendingEpoch = 0;
+    std::vector<unsigned> m_counts;         ///< Window and pending together, indexed by bucket.
+    uint64_t m_total = 0;
+
+    mutable SharedMutex x_percentiles;
+    std::array<u256, 101> m_percentiles;
+    bool m_havePercentiles = false;
+};
+
+}  // namespace eth
+}  // namespace dev
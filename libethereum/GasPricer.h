@@ -30,6 +30,8 @@ namespace eth
 
 class Block;
 class BlockChain;
+class BlockHeader;
+class TransactionQueue;
 
 enum class TransactionPriority
 {
@@ -52,6 +54,12 @@ public:
 	virtual u256 bid(TransactionPriority _p = TransactionPriority::Medium) const = 0;
 
 	virtual void update(BlockChain const&) {}
+
+	/// Called with each block that becomes the head of the chain.
+	virtual void onBlockImported(BlockChain const&, BlockHeader const&) {}
+
+	/// Called when the pending transactions may have changed.
+	virtual void notePending(TransactionQueue const&) {}
 };
 
 class TrivialGasPricer: public GasPricer
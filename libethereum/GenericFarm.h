@@ -128,7 +128,10 @@ public:
 		{
 			ReadGuard l2(x_minerWork);
 			for (auto const& i: m_miners)
-				p.hashes += i->hashCount();
+			{
+				p.minerHashes.push_back(i->hashCount());
+				p.hashes += p.minerHashes.back();
+			}
 		}
 		WriteGuard l(x_progress);
 		m_progress = p;
@@ -35,6 +35,13 @@ namespace eth
 inline std::ostream& operator<<(std::ostream& _out, WorkingProgress _p)
 {
 	_out << _p.rate() << " H/s = " <<  _p.hashes << " hashes / " << (double(_p.ms) / 1000) << " s";
+	if (_p.minerHashes.size() > 1)
+	{
+		_out << " (";
+		for (unsigned i = 0; i < _p.minerHashes.size(); ++i)
+			_out << (i ? ", " : "") << _p.minerRate(i);
+		_out << " H/s per miner)";
+	}
 	return _out;
 }
 
@@ -0,0 +1,51 @@
+// Copyright 2018 cpp-ethereum Authors.
+// Licensed under the GNU General Public License v3. See the LICENSE file.
+
+#include "HeaderSkeleton.h"
+
+#include <algorithm>
+
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+unsigned const HeaderSkeleton::c_stride;
+unsigned const HeaderSkeleton::c_maxSize;
+unsigned const HeaderSkeleton::c_maxMismatches;
+
+HeaderSkeleton::Request HeaderSkeleton::nextRequest(unsigned _linked, unsigned _highest) const
+{
+    unsigned const skeletonEnd = end();
+    if (skeletonEnd > _linked + c_stride * c_maxSize / 2)
+        return {};  // far enough ahead
+    unsigned const base = max(_linked, skeletonEnd);
+    if (_highest <= base + c_stride * 2)
+        return {};
+
+    Request ret;
+    ret.from = base + c_stride;
+    ret.count = min(c_maxSize, (_highest - base - 1) / c_stride);
+    return ret;
+}
+
+void HeaderSkeleton::noteTimedOut()
+{
+    m_late = m_requested;
+    m_requested = {};
+}
+
+HeaderSkeleton::Request HeaderSkeleton::takeRequest(bool _late)
+{
+    Request& request = _late ? m_late : m_requested;
+    Request const ret = request;
+    request = {};
+    return ret;
+}
+
+void HeaderSkeleton::reset()
+{
+    m_anchors.clear();
+    m_requested = {};
+    m_late = {};
+    m_mismatches = 0;
+}
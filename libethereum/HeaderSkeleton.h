@@ -0,0 +1,91 @@
+// Copyright 2018 cpp-ethereum Authors.
+// Licensed under the GNU General Public License v3. See the LICENSE file.
+
+#pragma once
+
+#include <set>
+
+namespace dev
+{
+namespace eth
+{
+/**
+ * @brief Bookkeeping of skeleton header sync.
+ *
+ * A skeleton is a sparse set of headers c_stride blocks apart, requested from the best peer. Other
+ * peers then fill the gaps, and a gap fill is only accepted if it links to the skeleton header
+ * (anchor) after it. Which peer a request went to is left to BlockChainSync.
+ */
+class HeaderSkeleton
+{
+public:
+    /// Distance between skeleton headers; the gaps are filled with one request each.
+    static unsigned const c_stride = 192;
+    /// Max number of skeleton headers requested at once.
+    static unsigned const c_maxSize = 128;
+    /// Gap fills in a row not linking to the skeleton before it is dropped.
+    static unsigned const c_maxMismatches = 4;
+
+    struct Request
+    {
+        unsigned from = 0;
+        unsigned count = 0;
+
+        explicit operator bool() const { return count > 0; }
+    };
+
+    /// @returns the skeleton to request when headers up to @a _linked link to our chain and the
+    /// best peer has @a _highest, or an empty request if the skeleton is far enough ahead.
+    Request nextRequest(unsigned _linked, unsigned _highest) const;
+
+    /// Notes that @a _request was sent.
+    void noteRequested(Request const& _request) { m_requested = _request; }
+
+    /// Notes that the peer asked for the skeleton didn't answer in time. Its answer may still
+    /// come, so the request is kept to recognise it.
+    void noteTimedOut();
+
+    /// @returns the request a skeleton reply answers and forgets it. @a _late selects the one
+    /// that timed out.
+    Request takeRequest(bool _late);
+
+    /// @returns true if @a _number is what the header at @a _index of a reply to @a _request
+    /// should be.
+    static bool isInPlace(Request const& _request, unsigned _index, unsigned _number)
+    {
+        return _number == _request.from + _index * c_stride;
+    }
+
+    /// Adds the skeleton header @a _number.
+    void add(unsigned _number) { m_anchors.insert(_number); }
+
+    bool empty() const { return m_anchors.empty(); }
+    bool isAnchor(unsigned _number) const { return m_anchors.count(_number) > 0; }
+
+    /// @returns the highest skeleton header number, 0 if there is none.
+    unsigned end() const { return m_anchors.empty() ? 0 : *m_anchors.rbegin(); }
+
+    /// Forgets the skeleton headers above @a _last, whose headers were dropped.
+    void truncate(unsigned _last) { m_anchors.erase(m_anchors.upper_bound(_last), m_anchors.end()); }
+
+    /// Forgets the skeleton headers up to the imported block @a _imported.
+    void prune(unsigned _imported) { m_anchors.erase(m_anchors.begin(), m_anchors.upper_bound(_imported)); }
+
+    /// Notes a gap fill that linked to the skeleton.
+    void noteLinked() { m_mismatches = 0; }
+
+    /// Notes a gap fill that didn't link to the skeleton. @returns true once so many did in a row
+    /// that the skeleton should be dropped.
+    bool noteMismatch() { return ++m_mismatches >= c_maxMismatches; }
+
+    void reset();
+
+private:
+    std::set<unsigned> m_anchors;  ///< Numbers of the downloaded skeleton headers.
+    Request m_requested;           ///< Outstanding skeleton request.
+    Request m_late;                ///< Skeleton request whose peer timed out.
+    unsigned m_mismatches = 0;     ///< Gap fills in a row that didn't link to the skeleton.
+};
+
+}  // namespace eth
+}  // namespace dev
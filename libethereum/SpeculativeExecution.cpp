@@ -0,0 +1,112 @@
+// Copyright 2018 cpp-ethereum Authors.
+// Licensed under the GNU General Public License v3. See the LICENSE file.
+
+#include "SpeculativeExecution.h"
+
+#include "State.h"
+
+#include <libethcore/SealEngine.h>
+#include <libevm/ExtVMFace.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+
+vector<SpeculativeResult> SpeculativeBlockBuilder::execute(State const& _state,
+    EnvInfo const& _envInfo, SealEngineFace const& _sealEngine,
+    vector<Transaction const*> const& _transactions, chrono::steady_clock::time_point _deadline) const
+{
+    vector<SpeculativeResult> ret(_transactions.size());
+    if (_transactions.empty())
+        return ret;
+
+    // Every worker gets its own copy and undoes each transaction after recording what it touched.
+    unsigned const threads = min<size_t>(m_threads, _transactions.size());
+    vector<State> states(threads, _state);
+    atomic<size_t> next{0};
+
+    auto work = [&](State& _s) {
+        while (true)
+        {
+            if (chrono::steady_clock::now() > _deadline)
+                return;
+            size_t const i = next++;
+            if (i >= _transactions.size())
+                return;
+
+            SpeculativeResult& r = ret[i];
+            size_t const savepoint = _s.savepoint();
+            _s.recordAccess(&r.reads);
+            try
+            {
+                auto const receipt =
+                    _s.execute(_envInfo, _sealEngine, *_transactions[i], Permanence::Uncommitted)
+                        .second;
+                r.gasUsed = receipt.cumulativeGasUsed() - _envInfo.gasUsed();
+                for (auto c = _s.changeLog().begin() + savepoint; c != _s.changeLog().end(); ++c)
+                    r.writes.insert(c->address);
+                r.valid = true;
+            }
+            catch (...)
+            {
+                // Left for the sequential execution to report and drop.
+            }
+            _s.recordAccess(nullptr);
+            _s.rollback(savepoint);
+        }
+    };
+
+    vector<thread> workers;
+    for (unsigned t = 1; t < threads; ++t)
+        workers.emplace_back([&, t]() {
+            setThreadName("speculate");
+            work(states[t]);
+        });
+    work(states[0]);
+    for (auto& w: workers)
+        w.join();
+
+    return ret;
+}
+
+vector<size_t> SpeculativeBlockBuilder::pack(vector<Transaction const*> const& _transactions,
+    vector<SpeculativeResult> const& _results, Address const& _author, u256 _gasLimit)
+{
+    vector<size_t> candidates;
+    for (size_t i = 0; i < _results.size(); ++i)
+        if (_results[i].valid)
+            candidates.push_back(i);
+
+    // Most fees first; these are what the author is paid for including the transaction.
+    auto fee = [&](size_t _i) { return _transactions[_i]->gasPrice() * _results[_i].gasUsed; };
+    stable_sort(candidates.begin(), candidates.end(),
+        [&](size_t _a, size_t _b) { return fee(_a) > fee(_b); });
+
+    vector<size_t> ret;
+    AddressHash read;
+    AddressHash written;
+    auto intersects = [&](AddressHash const& _a, AddressHash const& _b) {
+        for (auto const& a: _a)
+            if (a != _author && _b.count(a))
+                return true;
+        return false;
+    };
+    for (size_t i: candidates)
+    {
+        SpeculativeResult const& r = _results[i];
+        // The block checks the gas limit of the transaction, not what it ends up using.
+        u256 const gas = _transactions[i]->gas();
+        if (gas > _gasLimit || intersects(r.reads, written) || intersects(r.writes, read))
+            continue;
+
+        read += r.reads;
+        written += r.writes;
+        _gasLimit -= _results[i].gasUsed;
+        ret.push_back(i);
+    }
+    return ret;
+}
@@ -0,0 +1,63 @@
+// Copyright 2018 cpp-ethereum Authors.
+// Licensed under the GNU General Public License v3. See the LICENSE file.
+
+#pragma once
+
+#include "Transaction.h"
+
+#include <libdevcore/Address.h>
+#include <libdevcore/Common.h>
+
+#include <chrono>
+#include <vector>
+
+namespace dev
+{
+namespace eth
+{
+class EnvInfo;
+class SealEngineFace;
+class State;
+
+/// What a transaction did when executed on its own against the pending state.
+struct SpeculativeResult
+{
+    bool valid = false;  ///< Executed without an exception.
+    u256 gasUsed;
+    AddressHash reads;   ///< Accounts read or written.
+    AddressHash writes;  ///< Accounts changed.
+};
+
+/**
+ * @brief Pre-executes candidate transactions in parallel to choose which ones to put in a block.
+ *
+ * Every transaction is executed on its own against the same state, so the results only hold as
+ * long as the chosen transactions don't touch what the others changed. The block itself is still
+ * built by executing the chosen transactions one after another.
+ */
+class SpeculativeBlockBuilder
+{
+public:
+    explicit SpeculativeBlockBuilder(unsigned _threads): m_threads(std::max(_threads, 1u)) {}
+
+    /// Executes each of @a _transactions against @a _state, which is left untouched. Those not
+    /// started by @a _deadline are left out and reported invalid.
+    /// @returns the results in the order of @a _transactions.
+    std::vector<SpeculativeResult> execute(State const& _state, EnvInfo const& _envInfo,
+        SealEngineFace const& _sealEngine, std::vector<Transaction const*> const& _transactions,
+        std::chrono::steady_clock::time_point _deadline =
+            std::chrono::steady_clock::time_point::max()) const;
+
+    /// Greedily picks the valid transactions that pay the most, skipping those that read or write
+    /// an account written by one already picked or write one it read, until @a _gasLimit is used.
+    /// @a _author is not considered a conflict, as every transaction pays its fee to it.
+    /// @returns indices into @a _transactions in the order they should be executed.
+    static std::vector<size_t> pack(std::vector<Transaction const*> const& _transactions,
+        std::vector<SpeculativeResult> const& _results, Address const& _author, u256 _gasLimit);
+
+private:
+    unsigned m_threads;
+};
+
+}  // namespace eth
+}  // namespace dev
@@ -162,6 +162,9 @@ Account const* State::account(Address const& _a) const
 
 Account* State::account(Address const& _addr)
 {
+    if (m_accessed)
+        m_accessed->insert(_addr);
+
     auto it = m_cache.find(_addr);
     if (it != m_cache.end())
         return &it->second;
@@ -218,6 +221,16 @@ void State::commit(CommitBehaviour _commitBehaviour)
     m_unchangedCacheEntries.clear();
 }
 
+void State::setCommittedAccount(Address const& _address, std::string const& _rlp)
+{
+    m_cache.erase(_address);
+    m_nonExistingAccountsCache.erase(_address);
+    if (_rlp.empty())
+        m_state.remove(_address);
+    else
+        m_state.insert(_address, bytesConstRef(&_rlp));
+}
+
 unordered_map<Address, u256> State::addresses() const
 {
 #if ETH_FATDB
@@ -407,6 +420,8 @@ void State::createContract(Address const& _address)
 void State::createAccount(Address const& _address, Account const&& _account)
 {
     assert(!addressInUse(_address) && "Account already exists");
+    if (m_accessed)
+        m_accessed->insert(_address);
     m_cache[_address] = std::move(_account);
     m_nonExistingAccountsCache.erase(_address);
     m_changeLog.emplace_back(Change::Create, _address);
@@ -310,6 +310,14 @@ public:
     /// The hash of the root of our state tree.
     h256 rootHash() const { return m_state.root(); }
 
+    /// @returns the RLP of the account at @p _address as committed to the trie, or an empty string
+    /// if there is no such account. Changes still in the cache are not visible.
+    std::string committedAccount(Address const& _address) const { return m_state.at(_address); }
+
+    /// Writes the RLP of an account, as returned by committedAccount(), straight into the trie.
+    /// An empty string removes the account. Must not be used while there are uncommitted changes.
+    void setCommittedAccount(Address const& _address, std::string const& _rlp);
+
     /// Commit all changes waiting in the address cache to the DB.
     /// @param _commitBehaviour whether or not to remove empty accounts during commit.
     void commit(CommitBehaviour _commitBehaviour);
@@ -331,6 +339,10 @@ public:
 
     ChangeLog const& changeLog() const { return m_changeLog; }
 
+    /// Record the addresses of all accounts read or written from now on in @p o_accessed.
+    /// Pass nullptr to stop recording. Not copied with the state.
+    void recordAccess(AddressHash* o_accessed) { m_accessed = o_accessed; }
+
 private:
     /// Turns all "touched" empty accounts into non-alive accounts.
     void removeEmptyAccounts();
@@ -354,6 +366,7 @@ private:
     mutable std::vector<Address> m_unchangedCacheEntries;	///< Tracks entries in m_cache that can potentially be purged if it grows too large.
     mutable std::set<Address> m_nonExistingAccountsCache;	///< Tracks addresses that are known to not exist.
     AddressHash m_touched;						///< Tracks all addresses touched so far.
+    AddressHash* m_accessed = nullptr;			///< Receives the addresses of accessed accounts, if set.
 
     u256 m_accountStartNonce;
 
@@ -24,14 +24,16 @@
 #include <libdevcore/Log.h>
 #include <libethcore/Exceptions.h>
 #include "Transaction.h"
+#include <queue>
 using namespace std;
 using namespace dev;
 using namespace dev::eth;
 
 const size_t c_maxVerificationQueueSize = 8192;
+/// Smallest part of a packet worth handing to a separate verifier thread.
+const unsigned c_minVerificationRange = 16;
 
 TransactionQueue::TransactionQueue(unsigned _limit, unsigned _futureLimit):
-    m_current(PriorityCompare { *this }),
     m_limit(_limit),
     m_futureLimit(_futureLimit)
 {
@@ -65,7 +67,7 @@ ImportResult TransactionQueue::import(bytesConstRef _transactionRLP, IfDropped _
     }
 }
 
-ImportResult TransactionQueue::check_WITH_LOCK(h256 const& _h, IfDropped _ik)
+ImportResult TransactionQueue::check_WITH_LOCK(h256 const& _h, IfDropped _ik) const
 {
     if (m_known.count(_h))
         return ImportResult::AlreadyKnown;
@@ -84,6 +86,7 @@ ImportResult TransactionQueue::import(Transaction const& _transaction, IfDropped
     h256 h = _transaction.sha3(WithSignature);
 
     ImportResult ret;
+    bool ready = false;
     {
         UpgradableGuard l(m_lock);
         auto ir = check_WITH_LOCK(h, _ik);
@@ -94,21 +97,94 @@ ImportResult TransactionQueue::import(Transaction const& _transaction, IfDropped
             _transaction.safeSender();  // Perform EC recovery outside of the write lock
             UpgradeGuard ul(l);
             ret = manageImport_WITH_LOCK(h, _transaction);
+            ready = m_readyPending;
+            m_readyPending = false;
         }
     }
+    if (ready)
+        m_onReady();
     return ret;
 }
 
+template <class F>
+void TransactionQueue::forEachCurrent_WITH_LOCK(F const& _f) const
+{
+    // Merge the lanes: the next transaction is the best one among the heads that haven't been
+    // taken yet and the successors of those that have.
+    struct Next
+    {
+        LaneHead head;
+        Lane const* lane;
+        Lane::const_iterator position;
+    };
+    auto worse = [](Next const& _first, Next const& _second) {
+        return LaneHeadCompare()(_second.head, _first.head);
+    };
+    std::priority_queue<Next, std::vector<Next>, decltype(worse)> successors(worse);
+
+    auto head = m_heads.begin();
+    while (head != m_heads.end() || !successors.empty())
+    {
+        Next next;
+        if (head != m_heads.end() &&
+            (successors.empty() || LaneHeadCompare()(*head, successors.top().head)))
+        {
+            Lane const& lane = m_current.at(head->sender);
+            next = Next{*head, &lane, lane.begin()};
+            ++head;
+        }
+        else
+        {
+            next = successors.top();
+            successors.pop();
+        }
+
+        if (!_f(next.position->second))
+            return;
+
+        auto following = std::next(next.position);
+        if (following != next.lane->end())
+        {
+            VerifiedTransaction const& f = following->second;
+            LaneHead const fh{f.transaction->gasPrice(), f.sequence, next.head.sender};
+            successors.push(Next{fh, next.lane, following});
+        }
+    }
+}
+
 Transactions TransactionQueue::topTransactions(unsigned _limit, h256Hash const& _avoid) const
 {
     ReadGuard l(m_lock);
     Transactions ret;
-    for (auto t = m_current.begin(); ret.size() < _limit && t != m_current.end(); ++t)
-        if (!_avoid.count(t->transaction.sha3()))
-            ret.push_back(t->transaction);
+    if (!_limit)
+        return ret;
+    forEachCurrent_WITH_LOCK([&](VerifiedTransaction const& _t) {
+        if (!_avoid.count(_t.transaction->sha3()))
+            ret.push_back(*_t.transaction);
+        return ret.size() < _limit;
+    });
     return ret;
 }
 
+shared_ptr<TransactionQueue::Snapshot const> TransactionQueue::snapshot() const
+{
+    Guard l(x_snapshot);
+    ReadGuard rl(m_lock);
+    if (m_snapshot && m_snapshot->epoch == m_epoch)
+        return m_snapshot;
+
+    // Only pointers are copied, the transactions themselves are shared with the queue.
+    auto snapshot = make_shared<Snapshot>();
+    snapshot->epoch = m_epoch;
+    snapshot->transactions.reserve(m_currentByHash.size());
+    forEachCurrent_WITH_LOCK([&](VerifiedTransaction const& _t) {
+        snapshot->transactions.push_back(PendingTransaction{_t.transaction->sha3(), _t.transaction});
+        return true;
+    });
+    m_snapshot = snapshot;
+    return m_snapshot;
+}
+
 h256Hash TransactionQueue::knownTransactions() const
 {
     ReadGuard l(m_lock);
@@ -122,17 +198,17 @@ ImportResult TransactionQueue::manageImport_WITH_LOCK(h256 const& _h, Transactio
         assert(_h == _transaction.sha3());
         // Remove any prior transaction with the same nonce but a lower gas price.
         // Bomb out if there's a prior transaction with higher gas price.
-        auto cs = m_currentByAddressAndNonce.find(_transaction.from());
-        if (cs != m_currentByAddressAndNonce.end())
+        auto cs = m_current.find(_transaction.from());
+        if (cs != m_current.end())
         {
             auto t = cs->second.find(_transaction.nonce());
             if (t != cs->second.end())
             {
-                if (_transaction.gasPrice() < (*t->second).transaction.gasPrice())
+                if (_transaction.gasPrice() < t->second.transaction->gasPrice())
                     return ImportResult::OverbidGasPrice;
                 else
                 {
-                    h256 dropped = (*t->second).transaction.sha3();
+                    h256 dropped = t->second.transaction->sha3();
                     remove_WITH_LOCK(dropped);
                     m_onReplaced(dropped);
                 }
@@ -144,7 +220,7 @@ ImportResult TransactionQueue::manageImport_WITH_LOCK(h256 const& _h, Transactio
             auto t = fs->second.find(_transaction.nonce());
             if (t != fs->second.end())
             {
-                if (_transaction.gasPrice() < t->second.transaction.gasPrice())
+                if (_transaction.gasPrice() < t->second.transaction->gasPrice())
                     return ImportResult::OverbidGasPrice;
                 else
                 {
@@ -159,13 +235,16 @@ ImportResult TransactionQueue::manageImport_WITH_LOCK(h256 const& _h, Transactio
         insertCurrent_WITH_LOCK(make_pair(_h, _transaction));
         LOG(m_loggerDetail) << "Queued vaguely legit-looking transaction " << _h;
 
-        while (m_current.size() > m_limit)
+        while (m_currentByHash.size() > m_limit)
         {
-            LOG(m_loggerDetail) << "Dropping out of bounds transaction " << _h;
-            remove_WITH_LOCK(m_current.rbegin()->transaction.sha3());
+            // Drop the last transaction of the sender whose next transaction pays the least.
+            Lane const& cheapest = m_current.at(m_heads.rbegin()->sender);
+            h256 const dropped = cheapest.rbegin()->second.transaction->sha3();
+            LOG(m_loggerDetail) << "Dropping out of bounds transaction " << dropped;
+            remove_WITH_LOCK(dropped);
         }
 
-        m_onReady();
+        m_readyPending = true;
     }
     catch (Exception const& _e)
     {
@@ -181,6 +260,21 @@ ImportResult TransactionQueue::manageImport_WITH_LOCK(h256 const& _h, Transactio
     return ImportResult::Success;
 }
 
+bool TransactionQueue::isKnown(h256 const& _txHash) const
+{
+    ReadGuard l(m_lock);
+    return m_known.count(_txHash) || m_dropped.count(_txHash);
+}
+
+shared_ptr<Transaction const> TransactionQueue::transaction(h256 const& _txHash) const
+{
+    ReadGuard l(m_lock);
+    auto t = m_currentByHash.find(_txHash);
+    if (t == m_currentByHash.end())
+        return nullptr;
+    return m_current.at(t->second.first).at(t->second.second).transaction;
+}
+
 u256 TransactionQueue::maxNonce(Address const& _a) const
 {
     ReadGuard l(m_lock);
@@ -190,8 +284,8 @@ u256 TransactionQueue::maxNonce(Address const& _a) const
 u256 TransactionQueue::maxNonce_WITH_LOCK(Address const& _a) const
 {
     u256 ret = 0;
-    auto cs = m_currentByAddressAndNonce.find(_a);
-    if (cs != m_currentByAddressAndNonce.end() && !cs->second.empty())
+    auto cs = m_current.find(_a);
+    if (cs != m_current.end() && !cs->second.empty())
         ret = cs->second.rbegin()->first + 1;
     auto fs = m_future.find(_a);
     if (fs != m_future.end() && !fs->second.empty())
@@ -209,10 +303,13 @@ void TransactionQueue::insertCurrent_WITH_LOCK(std::pair<h256, Transaction> cons
 
     Transaction const& t = _p.second;
     // Insert into current
-    auto inserted = m_currentByAddressAndNonce[t.from()].insert(std::make_pair(t.nonce(), PriorityQueue::iterator()));
-    PriorityQueue::iterator handle = m_current.emplace(VerifiedTransaction(t));
-    inserted.first->second = handle;
-    m_currentByHash[_p.first] = handle;
+    Lane& lane = m_current[t.from()];
+    if (!lane.empty())
+        eraseHead_WITH_LOCK(t.from(), lane);
+    lane.emplace(t.nonce(), VerifiedTransaction(t, m_nextSequence++));
+    insertHead_WITH_LOCK(t.from(), lane);
+    ++m_epoch;
+    m_currentByHash[_p.first] = make_pair(t.from(), t.nonce());
 
     // Move following transactions from future to current
     makeCurrent_WITH_LOCK(t);
@@ -225,24 +322,39 @@ bool TransactionQueue::remove_WITH_LOCK(h256 const& _txHash)
     if (t == m_currentByHash.end())
         return false;
 
-    Address from = (*t->second).transaction.from();
-    auto it = m_currentByAddressAndNonce.find(from);
-    assert (it != m_currentByAddressAndNonce.end());
-    it->second.erase((*t->second).transaction.nonce());
-    m_current.erase(t->second);
-    m_currentByHash.erase(t);
+    Address const from = t->second.first;
+    auto it = m_current.find(from);
+    assert(it != m_current.end());
+    eraseHead_WITH_LOCK(from, it->second);
+    it->second.erase(t->second.second);
     if (it->second.empty())
-        m_currentByAddressAndNonce.erase(it);
+        m_current.erase(it);
+    else
+        insertHead_WITH_LOCK(from, it->second);
+    m_currentByHash.erase(t);
     m_known.erase(_txHash);
+    ++m_epoch;
     return true;
 }
 
+void TransactionQueue::eraseHead_WITH_LOCK(Address const& _sender, Lane const& _lane)
+{
+    VerifiedTransaction const& first = _lane.begin()->second;
+    m_heads.erase(LaneHead{first.transaction->gasPrice(), first.sequence, _sender});
+}
+
+void TransactionQueue::insertHead_WITH_LOCK(Address const& _sender, Lane const& _lane)
+{
+    VerifiedTransaction const& first = _lane.begin()->second;
+    m_heads.insert(LaneHead{first.transaction->gasPrice(), first.sequence, _sender});
+}
+
 unsigned TransactionQueue::waiting(Address const& _a) const
 {
     ReadGuard l(m_lock);
     unsigned ret = 0;
-    auto cs = m_currentByAddressAndNonce.find(_a);
-    if (cs != m_currentByAddressAndNonce.end())
+    auto cs = m_current.find(_a);
+    if (cs != m_current.end())
         ret = cs->second.size();
     auto fs = m_future.find(_a);
     if (fs != m_future.end())
@@ -257,23 +369,23 @@ void TransactionQueue::setFuture(h256 const& _txHash)
     if (it == m_currentByHash.end())
         return;
 
-    VerifiedTransaction const& st = *(it->second);
-
-    Address from = st.transaction.from();
-    auto& queue = m_currentByAddressAndNonce[from];
+    Address const from = it->second.first;
+    Lane& lane = m_current.at(from);
     auto& target = m_future[from];
-    auto cutoff = queue.lower_bound(st.transaction.nonce());
-    for (auto m = cutoff; m != queue.end(); ++m)
+    eraseHead_WITH_LOCK(from, lane);
+    auto cutoff = lane.lower_bound(it->second.second);
+    for (auto m = cutoff; m != lane.end(); ++m)
     {
-        VerifiedTransaction& t = const_cast<VerifiedTransaction&>(*(m->second)); // set has only const iterators. Since we are moving out of container that's fine
-        m_currentByHash.erase(t.transaction.sha3());
-        target.emplace(t.transaction.nonce(), move(t));
-        m_current.erase(m->second);
+        m_currentByHash.erase(m->second.transaction->sha3());
+        target.emplace(m->first, move(m->second));
         ++m_futureSize;
     }
-    queue.erase(cutoff, queue.end());
-    if (queue.empty())
-        m_currentByAddressAndNonce.erase(from);
+    lane.erase(cutoff, lane.end());
+    if (lane.empty())
+        m_current.erase(from);
+    else
+        insertHead_WITH_LOCK(from, lane);
+    ++m_epoch;
 }
 
 void TransactionQueue::makeCurrent_WITH_LOCK(Transaction const& _t)
@@ -286,18 +398,21 @@ void TransactionQueue::makeCurrent_WITH_LOCK(Transaction const& _t)
         auto fb = fs->second.find(nonce);
         if (fb != fs->second.end())
         {
+            Lane& lane = m_current[_t.from()];
+            if (!lane.empty())
+                eraseHead_WITH_LOCK(_t.from(), lane);
             auto ft = fb;
-            while (ft != fs->second.end() && ft->second.transaction.nonce() == nonce)
+            while (ft != fs->second.end() && ft->second.transaction->nonce() == nonce)
             {
-                auto inserted = m_currentByAddressAndNonce[_t.from()].insert(std::make_pair(ft->second.transaction.nonce(), PriorityQueue::iterator()));
-                PriorityQueue::iterator handle = m_current.emplace(move(ft->second));
-                inserted.first->second = handle;
-                m_currentByHash[(*handle).transaction.sha3()] = handle;
+                m_currentByHash[ft->second.transaction->sha3()] = make_pair(_t.from(), nonce);
+                lane.emplace(nonce, move(ft->second));
                 --m_futureSize;
                 ++ft;
                 ++nonce;
                 newCurrent = true;
             }
+            insertHead_WITH_LOCK(_t.from(), lane);
+            ++m_epoch;
             fs->second.erase(fb, ft);
             if (fs->second.empty())
                 m_future.erase(_t.from());
@@ -310,14 +425,14 @@ void TransactionQueue::makeCurrent_WITH_LOCK(Transaction const& _t)
         // For now just drop random chain end
         --m_futureSize;
         LOG(m_loggerDetail) << "Dropping out of bounds future transaction "
-                            << m_future.begin()->second.rbegin()->second.transaction.sha3();
+                            << m_future.begin()->second.rbegin()->second.transaction->sha3();
         m_future.begin()->second.erase(--m_future.begin()->second.end());
         if (m_future.begin()->second.empty())
             m_future.erase(m_future.begin());
     }
 
     if (newCurrent)
-        m_onReady();
+        m_readyPending = true;
 }
 
 void TransactionQueue::drop(h256 const& _txHash)
@@ -334,11 +449,17 @@ void TransactionQueue::drop(h256 const& _txHash)
 
 void TransactionQueue::dropGood(Transaction const& _t)
 {
-    WriteGuard l(m_lock);
-    makeCurrent_WITH_LOCK(_t);
-    if (!m_known.count(_t.sha3()))
-        return;
-    remove_WITH_LOCK(_t.sha3());
+    bool ready = false;
+    {
+        WriteGuard l(m_lock);
+        makeCurrent_WITH_LOCK(_t);
+        ready = m_readyPending;
+        m_readyPending = false;
+        if (m_known.count(_t.sha3()))
+            remove_WITH_LOCK(_t.sha3());
+    }
+    if (ready)
+        m_onReady();
 }
 
 void TransactionQueue::clear()
@@ -346,40 +467,58 @@ void TransactionQueue::clear()
     WriteGuard l(m_lock);
     m_known.clear();
     m_current.clear();
+    m_heads.clear();
+    ++m_epoch;
     m_dropped.clear();
-    m_currentByAddressAndNonce.clear();
     m_currentByHash.clear();
     m_future.clear();
     m_futureSize = 0;
 }
 
+TransactionQueue::UnverifiedPacket::UnverifiedPacket(
+    RLP const& _data, unsigned _count, h512 const& _nodeId)
+  : hashes(_count), verified(_count), results(_count, ImportResult::Success), nodeId(_nodeId)
+{
+    transactions.reserve(_count);
+    for (unsigned i = 0; i < _count; ++i)
+        transactions.push_back(_data[i].data().toBytes());
+}
+
 void TransactionQueue::enqueue(RLP const& _data, h512 const& _nodeId)
 {
-    bool queued = false;
+    unsigned itemCount = _data.itemCount();
+    if (!itemCount)
+        return;
+
+    unsigned count = itemCount;
     {
         Guard l(x_queue);
-        unsigned itemCount = _data.itemCount();
-        for (unsigned i = 0; i < itemCount; ++i)
+        if (m_unverifiedCount + count > c_maxVerificationQueueSize)
         {
-            if (m_unverified.size() >= c_maxVerificationQueueSize)
-            {
-                LOG(m_logger) << "Transaction verification queue is full. Dropping "
-                              << itemCount - i << " transactions";
-                break;
-            }
-            m_unverified.emplace_back(UnverifiedTransaction(_data[i].data(), _nodeId));
-            queued = true;
+            count = c_maxVerificationQueueSize - min(m_unverifiedCount, c_maxVerificationQueueSize);
+            LOG(m_logger) << "Transaction verification queue is full. Dropping "
+                          << itemCount - count << " transactions";
         }
+        if (!count)
+            return;
+
+        // Split the packet so that every verifier thread takes a part of it.
+        auto packet = make_shared<UnverifiedPacket>(_data, count, _nodeId);
+        unsigned const ranges = max(1u, min<unsigned>(m_verifiers.size(),
+            (count + c_minVerificationRange - 1) / c_minVerificationRange));
+        packet->pendingRanges = ranges;
+        for (unsigned r = 0; r < ranges; ++r)
+            m_unverified.push_back(
+                VerificationRange{packet, count * r / ranges, count * (r + 1) / ranges});
+        m_unverifiedCount += count;
     }
-    if (queued)
-        m_queueReady.notify_all();
+    m_queueReady.notify_all();
 }
-
 void TransactionQueue::verifierBody()
 {
     while (!m_aborting)
     {
-        UnverifiedTransaction work;
+        VerificationRange work;
 
         {
             unique_lock<Mutex> l(x_queue);
@@ -388,18 +527,78 @@ void TransactionQueue::verifierBody()
                 return;
             work = move(m_unverified.front());
             m_unverified.pop_front();
+            m_unverifiedCount -= work.end - work.begin;
+        }
+
+        UnverifiedPacket& packet = *work.packet;
+        for (unsigned i = work.begin; i < work.end; ++i)
+            packet.hashes[i] = sha3(packet.transactions[i]);
+        // Skip what we already know before paying for the signature checks.
+        DEV_READ_GUARDED(m_lock)
+            for (unsigned i = work.begin; i < work.end; ++i)
+                packet.results[i] = check_WITH_LOCK(packet.hashes[i], IfDropped::Ignore);
+
+        for (unsigned i = work.begin; i < work.end; ++i)
+        {
+            if (packet.results[i] != ImportResult::Success)
+                continue;
+
+            try
+            {
+                // Recovers the sender, so that the import doesn't need to.
+                packet.verified[i] = Transaction(&packet.transactions[i], CheckTransaction::Everything);
+                if (packet.verified[i].hasZeroSignature())
+                    packet.results[i] = ImportResult::ZeroSignature;
+            }
+            catch (Exception const&)
+            {
+                packet.results[i] = ImportResult::Malformed;
+            }
         }
 
-        try
+        // The last range to be verified imports the whole packet.
+        if (--packet.pendingRanges == 0)
         {
-            Transaction t(work.transaction, CheckTransaction::Cheap); //Signature will be checked later
-            ImportResult ir = import(t);
-            m_onImport(ir, t.sha3(), work.nodeId);
+            try
+            {
+                importPacket(packet);
+            }
+            catch (...)
+            {
+                // should not happen as exceptions are handled in import.
+                cwarn << "Bad transaction:" << boost::current_exception_diagnostic_information();
+            }
         }
-        catch (...)
+    }
+}
+
+void TransactionQueue::importPacket(UnverifiedPacket& _packet)
+{
+    ImportResults results;
+    results.reserve(_packet.transactions.size());
+    bool ready = false;
+    {
+        WriteGuard l(m_lock);
+        for (unsigned i = 0; i < _packet.transactions.size(); ++i)
         {
-            // should not happen as exceptions are handled in import.
-            cwarn << "Bad transaction:" << boost::current_exception_diagnostic_information();
+            if (_packet.results[i] != ImportResult::Success)
+            {
+                results.emplace_back(_packet.hashes[i], _packet.results[i]);
+                continue;
+            }
+
+            Transaction const& t = _packet.verified[i];
+            h256 const h = t.sha3();
+            ImportResult ir = check_WITH_LOCK(h, IfDropped::Ignore);
+            if (ir == ImportResult::Success)
+                ir = manageImport_WITH_LOCK(h, t);
+            results.emplace_back(h, ir);
         }
+        ready = m_readyPending;
+        m_readyPending = false;
     }
+
+    if (ready)
+        m_onReady();
+    m_onImport(results, _packet.nodeId);
 }
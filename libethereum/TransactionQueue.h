@@ -21,10 +21,14 @@
 
 #pragma once
 
+#include <atomic>
 #include <functional>
 #include <condition_variable>
 #include <thread>
 #include <deque>
+#include <map>
+#include <memory>
+#include <set>
 #include <libdevcore/Common.h>
 #include <libdevcore/Guards.h>
 #include <libdevcore/Log.h>
@@ -38,7 +42,8 @@ namespace eth
 
 /**
  * @brief A queue of Transactions, each stored as RLP.
- * Maintains a transaction queue sorted by nonce diff and gas price.
+ * Keeps the transactions of every sender in a lane ordered by nonce, and the lanes ordered by the
+ * gas price of their first transaction, so that an update costs O(log senders).
  * @threadsafe
  */
 class TransactionQueue
@@ -46,14 +51,34 @@ class TransactionQueue
 public:
     struct Limits { size_t current; size_t future; };
 
+    /// Outcome of importing each transaction of a packet, in packet order.
+    using ImportResults = std::vector<std::pair<h256, ImportResult>>;
+
+    /// Transaction of a snapshot with its hash.
+    struct PendingTransaction
+    {
+        h256 hash;
+        std::shared_ptr<Transaction const> transaction;
+    };
+
+    /// Current transactions in topTransactions order, as of one version of the queue.
+    /// Never modified once published, so it can be read without locking while the queue changes.
+    struct Snapshot
+    {
+        uint64_t epoch = 0;  ///< Version of the queue the snapshot was taken at.
+        std::vector<PendingTransaction> transactions;
+    };
+
     /// @brief TransactionQueue
     /// @param _limit Maximum number of pending transactions in the queue.
     /// @param _futureLimit Maximum number of future nonce transactions.
     TransactionQueue(unsigned _limit = 1024, unsigned _futureLimit = 1024);
     TransactionQueue(Limits const& _l): TransactionQueue(_l.current, _l.future) {}
     ~TransactionQueue();
-    /// Add transaction to the queue to be verified and imported.
-    /// @param _data RLP encoded transaction data.
+    /// Add a packet of transactions to the queue to be verified and imported.
+    /// The packet is verified by the verifier threads in parallel and then imported under a single
+    /// lock, with onImport called once for the whole packet.
+    /// @param _data RLP list of encoded transactions.
     /// @param _nodeId Optional network identified of a node transaction comes from.
     void enqueue(RLP const& _data, h512 const& _nodeId);
 
@@ -80,13 +105,30 @@ public:
     /// Get top transactions from the queue. Returned transactions are not removed from the queue automatically.
     /// @param _limit Max number of transactions to return.
     /// @param _avoid Transactions to avoid returning.
-    /// @returns up to _limit transactions ordered by nonce and gas price.
+    /// @returns up to _limit transactions, the transactions of each sender in nonce order and those
+    /// of different senders by gas price.
     Transactions topTransactions(unsigned _limit, h256Hash const& _avoid = h256Hash()) const;
 
+    /// Get the ordered current transactions without copying them.
+    /// The snapshot is rebuilt at most once per change of the queue and shared by all callers
+    /// until the next change.
+    /// @returns the snapshot of the current version of the queue.
+    std::shared_ptr<Snapshot const> snapshot() const;
+
+    /// @returns the version of the queue, which changes whenever the current transactions do.
+    uint64_t epoch() const { ReadGuard l(m_lock); return m_epoch; }
+
     /// Get a hash set of transactions in the queue
     /// @returns A hash set of all transactions in the queue
     h256Hash knownTransactions() const;
 
+    /// @returns true if the transaction is current or has been dropped, i.e. importing it again would
+    /// be pointless.
+    bool isKnown(h256 const& _txHash) const;
+
+    /// @returns the current transaction with the given hash, nullptr if there is none.
+    std::shared_ptr<Transaction const> transaction(h256 const& _txHash) const;
+
     /// Get max nonce for an account
     /// @returns Max transaction nonce for account in the queue
     u256 maxNonce(Address const& _a) const;
@@ -107,7 +149,7 @@ public:
         size_t dropped;
     };
     /// @returns the status of the transaction queue.
-    Status status() const { Status ret; DEV_GUARDED(x_queue) { ret.unverified = m_unverified.size(); } ReadGuard l(m_lock); ret.dropped = m_dropped.size(); ret.current = m_currentByHash.size(); ret.future = m_future.size(); return ret; }
+    Status status() const { Status ret; DEV_GUARDED(x_queue) { ret.unverified = m_unverifiedCount; } ReadGuard l(m_lock); ret.dropped = m_dropped.size(); ret.current = m_currentByHash.size(); ret.future = m_future.size(); return ret; }
 
     /// @returns the transacrtion limits on current/future.
     Limits limits() const { return Limits{m_limit, m_futureLimit}; }
@@ -118,8 +160,8 @@ public:
     /// Register a handler that will be called once there is a new transaction imported
     template <class T> Handler<> onReady(T const& _t) { return m_onReady.add(_t); }
 
-    /// Register a handler that will be called once asynchronous verification is comeplte an transaction has been imported
-    template <class T> Handler<ImportResult, h256 const&, h512 const&> onImport(T const& _t) { return m_onImport.add(_t); }
+    /// Register a handler that will be called once asynchronous verification of a packet is complete and its transactions have been imported
+    template <class T> Handler<ImportResults const&, h512 const&> onImport(T const& _t) { return m_onImport.add(_t); }
 
     /// Register a handler that will be called once asynchronous verification is comeplte an transaction has been imported
     template <class T> Handler<h256 const&> onReplaced(T const& _t) { return m_onReplaced.add(_t); }
@@ -129,59 +171,73 @@ private:
     /// Verified and imported transaction
     struct VerifiedTransaction
     {
-        VerifiedTransaction(Transaction const& _t): transaction(_t) {}
-        VerifiedTransaction(VerifiedTransaction&& _t): transaction(std::move(_t.transaction)) {}
+        VerifiedTransaction(Transaction const& _t, uint64_t _sequence): transaction(std::make_shared<Transaction const>(_t)), sequence(_sequence) {}
+        VerifiedTransaction(VerifiedTransaction&& _t): transaction(std::move(_t.transaction)), sequence(_t.sequence) {}
 
         VerifiedTransaction(VerifiedTransaction const&) = delete;
         VerifiedTransaction& operator=(VerifiedTransaction const&) = delete;
 
-        Transaction transaction;  ///< Transaction data
+        std::shared_ptr<Transaction const> transaction;  ///< Transaction data, shared with snapshots
+        uint64_t sequence;        ///< Arrival order, breaks gas price ties
     };
 
-    /// Transaction pending verification
-    struct UnverifiedTransaction
+    /// Transaction packet pending verification
+    struct UnverifiedPacket
     {
-        UnverifiedTransaction() {}
-        UnverifiedTransaction(bytesConstRef const& _t, h512 const& _nodeId): transaction(_t.toBytes()), nodeId(_nodeId) {}
-        UnverifiedTransaction(UnverifiedTransaction&& _t): transaction(std::move(_t.transaction)), nodeId(std::move(_t.nodeId)) {}
-        UnverifiedTransaction& operator=(UnverifiedTransaction&& _other)
-        {
-            assert(&_other != this);
+        UnverifiedPacket(RLP const& _data, unsigned _count, h512 const& _nodeId);
 
-            transaction = std::move(_other.transaction);
-            nodeId = std::move(_other.nodeId);
-            return *this;
-        }
+        UnverifiedPacket(UnverifiedPacket const&) = delete;
+        UnverifiedPacket& operator=(UnverifiedPacket const&) = delete;
+
+        std::vector<bytes> transactions;    ///< RLP encoded transaction data
+        h256s hashes;                       ///< Hashes of the transaction data
+        std::vector<Transaction> verified;  ///< Decoded transactions, with the senders recovered
+        std::vector<ImportResult> results;  ///< Verification failures, Success otherwise
+        h512 nodeId;                        ///< Network Id of the peer the packet comes from
+        std::atomic<unsigned> pendingRanges{0};  ///< Ranges still being verified
+    };
 
-        UnverifiedTransaction(UnverifiedTransaction const&) = delete;
-        UnverifiedTransaction& operator=(UnverifiedTransaction const&) = delete;
+    /// Range of a packet to be verified by one verifier thread
+    struct VerificationRange
+    {
+        std::shared_ptr<UnverifiedPacket> packet;
+        unsigned begin;
+        unsigned end;
+    };
 
-        bytes transaction;  ///< RLP encoded transaction data
-        h512 nodeId;        ///< Network Id of the peer transaction comes from
+    /// Current transactions of one sender ordered by nonce.
+    using Lane = std::map<u256, VerifiedTransaction>;
+
+    /// Entry for the first transaction of a lane.
+    struct LaneHead
+    {
+        u256 gasPrice;
+        uint64_t sequence;
+        Address sender;
     };
 
-    struct PriorityCompare
+    /// Orders by descending gas price, then by arrival.
+    struct LaneHeadCompare
     {
-        TransactionQueue& queue;
-        /// Compare transaction by nonce height and gas price.
-        bool operator()(VerifiedTransaction const& _first, VerifiedTransaction const& _second) const
+        bool operator()(LaneHead const& _first, LaneHead const& _second) const
         {
-            u256 const& height1 = _first.transaction.nonce() - queue.m_currentByAddressAndNonce[_first.transaction.sender()].begin()->first;
-            u256 const& height2 = _second.transaction.nonce() - queue.m_currentByAddressAndNonce[_second.transaction.sender()].begin()->first;
-            return height1 < height2 || (height1 == height2 && _first.transaction.gasPrice() > _second.transaction.gasPrice());
+            return _first.gasPrice > _second.gasPrice || (_first.gasPrice == _second.gasPrice && _first.sequence < _second.sequence);
         }
     };
 
-    // Use a set with dynamic comparator for minmax priority queue. The comparator takes into account min account nonce. Updating it does not affect the order.
-    using PriorityQueue = std::multiset<VerifiedTransaction, PriorityCompare>;
+    using LaneHeads = std::set<LaneHead, LaneHeadCompare>;
 
     ImportResult import(bytesConstRef _tx, IfDropped _ik = IfDropped::Ignore);
-    ImportResult check_WITH_LOCK(h256 const& _h, IfDropped _ik);
+    template <class F> void forEachCurrent_WITH_LOCK(F const& _f) const;
+    ImportResult check_WITH_LOCK(h256 const& _h, IfDropped _ik) const;
     ImportResult manageImport_WITH_LOCK(h256 const& _h, Transaction const& _transaction);
 
     void insertCurrent_WITH_LOCK(std::pair<h256, Transaction> const& _p);
     void makeCurrent_WITH_LOCK(Transaction const& _t);
+    void importPacket(UnverifiedPacket& _packet);
     bool remove_WITH_LOCK(h256 const& _txHash);
+    void eraseHead_WITH_LOCK(Address const& _sender, Lane const& _lane);
+    void insertHead_WITH_LOCK(Address const& _sender, Lane const& _lane);
     u256 maxNonce_WITH_LOCK(Address const& _a) const;
     void verifierBody();
 
@@ -191,13 +247,18 @@ private:
     std::unordered_map<h256, std::function<void(ImportResult)>> m_callbacks;	///< Called once.
     h256Hash m_dropped;															///< Transactions that have previously been dropped
 
-    PriorityQueue m_current;
-    std::unordered_map<h256, PriorityQueue::iterator> m_currentByHash;			///< Transaction hash to set ref
-    std::unordered_map<Address, std::map<u256, PriorityQueue::iterator>> m_currentByAddressAndNonce; ///< Transactions grouped by account and nonce
+    std::unordered_map<Address, Lane> m_current;								///< Current transactions grouped by sender
+    LaneHeads m_heads;															///< First transaction of every lane by gas price
+    std::unordered_map<h256, std::pair<Address, u256>> m_currentByHash;		///< Transaction hash to sender and nonce
+    uint64_t m_nextSequence = 0;												///< Arrival number of the next imported transaction
+    uint64_t m_epoch = 0;														///< Incremented on every change of the current transactions
+    mutable Mutex x_snapshot;													///< Guards m_snapshot
+    mutable std::shared_ptr<Snapshot const> m_snapshot;							///< Latest snapshot, possibly outdated
     std::unordered_map<Address, std::map<u256, VerifiedTransaction>> m_future;	/// Future transactions
+    bool m_readyPending = false;												///< New transactions became current since m_onReady was last called
 
     Signal<> m_onReady;															///< Called when a subsequent call to import transactions will return a non-empty container. Be nice and exit fast.
-    Signal<ImportResult, h256 const&, h512 const&> m_onImport;					///< Called for each import attempt. Arguments are result, transaction id an node id. Be nice and exit fast.
+    Signal<ImportResults const&, h512 const&> m_onImport;						///< Called for each imported packet. Arguments are the results per transaction id and the node id. Be nice and exit fast.
     Signal<h256 const&> m_onReplaced;											///< Called whan transction is dropped during a call to import() to make room for another transaction.
     unsigned m_limit;															///< Max number of pending transactions
     unsigned m_futureLimit;														///< Max number of future transactions
@@ -205,7 +266,8 @@ private:
 
     std::condition_variable m_queueReady;										///< Signaled when m_unverified has a new entry.
     std::vector<std::thread> m_verifiers;
-    std::deque<UnverifiedTransaction> m_unverified;  ///< Pending verification queue
+    std::deque<VerificationRange> m_unverified;      ///< Pending verification queue
+    size_t m_unverifiedCount = 0;                    ///< Transactions in the pending packets
     mutable Mutex x_queue;                           ///< Verification queue mutex
     std::atomic<bool> m_aborting = {false};          ///< Exit condition for verifier.
 
@@ -346,6 +346,18 @@ std::shared_ptr<p2p::Capability> WarpHostCapability::newPeerCapability(
     return ret;
 }
 
+p2p::TrafficClass WarpHostCapability::trafficClass(unsigned _packetType) const
+{
+    switch (_packetType)
+    {
+    case SnapshotManifest:
+    case SnapshotData:
+        return p2p::TrafficClass::SnapshotServing;
+    default:
+        return p2p::TrafficClass::Propagation;
+    }
+}
+
 void WarpHostCapability::doWork()
 {
     time_t const now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
@@ -40,6 +40,9 @@ protected:
     std::shared_ptr<p2p::Capability> newPeerCapability(std::shared_ptr<p2p::SessionFace> const& _s,
         unsigned _idOffset, p2p::CapDesc const& _cap) override;
 
+    /// Snapshot chunks give way to everything else.
+    p2p::TrafficClass trafficClass(unsigned _packetType) const override;
+
 private:
     std::shared_ptr<WarpPeerObserverFace> createPeerObserver(
         boost::filesystem::path const& _snapshotDownloadPath) const;
@@ -0,0 +1,80 @@
+// Copyright 2018 cpp-ethereum Authors.
+// Licensed under the GNU General Public License v3. See the LICENSE file.
+
+#include "BandwidthLimiter.h"
+
+using namespace std;
+using namespace dev;
+using namespace dev::p2p;
+
+double constexpr TokenBucket::c_burstSeconds;
+
+void TokenBucket::setRate(unsigned _bytesPerSecond)
+{
+    Guard l(x_tokens);
+    m_rate = _bytesPerSecond;
+    m_tokens = m_rate * c_burstSeconds;
+    m_lastRefill = chrono::steady_clock::now();
+}
+
+unsigned TokenBucket::rate() const
+{
+    Guard l(x_tokens);
+    return m_rate;
+}
+
+bool TokenBucket::ready()
+{
+    Guard l(x_tokens);
+    if (!m_rate)
+        return true;
+    refill_WITH_LOCK();
+    return m_tokens > 0;
+}
+
+void TokenBucket::consume(size_t _bytes)
+{
+    Guard l(x_tokens);
+    if (!m_rate)
+        return;
+    refill_WITH_LOCK();
+    m_tokens -= _bytes;
+}
+
+void TokenBucket::refill_WITH_LOCK()
+{
+    auto const now = chrono::steady_clock::now();
+    double const elapsed = chrono::duration<double>(now - m_lastRefill).count();
+    m_lastRefill = now;
+    m_tokens = min(m_rate * c_burstSeconds, m_tokens + elapsed * m_rate);
+}
+
+void EgressLimiter::setLimits(unsigned _total, array<unsigned, c_trafficClasses> const& _classes)
+{
+    m_total.setRate(_total);
+    // The session's own packets are never held back.
+    for (unsigned i = unsigned(TrafficClass::Session) + 1; i < c_trafficClasses; ++i)
+        m_classes[i].setRate(_classes[i]);
+}
+
+bool EgressLimiter::ready(TrafficClass _class)
+{
+    return _class == TrafficClass::Session ||
+           (m_total.ready() && m_classes[unsigned(_class)].ready());
+}
+
+void EgressLimiter::noteSent(TrafficClass _class, size_t _bytes)
+{
+    m_total.consume(_bytes);
+    m_classes[unsigned(_class)].consume(_bytes);
+    m_sentBytes[unsigned(_class)] += _bytes;
+}
+
+vector<TrafficClassInfo> EgressLimiter::info() const
+{
+    vector<TrafficClassInfo> ret;
+    for (unsigned i = 0; i < c_trafficClasses; ++i)
+        ret.push_back(TrafficClassInfo{
+            TrafficClass(i), m_classes[i].rate(), m_sentBytes[i].load(), m_throttled[i].load()});
+    return ret;
+}
@@ -0,0 +1,87 @@
+// Copyright 2018 cpp-ethereum Authors.
+// Licensed under the GNU General Public License v3. See the LICENSE file.
+
+#pragma once
+
+#include "Common.h"
+
+#include <libdevcore/Guards.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+namespace dev
+{
+namespace p2p
+{
+/**
+ * @brief Token bucket limiting a byte rate. Writes may overdraw it, so that a packet larger than
+ * the bucket still goes; what comes after it then waits until the debt is paid off.
+ *
+ * @threadsafe
+ */
+class TokenBucket
+{
+public:
+    /// The bucket holds at most this fraction of a second's worth of bytes.
+    static double constexpr c_burstSeconds = 0.25;
+
+    /// @a _bytesPerSecond of 0 means no limit.
+    explicit TokenBucket(unsigned _bytesPerSecond = 0) { setRate(_bytesPerSecond); }
+
+    /// Sets the rate and fills the bucket.
+    void setRate(unsigned _bytesPerSecond);
+
+    /// @returns the rate in bytes per second, 0 if unlimited.
+    unsigned rate() const;
+
+    /// @returns true if the bucket isn't in debt, so another write may go.
+    bool ready();
+
+    /// Takes @a _bytes out of the bucket, overdrawing it if need be.
+    void consume(size_t _bytes);
+
+private:
+    void refill_WITH_LOCK();
+
+    mutable Mutex x_tokens;
+    unsigned m_rate = 0;
+    double m_tokens = 0;
+    std::chrono::steady_clock::time_point m_lastRefill;
+};
+
+/**
+ * @brief The host's upload limits: one for all sessions together and one for each TrafficClass,
+ * along with how much each class has sent.
+ *
+ * @threadsafe
+ */
+class EgressLimiter
+{
+public:
+    /// Sets the limits in bytes per second, 0 meaning no limit.
+    void setLimits(unsigned _total, std::array<unsigned, c_trafficClasses> const& _classes);
+
+    /// @returns true if packets of @a _class may be written now.
+    bool ready(TrafficClass _class);
+
+    /// Notes that @a _bytes of @a _class have been framed.
+    void noteSent(TrafficClass _class, size_t _bytes);
+
+    /// Notes that a session held packets of @a _class back.
+    void noteThrottled(TrafficClass _class) { ++m_throttled[unsigned(_class)]; }
+
+    /// @returns the limit and statistics of each class.
+    std::vector<TrafficClassInfo> info() const;
+
+private:
+    TokenBucket m_total;
+    std::array<TokenBucket, c_trafficClasses> m_classes;
+    std::array<std::atomic<uint64_t>, c_trafficClasses> m_sentBytes{};
+    std::array<std::atomic<uint64_t>, c_trafficClasses> m_throttled{};
+};
+
+}  // namespace p2p
+}  // namespace dev
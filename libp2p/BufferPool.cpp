@@ -0,0 +1,71 @@
+// Copyright 2018 cpp-ethereum Authors.
+// Licensed under the GNU General Public License v3. See the LICENSE file.
+
+#include "BufferPool.h"
+
+using namespace std;
+using namespace dev;
+using namespace dev::p2p;
+
+namespace
+{
+unsigned sizeClass(size_t _size, unsigned _minBits)
+{
+    unsigned ret = 0;
+    while ((size_t(1) << (ret + _minBits)) < _size)
+        ++ret;
+    return ret;
+}
+}  // namespace
+
+BufferPool::Buffer& BufferPool::Buffer::operator=(Buffer&& _b)
+{
+    if (this != &_b)
+    {
+        release();
+        m_pool = move(_b.m_pool);
+        m_data = move(_b.m_data);
+        m_capacity = _b.m_capacity;
+        _b.m_capacity = 0;
+    }
+    return *this;
+}
+
+void BufferPool::Buffer::release()
+{
+    if (!m_data)
+        return;
+    if (auto pool = m_pool.lock())
+        pool->recycle(move(m_data), m_capacity);
+    m_data.reset();
+    m_capacity = 0;
+}
+
+BufferPool::Buffer BufferPool::acquire(size_t _size)
+{
+    unsigned const c = sizeClass(_size, c_minSizeBits);
+    assert(c < m_free.size());
+
+    Buffer ret;
+    ret.m_pool = shared_from_this();
+    ret.m_capacity = size_t(1) << (c + c_minSizeBits);
+    DEV_GUARDED(x_free)
+        if (!m_free[c].empty())
+        {
+            ret.m_data = move(m_free[c].back());
+            m_free[c].pop_back();
+            m_pooledBytes -= ret.m_capacity;
+        }
+    if (!ret.m_data)
+        ret.m_data.reset(new byte[ret.m_capacity]);
+    return ret;
+}
+
+void BufferPool::recycle(unique_ptr<byte[]>&& _data, size_t _capacity)
+{
+    Guard l(x_free);
+    if (m_pooledBytes + _capacity > c_maxPooledBytes)
+        return;
+    m_free[sizeClass(_capacity, c_minSizeBits)].push_back(move(_data));
+    m_pooledBytes += _capacity;
+}
@@ -0,0 +1,71 @@
+// Copyright 2018 cpp-ethereum Authors.
+// Licensed under the GNU General Public License v3. See the LICENSE file.
+
+#pragma once
+
+#include <libdevcore/Common.h>
+#include <libdevcore/Guards.h>
+
+#include <array>
+#include <memory>
+#include <vector>
+
+namespace dev
+{
+namespace p2p
+{
+/**
+ * @brief Recycles the buffers that ingress frames are read and decrypted into.
+ *
+ * Buffers come in power-of-two sizes from 4 KB up and are not initialised, so taking one for a
+ * large frame costs neither an allocation nor clearing it once the pool is warm. Buffers handed
+ * back are kept for the next taker, up to c_maxPooledBytes in all.
+ *
+ * @threadsafe
+ */
+class BufferPool: public std::enable_shared_from_this<BufferPool>
+{
+public:
+    static size_t const c_maxPooledBytes = 64 * 1024 * 1024;
+
+    /// A buffer of the pool, which goes back to it when destroyed.
+    class Buffer
+    {
+    public:
+        Buffer() = default;
+        Buffer(Buffer&& _b) = default;
+        Buffer& operator=(Buffer&& _b);
+        ~Buffer() { release(); }
+
+        byte* data() const { return m_data.get(); }
+        size_t capacity() const { return m_capacity; }
+        bytesRef ref(size_t _size) const { return bytesRef(m_data.get(), _size); }
+
+    private:
+        friend class BufferPool;
+
+        void release();
+
+        std::weak_ptr<BufferPool> m_pool;
+        std::unique_ptr<byte[]> m_data;
+        size_t m_capacity = 0;
+    };
+
+    /// @returns a buffer of at least @a _size bytes.
+    Buffer acquire(size_t _size);
+
+    /// @returns the number of bytes kept for reuse.
+    size_t pooledBytes() const { Guard l(x_free); return m_pooledBytes; }
+
+private:
+    static unsigned const c_minSizeBits = 12;
+
+    void recycle(std::unique_ptr<byte[]>&& _data, size_t _capacity);
+
+    mutable Mutex x_free;
+    std::array<std::vector<std::unique_ptr<byte[]>>, 32> m_free;    ///< Indexed by size class.
+    size_t m_pooledBytes = 0;
+};
+
+}  // namespace p2p
+}  // namespace dev
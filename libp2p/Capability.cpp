@@ -60,3 +60,9 @@ void Capability::addRating(int _r)
     if (session)
         session->addRating(_r);
 }
+
+bool Capability::isEgressFull() const
+{
+    shared_ptr<SessionFace> session = m_session.lock();
+    return session && session->isEgressFull();
+}
@@ -48,6 +48,8 @@ protected:
     std::shared_ptr<SessionFace> session() const { return m_session.lock(); }
     HostCapabilityFace* hostCapability() const { return m_hostCap; }
 
+    /// The RLP points into the session's ingress buffer and is only valid during the call; copy
+    /// out whatever has to outlive it.
     virtual bool interpret(unsigned _id, RLP const&) = 0;
     virtual void onDisconnect() {}
 
@@ -57,6 +59,9 @@ protected:
     void sealAndSend(RLPStream& _s);
     void addRating(int _r);
 
+    /// @returns true if the session is too backed up to take what can be sent later.
+    bool isEgressFull() const;
+
 private:
     std::weak_ptr<SessionFace> m_session;
     HostCapabilityFace* m_hostCap;
@@ -26,6 +26,7 @@ using namespace dev;
 using namespace dev::p2p;
 
 const unsigned dev::p2p::c_protocolVersion = 4;
+const unsigned dev::p2p::c_snappyProtocolVersion = 5;
 const unsigned dev::p2p::c_defaultIPPort = 30303;
 static_assert(dev::p2p::c_protocolVersion == 4, "Replace v3 compatbility with v4 compatibility before updating network version.");
 
@@ -118,6 +119,19 @@ std::string p2p::reasonOf(DisconnectReason _r)
     }
 }
 
+std::string p2p::trafficClassName(TrafficClass _class)
+{
+    switch (_class)
+    {
+    case TrafficClass::Session: return "session";
+    case TrafficClass::Propagation: return "propagation";
+    case TrafficClass::TxGossip: return "txGossip";
+    case TrafficClass::SyncServing: return "syncServing";
+    case TrafficClass::SnapshotServing: return "snapshotServing";
+    default: return "unknown";
+    }
+}
+
 void NodeIPEndpoint::streamRLP(RLPStream& _s, RLPAppend _append) const
 {
     if (_append == StreamList)
@@ -53,6 +53,9 @@ namespace p2p
 
 /// Peer network protocol version.
 extern const unsigned c_protocolVersion;
+/// Protocol version we announce in Hello. Packets between peers that both announce it or later
+/// are compressed with Snappy (EIP-706).
+extern const unsigned c_snappyProtocolVersion;
 extern const unsigned c_defaultIPPort;
 
 class NodeIPEndpoint;
@@ -159,10 +162,40 @@ struct PeerSessionInfo
     unsigned socketId;
     std::map<std::string, std::string> notes;
     unsigned const protocolVersion;
+    bool const multiplexing;        ///< Whether the peer takes packets chunked into several frames.
+    uint64_t sentBytes;             ///< Packet bytes sent, before compression.
+    uint64_t sentWireBytes;         ///< Packet bytes sent, as sent.
+    uint64_t receivedBytes;         ///< Packet bytes received, after decompression.
+    uint64_t receivedWireBytes;     ///< Packet bytes received, as received.
 };
 
 using PeerSessionInfos = std::vector<PeerSessionInfo>;
 
+/// Classes of egress traffic. A session writes the packets of earlier classes first, so when it
+/// reaches an upload limit it is the later classes that wait.
+enum class TrafficClass : unsigned
+{
+    Session,          ///< The session's own packets, such as pings. Never held back.
+    Propagation,      ///< New blocks, our own requests and anything not in another class.
+    TxGossip,         ///< Pending transactions.
+    SyncServing,      ///< Replies to other peers' chain sync requests.
+    SnapshotServing,  ///< Replies to other peers' snapshot requests.
+};
+
+unsigned const c_trafficClasses = 5;
+
+/// @returns the name under which admin_net reports the given traffic class.
+std::string trafficClassName(TrafficClass _class);
+
+/// Point-in-time upload statistics of a traffic class, summed over all sessions.
+struct TrafficClassInfo
+{
+    TrafficClass trafficClass;
+    unsigned limit;      ///< Bytes per second the class may send, 0 if unlimited.
+    uint64_t sentBytes;  ///< Packet bytes framed for sending.
+    uint64_t throttled;  ///< Times a session held packets of the class back to keep to a limit.
+};
+
 enum class PeerType
 {
     Optional,
@@ -0,0 +1,90 @@
+// Copyright 2018 cpp-ethereum Authors.
+// Licensed under the GNU General Public License v3. See the LICENSE file.
+
+#include "HandshakeWorkers.h"
+
+#include <libdevcore/CommonIO.h>
+#include <libdevcore/Log.h>
+
+using namespace std;
+using namespace dev;
+using namespace dev::p2p;
+
+size_t const HandshakeWorkers::c_maxQueued;
+unsigned const HandshakeWorkers::c_ingressPerSecond;
+
+HandshakeWorkers::HandshakeWorkers(unsigned _threads)
+{
+    for (unsigned i = 0; i < max(_threads, 1u); ++i)
+        m_workers.emplace_back([=]() {
+            setThreadName("handshake" + toString(i));
+            workerBody();
+        });
+}
+
+HandshakeWorkers::~HandshakeWorkers()
+{
+    DEV_GUARDED(x_queue)
+        m_stopping = true;
+
+    m_moreToDo.notify_all();
+    for (auto& i: m_workers)
+        i.join();
+}
+
+bool HandshakeWorkers::enqueue(Priority _priority, function<void()> _job)
+{
+    {
+        Guard l(x_queue);
+        if (m_stopping || (_priority == Normal && m_queue[Normal].size() >= c_maxQueued))
+            return false;
+        m_queue[_priority].push_back(move(_job));
+    }
+    m_moreToDo.notify_one();
+    return true;
+}
+
+bool HandshakeWorkers::admitIngress()
+{
+    Guard l(x_ingress);
+    auto const now = chrono::steady_clock::now();
+    double const elapsed = chrono::duration<double>(now - m_lastIngress).count();
+    m_lastIngress = now;
+    m_ingressTokens = min<double>(c_ingressPerSecond, m_ingressTokens + elapsed * c_ingressPerSecond);
+    if (m_ingressTokens < 1)
+        return false;
+    m_ingressTokens -= 1;
+    return true;
+}
+
+size_t HandshakeWorkers::queued() const
+{
+    Guard l(x_queue);
+    return m_queue[High].size() + m_queue[Normal].size();
+}
+
+void HandshakeWorkers::workerBody()
+{
+    while (true)
+    {
+        function<void()> job;
+        {
+            unique_lock<Mutex> l(x_queue);
+            m_moreToDo.wait(l, [&]() { return m_stopping || !m_queue[High].empty() || !m_queue[Normal].empty(); });
+            if (m_stopping)
+                return;
+            auto& queue = m_queue[High].empty() ? m_queue[Normal] : m_queue[High];
+            job = move(queue.front());
+            queue.pop_front();
+        }
+
+        try
+        {
+            job();
+        }
+        catch (std::exception const& _e)
+        {
+            cwarn << "Exception in handshake worker: " << _e.what();
+        }
+    }
+}
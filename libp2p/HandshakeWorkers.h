@@ -0,0 +1,70 @@
+// Copyright 2018 cpp-ethereum Authors.
+// Licensed under the GNU General Public License v3. See the LICENSE file.
+
+#pragma once
+
+#include <libdevcore/Guards.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace dev
+{
+namespace p2p
+{
+/**
+ * @brief Threads that do the public-key crypto of RLPx handshakes, so that a burst of new
+ * connections doesn't hold up the network threads serving established sessions.
+ *
+ * Jobs of outbound and trusted peers go before those of other inbound peers. At most
+ * c_maxQueued of the latter may wait, and admitIngress() limits how fast new ones arrive.
+ *
+ * @threadsafe
+ */
+class HandshakeWorkers
+{
+public:
+    enum Priority
+    {
+        High,
+        Normal
+    };
+
+    /// Normal-priority jobs that may wait at once.
+    static size_t const c_maxQueued = 256;
+
+    /// Inbound handshakes admitted per second, and at once after a quiet spell.
+    static unsigned const c_ingressPerSecond = 32;
+
+    explicit HandshakeWorkers(unsigned _threads);
+    ~HandshakeWorkers();
+
+    /// Queues @a _job to run on a worker. @returns false if there is no room for it.
+    bool enqueue(Priority _priority, std::function<void()> _job);
+
+    /// @returns true if another inbound handshake may start now.
+    bool admitIngress();
+
+    /// @returns the number of jobs waiting.
+    size_t queued() const;
+
+private:
+    void workerBody();
+
+    std::vector<std::thread> m_workers;
+    mutable Mutex x_queue;
+    std::condition_variable m_moreToDo;
+    std::deque<std::function<void()>> m_queue[2];   ///< Indexed by Priority.
+    bool m_stopping = false;
+
+    Mutex x_ingress;
+    double m_ingressTokens = c_ingressPerSecond;
+    std::chrono::steady_clock::time_point m_lastIngress = std::chrono::steady_clock::now();
+};
+
+}  // namespace p2p
+}  // namespace dev
@@ -47,6 +47,9 @@ std::chrono::seconds const c_keepAliveInterval = std::chrono::seconds(30);
 /// Disconnect timeout after failure to respond to keepAlivePeers ping.
 std::chrono::milliseconds const c_keepAliveTimeOut = std::chrono::milliseconds(1000);
 
+/// Most peers saveNetwork() keeps besides required ones; the best scored are kept.
+unsigned const c_maxSavedPeers = 256;
+
 HostNodeTableHandler::HostNodeTableHandler(Host& _host): m_host(_host) {}
 
 void HostNodeTableHandler::processEvent(NodeID const& _n, NodeTableEventType const& _e)
@@ -103,6 +106,7 @@ Host::Host(string const& _clientVersion, KeyPair const& _alias, NetworkPreferenc
     m_netPrefs(_n),
     m_ifAddresses(Network::getInterfaceAddresses()),
     m_ioService(2),
+    m_handshakeWorkers(_n.handshakeThreads),
     m_tcp4Acceptor(m_ioService),
     m_alias(_alias),
     m_lastPing(chrono::steady_clock::time_point::min())
@@ -161,6 +165,15 @@ void Host::stop()
 
 void Host::doneWorking()
 {
+    // the other I/O threads leave once run() has stopped the io_service
+    for (auto& t: m_ioThreads)
+        t.join();
+    m_ioThreads.clear();
+
+    // reset NodeTable
+    DEV_GUARDED(x_nodeTable)
+        m_nodeTable.reset();
+
     // reset ioservice (cancels all timers and allows manually polling network, below)
     m_ioService.reset();
 
@@ -263,6 +276,8 @@ void Host::startPeerSession(Public const& _id, RLP const& _rlp, unique_ptr<RLPXF
     auto caps = _rlp[2].toVector<CapDesc>();
     auto listenPort = _rlp[3].toInt<unsigned short>();
     auto pub = _rlp[4].toHash<Public>();
+    // Hello has five items; we add a sixth that is non-zero if chunked packets are fine.
+    bool multiplexing = _rlp.itemCount() > 5 && _rlp[5].isInt() && _rlp[5].toInt<unsigned>();
 
     if (pub != _id)
     {
@@ -284,7 +299,7 @@ void Host::startPeerSession(Public const& _id, RLP const& _rlp, unique_ptr<RLPXF
             << " " << _id << " " << showbase << capslog.str() << " " << dec << listenPort;
 
     // create session so disconnects are managed
-    shared_ptr<SessionFace> ps = make_shared<Session>(this, move(_io), _s, p, PeerSessionInfo({_id, clientVersion, p->endpoint.address.to_string(), listenPort, chrono::steady_clock::duration(), _rlp[2].toSet<CapDesc>(), 0, map<string, string>(), protocolVersion}));
+    shared_ptr<SessionFace> ps = make_shared<Session>(this, move(_io), _s, p, PeerSessionInfo({_id, clientVersion, p->endpoint.address.to_string(), listenPort, chrono::steady_clock::duration(), _rlp[2].toSet<CapDesc>(), 0, map<string, string>(), protocolVersion, multiplexing, 0, 0, 0, 0}));
     if (protocolVersion < dev::p2p::c_protocolVersion - 1)
     {
         ps->disconnect(IncompatibleProtocol);
@@ -338,6 +353,11 @@ void Host::startPeerSession(Public const& _id, RLP const& _rlp, unique_ptr<RLPXF
 
         ps->start();
         m_sessions[_id] = ps;
+
+        p->m_handshakes++;
+        p->m_lastSeen = chrono::system_clock::now();
+        // Only what we have too is left of the capabilities it advertised.
+        p->m_caps = caps;
     }
     
     LOG(m_logger) << "p2p.host.peer.register " << _id;
@@ -454,6 +474,14 @@ void Host::runAcceptor()
                     runAcceptor();
                 return;
             }
+            if (!m_handshakeWorkers.admitIngress())
+            {
+                cnetdetails << "Dropping incoming connect due to handshake rate limit: "
+                            << socket->remoteEndpoint();
+                socket->close();
+                runAcceptor();
+                return;
+            }
             
             bool success = false;
             try
@@ -654,9 +682,8 @@ void Host::run(boost::system::error_code const&)
 {
     if (!m_run)
     {
-        // reset NodeTable
-        DEV_GUARDED(x_nodeTable)
-            m_nodeTable.reset();
+        // The NodeTable is reset in doneWorking(), once no other I/O thread can be running its
+        // handlers.
 
         // stopping io service allows running manual network operations for shutdown
         // and also stops blocking worker thread, allowing worker thread to exit
@@ -706,6 +733,11 @@ void Host::run(boost::system::error_code const&)
         }
     }
 
+    // Best first, so that after a restart the slots fill with the peers that served us well.
+    toConnect.sort([](shared_ptr<Peer> const& _a, shared_ptr<Peer> const& _b) {
+        return _a->dialScore() > _b->dialScore();
+    });
+
     for (auto p: toConnect)
         if (p->peerType == PeerType::Required && reqConn++ < m_idealPeerCount)
             connect(p);
@@ -744,6 +776,8 @@ void Host::startedWorking()
         m_run = true;
     }
 
+    m_egressLimiter.setLimits(m_netPrefs.uploadLimit, m_netPrefs.classUploadLimits);
+
     // start capability threads (ready for incoming connections)
     for (auto const& h: m_capabilities)
         h.second->onStarting();
@@ -773,6 +807,14 @@ void Host::startedWorking()
     LOG(m_logger) << "p2p.started id: " << id();
 
     run(boost::system::error_code());
+
+    // the worker thread runs the io_service too, in doWork()
+    for (unsigned i = 1; i < m_netPrefs.ioThreads; ++i)
+        m_ioThreads.emplace_back([this, i]() {
+            setThreadName("p2p" + toString(i));
+            while (m_run)
+                doWork();
+        });
 }
 
 void Host::doWork()
@@ -826,29 +868,40 @@ bytes Host::saveNetwork() const
     {
         RecursiveGuard l(x_sessions);
         for (auto p: m_peers)
-            if (p.second)
+            if (p.second && p.second->worthKeeping())
                 peers.push_back(*p.second);
     }
-    peers.sort();
+    // Best first, and no more than we could use.
+    peers.sort([](Peer const& _a, Peer const& _b) {
+        double const a = _a.dialScore();
+        double const b = _b.dialScore();
+        return a != b ? a > b : _a.id < _b.id;
+    });
 
     RLPStream network;
     int count = 0;
+    unsigned saved = 0;
     for (auto const& p: peers)
     {
         // todo: ipv6
         if (!p.endpoint.address.is_v4())
             continue;
 
-        // Only save peers which have connected within 2 days, with properly-advertised port and public IP address
-        if (chrono::system_clock::now() - p.m_lastConnected < chrono::seconds(3600 * 48) && !!p.endpoint && p.id != id() && (p.peerType == PeerType::Required || p.endpoint.isAllowed()))
+        // Only save peers which have been seen within 2 days, with properly-advertised port and public IP address
+        auto const lastSeen = max(p.m_lastSeen.load(), p.m_lastConnected);
+        if (chrono::system_clock::now() - lastSeen < chrono::seconds(3600 * 48) && !!p.endpoint && p.id != id() && (p.peerType == PeerType::Required || p.endpoint.isAllowed()))
         {
-            network.appendList(11);
+            if (p.peerType != PeerType::Required && saved >= c_maxSavedPeers)
+                continue;
+            network.appendList(15);
             p.endpoint.streamRLP(network, NodeIPEndpoint::StreamInline);
             network << p.id << (p.peerType == PeerType::Required ? true : false)
-                << chrono::duration_cast<chrono::seconds>(p.m_lastConnected.time_since_epoch()).count()
+                << chrono::duration_cast<chrono::seconds>(lastSeen.time_since_epoch()).count()
                 << chrono::duration_cast<chrono::seconds>(p.m_lastAttempted.time_since_epoch()).count()
-                << p.m_failedAttempts.load() << (unsigned)p.m_lastDisconnect << p.m_score.load() << p.m_rating.load();
+                << p.m_failedAttempts.load() << (unsigned)p.m_lastDisconnect << p.m_score.load() << p.m_rating.load()
+                << p.m_handshakes.load() << p.m_latency.load() << p.m_servedBytes.load() << p.m_caps;
             count++;
+            saved++;
         }
     }
 
@@ -901,14 +954,14 @@ void Host::restoreNetwork(bytesConstRef _b)
             if (i[0].itemCount() != 4 && i[0].size() != 4)
                 continue;
 
-            if (i.itemCount() == 4 || i.itemCount() == 11)
+            if (i.itemCount() == 4 || i.itemCount() == 11 || i.itemCount() == 15)
             {
                 Node n((NodeID)i[3], NodeIPEndpoint(i));
                 if (i.itemCount() == 4 && n.endpoint.isAllowed())
                 {
                     addNodeToNodeTable(n);
                 }
-                else if (i.itemCount() == 11)
+                else if (i.itemCount() >= 11)
                 {
                     n.peerType = i[4].toInt<bool>() ? PeerType::Required : PeerType::Optional;
                     if (!n.endpoint.isAllowed() && n.peerType == PeerType::Optional)
@@ -920,6 +973,16 @@ void Host::restoreNetwork(bytesConstRef _b)
                     p->m_lastDisconnect = (DisconnectReason)i[8].toInt<unsigned>();
                     p->m_score = (int)i[9].toInt<unsigned>();
                     p->m_rating = (int)i[10].toInt<unsigned>();
+                    p->m_lastSeen = p->m_lastConnected;
+                    if (i.itemCount() == 15)
+                    {
+                        p->m_handshakes = i[11].toInt<unsigned>();
+                        p->m_latency = i[12].toInt<unsigned>();
+                        p->m_servedBytes = i[13].toInt<uint64_t>();
+                        p->m_caps = i[14].toVector<CapDesc>();
+                    }
+                    if (!p->worthKeeping())
+                        continue;
                     m_peers[p->id] = p;
                     if (p->peerType == PeerType::Required)
                         requirePeer(p->id, n.endpoint);
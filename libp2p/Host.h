@@ -40,6 +40,9 @@
 #include "Peer.h"
 #include "RLPXSocket.h"
 #include "RLPXFrameCoder.h"
+#include "BufferPool.h"
+#include "HandshakeWorkers.h"
+#include "BandwidthLimiter.h"
 #include "Common.h"
 namespace ba = boost::asio;
 namespace bi = ba::ip;
@@ -225,6 +228,15 @@ public:
 	/// Validates and starts peer session, taking ownership of _io. Disconnects and returns false upon error.
 	void startPeerSession(Public const& _id, RLP const& _hello, std::unique_ptr<RLPXFrameCoder>&& _io, std::shared_ptr<RLPXSocket> const& _s);
 
+	/// Get the host-wide upload limits that sessions keep to.
+	EgressLimiter& egressLimiter() { return m_egressLimiter; }
+
+	/// @returns the upload limit and statistics of each traffic class.
+	std::vector<TrafficClassInfo> trafficClasses() const { return m_egressLimiter.info(); }
+
+	/// Get the pool that sessions read ingress frames into.
+	std::shared_ptr<BufferPool> const& bufferPool() const { return m_bufferPool; }
+
 	/// Get session by id
 	std::shared_ptr<SessionFace> peerSession(NodeID const& _id) { RecursiveGuard l(x_sessions); return m_sessions.count(_id) ? m_sessions[_id].lock() : std::shared_ptr<SessionFace>(); }
 
@@ -237,6 +249,9 @@ public:
 	/// Get the public endpoint information.
 	std::string enode() const { return "enode://" + id().hex() + "@" + (networkPreferences().publicIPAddress.empty() ? m_tcpPublic.address().to_string() : networkPreferences().publicIPAddress) + ":" + toString(m_tcpPublic.port()); }
 
+	/// Advertises @a _version in Hello instead of the version we speak, to act as an older peer.
+	void test_setProtocolVersion(unsigned _version) { m_protocolVersion = _version; }
+
 	/// Get the node information.
 	p2p::NodeInfo nodeInfo() const { return NodeInfo(id(), (networkPreferences().publicIPAddress.empty() ? m_tcpPublic.address().to_string() : networkPreferences().publicIPAddress), m_tcpPublic.port(), m_clientVersion); }
 
@@ -296,6 +311,7 @@ private:
 	std::atomic<bool> m_run{false};													///< Whether network is running.
 
 	std::string m_clientVersion;											///< Our version string.
+	unsigned m_protocolVersion = c_snappyProtocolVersion;					///< Version we advertise in Hello.
 
 	NetworkPreferences m_netPrefs;										///< Network settings.
 
@@ -305,6 +321,10 @@ private:
 	std::atomic<int> m_listenPort{-1};												///< What port are we listening on. -1 means binding failed or acceptor hasn't been initialized.
 
 	ba::io_service m_ioService;											///< IOService for network stuff.
+	std::vector<std::thread> m_ioThreads;								///< Threads running m_ioService besides the worker.
+	HandshakeWorkers m_handshakeWorkers;								///< Key agreement and ECIES of handshakes. Its jobs post to m_ioService, so it is destroyed first.
+	std::shared_ptr<BufferPool> m_bufferPool = std::make_shared<BufferPool>();	///< Ingress frame buffers shared by all sessions.
+	EgressLimiter m_egressLimiter;										///< Upload limits from m_netPrefs, shared by all sessions.
 	bi::tcp::acceptor m_tcp4Acceptor;										///< Listening acceptor.
 
 	std::unique_ptr<boost::asio::deadline_timer> m_timer;					///< Timer which, when network is running, calls scheduler() every c_timerInterval ms.
@@ -55,6 +55,8 @@ protected:
 	virtual u256 version() const = 0;
 	CapDesc capDesc() const { return std::make_pair(name(), version()); }
 	virtual unsigned messageCount() const = 0;
+	/// @returns the class of the capability's packet @a _packetType, counted from its id offset.
+	virtual TrafficClass trafficClass(unsigned /*_packetType*/) const { return TrafficClass::Propagation; }
 	virtual std::shared_ptr<Capability> newPeerCapability(std::shared_ptr<SessionFace> const& _s, unsigned _idOffset, CapDesc const& _cap) = 0;
 
 	virtual void onStarting() {}
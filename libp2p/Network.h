@@ -62,6 +62,11 @@ struct NetworkPreferences
 	bool traverseNAT = true;
 	bool discovery = true;		// Discovery is activated with network.
 	bool pin = false;			// Only accept or connect to trusted peers.
+	unsigned ioThreads = 1;		// Threads running network I/O; a session's handlers never run concurrently.
+	unsigned handshakeThreads = 2;	// Threads doing the public-key crypto of connection handshakes.
+	unsigned uploadLimit = 0;		// Bytes per second all sessions together may send; 0 for no limit.
+	unsigned peerUploadLimit = 0;	// Bytes per second each session may send; 0 for no limit.
+	std::array<unsigned, c_trafficClasses> classUploadLimits{};	// Bytes per second each TrafficClass may send; 0 for no limit.
 };
 
 /**
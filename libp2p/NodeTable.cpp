@@ -40,17 +40,19 @@ inline bool operator==(
     return !_weak.owner_before(_shared) && !_shared.owner_before(_weak);
 }
 
-NodeEntry::NodeEntry(NodeID const& _src, Public const& _pubk, NodeIPEndpoint const& _gw): Node(_pubk, _gw), distance(NodeTable::distance(_src, _pubk)) {}
+NodeEntry::NodeEntry(NodeID const& _src, Public const& _pubk, NodeIPEndpoint const& _gw): Node(_pubk, _gw), hash(sha3(_pubk)), distance(NodeTable::hashDistance(sha3(_src), hash)) {}
 
 NodeTable::NodeTable(ba::io_service& _io, KeyPair const& _alias, NodeIPEndpoint const& _endpoint, bool _enabled):
     m_node(Node(_alias.pub(), _endpoint)),
     m_secret(_alias.secret()),
+    m_hash(sha3(m_node.id)),
     m_socket(make_shared<NodeSocket>(_io, *reinterpret_cast<UDPSocketEvents*>(this), (bi::udp::endpoint)m_node.endpoint)),
     m_socketPointer(m_socket.get()),
     m_timers(_io)
 {
     for (unsigned i = 0; i < s_bins; i++)
         m_state[i].distance = i;
+    m_discoverTried.reserve(s_alpha * s_maxSteps);
     
     if (!_enabled)
         return;
@@ -156,7 +158,7 @@ shared_ptr<NodeEntry> NodeTable::nodeEntry(NodeID _id)
     return m_nodes.count(_id) ? m_nodes[_id] : shared_ptr<NodeEntry>();
 }
 
-void NodeTable::doDiscover(NodeID _node, unsigned _round, shared_ptr<set<shared_ptr<NodeEntry>>> _tried)
+void NodeTable::doDiscover(NodeID _node, unsigned _round)
 {
     // NOTE: ONLY called by doDiscovery!
     
@@ -169,17 +171,16 @@ void NodeTable::doDiscover(NodeID _node, unsigned _round, shared_ptr<set<shared_
         doDiscovery();
         return;
     }
-    else if (!_round && !_tried)
-        // initialized _tried on first round
-        _tried = make_shared<set<shared_ptr<NodeEntry>>>();
+    else if (!_round)
+        m_discoverTried.clear();
     
     auto nearest = nearestNodeEntries(_node);
-    list<shared_ptr<NodeEntry>> tried;
-    for (unsigned i = 0; i < nearest.size() && tried.size() < s_alpha; i++)
-        if (!_tried->count(nearest[i]))
+    size_t const triedBefore = m_discoverTried.size();
+    for (unsigned i = 0; i < nearest.size() && m_discoverTried.size() - triedBefore < s_alpha; i++)
+        if (find(m_discoverTried.begin(), m_discoverTried.end(), nearest[i]->id) == m_discoverTried.end())
         {
             auto r = nearest[i];
-            tried.push_back(r);
+            m_discoverTried.push_back(r->id);
             FindNode p(r->endpoint, _node);
             p.sign(m_secret);
             DEV_GUARDED(x_findNodeTimeout)
@@ -187,20 +188,14 @@ void NodeTable::doDiscover(NodeID _node, unsigned _round, shared_ptr<set<shared_
             m_socketPointer->send(p);
         }
     
-    if (tried.empty())
+    if (m_discoverTried.size() == triedBefore)
     {
         LOG(m_logger) << "Terminating discover after " << _round << " rounds.";
         doDiscovery();
         return;
     }
-        
-    while (!tried.empty())
-    {
-        _tried->insert(tried.front());
-        tried.pop_front();
-    }
 
-    m_timers.schedule(c_reqTimeout.count() * 2, [this, _node, _round, _tried](boost::system::error_code const& _ec)
+    m_timers.schedule(c_reqTimeout.count() * 2, [this, _node, _round](boost::system::error_code const& _ec)
     {
         if (_ec)
             // we can't use m_logger here, because captured this might be already destroyed
@@ -217,61 +212,45 @@ void NodeTable::doDiscover(NodeID _node, unsigned _round, shared_ptr<set<shared_
         // m_timers.isStopped(), because "this" pointer was captured by the lambda,
         // and therefore, in case of deallocation m_timers object no longer exists.
 
-        doDiscover(_node, _round + 1, _tried);
+        doDiscover(_node, _round + 1);
     });
 }
 
 vector<shared_ptr<NodeEntry>> NodeTable::nearestNodeEntries(NodeID _target)
 {
-    // send s_alpha FindNode packets to nodes we know, closest to target
-    static unsigned lastBin = s_bins - 1;
-    unsigned head = distance(m_node.id, _target);
-    unsigned tail = head == 0 ? lastBin : (head - 1) % s_bins;
-    
-    map<unsigned, list<shared_ptr<NodeEntry>>> found;
-    
-    // if d is 0, then we roll look forward, if last, we reverse, else, spread from d
-    if (head > 1 && tail != lastBin)
-        while (head != tail && head < s_bins)
-        {
-            Guard l(x_state);
-            for (auto const& n: m_state[head].nodes)
+    // Nodes in the bucket at the target's distance from us are nearer to it than any others.
+    // Nodes in nearer buckets are all at that same distance from it, and nodes in farther buckets
+    // at their own distance from us, so buckets are taken in that order until there are enough.
+    h256 const targetHash = sha3(_target);
+    unsigned const head = hashDistance(m_hash, targetHash);
+
+    vector<shared_ptr<NodeEntry>> ret;
+    ret.reserve(s_bucketSize);
+    auto const nearer = [&](shared_ptr<NodeEntry> const& _a, shared_ptr<NodeEntry> const& _b) {
+        return (_a->hash ^ targetHash) < (_b->hash ^ targetHash);
+    };
+    auto const addSorted = [&](unsigned _begin, unsigned _end) {
+        size_t const first = ret.size();
+        for (unsigned i = _begin; i < _end; ++i)
+            for (auto const& n: m_state[i].nodes)
                 if (auto p = n.lock())
-                    found[distance(_target, p->id)].push_back(p);
+                    if (!!p->endpoint && p->endpoint.isAllowed())
+                        ret.push_back(p);
+        sort(ret.begin() + first, ret.end(), nearer);
+    };
 
-            if (tail)
-                for (auto const& n: m_state[tail].nodes)
-                    if (auto p = n.lock())
-                        found[distance(_target, p->id)].push_back(p);
+    Guard l(x_state);
+    if (head > 0)
+    {
+        addSorted(head - 1, head);
+        if (ret.size() < s_bucketSize)
+            addSorted(0, head - 1);
+    }
+    for (unsigned i = head; i < s_bins && ret.size() < s_bucketSize; ++i)
+        addSorted(i, i + 1);
 
-            head++;
-            if (tail)
-                tail--;
-        }
-    else if (head < 2)
-        while (head < s_bins)
-        {
-            Guard l(x_state);
-            for (auto const& n: m_state[head].nodes)
-                if (auto p = n.lock())
-                    found[distance(_target, p->id)].push_back(p);
-            head++;
-        }
-    else
-        while (tail > 0)
-        {
-            Guard l(x_state);
-            for (auto const& n: m_state[tail].nodes)
-                if (auto p = n.lock())
-                    found[distance(_target, p->id)].push_back(p);
-            tail--;
-        }
-    
-    vector<shared_ptr<NodeEntry>> ret;
-    for (auto& nodes: found)
-        for (auto const& n: nodes.second)
-            if (ret.size() < s_bucketSize && !!n->endpoint && n->endpoint.isAllowed())
-                ret.push_back(n);
+    if (ret.size() > s_bucketSize)
+        ret.resize(s_bucketSize);
     return ret;
 }
 
@@ -334,11 +313,11 @@ void NodeTable::noteActiveNode(Public const& _pubk, bi::udp::endpoint const& _en
             if (it != nodes.end())
             {
                 // if it was in the bucket, move it to the last position
-                nodes.splice(nodes.end(), nodes, it);
+                nodes.moveToBack(it);
             }
             else
             {
-                if (nodes.size() < s_bucketSize)
+                if (!nodes.full())
                 {
                     // if it was not there, just add it as a most recently seen node
                     // (i.e. to the end of the list)
@@ -374,8 +353,9 @@ void NodeTable::dropNode(shared_ptr<NodeEntry> _n)
     {
         Guard l(x_state);
         NodeBucket& s = bucket_UNSAFE(_n.get());
-        s.nodes.remove_if(
-            [_n](weak_ptr<NodeEntry> const& _bucketEntry) { return _bucketEntry == _n; });
+        auto it = std::find(s.nodes.begin(), s.nodes.end(), _n);
+        if (it != s.nodes.end())
+            s.nodes.erase(it);
     }
     
     // notify host
@@ -22,6 +22,7 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
 
 #include <boost/integer/static_log2.hpp>
 
@@ -40,6 +41,7 @@ namespace p2p
 struct NodeEntry: public Node
 {
     NodeEntry(NodeID const& _src, Public const& _pubk, NodeIPEndpoint const& _gw);
+    h256 const hash;	///< sha3 of the node's id, which distances are measured between.
     int const distance;	///< Node's distance (xor of _src as integer).
     bool pending = true;		///< Node will be ignored until Pong is received
 };
@@ -146,7 +148,22 @@ public:
     ~NodeTable();
 
     /// Returns distance based on xor metric two node ids. Used by NodeEntry and NodeTable.
-    static int distance(NodeID const& _a, NodeID const& _b) { u256 d = sha3(_a) ^ sha3(_b); unsigned ret; for (ret = 0; d >>= 1; ++ret) {}; return ret; }
+    static int distance(NodeID const& _a, NodeID const& _b) { return hashDistance(sha3(_a), sha3(_b)); }
+
+    /// Returns distance based on xor metric of the hashes of two node ids: the index of the
+    /// highest bit in which they differ.
+    static int hashDistance(h256 const& _a, h256 const& _b)
+    {
+        for (unsigned i = 0; i < h256::size; ++i)
+            if (byte x = _a[i] ^ _b[i])
+            {
+                int ret = 8 * (h256::size - 1 - i);
+                while (x >>= 1)
+                    ++ret;
+                return ret;
+            }
+        return 0;
+    }
 
     /// Set event handler for NodeEntryAdded and NodeEntryDropped events.
     void setEventHandler(NodeTableEventHandler* _handler) { m_nodeEventHandler.reset(_handler); }
@@ -197,10 +214,39 @@ private:
     std::chrono::milliseconds const c_reqTimeout = std::chrono::milliseconds(300);						///< How long to wait for requests (evict, find iterations).
     std::chrono::milliseconds const c_bucketRefresh = std::chrono::milliseconds(7200);							///< Refresh interval prevents bucket from becoming stale. [Kademlia]
 
+    /// Nodes of a bucket, least recently seen first, kept in place so that buckets never allocate.
+    class BucketNodes
+    {
+    public:
+        using iterator = std::weak_ptr<NodeEntry>*;
+        using const_iterator = std::weak_ptr<NodeEntry> const*;
+
+        size_t size() const { return m_size; }
+        bool empty() const { return !m_size; }
+        bool full() const { return m_size == s_bucketSize; }
+
+        iterator begin() { return m_nodes.data(); }
+        iterator end() { return m_nodes.data() + m_size; }
+        const_iterator begin() const { return m_nodes.data(); }
+        const_iterator end() const { return m_nodes.data() + m_size; }
+        std::weak_ptr<NodeEntry> const& front() const { return m_nodes[0]; }
+        std::weak_ptr<NodeEntry> const& back() const { return m_nodes[m_size - 1]; }
+
+        void push_back(std::shared_ptr<NodeEntry> const& _n) { assert(!full()); m_nodes[m_size++] = _n; }
+        void pop_front() { erase(begin()); }
+        void erase(iterator _it) { std::move(_it + 1, end(), _it); m_nodes[--m_size].reset(); }
+        void moveToBack(iterator _it) { std::rotate(_it, _it + 1, end()); }
+        void clear() { for (auto& n: *this) n.reset(); m_size = 0; }
+
+    private:
+        std::array<std::weak_ptr<NodeEntry>, s_bucketSize> m_nodes;
+        size_t m_size = 0;
+    };
+
     struct NodeBucket
     {
         unsigned distance;
-        std::list<std::weak_ptr<NodeEntry>> nodes;
+        BucketNodes nodes;
     };
 
     /// Used to ping endpoint.
@@ -217,9 +263,11 @@ private:
 
     /// Used to discovery nodes on network which are close to the given target.
     /// Sends s_alpha concurrent requests to nodes nearest to target, for nodes nearest to target, up to s_maxSteps rounds.
-    void doDiscover(NodeID _target, unsigned _round = 0, std::shared_ptr<std::set<std::shared_ptr<NodeEntry>>> _tried = std::shared_ptr<std::set<std::shared_ptr<NodeEntry>>>());
+    /// Nodes already asked are kept in m_discoverTried; only one discovery runs at a time.
+    void doDiscover(NodeID _target, unsigned _round = 0);
 
-    /// Returns nodes from node table which are closest to target.
+    /// Returns nodes from node table which are closest to target, nearest first. Only visits as
+    /// many buckets as it takes to find them.
     std::vector<std::shared_ptr<NodeEntry>> nearestNodeEntries(NodeID _target);
 
     /// Asynchronously drops _leastSeen node if it doesn't reply and adds _new node, otherwise _new node is thrown away.
@@ -256,6 +304,7 @@ private:
 
     Node m_node;													///< This node. LOCK x_state if endpoint access or mutation is required. Do not modify id.
     Secret m_secret;												///< This nodes secret key.
+    h256 const m_hash;												///< sha3 of our id, which distances are measured from.
 
     mutable Mutex x_nodes;											///< LOCK x_state first if both locks are required. Mutable for thread-safe copy in nodes() const.
     std::unordered_map<NodeID, std::shared_ptr<NodeEntry>> m_nodes;	///< Known Node Endpoints
@@ -272,6 +321,8 @@ private:
     Mutex x_findNodeTimeout;
     std::list<NodeIdTimePoint> m_findNodeTimeout;					///< Timeouts for FindNode requests.
 
+    std::vector<NodeID> m_discoverTried;							///< Nodes asked in the current discovery; room for all its rounds.
+
     std::shared_ptr<NodeSocket> m_socket;							///< Shared pointer for our UDPSocket; ASIO requires shared_ptr.
     NodeSocket* m_socketPointer;									///< Set to m_socket.get(). Socket is created in constructor and disconnected in destructor to ensure access to pointer is safe.
 
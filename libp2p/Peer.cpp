@@ -21,6 +21,9 @@
  */
 
 #include "Peer.h"
+
+#include <cmath>
+#include <limits>
 using namespace std;
 using namespace dev;
 using namespace dev::p2p;
@@ -36,11 +39,49 @@ Peer::Peer(Peer const& _original):
 	m_lastConnected(_original.m_lastConnected),
 	m_lastAttempted(_original.m_lastAttempted),
 	m_lastDisconnect(_original.m_lastDisconnect),
+	m_caps(_original.m_caps),
 	m_session(_original.m_session)
 {
 	m_score = _original.m_score.load();
 	m_rating = _original.m_rating.load();
 	m_failedAttempts = _original.m_failedAttempts.load();
+	m_lastSeen = _original.m_lastSeen.load();
+	m_handshakes = _original.m_handshakes.load();
+	m_latency = _original.m_latency.load();
+	m_servedBytes = _original.m_servedBytes.load();
+}
+
+double Peer::dialScore() const
+{
+	if (peerType == PeerType::Required)
+		return numeric_limits<double>::max();
+
+	// Each doubling of sessions or of data served counts the same; failures count linearly.
+	double ret = 10 * log2(1.0 + m_handshakes) + 2 * log2(1.0 + m_servedBytes / 1024.0) + m_score;
+	ret -= min(m_latency.load(), 2000u) / 100.0;
+	ret -= 5.0 * m_failedAttempts;
+	switch (m_lastDisconnect)
+	{
+	case BadProtocol:
+	case UselessPeer:
+	case IncompatibleProtocol:
+	case UnexpectedIdentity:
+		ret -= 20;
+		break;
+	default:
+		break;
+	}
+	return ret;
+}
+
+bool Peer::worthKeeping() const
+{
+	if (peerType == PeerType::Required)
+		return true;
+	if (m_lastDisconnect == IncompatibleProtocol || m_lastDisconnect == UnexpectedIdentity)
+		return false;
+	// Peers that never completed a handshake get fewer tries than ones that did.
+	return m_failedAttempts < (m_handshakes ? 15u : 5u);
 }
 
 bool Peer::shouldReconnect() const
@@ -80,6 +80,13 @@ public:
 	
 	/// Peer session is noted as useful.
 	void noteSessionGood() { m_failedAttempts = 0; }
+
+	/// @returns how worthwhile dialling this peer is, judged by its record across restarts.
+	/// Higher is better.
+	double dialScore() const;
+
+	/// @returns false if the peer's record is bad enough for it to be forgotten.
+	bool worthKeeping() const;
 	
 protected:
 	/// Returns number of seconds to wait until attempting connection, based on attempted connection history.
@@ -95,6 +102,14 @@ protected:
 	std::atomic<unsigned> m_failedAttempts{0};
 	DisconnectReason m_lastDisconnect = NoDisconnect;	///< Reason for disconnect that happened last.
 
+	/// Record kept across restarts
+	
+	std::atomic<std::chrono::system_clock::time_point> m_lastSeen{};	///< When a session with it last started or ended.
+	std::atomic<unsigned> m_handshakes{0};					///< Sessions established with it.
+	std::atomic<unsigned> m_latency{0};						///< Smoothed ping round trip in ms, 0 if unknown.
+	std::atomic<uint64_t> m_servedBytes{0};					///< Capability packet bytes received from it.
+	std::vector<CapDesc> m_caps;							///< Highest versions of the capabilities it had in common with us. Guarded by Host::x_sessions.
+
 	/// Used by isOffline() and (todo) for peer to emit session information.
 	std::weak_ptr<Session> m_session;
 };
@@ -0,0 +1,288 @@
+// Copyright 2018 cpp-ethereum Authors.
+// Licensed under the GNU General Public License v3. See the LICENSE file.
+
+#include "RLPXCipher.h"
+
+#include <libdevcore/Assertions.h>
+#include <libdevcore/Guards.h>
+
+#include <cryptopp/aes.h>
+#include <cryptopp/modes.h>
+#include <ethash/keccak.hpp>
+
+#include <cstring>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define ETH_RLPX_AESNI 1
+#include <cpuid.h>
+#include <immintrin.h>
+#define AESNI_TARGET __attribute__((target("aes,ssse3")))
+#endif
+
+static_assert(CRYPTOPP_VERSION == 565, "Wrong Crypto++ version");
+
+using namespace std;
+using namespace dev;
+using namespace dev::p2p;
+
+struct RLPXAES::Fallback
+{
+    CryptoPP::CTR_Mode<CryptoPP::AES>::Encryption ctr;
+    CryptoPP::ECB_Mode<CryptoPP::AES>::Encryption ecb;
+    Mutex x_ecb;
+};
+
+namespace
+{
+unsigned const c_rounds = 14;
+
+/// Keccak-256 absorbs this many bytes per permutation.
+unsigned const c_keccakRate = 136;
+
+inline uint64_t load64be(byte const* _p)
+{
+    uint64_t ret = 0;
+    for (unsigned i = 0; i < 8; ++i)
+        ret = (ret << 8) | _p[i];
+    return ret;
+}
+
+inline uint64_t load64le(byte const* _p)
+{
+    uint64_t ret = 0;
+    for (unsigned i = 0; i < 8; ++i)
+        ret |= uint64_t(_p[i]) << (8 * i);
+    return ret;
+}
+
+#if ETH_RLPX_AESNI
+
+AESNI_TARGET inline __m128i prefixXor(__m128i _k)
+{
+    __m128i t = _mm_slli_si128(_k, 4);
+    _k = _mm_xor_si128(_k, t);
+    t = _mm_slli_si128(t, 4);
+    _k = _mm_xor_si128(_k, t);
+    t = _mm_slli_si128(t, 4);
+    return _mm_xor_si128(_k, t);
+}
+
+template <int Rcon>
+AESNI_TARGET inline __m128i evenRoundKey(__m128i _prev2, __m128i _prev)
+{
+    return _mm_xor_si128(prefixXor(_prev2), _mm_shuffle_epi32(_mm_aeskeygenassist_si128(_prev, Rcon), 0xff));
+}
+
+AESNI_TARGET inline __m128i oddRoundKey(__m128i _prev2, __m128i _prev)
+{
+    return _mm_xor_si128(prefixXor(_prev2), _mm_shuffle_epi32(_mm_aeskeygenassist_si128(_prev, 0), 0xaa));
+}
+
+AESNI_TARGET void expandKey(byte const* _key, byte* o_roundKeys)
+{
+    __m128i k[c_rounds + 1];
+    k[0] = _mm_loadu_si128(reinterpret_cast<__m128i const*>(_key));
+    k[1] = _mm_loadu_si128(reinterpret_cast<__m128i const*>(_key + 16));
+    k[2] = evenRoundKey<0x01>(k[0], k[1]);
+    k[3] = oddRoundKey(k[1], k[2]);
+    k[4] = evenRoundKey<0x02>(k[2], k[3]);
+    k[5] = oddRoundKey(k[3], k[4]);
+    k[6] = evenRoundKey<0x04>(k[4], k[5]);
+    k[7] = oddRoundKey(k[5], k[6]);
+    k[8] = evenRoundKey<0x08>(k[6], k[7]);
+    k[9] = oddRoundKey(k[7], k[8]);
+    k[10] = evenRoundKey<0x10>(k[8], k[9]);
+    k[11] = oddRoundKey(k[9], k[10]);
+    k[12] = evenRoundKey<0x20>(k[10], k[11]);
+    k[13] = oddRoundKey(k[11], k[12]);
+    k[14] = evenRoundKey<0x40>(k[12], k[13]);
+    for (unsigned i = 0; i <= c_rounds; ++i)
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(o_roundKeys + 16 * i), k[i]);
+}
+
+AESNI_TARGET inline __m128i counterBlock(uint64_t _high, uint64_t _low)
+{
+    __m128i const byteSwap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    return _mm_shuffle_epi8(_mm_set_epi64x(_high, _low), byteSwap);
+}
+
+AESNI_TARGET void encryptBlockNI(byte const* _roundKeys, byte* io_block)
+{
+    auto const* k = reinterpret_cast<__m128i const*>(_roundKeys);
+    __m128i b = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<__m128i const*>(io_block)), _mm_loadu_si128(k));
+    for (unsigned r = 1; r < c_rounds; ++r)
+        b = _mm_aesenc_si128(b, _mm_loadu_si128(k + r));
+    b = _mm_aesenclast_si128(b, _mm_loadu_si128(k + c_rounds));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(io_block), b);
+}
+
+/// Encrypts @a _blocks whole blocks from @a _in to @a _out, eight at a time while there are enough.
+AESNI_TARGET void processCTRNI(byte const* _roundKeys, uint64_t& io_high, uint64_t& io_low, byte* _out,
+    byte const* _in, size_t _blocks)
+{
+    unsigned const c_lanes = 8;
+    __m128i k[c_rounds + 1];
+    for (unsigned r = 0; r <= c_rounds; ++r)
+        k[r] = _mm_loadu_si128(reinterpret_cast<__m128i const*>(_roundKeys) + r);
+
+    // Lambdas don't inherit the target of the function they are in.
+    auto next = [&]() AESNI_TARGET {
+        __m128i ret = _mm_xor_si128(counterBlock(io_high, io_low), k[0]);
+        if (++io_low == 0)
+            ++io_high;
+        return ret;
+    };
+
+    for (; _blocks >= c_lanes; _blocks -= c_lanes, _in += 16 * c_lanes, _out += 16 * c_lanes)
+    {
+        __m128i b[c_lanes];
+        for (unsigned l = 0; l < c_lanes; ++l)
+            b[l] = next();
+        for (unsigned r = 1; r < c_rounds; ++r)
+            for (unsigned l = 0; l < c_lanes; ++l)
+                b[l] = _mm_aesenc_si128(b[l], k[r]);
+        for (unsigned l = 0; l < c_lanes; ++l)
+        {
+            b[l] = _mm_aesenclast_si128(b[l], k[c_rounds]);
+            auto in = _mm_loadu_si128(reinterpret_cast<__m128i const*>(_in) + l);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(_out) + l, _mm_xor_si128(b[l], in));
+        }
+    }
+
+    for (; _blocks; --_blocks, _in += 16, _out += 16)
+    {
+        __m128i b = next();
+        for (unsigned r = 1; r < c_rounds; ++r)
+            b = _mm_aesenc_si128(b, k[r]);
+        b = _mm_aesenclast_si128(b, k[c_rounds]);
+        auto in = _mm_loadu_si128(reinterpret_cast<__m128i const*>(_in));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(_out), _mm_xor_si128(b, in));
+    }
+}
+
+bool detectAESNI()
+{
+    unsigned eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return false;
+    return (ecx & bit_AES) && (ecx & bit_SSSE3);
+}
+
+#endif
+}  // namespace
+
+bool RLPXAES::hardwareAccelerated()
+{
+#if ETH_RLPX_AESNI
+    static bool const s_aesni = detectAESNI();
+    return s_aesni;
+#else
+    return false;
+#endif
+}
+
+RLPXAES::RLPXAES(bytesConstRef _key, h128 const& _iv)
+{
+    assertsEqual(_key.size(), h256::size);
+    m_counterHigh = load64be(_iv.data());
+    m_counterLow = load64be(_iv.data() + 8);
+
+#if ETH_RLPX_AESNI
+    if (hardwareAccelerated())
+    {
+        expandKey(_key.data(), m_roundKeys);
+        return;
+    }
+#endif
+    m_fallback.reset(new Fallback);
+    m_fallback->ctr.SetKeyWithIV(_key.data(), _key.size(), _iv.data());
+    m_fallback->ecb.SetKey(_key.data(), _key.size());
+}
+
+RLPXAES::~RLPXAES()
+{
+    memset(m_roundKeys, 0, sizeof(m_roundKeys));
+}
+
+void RLPXAES::processCTR(byte* _out, byte const* _in, size_t _size)
+{
+    if (m_fallback)
+    {
+        m_fallback->ctr.ProcessData(_out, _in, _size);
+        return;
+    }
+
+#if ETH_RLPX_AESNI
+    for (; _size && m_keyStreamUsed < 16; --_size)
+        *_out++ = *_in++ ^ m_keyStream[m_keyStreamUsed++];
+
+    size_t const blocks = _size / 16;
+    processCTRNI(m_roundKeys, m_counterHigh, m_counterLow, _out, _in, blocks);
+    _out += blocks * 16;
+    _in += blocks * 16;
+    _size -= blocks * 16;
+
+    if (_size)
+    {
+        nextKeyStream();
+        for (; _size; --_size)
+            *_out++ = *_in++ ^ m_keyStream[m_keyStreamUsed++];
+    }
+#endif
+}
+
+void RLPXAES::nextKeyStream()
+{
+#if ETH_RLPX_AESNI
+    memset(m_keyStream, 0, sizeof(m_keyStream));
+    processCTRNI(m_roundKeys, m_counterHigh, m_counterLow, m_keyStream, m_keyStream, 1);
+    m_keyStreamUsed = 0;
+#endif
+}
+
+void RLPXAES::encryptBlock(h128& io_block)
+{
+    if (m_fallback)
+    {
+        Guard l(m_fallback->x_ecb);
+        m_fallback->ecb.ProcessData(io_block.data(), io_block.data(), h128::size);
+        return;
+    }
+#if ETH_RLPX_AESNI
+    encryptBlockNI(m_roundKeys, io_block.data());
+#endif
+}
+
+void RLPXMAC::update(bytesConstRef _data)
+{
+    byte const* p = _data.data();
+    size_t size = _data.size();
+    while (size)
+    {
+        if (m_absorbed % 8 == 0)
+            for (; size >= 8 && m_absorbed < c_keccakRate; p += 8, size -= 8, m_absorbed += 8)
+                m_state[m_absorbed / 8] ^= load64le(p);
+        for (; size && (m_absorbed % 8 || size < 8) && m_absorbed < c_keccakRate; ++p, --size, ++m_absorbed)
+            m_state[m_absorbed / 8] ^= uint64_t(*p) << (8 * (m_absorbed % 8));
+        if (m_absorbed == c_keccakRate)
+        {
+            ethash_keccakf1600(m_state);
+            m_absorbed = 0;
+        }
+    }
+}
+
+h128 RLPXMAC::digest() const
+{
+    uint64_t state[25];
+    memcpy(state, m_state, sizeof(state));
+    // Original Keccak padding, as Crypto++'s Keccak_256 and dev::sha3 use.
+    state[m_absorbed / 8] ^= uint64_t(0x01) << (8 * (m_absorbed % 8));
+    state[c_keccakRate / 8 - 1] ^= uint64_t(0x80) << 56;
+    ethash_keccakf1600(state);
+
+    h128 ret;
+    for (unsigned i = 0; i < h128::size; ++i)
+        ret[i] = byte(state[i / 8] >> (8 * (i % 8)));
+    return ret;
+}
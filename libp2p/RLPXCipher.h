@@ -0,0 +1,76 @@
+// Copyright 2018 cpp-ethereum Authors.
+// Licensed under the GNU General Public License v3. See the LICENSE file.
+
+#pragma once
+
+#include <libdevcore/Common.h>
+#include <libdevcore/FixedHash.h>
+
+#include <memory>
+
+namespace dev
+{
+namespace p2p
+{
+/**
+ * @brief AES-256 in the two modes RLPx uses: CTR for frames and single blocks for MAC updates.
+ *
+ * On x86 CPUs with AES-NI, eight counter blocks are encrypted at a time so that their rounds
+ * overlap in the pipeline. Other CPUs use Crypto++.
+ *
+ * Thread Safety
+ * Distinct Objects: Safe.
+ * Shared objects: Unsafe, except that encryptBlock() may be called from several threads at once.
+ */
+class RLPXAES
+{
+public:
+    /// Sets up with the 32-byte @a _key and the counter starting at @a _iv.
+    explicit RLPXAES(bytesConstRef _key, h128 const& _iv = h128());
+    ~RLPXAES();
+
+    /// Encrypts or decrypts @a _size bytes from @a _in to @a _out, which may be the same. Each call
+    /// continues the key stream where the previous one stopped.
+    void processCTR(byte* _out, byte const* _in, size_t _size);
+
+    /// Encrypts one block in place without touching the counter.
+    void encryptBlock(h128& io_block);
+
+    /// @returns true if this CPU has AES-NI.
+    static bool hardwareAccelerated();
+
+private:
+    struct Fallback;
+
+    /// Fills m_keyStream with the next block of the key stream.
+    void nextKeyStream();
+
+    byte m_roundKeys[15 * 16];
+    uint64_t m_counterHigh = 0;     ///< Counter block, big-endian as Crypto++ increments it.
+    uint64_t m_counterLow = 0;
+    byte m_keyStream[16];
+    unsigned m_keyStreamUsed = 16;  ///< Bytes of m_keyStream already used.
+    std::unique_ptr<Fallback> m_fallback;
+};
+
+/**
+ * @brief Keccak-256 state of an RLPx MAC.
+ *
+ * The state is plain data, so a digest is read off a stack copy of it rather than a copy of a
+ * Crypto++ hash object.
+ */
+class RLPXMAC
+{
+public:
+    void update(bytesConstRef _data);
+
+    /// @returns the first 16 bytes of the digest of everything absorbed so far.
+    h128 digest() const;
+
+private:
+    uint64_t m_state[25] = {};
+    unsigned m_absorbed = 0;    ///< Bytes absorbed into the current block.
+};
+
+}  // namespace p2p
+}  // namespace dev
@@ -20,15 +20,11 @@
  */
 
 #include "RLPXFrameCoder.h"
-#include <cryptopp/aes.h>
-#include <cryptopp/keccak.h>
-#include <cryptopp/modes.h>
 #include <libdevcore/Assertions.h>
 #include <libdevcore/SHA3.h>
 #include "RLPxHandshake.h"
 #include "RLPXPacket.h"
-
-static_assert(CRYPTOPP_VERSION == 565, "Wrong Crypto++ version");
+#include "RLPXCipher.h"
 
 using namespace std;
 using namespace dev;
@@ -53,22 +49,14 @@ class RLPXFrameCoderImpl
 {
 public:
 	/// Update state of _mac.
-	void updateMAC(CryptoPP::Keccak_256& _mac, bytesConstRef _seed = {});
-
-	CryptoPP::SecByteBlock frameEncKey;						///< Key for m_frameEnc
-	CryptoPP::CTR_Mode<CryptoPP::AES>::Encryption frameEnc;	///< Encoder for egress plaintext.
-
-	CryptoPP::SecByteBlock frameDecKey;						///< Key for m_frameDec
-	CryptoPP::CTR_Mode<CryptoPP::AES>::Encryption frameDec;	///< Decoder for egress plaintext.
+	void updateMAC(RLPXMAC& _mac, bytesConstRef _seed = {});
 
-	CryptoPP::SecByteBlock macEncKey;						/// Key for m_macEnd
-	CryptoPP::ECB_Mode<CryptoPP::AES>::Encryption macEnc;	/// One-way coder used by updateMAC for ingress and egress MAC updates.
+	std::unique_ptr<RLPXAES> frameEnc;	///< Encoder for egress plaintext.
+	std::unique_ptr<RLPXAES> frameDec;	///< Decoder for ingress ciphertext.
+	std::unique_ptr<RLPXAES> macEnc;	///< One-way coder used by updateMAC for ingress and egress MAC updates.
 
-	CryptoPP::Keccak_256 egressMac;		///< State of MAC for egress ciphertext.
-	CryptoPP::Keccak_256 ingressMac;	///< State of MAC for ingress ciphertext.
-
-private:
-	Mutex x_macEnc;  ///< Mutex.
+	RLPXMAC egressMac;		///< State of MAC for egress ciphertext.
+	RLPXMAC ingressMac;		///< State of MAC for ingress ciphertext.
 };
 }
 }
@@ -115,20 +103,13 @@ void RLPXFrameCoder::setup(bool _originated, h512 const& _remoteEphemeral, h256
 	
 	// aes-secret = sha3(ecdhe-shared-secret || shared-secret)
 	sha3(keyMaterial, outRef); // output aes-secret
-	assert(m_impl->frameEncKey.empty() && "ECDHE aggreed before!");
-	m_impl->frameEncKey.resize(h256::size);
-	memcpy(m_impl->frameEncKey.data(), outRef.data(), h256::size);
-	m_impl->frameDecKey.resize(h256::size);
-	memcpy(m_impl->frameDecKey.data(), outRef.data(), h256::size);
-	h128 iv;
-	m_impl->frameEnc.SetKeyWithIV(m_impl->frameEncKey, h256::size, iv.data());
-	m_impl->frameDec.SetKeyWithIV(m_impl->frameDecKey, h256::size, iv.data());
+	assert(!m_impl->frameEnc && "ECDHE aggreed before!");
+	m_impl->frameEnc.reset(new RLPXAES(outRef));
+	m_impl->frameDec.reset(new RLPXAES(outRef));
 
 	// mac-secret = sha3(ecdhe-shared-secret || aes-secret)
 	sha3(keyMaterial, outRef); // output mac-secret
-	m_impl->macEncKey.resize(h256::size);
-	memcpy(m_impl->macEncKey.data(), outRef.data(), h256::size);
-	m_impl->macEnc.SetKey(m_impl->macEncKey, h256::size);
+	m_impl->macEnc.reset(new RLPXAES(outRef));
 
 	// Initiator egress-mac: sha3(mac-secret^recipient-nonce || auth-sent-init)
 	//           ingress-mac: sha3(mac-secret^initiator-nonce || auth-recvd-ack)
@@ -140,7 +121,7 @@ void RLPXFrameCoder::setup(bool _originated, h512 const& _remoteEphemeral, h256
 	keyMaterialBytes.resize(h256::size + egressCipher.size());
 	keyMaterial.retarget(keyMaterialBytes.data(), keyMaterialBytes.size());
 	egressCipher.copyTo(keyMaterial.cropped(h256::size, egressCipher.size()));
-	m_impl->egressMac.Update(keyMaterial.data(), keyMaterial.size());
+	m_impl->egressMac.update(keyMaterial);
 
 	// recover mac-secret by re-xoring remoteNonce
 	(*(h256*)keyMaterial.data() ^ _remoteNonce ^ _nonce).ref().copyTo(keyMaterial);
@@ -148,7 +129,7 @@ void RLPXFrameCoder::setup(bool _originated, h512 const& _remoteEphemeral, h256
 	keyMaterialBytes.resize(h256::size + ingressCipher.size());
 	keyMaterial.retarget(keyMaterialBytes.data(), keyMaterialBytes.size());
 	ingressCipher.copyTo(keyMaterial.cropped(h256::size, ingressCipher.size()));
-	m_impl->ingressMac.Update(keyMaterial.data(), keyMaterial.size());
+	m_impl->ingressMac.update(keyMaterial);
 }
 
 void RLPXFrameCoder::writeFrame(uint16_t _protocolType, bytesConstRef _payload, bytes& o_bytes)
@@ -181,21 +162,21 @@ void RLPXFrameCoder::writeFrame(uint16_t _protocolType, uint16_t _seqId, uint32_
 void RLPXFrameCoder::writeFrame(RLPStream const& _header, bytesConstRef _payload, bytes& o_bytes)
 {
 	// TODO: SECURITY check header values && header <= 16 bytes
-	bytes headerWithMac(h256::size);
-	bytesConstRef(&_header.out()).copyTo(bytesRef(&headerWithMac));
-	m_impl->frameEnc.ProcessData(headerWithMac.data(), headerWithMac.data(), 16);
-	updateEgressMACWithHeader(bytesConstRef(&headerWithMac).cropped(0, 16));
-	egressDigest().ref().copyTo(bytesRef(&headerWithMac).cropped(h128::size,h128::size));
-
+	// o_bytes is cleared before _payload is copied into it.
+	assert(_payload.data() != o_bytes.data() || _payload.empty());
 	auto padding = (16 - (_payload.size() % 16)) % 16;
-	o_bytes.swap(headerWithMac);
+	o_bytes.clear();
 	o_bytes.resize(32 + _payload.size() + padding + h128::size);
-	bytesRef packetRef(o_bytes.data() + 32, _payload.size());
-	m_impl->frameEnc.ProcessData(packetRef.data(), _payload.data(), _payload.size());
-	bytesRef paddingRef(o_bytes.data() + 32 + _payload.size(), padding);
-	if (padding)
-		m_impl->frameEnc.ProcessData(paddingRef.data(), paddingRef.data(), padding);
+	bytesRef headerWithMac(o_bytes.data(), h256::size);
+	bytesConstRef(&_header.out()).copyTo(headerWithMac);
+	m_impl->frameEnc->processCTR(headerWithMac.data(), headerWithMac.data(), 16);
+	updateEgressMACWithHeader(headerWithMac.cropped(0, 16));
+	egressDigest().ref().copyTo(headerWithMac.cropped(h128::size, h128::size));
+
+	// Payload and zero padding are encrypted in one go so the cipher sees whole blocks.
+	_payload.copyTo(bytesRef(o_bytes.data() + 32, _payload.size()));
 	bytesRef packetWithPaddingRef(o_bytes.data() + 32, _payload.size() + padding);
+	m_impl->frameEnc->processCTR(packetWithPaddingRef.data(), packetWithPaddingRef.data(), packetWithPaddingRef.size());
 	updateEgressMACWithFrame(packetWithPaddingRef);
 	bytesRef macRef(o_bytes.data() + 32 + _payload.size() + padding, h128::size);
 	egressDigest().ref().copyTo(macRef);
@@ -218,7 +199,7 @@ bool RLPXFrameCoder::authAndDecryptHeader(bytesRef io)
 	h128 expected = ingressDigest();
 	if (*(h128*)macRef.data() != expected)
 		return false;
-	m_impl->frameDec.ProcessData(io.data(), io.data(), h128::size);
+	m_impl->frameDec->processCTR(io.data(), io.data(), h128::size);
 	return true;
 }
 
@@ -229,24 +210,18 @@ bool RLPXFrameCoder::authAndDecryptFrame(bytesRef io)
 	bytesConstRef frameMac(io.data() + io.size() - h128::size, h128::size);
 	if (*(h128*)frameMac.data() != ingressDigest())
 		return false;
-	m_impl->frameDec.ProcessData(io.data(), io.data(), io.size() - h128::size);
+	m_impl->frameDec->processCTR(io.data(), io.data(), io.size() - h128::size);
 	return true;
 }
 
 h128 RLPXFrameCoder::egressDigest()
 {
-	CryptoPP::Keccak_256 h(m_impl->egressMac);
-	h128 digest;
-	h.TruncatedFinal(digest.data(), h128::size);
-	return digest;
+	return m_impl->egressMac.digest();
 }
 
 h128 RLPXFrameCoder::ingressDigest()
 {
-	CryptoPP::Keccak_256 h(m_impl->ingressMac);
-	h128 digest;
-	h.TruncatedFinal(digest.data(), h128::size);
-	return digest;
+	return m_impl->ingressMac.digest();
 }
 
 void RLPXFrameCoder::updateEgressMACWithHeader(bytesConstRef _headerCipher)
@@ -256,7 +231,7 @@ void RLPXFrameCoder::updateEgressMACWithHeader(bytesConstRef _headerCipher)
 
 void RLPXFrameCoder::updateEgressMACWithFrame(bytesConstRef _cipher)
 {
-	m_impl->egressMac.Update(_cipher.data(), _cipher.size());
+	m_impl->egressMac.update(_cipher);
 	m_impl->updateMAC(m_impl->egressMac);
 }
 
@@ -267,29 +242,23 @@ void RLPXFrameCoder::updateIngressMACWithHeader(bytesConstRef _headerCipher)
 
 void RLPXFrameCoder::updateIngressMACWithFrame(bytesConstRef _cipher)
 {
-	m_impl->ingressMac.Update(_cipher.data(), _cipher.size());
+	m_impl->ingressMac.update(_cipher);
 	m_impl->updateMAC(m_impl->ingressMac);
 }
 
-void RLPXFrameCoderImpl::updateMAC(CryptoPP::Keccak_256& _mac, bytesConstRef _seed)
+void RLPXFrameCoderImpl::updateMAC(RLPXMAC& _mac, bytesConstRef _seed)
 {
 	if (_seed.size() && _seed.size() != h128::size)
 		asserts(false);
 
-	CryptoPP::Keccak_256 prevDigest(_mac);
-	h128 encDigest(h128::size);
-	prevDigest.TruncatedFinal(encDigest.data(), h128::size);
-	h128 prevDigestOut = encDigest;
-
-	{
-		Guard l(x_macEnc);
-		macEnc.ProcessData(encDigest.data(), encDigest.data(), 16);
-	}
+	h128 const prevDigest = _mac.digest();
+	h128 encDigest = prevDigest;
+	macEnc->encryptBlock(encDigest);
 	if (_seed.size())
 		encDigest ^= *(h128*)_seed.data();
 	else
-		encDigest ^= *(h128*)prevDigestOut.data();
+		encDigest ^= prevDigest;
 
 	// update mac for final digest
-	_mac.Update(encDigest.data(), h128::size);
+	_mac.update(encDigest.ref());
 }
@@ -84,7 +84,8 @@ public:
 	/// Establish shared secrets and setup AES and MAC states.
 	void setup(bool _originated, h512 const& _remoteEphemeral, h256 const& _remoteNonce, KeyPair const& _ecdheLocal, h256 const& _nonce, bytesConstRef _ackCipher, bytesConstRef _authCipher);
 	
-	/// Write single-frame payload of packet(s).
+	/// Write single-frame payload of packet(s). In all writeFrame() overloads and in
+	/// writeSingleFramePacket(), the payload must not point into o_bytes.
 	void writeFrame(uint16_t _protocolType, bytesConstRef _payload, bytes& o_bytes);
 
 	/// Write continuation frame of segmented payload.
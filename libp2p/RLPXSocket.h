@@ -39,16 +39,20 @@ namespace p2p
 class RLPXSocket: public std::enable_shared_from_this<RLPXSocket>
 {
 public:
-	RLPXSocket(ba::io_service& _ioService): m_socket(_ioService) {}
+	RLPXSocket(ba::io_service& _ioService): m_socket(_ioService), m_strand(_ioService) {}
 	~RLPXSocket() { close(); }
 	
 	bool isConnected() const { return m_socket.is_open(); }
 	void close() { try { boost::system::error_code ec; m_socket.shutdown(bi::tcp::socket::shutdown_both, ec); if (m_socket.is_open()) m_socket.close(); } catch (...){} }
 	bi::tcp::endpoint remoteEndpoint() { boost::system::error_code ec; return m_socket.remote_endpoint(ec); }
 	bi::tcp::socket& ref() { return m_socket; }
+	/// Handlers of the connection are run through this, so that they stay in order when the
+	/// network runs on several threads.
+	ba::io_service::strand& strand() { return m_strand; }
 	
 protected:
 	bi::tcp::socket m_socket;
+	ba::io_service::strand m_strand;
 };
 
 }
@@ -31,44 +31,52 @@ using namespace dev::crypto;
 void RLPXHandshake::writeAuth()
 {
     LOG(m_logger) << "p2p.connect.egress sending auth to " << m_socket->remoteEndpoint();
-    m_auth.resize(Signature::size + h256::size + Public::size + h256::size + 1);
-    bytesRef sig(&m_auth[0], Signature::size);
-    bytesRef hepubk(&m_auth[Signature::size], h256::size);
-    bytesRef pubk(&m_auth[Signature::size + h256::size], Public::size);
-    bytesRef nonce(&m_auth[Signature::size + h256::size + Public::size], h256::size);
-    
-    // E(remote-pubk, S(ecdhe-random, ecdh-shared-secret^nonce) || H(ecdhe-random-pubk) || pubk || nonce || 0x0)
-    Secret staticShared;
-    crypto::ecdh::agree(m_host->m_alias.secret(), m_remote, staticShared);
-    sign(m_ecdheLocal.secret(), staticShared.makeInsecure() ^ m_nonce).ref().copyTo(sig);
-    sha3(m_ecdheLocal.pub().ref(), hepubk);
-    m_host->m_alias.pub().ref().copyTo(pubk);
-    m_nonce.ref().copyTo(nonce);
-    m_auth[m_auth.size() - 1] = 0x0;
-    encryptECIES(m_remote, &m_auth, m_authCipher);
+    offload([this]() {
+        m_ecdheLocal = KeyPair::create();
+        m_auth.resize(Signature::size + h256::size + Public::size + h256::size + 1);
+        bytesRef sig(&m_auth[0], Signature::size);
+        bytesRef hepubk(&m_auth[Signature::size], h256::size);
+        bytesRef pubk(&m_auth[Signature::size + h256::size], Public::size);
+        bytesRef nonce(&m_auth[Signature::size + h256::size + Public::size], h256::size);
 
-    auto self(shared_from_this());
-    ba::async_write(m_socket->ref(), ba::buffer(m_authCipher), [this, self](boost::system::error_code ec, std::size_t)
-    {
-        transition(ec);
+        // E(remote-pubk, S(ecdhe-random, ecdh-shared-secret^nonce) || H(ecdhe-random-pubk) || pubk || nonce || 0x0)
+        Secret staticShared;
+        crypto::ecdh::agree(m_host->m_alias.secret(), m_remote, staticShared);
+        sign(m_ecdheLocal.secret(), staticShared.makeInsecure() ^ m_nonce).ref().copyTo(sig);
+        sha3(m_ecdheLocal.pub().ref(), hepubk);
+        m_host->m_alias.pub().ref().copyTo(pubk);
+        m_nonce.ref().copyTo(nonce);
+        m_auth[m_auth.size() - 1] = 0x0;
+        encryptECIES(m_remote, &m_auth, m_authCipher);
+        return true;
+    }, [this](bool) {
+        auto self(shared_from_this());
+        ba::async_write(m_socket->ref(), ba::buffer(m_authCipher), m_socket->strand().wrap([this, self](boost::system::error_code ec, std::size_t)
+        {
+            transition(ec);
+        }));
     });
 }
 
 void RLPXHandshake::writeAck()
 {
     LOG(m_logger) << "p2p.connect.ingress sending ack to " << m_socket->remoteEndpoint();
-    m_ack.resize(Public::size + h256::size + 1);
-    bytesRef epubk(&m_ack[0], Public::size);
-    bytesRef nonce(&m_ack[Public::size], h256::size);
-    m_ecdheLocal.pub().ref().copyTo(epubk);
-    m_nonce.ref().copyTo(nonce);
-    m_ack[m_ack.size() - 1] = 0x0;
-    encryptECIES(m_remote, &m_ack, m_ackCipher);
-
-    auto self(shared_from_this());
-    ba::async_write(m_socket->ref(), ba::buffer(m_ackCipher), [this, self](boost::system::error_code ec, std::size_t)
-    {
-        transition(ec);
+    offload([this]() {
+        m_ecdheLocal = KeyPair::create();
+        m_ack.resize(Public::size + h256::size + 1);
+        bytesRef epubk(&m_ack[0], Public::size);
+        bytesRef nonce(&m_ack[Public::size], h256::size);
+        m_ecdheLocal.pub().ref().copyTo(epubk);
+        m_nonce.ref().copyTo(nonce);
+        m_ack[m_ack.size() - 1] = 0x0;
+        encryptECIES(m_remote, &m_ack, m_ackCipher);
+        return true;
+    }, [this](bool) {
+        auto self(shared_from_this());
+        ba::async_write(m_socket->ref(), ba::buffer(m_ackCipher), m_socket->strand().wrap([this, self](boost::system::error_code ec, std::size_t)
+        {
+            transition(ec);
+        }));
     });
 }
 
@@ -76,24 +84,28 @@ void RLPXHandshake::writeAckEIP8()
 {
     LOG(m_logger) << "p2p.connect.ingress sending EIP-8 ack to " << m_socket->remoteEndpoint();
 
-    RLPStream rlp;
-    rlp.appendList(3)
-        << m_ecdheLocal.pub()
-        << m_nonce
-        << c_rlpxVersion;
-    m_ack = rlp.out();
     int padAmount(rand()%100 + 100);
-    m_ack.resize(m_ack.size() + padAmount, 0);
+    offload([this, padAmount]() {
+        m_ecdheLocal = KeyPair::create();
+        RLPStream rlp;
+        rlp.appendList(3)
+            << m_ecdheLocal.pub()
+            << m_nonce
+            << c_rlpxVersion;
+        m_ack = rlp.out();
+        m_ack.resize(m_ack.size() + padAmount, 0);
 
-    bytes prefix(2);
-    toBigEndian<uint16_t>(m_ack.size() + c_eciesOverhead, prefix);
-    encryptECIES(m_remote, bytesConstRef(&prefix), &m_ack, m_ackCipher);
-    m_ackCipher.insert(m_ackCipher.begin(), prefix.begin(), prefix.end());
-    
-    auto self(shared_from_this());
-    ba::async_write(m_socket->ref(), ba::buffer(m_ackCipher), [this, self](boost::system::error_code ec, std::size_t)
-    {
-        transition(ec);
+        bytes prefix(2);
+        toBigEndian<uint16_t>(m_ack.size() + c_eciesOverhead, prefix);
+        encryptECIES(m_remote, bytesConstRef(&prefix), &m_ack, m_ackCipher);
+        m_ackCipher.insert(m_ackCipher.begin(), prefix.begin(), prefix.end());
+        return true;
+    }, [this](bool) {
+        auto self(shared_from_this());
+        ba::async_write(m_socket->ref(), ba::buffer(m_ackCipher), m_socket->strand().wrap([this, self](boost::system::error_code ec, std::size_t)
+        {
+            transition(ec);
+        }));
     });
 }
 
@@ -105,6 +117,10 @@ void RLPXHandshake::setAuthValues(Signature const& _sig, Public const& _remotePu
     Secret sharedSecret;
     crypto::ecdh::agree(m_host->m_alias.secret(), _remotePubk, sharedSecret);
     m_ecdheRemote = recover(_sig, sharedSecret.makeInsecure() ^ _remoteNonce);
+
+    // Trusted peers go ahead of other inbound ones for the rest of the handshake.
+    if (m_host->isRequiredPeer(m_remote))
+        m_priority = HandshakeWorkers::High;
 }
 
 void RLPXHandshake::readAuth()
@@ -112,22 +128,29 @@ void RLPXHandshake::readAuth()
     LOG(m_logger) << "p2p.connect.ingress receiving auth from " << m_socket->remoteEndpoint();
     m_authCipher.resize(307);
     auto self(shared_from_this());
-    ba::async_read(m_socket->ref(), ba::buffer(m_authCipher, 307), [this, self](boost::system::error_code ec, std::size_t)
+    ba::async_read(m_socket->ref(), ba::buffer(m_authCipher, 307), m_socket->strand().wrap([this, self](boost::system::error_code ec, std::size_t)
     {
         if (ec)
-            transition(ec);
-        else if (decryptECIES(m_host->m_alias.secret(), bytesConstRef(&m_authCipher), m_auth))
         {
+            transition(ec);
+            return;
+        }
+        offload([this]() {
+            if (!decryptECIES(m_host->m_alias.secret(), bytesConstRef(&m_authCipher), m_auth))
+                return false;
             bytesConstRef data(&m_auth);
             Signature sig(data.cropped(0, Signature::size));
             Public pubk(data.cropped(Signature::size + h256::size, Public::size));
             h256 nonce(data.cropped(Signature::size + h256::size + Public::size, h256::size));
             setAuthValues(sig, pubk, nonce, 4);
-            transition();
-        }
-        else
-            readAuthEIP8();
-    });
+            return true;
+        }, [this](bool _decrypted) {
+            if (_decrypted)
+                transition();
+            else
+                readAuthEIP8();
+        });
+    }));
 }
 
 void RLPXHandshake::readAuthEIP8()
@@ -139,13 +162,17 @@ void RLPXHandshake::readAuthEIP8()
     m_authCipher.resize((size_t)size + 2);
     auto rest = ba::buffer(ba::buffer(m_authCipher) + 307);
     auto self(shared_from_this());
-    ba::async_read(m_socket->ref(), rest, [this, self](boost::system::error_code ec, std::size_t)
+    ba::async_read(m_socket->ref(), rest, m_socket->strand().wrap([this, self](boost::system::error_code ec, std::size_t)
     {
-        bytesConstRef ct(&m_authCipher);
         if (ec)
-            transition(ec);
-        else if (decryptECIES(m_host->m_alias.secret(), ct.cropped(0, 2), ct.cropped(2), m_auth))
         {
+            transition(ec);
+            return;
+        }
+        offload([this]() {
+            bytesConstRef ct(&m_authCipher);
+            if (!decryptECIES(m_host->m_alias.secret(), ct.cropped(0, 2), ct.cropped(2), m_auth))
+                return false;
             RLP rlp(m_auth, RLP::ThrowOnFail | RLP::FailIfTooSmall);
             setAuthValues(
                 rlp[0].toHash<Signature>(),
@@ -153,17 +180,19 @@ void RLPXHandshake::readAuthEIP8()
                 rlp[2].toHash<h256>(),
                 rlp[3].toInt<uint64_t>()
             );
-            m_nextState = AckAuthEIP8;
-            transition();
-        }
-        else
-        {
-            LOG(m_logger) << "p2p.connect.ingress auth decrypt failed for "
-                          << m_socket->remoteEndpoint();
-            m_nextState = Error;
+            return true;
+        }, [this](bool _decrypted) {
+            if (_decrypted)
+                m_nextState = AckAuthEIP8;
+            else
+            {
+                LOG(m_logger) << "p2p.connect.ingress auth decrypt failed for "
+                              << m_socket->remoteEndpoint();
+                m_nextState = Error;
+            }
             transition();
-        }
-    });
+        });
+    }));
 }
 
 void RLPXHandshake::readAck()
@@ -171,20 +200,27 @@ void RLPXHandshake::readAck()
     LOG(m_logger) << "p2p.connect.egress receiving ack from " << m_socket->remoteEndpoint();
     m_ackCipher.resize(210);
     auto self(shared_from_this());
-    ba::async_read(m_socket->ref(), ba::buffer(m_ackCipher, 210), [this, self](boost::system::error_code ec, std::size_t)
+    ba::async_read(m_socket->ref(), ba::buffer(m_ackCipher, 210), m_socket->strand().wrap([this, self](boost::system::error_code ec, std::size_t)
     {
         if (ec)
-            transition(ec);
-        else if (decryptECIES(m_host->m_alias.secret(), bytesConstRef(&m_ackCipher), m_ack))
         {
+            transition(ec);
+            return;
+        }
+        offload([this]() {
+            if (!decryptECIES(m_host->m_alias.secret(), bytesConstRef(&m_ackCipher), m_ack))
+                return false;
             bytesConstRef(&m_ack).cropped(0, Public::size).copyTo(m_ecdheRemote.ref());
             bytesConstRef(&m_ack).cropped(Public::size, h256::size).copyTo(m_remoteNonce.ref());
             m_remoteVersion = 4;
-            transition();
-        }
-        else
-            readAckEIP8();
-    });
+            return true;
+        }, [this](bool _decrypted) {
+            if (_decrypted)
+                transition();
+            else
+                readAckEIP8();
+        });
+    }));
 }
 
 void RLPXHandshake::readAckEIP8()
@@ -196,27 +232,73 @@ void RLPXHandshake::readAckEIP8()
     m_ackCipher.resize((size_t)size + 2);
     auto rest = ba::buffer(ba::buffer(m_ackCipher) + 210);
     auto self(shared_from_this());
-    ba::async_read(m_socket->ref(), rest, [this, self](boost::system::error_code ec, std::size_t)
+    ba::async_read(m_socket->ref(), rest, m_socket->strand().wrap([this, self](boost::system::error_code ec, std::size_t)
     {
-        bytesConstRef ct(&m_ackCipher);
         if (ec)
-            transition(ec);
-        else if (decryptECIES(m_host->m_alias.secret(), ct.cropped(0, 2), ct.cropped(2), m_ack))
         {
+            transition(ec);
+            return;
+        }
+        offload([this]() {
+            bytesConstRef ct(&m_ackCipher);
+            if (!decryptECIES(m_host->m_alias.secret(), ct.cropped(0, 2), ct.cropped(2), m_ack))
+                return false;
             RLP rlp(m_ack, RLP::ThrowOnFail | RLP::FailIfTooSmall);
             m_ecdheRemote = rlp[0].toHash<Public>();
             m_remoteNonce = rlp[1].toHash<h256>();
             m_remoteVersion = rlp[2].toInt<uint64_t>();
+            return true;
+        }, [this](bool _decrypted) {
+            if (!_decrypted)
+            {
+                LOG(m_logger) << "p2p.connect.egress ack decrypt failed for "
+                              << m_socket->remoteEndpoint();
+                m_nextState = Error;
+            }
             transition();
-        }
-        else
+        });
+    }));
+}
+
+void RLPXHandshake::offload(function<bool()> _crypto, function<void(bool)> _then)
+{
+    auto self(shared_from_this());
+    // Keeps the io_service running while the job is away from it.
+    auto work = make_shared<ba::io_service::work>(m_socket->ref().get_io_service());
+    auto job = [this, self, work, _crypto, _then]() {
+        bool ok = false;
+        bool failed = false;
+        if (!m_cancel)
         {
-            LOG(m_logger) << "p2p.connect.egress ack decrypt failed for "
-                          << m_socket->remoteEndpoint();
-            m_nextState = Error;
-            transition();
+            try
+            {
+                ok = _crypto();
+            }
+            catch (std::exception const& _e)
+            {
+                cnetdetails << "Handshake crypto failed: " << _e.what();
+                failed = true;
+            }
         }
-    });
+        m_socket->strand().post([this, self, _then, ok, failed]() {
+            if (m_cancel)
+                return;
+            if (failed)
+            {
+                m_nextState = Error;
+                transition();
+            }
+            else
+                _then(ok);
+        });
+    };
+
+    if (!m_host->m_handshakeWorkers.enqueue(m_priority, job))
+    {
+        LOG(m_logger) << "Handshake queue full, dropping " << m_socket->remoteEndpoint();
+        m_nextState = Error;
+        transition();
+    }
 }
 
 void RLPXHandshake::cancel()
@@ -252,7 +334,7 @@ void RLPXHandshake::transition(boost::system::error_code _ech)
     auto self(shared_from_this());
     assert(m_nextState != StartSession);
     m_idleTimer.expires_from_now(c_timeout);
-    m_idleTimer.async_wait([this, self](boost::system::error_code const& _ec)
+    m_idleTimer.async_wait(m_socket->strand().wrap([this, self](boost::system::error_code const& _ec)
     {
         if (!_ec)
         {
@@ -261,7 +343,7 @@ void RLPXHandshake::transition(boost::system::error_code _ech)
                               << " (Handshake Timeout)";
             cancel();
         }
-    });
+    }));
     
     if (m_nextState == New)
     {
@@ -293,24 +375,33 @@ void RLPXHandshake::transition(boost::system::error_code _ech)
         LOG(m_logger) << (m_originated ? "p2p.connect.egress" : "p2p.connect.ingress")
                       << " sending capabilities handshake";
 
-        /// This pointer will be freed if there is an error otherwise
-        /// it will be passed to Host which will take ownership.
-        m_io.reset(new RLPXFrameCoder(*this));
+        // The frame coder's key agreement runs on a worker; cancel() may reset m_io meanwhile.
+        auto io = make_shared<unique_ptr<RLPXFrameCoder>>();
+        offload([this, io]() {
+            io->reset(new RLPXFrameCoder(*this));
+            return true;
+        }, [this, self, io](bool) {
+            /// This pointer will be freed if there is an error otherwise
+            /// it will be passed to Host which will take ownership.
+            m_io = move(*io);
 
-        RLPStream s;
-        s.append((unsigned)HelloPacket).appendList(5)
-            << dev::p2p::c_protocolVersion
-            << m_host->m_clientVersion
-            << m_host->caps()
-            << m_host->listenPort()
-            << m_host->id();
+            RLPStream s;
+            // Other clients ignore items past the fifth (EIP-8). The sixth says we take chunked packets.
+            s.append((unsigned)HelloPacket).appendList(6)
+                << m_host->m_protocolVersion
+                << m_host->m_clientVersion
+                << m_host->caps()
+                << m_host->listenPort()
+                << m_host->id()
+                << 1;
 
-        bytes packet;
-        s.swapOut(packet);
-        m_io->writeSingleFramePacket(&packet, m_handshakeOutBuffer);
-        ba::async_write(m_socket->ref(), ba::buffer(m_handshakeOutBuffer), [this, self](boost::system::error_code ec, std::size_t)
-        {
-            transition(ec);
+            bytes packet;
+            s.swapOut(packet);
+            m_io->writeSingleFramePacket(&packet, m_handshakeOutBuffer);
+            ba::async_write(m_socket->ref(), ba::buffer(m_handshakeOutBuffer), m_socket->strand().wrap([this, self](boost::system::error_code ec, std::size_t)
+            {
+                transition(ec);
+            }));
         });
     }
     else if (m_nextState == ReadHello)
@@ -322,7 +413,7 @@ void RLPXHandshake::transition(boost::system::error_code _ech)
         // read frame header
         unsigned const handshakeSize = 32;
         m_handshakeInBuffer.resize(handshakeSize);
-        ba::async_read(m_socket->ref(), boost::asio::buffer(m_handshakeInBuffer, handshakeSize), [this, self](boost::system::error_code ec, std::size_t)
+        ba::async_read(m_socket->ref(), boost::asio::buffer(m_handshakeInBuffer, handshakeSize), m_socket->strand().wrap([this, self](boost::system::error_code ec, std::size_t)
         {
             if (ec)
                 transition(ec);
@@ -367,7 +458,7 @@ void RLPXHandshake::transition(boost::system::error_code _ech)
                 
                 /// read padded frame and mac
                 m_handshakeInBuffer.resize(frameSize + ((16 - (frameSize % 16)) % 16) + h128::size);
-                ba::async_read(m_socket->ref(), boost::asio::buffer(m_handshakeInBuffer, m_handshakeInBuffer.size()), [this, self, headerRLP](boost::system::error_code ec, std::size_t)
+                ba::async_read(m_socket->ref(), boost::asio::buffer(m_handshakeInBuffer, m_handshakeInBuffer.size()), m_socket->strand().wrap([this, self, headerRLP](boost::system::error_code ec, std::size_t)
                 {
                     m_idleTimer.cancel();
                     
@@ -419,8 +510,8 @@ void RLPXHandshake::transition(boost::system::error_code _ech)
                             transition();
                         }
                     }
-                });
+                }));
             }
-        });
+        }));
     }
 }
@@ -22,10 +22,13 @@
 
 #pragma once
 
+#include <atomic>
+#include <functional>
 #include <memory>
 #include <libdevcrypto/Common.h>
 #include "RLPXSocket.h"
 #include "RLPXFrameCoder.h"
+#include "HandshakeWorkers.h"
 #include "Common.h"
 namespace ba = boost::asio;
 namespace bi = boost::asio::ip;
@@ -43,6 +46,8 @@ static const unsigned c_rlpxVersion = 4;
  *
  * @todo Implement StartSession transition via lambda which is passed to constructor.
  *
+ * Key agreement and ECIES run on the host's HandshakeWorkers; the rest runs on the socket's strand.
+ *
  * Thread Safety
  * Distinct Objects: Safe.
  * Shared objects: Unsafe.
@@ -53,10 +58,10 @@ class RLPXHandshake: public std::enable_shared_from_this<RLPXHandshake>
 
 public:
     /// Setup incoming connection.
-    RLPXHandshake(Host* _host, std::shared_ptr<RLPXSocket> const& _socket): m_host(_host), m_originated(false), m_socket(_socket), m_idleTimer(m_socket->ref().get_io_service()) { crypto::Nonce::get().ref().copyTo(m_nonce.ref()); }
+    RLPXHandshake(Host* _host, std::shared_ptr<RLPXSocket> const& _socket): m_host(_host), m_originated(false), m_priority(HandshakeWorkers::Normal), m_socket(_socket), m_idleTimer(m_socket->ref().get_io_service()) { crypto::Nonce::get().ref().copyTo(m_nonce.ref()); }
     
     /// Setup outbound connection.
-    RLPXHandshake(Host* _host, std::shared_ptr<RLPXSocket> const& _socket, NodeID _remote): m_host(_host), m_remote(_remote), m_originated(true), m_socket(_socket), m_idleTimer(m_socket->ref().get_io_service()) { crypto::Nonce::get().ref().copyTo(m_nonce.ref()); }
+    RLPXHandshake(Host* _host, std::shared_ptr<RLPXSocket> const& _socket, NodeID _remote): m_host(_host), m_remote(_remote), m_originated(true), m_priority(HandshakeWorkers::High), m_socket(_socket), m_idleTimer(m_socket->ref().get_io_service()) { crypto::Nonce::get().ref().copyTo(m_nonce.ref()); }
 
     virtual ~RLPXHandshake() = default;
 
@@ -106,6 +111,10 @@ protected:
     /// Closes connection and ends transitions.
     void error();
     
+    /// Runs @a _crypto on a handshake worker, then @a _then with its result on the strand. Errors out
+    /// if the workers have no room for it.
+    void offload(std::function<bool()> _crypto, std::function<void(bool)> _then);
+
     /// Performs transition for m_nextState.
     virtual void transition(boost::system::error_code _ech = boost::system::error_code());
 
@@ -113,13 +122,14 @@ protected:
     boost::posix_time::milliseconds const c_timeout = boost::posix_time::milliseconds(1800);
 
     State m_nextState = New;		///< Current or expected state of transition.
-    bool m_cancel = false;			///< Will be set to true if connection was canceled.
+    std::atomic<bool> m_cancel{false};	///< Will be set to true if connection was canceled.
     
     Host* m_host;					///< Host which provides m_alias, protocolVersion(), m_clientVersion, caps(), and TCP listenPort().
     
     /// Node id of remote host for socket.
     NodeID m_remote;				///< Public address of remote host.
     bool m_originated = false;		///< True if connection is outbound.
+    HandshakeWorkers::Priority m_priority;	///< High for outbound and trusted peers.
     
     /// Buffers for encoded and decoded handshake phases
     bytes m_auth;					///< Plaintext of egress or ingress Auth message.
@@ -129,7 +139,7 @@ protected:
     bytes m_handshakeOutBuffer;		///< Frame buffer for egress Hello packet.
     bytes m_handshakeInBuffer;		///< Frame buffer for ingress Hello packet.
     
-    KeyPair m_ecdheLocal = KeyPair::create();  ///< Ephemeral ECDH secret and agreement.
+    KeyPair m_ecdheLocal{Secret()};	///< Ephemeral ECDH secret and agreement, created on a worker by writeAuth() or writeAck().
     h256 m_nonce;					///< Nonce generated by this host for handshake.
     
     Public m_ecdheRemote;			///< Remote ephemeral public key.
@@ -26,6 +26,7 @@
 #include <libdevcore/Common.h>
 #include <libdevcore/CommonIO.h>
 #include <libdevcore/Exceptions.h>
+#include <snappy.h>
 #include "Host.h"
 #include "Capability.h"
 
@@ -33,11 +34,60 @@ using namespace std;
 using namespace dev;
 using namespace dev::p2p;
 
+namespace
+{
+/// Capabilities are asked to hold back once this much is waiting to be written to a peer.
+size_t const c_egressLimit = 4 * 1024 * 1024;
+
+/// A peer with this much waiting to be written to it is dropped.
+size_t const c_maxEgressBytes = 4 * c_egressLimit;
+
+/// A session keeps its ingress frame buffer between frames up to this size.
+size_t const c_keptFrameSize = 64 * 1024;
+
+/// Compressed packets may not decompress to more than this (EIP-706).
+size_t const c_maxUncompressedSize = 16 * 1024 * 1024;
+
+/// Packets larger than this are sent in chunks of this size to peers that take them.
+size_t const c_chunkSize = 16 * 1024;
+
+/// A write stops adding frames once it has this much, so urgent packets queued meanwhile don't
+/// wait behind more than this.
+size_t const c_writeBatchBytes = 64 * 1024;
+
+/// A write held back by upload limits is retried after this long.
+boost::posix_time::milliseconds const c_throttleRetry(25);
+
+/// Chunked ingress packets may add up to this much while they are being received.
+size_t const c_maxIngressChunkBytes = 2 * c_maxUncompressedSize;
+}
+
+void Session::compressPacket(bytes& io_packet)
+{
+    // Snappy can't compress in place, so the packet goes through a scratch buffer of this thread
+    // and back into its own storage, which fits it unless it doesn't compress. Egress packets
+    // don't come from the BufferPool, as they would keep its buffers while waiting in the queue.
+    thread_local bytes s_compressed;
+    s_compressed.resize(1 + snappy::MaxCompressedLength(io_packet.size() - 1));
+    s_compressed[0] = io_packet[0];
+    size_t size;
+    snappy::RawCompress(reinterpret_cast<char const*>(io_packet.data()) + 1, io_packet.size() - 1,
+        reinterpret_cast<char*>(s_compressed.data()) + 1, &size);
+    io_packet.assign(s_compressed.begin(), s_compressed.begin() + 1 + size);
+    if (s_compressed.capacity() > c_keptFrameSize)
+        bytes().swap(s_compressed);
+}
+
 Session::Session(Host* _h, unique_ptr<RLPXFrameCoder>&& _io, std::shared_ptr<RLPXSocket> const& _s,
     std::shared_ptr<Peer> const& _n, PeerSessionInfo _info)
   : m_server(_h),
     m_io(move(_io)),
     m_socket(_s),
+    m_uploadLimiter(_h->networkPreferences().peerUploadLimit),
+    m_throttleTimer(_s->ref().get_io_service()),
+    m_bufferPool(_h->bufferPool()),
+    m_snappy(min(_info.protocolVersion, _h->m_protocolVersion) >= c_snappyProtocolVersion),
+    m_multiplexing(_info.multiplexing),
     m_peer(_n),
     m_info(_info),
     m_ping(chrono::steady_clock::time_point::max()),
@@ -55,6 +105,7 @@ Session::~Session()
 
     cnetlog << "Closing peer session :-(";
     m_peer->m_lastConnected = m_peer->m_lastAttempted - chrono::seconds(1);
+    m_peer->m_lastSeen = chrono::system_clock::now();
 
     // Read-chain finished for one reason or another.
     for (auto& i : m_capabilities)
@@ -172,6 +223,9 @@ bool Session::interpret(PacketType _t, RLP const& _r)
         DEV_GUARDED(x_info)
         {
             m_info.lastPing = std::chrono::steady_clock::now() - m_ping;
+            unsigned const ms = chrono::duration_cast<chrono::milliseconds>(m_info.lastPing).count();
+            unsigned const smoothed = m_peer->m_latency;
+            m_peer->m_latency = smoothed ? (3 * smoothed + ms) / 4 : max(ms, 1u);
             cnetdetails << "Latency: "
                         << chrono::duration_cast<chrono::milliseconds>(m_info.lastPing).count()
                         << " ms";
@@ -205,6 +259,17 @@ void Session::sealAndSend(RLPStream& _s)
     send(move(b));
 }
 
+PeerSessionInfo Session::info() const
+{
+    Guard l(x_info);
+    PeerSessionInfo ret = m_info;
+    ret.sentBytes = m_sentBytes;
+    ret.sentWireBytes = m_sentWireBytes;
+    ret.receivedBytes = m_receivedBytes;
+    ret.receivedWireBytes = m_receivedWireBytes;
+    return ret;
+}
+
 bool Session::checkPacket(bytesConstRef _msg)
 {
     if (_msg[0] > 0x7f || _msg.size() < 2)
@@ -224,28 +289,163 @@ void Session::send(bytes&& _msg)
     if (!m_socket->ref().is_open())
         return;
 
+    m_sentBytes += _msg.size();
+    if (m_snappy && !_msg.empty())
+        compressPacket(_msg);
+    m_sentWireBytes += _msg.size();
+
     bool doWrite = false;
+    bool overflow = false;
     DEV_GUARDED(x_framing)
     {
-        m_writeQueue.push_back(std::move(_msg));
-        doWrite = (m_writeQueue.size() == 1);
+        auto const queue = writeQueueOf_WITH_LOCK(_msg.empty() ? 0 : _msg[0]);
+        overflow = m_egressBytes + _msg.size() > c_maxEgressBytes;
+        if (!overflow)
+        {
+            m_egressBytes += _msg.size();
+            m_writeQueues[queue].push_back(EgressPacket{std::move(_msg), 0, 0});
+            doWrite = m_writing.empty();
+        }
+    }
+
+    if (overflow)
+    {
+        // A peer that doesn't read what we send is of no use, and telling it so would only queue
+        // more.
+        cnetlog << "Egress queue overflow";
+        drop(UselessPeer);
+    }
+    else if (doWrite)
+    {
+        auto self(shared_from_this());
+        m_socket->strand().dispatch([this, self]() { write(); });
+    }
+}
+
+bool Session::isEgressFull() const
+{
+    Guard l(x_framing);
+    return m_egressBytes >= c_egressLimit;
+}
+
+pair<TrafficClass, unsigned> Session::writeQueueOf_WITH_LOCK(byte _packetType) const
+{
+    if (_packetType < UserPacket)
+        return {TrafficClass::Session, 0};
+    unsigned index = 1;
+    for (auto const& i: m_capabilities)
+    {
+        auto const& cap = *i.second;
+        if (_packetType >= cap.m_idOffset &&
+            _packetType - cap.m_idOffset < cap.hostCapability()->messageCount())
+            return {cap.hostCapability()->trafficClass(_packetType - cap.m_idOffset), index};
+        ++index;
+    }
+    return {TrafficClass::Session, 0};
+}
+
+size_t Session::frameNext_WITH_LOCK(deque<EgressPacket>& _queue)
+{
+    EgressPacket& p = _queue.front();
+    m_writing.emplace_back();
+    size_t size = p.data.size();
+    if (!m_multiplexing || size <= c_chunkSize)
+    {
+        m_io->writeSingleFramePacket(&p.data, m_writing.back());
+        p.written = size;
+    }
+    else
+    {
+        bytesConstRef chunk = bytesConstRef(&p.data).cropped(p.written, min(c_chunkSize, size - p.written));
+        if (!p.written)
+        {
+            // Sequence id 0 marks single-frame packets.
+            if (!++m_lastSequenceId)
+                ++m_lastSequenceId;
+            p.sequenceId = m_lastSequenceId;
+            m_io->writeFrame(0, p.sequenceId, uint32_t(size), chunk, m_writing.back());
+        }
+        else
+            m_io->writeFrame(0, p.sequenceId, chunk, m_writing.back());
+        p.written += chunk.size();
+        size = chunk.size();
     }
 
-    if (doWrite)
-        write();
+    m_writingBytes += size;
+    // An unfinished packet stays in front, so that the packets of a capability arrive in order;
+    // write() takes turns between the queues.
+    if (p.written == p.data.size())
+        _queue.pop_front();
+    return size;
 }
 
 void Session::write()
 {
-    bytes const* out = nullptr;
+    vector<ba::const_buffer> buffers;
+    bool retry = false;
     DEV_GUARDED(x_framing)
     {
-        m_io->writeSingleFramePacket(&m_writeQueue[0], m_writeQueue[0]);
-        out = &m_writeQueue[0];
+        if (!m_writing.empty())
+            return;
+
+        // While waiting for the throttle timer only the session's own packets go.
+        EgressLimiter& limiter = m_server->egressLimiter();
+        set<TrafficClass> held;
+        auto allowed = [&](TrafficClass _class) {
+            if (_class == TrafficClass::Session ||
+                (!m_throttled && m_uploadLimiter.ready() && limiter.ready(_class)))
+                return true;
+            held.insert(_class);
+            return false;
+        };
+        for (size_t batchBytes = 0; batchBytes < c_writeBatchBytes;)
+        {
+            auto level = find_if(m_writeQueues.begin(), m_writeQueues.end(),
+                [&](decltype(m_writeQueues)::value_type const& _q) {
+                    return !_q.second.empty() && allowed(_q.first.first);
+                });
+            if (level == m_writeQueues.end())
+                break;
+            TrafficClass const trafficClass = level->first.first;
+            for (auto q = level; q != m_writeQueues.end() && q->first.first == trafficClass &&
+                                 batchBytes < c_writeBatchBytes;
+                 ++q)
+                if (!q->second.empty())
+                {
+                    size_t const size = frameNext_WITH_LOCK(q->second);
+                    batchBytes += size;
+                    m_uploadLimiter.consume(size);
+                    limiter.noteSent(trafficClass, size);
+                }
+        }
+        buffers.reserve(m_writing.size());
+        for (auto const& frame: m_writing)
+            buffers.push_back(ba::buffer(frame));
+        if (!m_throttled)
+        {
+            for (auto c: held)
+                limiter.noteThrottled(c);
+            // Once the frames written now are out, write() runs again and sees to the rest.
+            retry = m_throttled = buffers.empty() && !held.empty();
+        }
     }
+    if (retry)
+    {
+        auto self(shared_from_this());
+        m_throttleTimer.expires_from_now(c_throttleRetry);
+        m_throttleTimer.async_wait(m_socket->strand().wrap([this, self](boost::system::error_code) {
+            DEV_GUARDED(x_framing)
+                m_throttled = false;
+            if (!m_dropped)
+                write();
+        }));
+    }
+    if (buffers.empty())
+        return;
+
     auto self(shared_from_this());
-    ba::async_write(m_socket->ref(), ba::buffer(*out),
-        [this, self](boost::system::error_code ec, std::size_t /*length*/) {
+    ba::async_write(m_socket->ref(), buffers,
+        m_socket->strand().wrap([this, self](boost::system::error_code ec, std::size_t /*length*/) {
             LOG_SCOPED_CONTEXT(m_logContext);
 
             // must check queue, as write callback can occur following dropped()
@@ -258,12 +458,12 @@ void Session::write()
 
             DEV_GUARDED(x_framing)
             {
-                m_writeQueue.pop_front();
-                if (m_writeQueue.empty())
-                    return;
+                m_egressBytes -= m_writingBytes;
+                m_writingBytes = 0;
+                m_writing.clear();
             }
             write();
-        });
+        }));
 }
 
 namespace
@@ -334,14 +534,13 @@ void Session::doRead()
         return;
 
     auto self(shared_from_this());
-    m_data.resize(h256::size);
-    ba::async_read(m_socket->ref(), boost::asio::buffer(m_data, h256::size),
-        [this, self](boost::system::error_code ec, std::size_t length) {
+    ba::async_read(m_socket->ref(), boost::asio::buffer(m_header),
+        m_socket->strand().wrap([this, self](boost::system::error_code ec, std::size_t length) {
             LOG_SCOPED_CONTEXT(m_logContext);
 
             if (!checkRead(h256::size, ec, length))
                 return;
-            else if (!m_io->authAndDecryptHeader(bytesRef(m_data.data(), length)))
+            else if (!m_io->authAndDecryptHeader(bytesRef(m_header.data(), length)))
             {
                 cnetlog << "header decrypt failed";
                 drop(BadProtocol);  // todo: better error
@@ -351,57 +550,152 @@ void Session::doRead()
             uint16_t hProtocolId;
             uint32_t hLength;
             uint8_t hPadding;
+            uint16_t hSequenceId;
+            uint32_t hTotalLength;
             try
             {
-                RLPXFrameInfo header(bytesConstRef(m_data.data(), length));
+                RLPXFrameInfo header(bytesConstRef(m_header.data(), length));
                 hProtocolId = header.protocolId;
                 hLength = header.length;
                 hPadding = header.padding;
+                hSequenceId = header.sequenceId;
+                hTotalLength = header.totalLength;
             }
             catch (std::exception const& _e)
             {
                 cnetlog << "Exception decoding frame header RLP: " << _e.what() << " "
-                        << bytesConstRef(m_data.data(), h128::size).cropped(3);
+                        << bytesConstRef(m_header.data(), h128::size).cropped(3);
                 drop(BadProtocol);
                 return;
             }
 
             /// read padded frame and mac
             auto tlen = hLength + hPadding + h128::size;
-            m_data.resize(tlen);
-            ba::async_read(m_socket->ref(), boost::asio::buffer(m_data, tlen),
-                [this, self, hLength, hProtocolId, tlen](
+            if (m_frame.capacity() < tlen)
+                m_frame = m_bufferPool->acquire(tlen);
+            ba::async_read(m_socket->ref(), boost::asio::buffer(m_frame.data(), tlen),
+                m_socket->strand().wrap([this, self, hLength, hProtocolId, hSequenceId,
+                                            hTotalLength, tlen](
                     boost::system::error_code ec, std::size_t length) {
                     LOG_SCOPED_CONTEXT(m_logContext);
 
                     if (!checkRead(tlen, ec, length))
                         return;
-                    else if (!m_io->authAndDecryptFrame(bytesRef(m_data.data(), tlen)))
+                    else if (!m_io->authAndDecryptFrame(m_frame.ref(tlen)))
                     {
                         cnetlog << "frame decrypt failed";
                         drop(BadProtocol);  // todo: better error
                         return;
                     }
 
-                    bytesConstRef frame(m_data.data(), hLength);
-                    if (!checkPacket(frame))
+                    bytesConstRef frame(m_frame.data(), hLength);
+                    if (!hSequenceId)
                     {
-                        cerr << "Received " << frame.size() << ": " << toHex(frame) << endl;
-                        cnetlog << "INVALID MESSAGE RECEIVED";
-                        disconnect(BadProtocol);
-                        return;
+                        if (!processPacket(hProtocolId, frame))
+                            return;
                     }
                     else
                     {
-                        auto packetType = (PacketType)RLP(frame.cropped(0, 1)).toInt<unsigned>();
-                        RLP r(frame.cropped(1));
-                        bool ok = readPacket(hProtocolId, packetType, r);
-                        if (!ok)
-                            cnetlog << "Couldn't interpret packet. " << RLP(r);
+                        IngressChunks packet;
+                        if (!addChunk(hSequenceId, hTotalLength, frame, packet))
+                        {
+                            cnetlog << "Invalid chunk of packet " << hSequenceId;
+                            disconnect(BadProtocol);
+                            return;
+                        }
+                        if (packet.size &&
+                            !processPacket(hProtocolId, bytesConstRef(packet.buffer.data(), packet.size)))
+                            return;
                     }
+                    // Hand large buffers back rather than keep them for every idle peer.
+                    if (m_frame.capacity() > c_keptFrameSize)
+                        m_frame = BufferPool::Buffer();
+                    if (m_packet.capacity() > c_keptFrameSize)
+                        m_packet = BufferPool::Buffer();
                     doRead();
-                });
-        });
+                }));
+        }));
+}
+
+bool Session::decompressPacket(
+    bytesConstRef& io_packet, BufferPool& _pool, BufferPool::Buffer& io_buffer)
+{
+    size_t size;
+    if (io_packet.empty() ||
+        !snappy::GetUncompressedLength(
+            reinterpret_cast<char const*>(io_packet.data()) + 1, io_packet.size() - 1, &size) ||
+        size > c_maxUncompressedSize)
+        return false;
+
+    if (io_buffer.capacity() < size + 1)
+        io_buffer = _pool.acquire(size + 1);
+    io_buffer.data()[0] = io_packet[0];
+    if (!snappy::RawUncompress(reinterpret_cast<char const*>(io_packet.data()) + 1,
+            io_packet.size() - 1, reinterpret_cast<char*>(io_buffer.data()) + 1))
+        return false;
+    io_packet = bytesConstRef(io_buffer.data(), size + 1);
+    return true;
+}
+
+bool Session::processPacket(uint16_t _protocolId, bytesConstRef _packet)
+{
+    // Capabilities get an RLP over the frame or m_packet, valid until they return.
+    m_receivedWireBytes += _packet.size();
+    if (m_snappy && !decompressPacket(_packet, *m_bufferPool, m_packet))
+    {
+        cnetlog << "Snappy decompression failed";
+        disconnect(BadProtocol);
+        return false;
+    }
+    m_receivedBytes += _packet.size();
+    if (!checkPacket(_packet))
+    {
+        cerr << "Received " << _packet.size() << ": " << toHex(_packet) << endl;
+        cnetlog << "INVALID MESSAGE RECEIVED";
+        disconnect(BadProtocol);
+        return false;
+    }
+
+    auto packetType = (PacketType)RLP(_packet.cropped(0, 1)).toInt<unsigned>();
+    if (packetType >= UserPacket)
+        m_peer->m_servedBytes += _packet.size();
+    RLP r(_packet.cropped(1));
+    bool ok = readPacket(_protocolId, packetType, r);
+    if (!ok)
+        cnetlog << "Couldn't interpret packet. " << RLP(r);
+    return true;
+}
+
+bool Session::addChunk(
+    uint16_t _sequenceId, uint32_t _totalLength, bytesConstRef _frame, IngressChunks& o_packet)
+{
+    auto it = m_ingressChunks.find(_sequenceId);
+    if (_totalLength)
+    {
+        // The first frame says how large the packet is.
+        if (it != m_ingressChunks.end() || _totalLength > c_maxUncompressedSize ||
+            m_ingressChunkBytes + _totalLength > c_maxIngressChunkBytes)
+            return false;
+        it = m_ingressChunks.emplace(_sequenceId, IngressChunks()).first;
+        it->second.buffer = m_bufferPool->acquire(_totalLength);
+        it->second.size = _totalLength;
+        m_ingressChunkBytes += _totalLength;
+    }
+    else if (it == m_ingressChunks.end())
+        return false;
+
+    IngressChunks& p = it->second;
+    if (_frame.size() > p.size - p.received)
+        return false;
+    _frame.copyTo(bytesRef(p.buffer.data() + p.received, _frame.size()));
+    p.received += _frame.size();
+    if (p.received == p.size)
+    {
+        m_ingressChunkBytes -= p.size;
+        o_packet = std::move(p);
+        m_ingressChunks.erase(it);
+    }
+    return true;
 }
 
 bool Session::checkRead(std::size_t _expected, boost::system::error_code _ec, std::size_t _length)
@@ -421,7 +715,7 @@ bool Session::checkRead(std::size_t _expected, boost::system::error_code _ec, st
     }
     else if (_length != _expected)
     {
-        // with static m_data-sized buffer this shouldn't happen unless there's a regression
+        // with frame-sized buffers this shouldn't happen unless there's a regression
         // sec recommends checking anyways (instead of assert)
         cnetlog << "Error reading - TCP read buffer length differs from expected frame size.";
         disconnect(UserReason);
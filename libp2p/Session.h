@@ -22,9 +22,11 @@
 
 #pragma once
 
+#include <atomic>
 #include <mutex>
 #include <array>
 #include <deque>
+#include <map>
 #include <set>
 #include <memory>
 #include <utility>
@@ -34,6 +36,8 @@
 #include <libdevcore/Guards.h>
 #include "RLPXFrameCoder.h"
 #include "RLPXSocket.h"
+#include "BufferPool.h"
+#include "BandwidthLimiter.h"
 #include "Common.h"
 
 namespace dev
@@ -61,6 +65,10 @@ public:
 
 	virtual void sealAndSend(RLPStream& _s) = 0;
 
+	/// @returns true while so much is waiting to be written to the peer that capabilities should
+	/// hold back whatever they can send later.
+	virtual bool isEgressFull() const = 0;
+
 	virtual int rating() const = 0;
 	virtual void addRating(int _r) = 0;
 
@@ -101,12 +109,14 @@ public:
 
 	void sealAndSend(RLPStream& _s) override;
 
+	bool isEgressFull() const override;
+
 	int rating() const override;
 	void addRating(int _r) override;
 
 	void addNote(std::string const& _k, std::string const& _v) override { Guard l(x_info); m_info.notes[_k] = _v; }
 
-	PeerSessionInfo info() const override { Guard l(x_info); return m_info; }
+	PeerSessionInfo info() const override;
 	std::chrono::steady_clock::time_point connectionTime() override { return m_connect; }
 
 	void registerCapability(CapDesc const& _desc, std::shared_ptr<Capability> _p) override;
@@ -119,6 +129,13 @@ public:
 
 	ReputationManager& repMan() override;
 
+	/// Compresses the payload of @a io_packet with Snappy, leaving its packet type in front.
+	static void compressPacket(bytes& io_packet);
+
+	/// Points @a io_packet at its decompressed copy in @a io_buffer, which is taken from @a _pool
+	/// if it is too small. @returns false if it doesn't decompress or would be too large.
+	static bool decompressPacket(bytesConstRef& io_packet, BufferPool& _pool, BufferPool::Buffer& io_buffer);
+
 private:
 	static RLPStream& prep(RLPStream& _s, PacketType _t, unsigned _args = 0);
 
@@ -133,7 +150,8 @@ private:
 	/// Check error code after reading and drop peer if error code.
 	bool checkRead(std::size_t _expected, boost::system::error_code _ec, std::size_t _length);
 
-	/// Perform a single round of the write operation. This could end up calling itself asynchronously.
+	/// Frames a batch of what is queued and writes it in one go. Once done, it calls itself
+	/// asynchronously if more is queued.
 	void write();
 
 	/// Deliver RLPX packet to Session or Capability for interpretation.
@@ -145,17 +163,68 @@ private:
 	/// @returns true iff the _msg forms a valid message for sending or receiving on the network.
 	static bool checkPacket(bytesConstRef _msg);
 
+	/// Decompresses, checks and delivers a whole ingress packet. @returns false if it disconnected.
+	bool processPacket(uint16_t _protocolId, bytesConstRef _packet);
+
+	/// A packet being received in several frames.
+	struct IngressChunks
+	{
+		BufferPool::Buffer buffer;
+		size_t size = 0;
+		size_t received = 0;
+	};
+
+	/// Adds a frame of a chunked packet, moving the packet to @a o_packet once it is complete.
+	/// @returns false if the frame doesn't fit any packet.
+	bool addChunk(uint16_t _sequenceId, uint32_t _totalLength, bytesConstRef _frame, IngressChunks& o_packet);
+
+	/// A packet waiting to be written, possibly in several frames.
+	struct EgressPacket
+	{
+		bytes data;
+		size_t written = 0;			///< Bytes of data already framed.
+		uint16_t sequenceId = 0;	///< Non-zero once it is being sent in chunks.
+	};
+
+	/// @returns the key of the queue of packets of type @a _packetType in m_writeQueues.
+	/// Needs x_framing, which also guards m_capabilities.
+	std::pair<TrafficClass, unsigned> writeQueueOf_WITH_LOCK(byte _packetType) const;
+
+	/// Frames the next packet, or its next chunk, of @a _queue into m_writing.
+	/// @returns the size of what was framed.
+	size_t frameNext_WITH_LOCK(std::deque<EgressPacket>& _queue);
+
 	Host* m_server;							///< The host that owns us. Never null.
 
 	std::unique_ptr<RLPXFrameCoder> m_io;	///< Transport over which packets are sent.
 	std::shared_ptr<RLPXSocket> m_socket;		///< Socket of peer's connection.
-	Mutex x_framing;						///< Mutex for the write queue.
-	std::deque<bytes> m_writeQueue;			///< The write queue.
-	std::vector<byte> m_data;			    ///< Buffer for ingress packet data.
-	bytes m_incoming;						///< Read buffer for ingress bytes.
+	mutable Mutex x_framing;				///< Mutex for the write queue.
+	/// Packets waiting to be written by traffic class, then capability. Queues of the first class
+	/// that has packets and is within its upload limits take turns to add a frame to each write.
+	std::map<std::pair<TrafficClass, unsigned>, std::deque<EgressPacket>> m_writeQueues;
+	TokenBucket m_uploadLimiter;			///< This session's upload limit.
+	bool m_throttled = false;				///< Whether m_throttleTimer will resume writing.
+	boost::asio::deadline_timer m_throttleTimer;	///< Retries writes held back by upload limits.
+	uint16_t m_lastSequenceId = 0;			///< Sequence id of the last packet sent in chunks.
+	std::vector<bytes> m_writing;			///< Frames being written.
+	size_t m_writingBytes = 0;				///< Size of the packets in m_writing before framing.
+	size_t m_egressBytes = 0;				///< Size of the packets queued or being written.
+	std::shared_ptr<BufferPool> m_bufferPool;	///< Where m_frame comes from.
+	std::array<byte, h256::size> m_header;	///< Buffer for ingress frame headers.
+	BufferPool::Buffer m_frame;				///< Buffer for ingress frames, decrypted in place.
+	BufferPool::Buffer m_packet;			///< Buffer for decompressed ingress packets.
+	std::map<uint16_t, IngressChunks> m_ingressChunks;	///< Chunked packets being received by sequence id.
+	size_t m_ingressChunkBytes = 0;			///< Total size of m_ingressChunks.
+
+	bool const m_snappy;					///< Whether packets are compressed both ways.
+	bool const m_multiplexing;				///< Whether large packets may be sent in chunks.
+	std::atomic<uint64_t> m_sentBytes{0};
+	std::atomic<uint64_t> m_sentWireBytes{0};
+	std::atomic<uint64_t> m_receivedBytes{0};
+	std::atomic<uint64_t> m_receivedWireBytes{0};
 
 	std::shared_ptr<Peer> m_peer;			///< The Peer object.
-	bool m_dropped = false;					///< If true, we've already divested ourselves of this peer. We're just waiting for the reads & writes to fail before the shared_ptr goes OOS and the destructor kicks in.
+	std::atomic<bool> m_dropped{false};					///< If true, we've already divested ourselves of this peer. We're just waiting for the reads & writes to fail before the shared_ptr goes OOS and the destructor kicks in.
 
 	mutable Mutex x_info;
 	PeerSessionInfo m_info;						///< Dynamic information about this peer.
@@ -49,6 +49,11 @@ Json::Value AdminNet::admin_net_nodeInfo(std::string const& _session)
 	ret["listenAddr"] = i.address + ":" + toString(i.port);
 	ret["id"] = i.id.hex();
 	ret["enode"] = i.enode();
+	p2p::NetworkPreferences const& prefs = m_network.networkPreferences();
+	ret["bandwidth"]["uploadLimit"] = prefs.uploadLimit;
+	ret["bandwidth"]["peerUploadLimit"] = prefs.peerUploadLimit;
+	for (p2p::TrafficClassInfo const& c: m_network.trafficClasses())
+		ret["bandwidth"]["classes"][p2p::trafficClassName(c.trafficClass)] = toJson(c);
 	return ret;
 }
 
@@ -69,6 +69,10 @@ Json::Value toJson(p2p::PeerSessionInfo const& _p)
     ret["id"] = _p.id.hex();
     ret["name"] = _p.clientVersion;
     ret["network"]["remoteAddress"] = _p.host + ":" + toString(_p.port);
+    ret["network"]["sentBytes"] = Json::UInt64(_p.sentBytes);
+    ret["network"]["sentWireBytes"] = Json::UInt64(_p.sentWireBytes);
+    ret["network"]["receivedBytes"] = Json::UInt64(_p.receivedBytes);
+    ret["network"]["receivedWireBytes"] = Json::UInt64(_p.receivedWireBytes);
     ret["lastPing"] = (int)chrono::duration_cast<chrono::milliseconds>(_p.lastPing).count();
     for (auto const& i: _p.notes)
         ret["notes"][i.first] = i.second;
@@ -77,6 +81,15 @@ Json::Value toJson(p2p::PeerSessionInfo const& _p)
     return ret;
 }
 
+Json::Value toJson(p2p::TrafficClassInfo const& _c)
+{
+    Json::Value ret;
+    ret["limit"] = _c.limit;
+    ret["sentBytes"] = Json::UInt64(_c.sentBytes);
+    ret["throttled"] = Json::UInt64(_c.throttled);
+    return ret;
+}
+
 }
 
 // ////////////////////////////////////////////////////////////////////////////////
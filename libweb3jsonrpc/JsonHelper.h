@@ -38,6 +38,7 @@ namespace p2p
 {
 
 Json::Value toJson(PeerSessionInfo const& _p);
+Json::Value toJson(TrafficClassInfo const& _c);
 
 }
 
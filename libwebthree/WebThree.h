@@ -102,6 +102,9 @@ public:
 
     /// Get enode string.
     virtual std::string enode() const = 0;
+
+    /// Get the upload limit and statistics of each traffic class.
+    virtual std::vector<p2p::TrafficClassInfo> trafficClasses() const = 0;
 };
 
 
@@ -196,6 +199,8 @@ public:
 
     std::string enode() const override { return m_net.enode(); }
 
+    std::vector<p2p::TrafficClassInfo> trafficClasses() const override { return m_net.trafficClasses(); }
+
     /// Gets the nodes.
     p2p::Peers nodes() const override { return m_net.getPeers(); }
 
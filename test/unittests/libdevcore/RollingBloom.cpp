@@ -0,0 +1,60 @@
+// Copyright 2018 cpp-ethereum Authors.
+// Licensed under the GNU General Public License v3. See the LICENSE file.
+
+#include <libdevcore/RollingBloom.h>
+#include <libdevcore/SHA3.h>
+#include <test/tools/libtesteth/TestOutputHelper.h>
+#include <boost/test/unit_test.hpp>
+
+using namespace std;
+using namespace dev;
+using namespace dev::test;
+
+namespace
+{
+h256 entry(unsigned _i)
+{
+    return sha3(toBigEndian(u256(_i)));
+}
+}  // namespace
+
+BOOST_FIXTURE_TEST_SUITE(RollingBloomTest, TestOutputHelperFixture)
+
+BOOST_AUTO_TEST_CASE(remembersRecentEntries)
+{
+    unsigned const capacity = 1000;
+    RollingBloom bloom(capacity);
+    for (unsigned i = 0; i < 5 * capacity; ++i)
+    {
+        bloom.insert(entry(i));
+        // The last capacity entries are never forgotten.
+        BOOST_REQUIRE(bloom.contains(entry(i)));
+        if (i >= capacity)
+            BOOST_REQUIRE(bloom.contains(entry(i - capacity + 1)));
+    }
+
+    unsigned falsePositives = 0;
+    for (unsigned i = 5 * capacity; i < 105 * capacity; ++i)
+        falsePositives += bloom.contains(entry(i));
+    BOOST_CHECK_LT(falsePositives, 100 * capacity / 200);
+}
+
+BOOST_AUTO_TEST_CASE(forgetsOldEntriesInFixedMemory)
+{
+    unsigned const capacity = 100;
+    RollingBloom bloom(capacity);
+    size_t const size = bloom.byteSize();
+    for (unsigned i = 0; i < 3 * capacity; ++i)
+        bloom.insert(entry(i));
+
+    unsigned remembered = 0;
+    for (unsigned i = 0; i < capacity; ++i)
+        remembered += bloom.contains(entry(i));
+    BOOST_CHECK_LT(remembered, capacity / 10);
+    BOOST_CHECK_EQUAL(bloom.byteSize(), size);
+
+    bloom.clear();
+    BOOST_CHECK(!bloom.contains(entry(3 * capacity - 1)));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -19,13 +19,18 @@
  */
 
 #include <libethashseal/Ethash.h>
+#include <libethashseal/EthashDataset.h>
+#include <libethashseal/EthashEpochManager.h>
 
 #include <test/tools/libtesteth/TestOutputHelper.h>
 
 #include <ethash/ethash.hpp>
 
+#include <boost/filesystem.hpp>
 #include <boost/test/unit_test.hpp>
 
+#include <fstream>
+
 using namespace dev;
 using namespace dev::eth;
 using namespace dev::test;
@@ -198,6 +203,37 @@ BOOST_AUTO_TEST_CASE(etashVerify)
     etash.verify(CheckEverything, header, {}, {});
 }
 
+BOOST_AUTO_TEST_CASE(ethashVerifySeals)
+{
+    BlockHeader header;
+    header.setParentHash(h256{"aff00eb20f8a48450b9ea5307e2737287854f357c9022280772e995cc22affd3"});
+    header.setAuthor(Address{"8888f1f195afa192cfee860698584c030f4c9db1"});
+    header.setRoots(h256{"fcfe9f2203bd98342867117fa3de299a09578371efd04fc9e76a46f7f1fda4bb"},
+        h256{"1751f772ba1fdb3ad31fa04c39144ea3b523f10604a5a09a19cb4c1d0b56992c"},
+        h256{"1dcc4de8dec75d7aab85b567b6ccd41ad312451b948a7413f0a142fd40d49347"},
+        h256{"1cd69d76c84ea914e746833b7a31d9bfe210f75929893f1da0748efaeb31fe27"});
+    header.setLogBloom({});
+    header.setDifficulty(h256{131072});
+    header.setNumber(1);
+    header.setGasLimit(3141562);
+    header.setGasUsed(55179);
+    header.setTimestamp(1507291743);
+    Ethash::setMixHash(
+        header, h256{"d8ada7ff7720ebc9700c170c046352b8ee6fb4630cf6a285489896daac7a40eb"});
+    Ethash::setNonce(header, Nonce{"81c3f9bfae230a8e"});
+
+    BlockHeader broken = header;
+    Ethash::setNonce(broken, Nonce{"71c3f9bfae230a8e"});
+
+    Ethash etash;
+    etash.verifySeals({header, header, header});
+    BOOST_CHECK_THROW(etash.verifySeals({header, broken, header}), InvalidBlockNonce);
+
+    // Both are block 1, so with sampling only the last one is checked.
+    etash.verifySeals({broken, header}, 2);
+    BOOST_CHECK_THROW(etash.verifySeals({header, broken}, 2), InvalidBlockNonce);
+}
+
 namespace
 {
 struct EthashTestCase
@@ -285,4 +321,154 @@ BOOST_AUTO_TEST_CASE(ethashEvalHeader)
     }
 }
 
+BOOST_AUTO_TEST_CASE(ethashEpochManagerSharesLightCache)
+{
+    auto& epochs = EthashEpochManager::get();
+    auto light = epochs.light(0);
+    BOOST_REQUIRE(light);
+    BOOST_CHECK_EQUAL(light->epoch_number, 0);
+    BOOST_CHECK_EQUAL(epochs.light(0).get(), light.get());
+
+    // Epoch 1 was generated in the background and is shared as well.
+    auto next = epochs.light(1);
+    BOOST_CHECK_EQUAL(next->epoch_number, 1);
+    BOOST_CHECK_EQUAL(epochs.light(1).get(), next.get());
+}
+
+BOOST_AUTO_TEST_CASE(ethashDatasetHash)
+{
+    EthashDataset dataset{EthashEpochManager::get().light(0)};
+    h256 const headerHash = sha3("header");
+    for (uint64_t nonce : {0ull, 1ull, 0x1234567890abcdefull})
+    {
+        ethash::result expected = ethash::hash(
+            ethash::get_global_epoch_context(0), toEthash(headerHash), nonce);
+        ethash::result result = dataset.hash(headerHash, nonce);
+
+        BOOST_CHECK_EQUAL(h256(result.final_hash.bytes, h256::ConstructFromPointer),
+            h256(expected.final_hash.bytes, h256::ConstructFromPointer));
+        BOOST_CHECK_EQUAL(h256(result.mix_hash.bytes, h256::ConstructFromPointer),
+            h256(expected.mix_hash.bytes, h256::ConstructFromPointer));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ethashDatasetSearch)
+{
+    EthashDataset dataset{EthashEpochManager::get().light(0)};
+    h256 const headerHash = sha3("header");
+
+    unsigned tried = 0;
+    auto solution = dataset.search(headerHash, ~h256(), 42, 10, &tried);
+    BOOST_REQUIRE(solution);
+    BOOST_CHECK_EQUAL(solution->nonce, (h64)(u64)42);
+    // Only the nonces hashed alongside the solution count.
+    BOOST_CHECK_LT(tried, 10u);
+
+    BOOST_CHECK(!dataset.search(headerHash, h256(), 42, 10, &tried));
+    BOOST_CHECK_EQUAL(tried, 10u);
+
+    // About half of the nonces meet this boundary; search() must agree with hash() on which.
+    h256 half = ~h256();
+    half[0] = 0x7f;
+    for (uint64_t nonce = 0; nonce < 16; ++nonce)
+    {
+        ethash::result r = dataset.hash(headerHash, nonce);
+        solution = dataset.search(headerHash, half, nonce, 1);
+        BOOST_CHECK_EQUAL(!!solution, h256(r.final_hash.bytes, h256::ConstructFromPointer) <= half);
+        if (solution)
+            BOOST_CHECK_EQUAL(solution->mixHash, h256(r.mix_hash.bytes, h256::ConstructFromPointer));
+    }
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+namespace
+{
+// The header of a dataset file is a page; its epoch is at offset 12 and its clean flag at 24.
+size_t const c_fileHeaderSize = 4096;
+
+void writeAt(boost::filesystem::path const& _file, size_t _offset, bytes const& _data)
+{
+    std::fstream f(_file.string(), std::ios::in | std::ios::out | std::ios::binary);
+    f.seekp(_offset);
+    f.write(reinterpret_cast<char const*>(_data.data()), _data.size());
+}
+
+bytes readAt(boost::filesystem::path const& _file, size_t _offset, size_t _size)
+{
+    bytes ret(_size);
+    std::ifstream f(_file.string(), std::ios::binary);
+    f.seekg(_offset);
+    f.read(reinterpret_cast<char*>(ret.data()), _size);
+    return ret;
+}
+}  // namespace
+
+BOOST_AUTO_TEST_CASE(ethashDatasetFile)
+{
+    auto const dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::create_directories(dir);
+    auto const file = dir / "full-0";
+    h256 const headerHash = sha3("header");
+    auto const light = EthashEpochManager::get().light(0);
+    ethash::result const expected = ethash::hash(*light, ethash::hash256_from_bytes(headerHash.data()), 7);
+    bytes const garbage(8, 0xff);
+
+    // Closed cleanly, the file is trusted as it is.
+    {
+        EthashDataset dataset{light, file};
+        dataset.hash(headerHash, 7);
+    }
+    BOOST_CHECK_EQUAL(boost::filesystem::file_size(file),
+        c_fileHeaderSize + light->full_dataset_num_items * 128);
+    BOOST_CHECK(readAt(file, 24, 1) == bytes{1});
+    writeAt(file, c_fileHeaderSize, garbage);
+    {
+        EthashDataset dataset{light, file};
+        BOOST_CHECK(readAt(file, 24, 1) == bytes{0});
+    }
+    BOOST_CHECK(readAt(file, c_fileHeaderSize, garbage.size()) == garbage);
+
+    // A file not closed cleanly, or of another epoch, is rebuilt.
+    writeAt(file, 24, bytes{0});
+    {
+        EthashDataset dataset{light, file};
+        ethash::result const r = dataset.hash(headerHash, 7);
+        BOOST_CHECK_EQUAL(h256(r.final_hash.bytes, h256::ConstructFromPointer),
+            h256(expected.final_hash.bytes, h256::ConstructFromPointer));
+    }
+    BOOST_CHECK(readAt(file, c_fileHeaderSize, garbage.size()) != garbage);
+    writeAt(file, c_fileHeaderSize, garbage);
+    writeAt(file, 12, bytes{1});
+    {
+        EthashDataset dataset{light, file};
+    }
+    BOOST_CHECK(readAt(file, c_fileHeaderSize, garbage.size()) != garbage);
+    BOOST_CHECK(readAt(file, 12, 1) == bytes{0});
+
+    boost::filesystem::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_CASE(ethashEpochManagerPrunesDatasetFiles)
+{
+    auto const dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    boost::filesystem::create_directories(dir);
+    for (auto const& name : {"full-0", "full-1", "full-5", "other"})
+        std::ofstream(boost::filesystem::path(dir / name).string());
+
+    auto& epochs = EthashEpochManager::get();
+    epochs.setDatasetDirectory(dir);
+    epochs.dataset(2);
+    epochs.setDatasetDirectory({});
+
+    // Only files of epochs before the previous one go.
+    BOOST_CHECK(!boost::filesystem::exists(dir / "full-0"));
+    BOOST_CHECK(boost::filesystem::exists(dir / "full-1"));
+    BOOST_CHECK(boost::filesystem::exists(dir / "full-2"));
+    BOOST_CHECK(boost::filesystem::exists(dir / "full-5"));
+    BOOST_CHECK(boost::filesystem::exists(dir / "other"));
+
+    boost::filesystem::remove_all(dir);
+}
+#endif
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -127,6 +127,51 @@ BOOST_AUTO_TEST_CASE(bCopyOperator)
 	BOOST_CHECK_EXCEPTION(block32.populateFromChain(blockchain, h256("0x0000000000000000000000000000000000000000000000000000000000000001")), BlockNotFound, is_critical);
 }
 
+BOOST_AUTO_TEST_CASE(bRebase)
+{
+	TestBlockChain testBlockchain(TestBlockChain::defaultGenesisBlock());
+	TestBlock const& genesisBlock = testBlockchain.testGenesis();
+	OverlayDB const& genesisDB = genesisBlock.state().db();
+	BlockChain const& blockchain = testBlockchain.getInterface();
+
+	TestBlock pending;
+	pending.addTransaction(TestTransaction::defaultTransaction(1));
+	pending.addTransaction(TestTransaction::defaultTransaction(2));
+
+	ZeroGasPricer gp;
+	Block block = blockchain.genesisBlock(genesisDB);
+	block.sync(blockchain);
+	block.sync(blockchain, pending.transactionQueue(), gp);
+	BOOST_REQUIRE_EQUAL(block.pending().size(), 2);
+
+	// An empty block leaves the accounts alone, so both transactions are carried over.
+	TestBlock empty;
+	empty.mine(testBlockchain);
+	testBlockchain.addBlock(empty);
+
+	BOOST_REQUIRE(block.rebase(blockchain));
+	BOOST_REQUIRE_EQUAL(block.pending().size(), 2);
+	BOOST_CHECK_EQUAL(block.info().parentHash(), blockchain.currentHash());
+
+	Block executed = blockchain.genesisBlock(genesisDB);
+	executed.sync(blockchain);
+	executed.sync(blockchain, pending.transactionQueue(), gp);
+	BOOST_REQUIRE_EQUAL(executed.pending().size(), 2);
+	BOOST_CHECK_EQUAL(block.rootHash(), executed.rootHash());
+	for (unsigned i = 0; i < 2; ++i)
+		BOOST_CHECK(block.receipt(i).rlp() == executed.receipt(i).rlp());
+
+	// A block that includes the first transaction changes the sender, so neither can be kept.
+	TestBlock mined;
+	mined.addTransaction(TestTransaction::defaultTransaction(1));
+	mined.mine(testBlockchain);
+	testBlockchain.addBlock(mined);
+
+	BOOST_REQUIRE(block.rebase(blockchain));
+	BOOST_CHECK(block.pending().empty());
+	BOOST_CHECK_EQUAL(block.info().parentHash(), blockchain.currentHash());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 BOOST_AUTO_TEST_CASE(bGasPricer)
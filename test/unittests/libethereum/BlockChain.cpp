@@ -22,6 +22,7 @@
 
 #include <libethereum/Block.h>
 #include <libethereum/BlockChain.h>
+#include <libethereum/BulkImport.h>
 #include <test/tools/libtesteth/TestHelper.h>
 #include <test/tools/libtesteth/BlockChainHelper.h>
 #include <libethereum/GenesisInfo.h>
@@ -71,6 +72,54 @@ BOOST_AUTO_TEST_CASE(Mining_1_mineBlockWithTransaction)
     BOOST_REQUIRE(bc.getInterface().transactions().size() > 0);
 }
 
+BOOST_AUTO_TEST_CASE(cachedBlock)
+{
+    TestBlockChain bc(TestBlockChain::defaultGenesisBlock());
+    TestTransaction tr = TestTransaction::defaultTransaction(1); //nonce = 1
+    TestBlock block;
+    block.addTransaction(tr);
+    block.mine(bc);
+    bc.addBlock(block);
+
+    BlockChain const& bcRef = bc.getInterface();
+    h256 const hash = block.blockHeader().hash();
+    CachedBlockPtr cached = bcRef.cachedBlock(hash);
+    BOOST_CHECK(cached->block() == block.bytes());
+    BOOST_CHECK(bcRef.cachedBlock(hash) == cached);
+
+    h256 const transactionHash = tr.transaction().sha3();
+    BOOST_REQUIRE_EQUAL(cached->transactionCount(), 1);
+    BOOST_CHECK_EQUAL(cached->transactionHashes()[0], transactionHash);
+    BOOST_CHECK(bcRef.transactionHashes(hash) == h256s{transactionHash});
+    BOOST_CHECK(bcRef.transaction(hash, 0) == tr.transaction().rlp());
+    BOOST_CHECK(bcRef.transaction(hash, 1).empty());
+    BOOST_CHECK(bcRef.uncleHashes(hash).empty());
+    BOOST_CHECK(BlockHeader(bcRef.headerData(hash), HeaderData) == block.blockHeader());
+
+    BOOST_CHECK(bcRef.cachedBlock(h256(1))->empty());
+}
+
+BOOST_AUTO_TEST_CASE(transactionIndex)
+{
+    TestBlockChain bc(TestBlockChain::defaultGenesisBlock());
+    TestTransaction tr = TestTransaction::defaultTransaction(1); //nonce = 1
+    TestBlock block;
+    block.addTransaction(tr);
+    block.mine(bc);
+    bc.addBlock(block);
+
+    BlockChain const& bcRef = bc.getInterface();
+    h256 const blockHash = block.blockHeader().hash();
+    h256 const transactionHash = tr.transaction().sha3();
+
+    // Lookups don't depend on the background indexer having caught up.
+    BOOST_CHECK(bcRef.isKnownTransaction(transactionHash));
+    BOOST_CHECK(bcRef.transactionLocation(transactionHash) == make_pair(blockHash, 0u));
+    BOOST_CHECK(bcRef.transaction(transactionHash) == tr.transaction().rlp());
+    BOOST_CHECK_EQUAL(bcRef.logBlooms(blockHash).blooms.size(), 1);
+    BOOST_CHECK(!bcRef.isKnownTransaction(h256(1)));
+}
+
 BOOST_AUTO_TEST_CASE(Mining_2_mineUncles)
 {
     TestBlockChain bc(TestBlockChain::defaultGenesisBlock());
@@ -268,6 +317,38 @@ BOOST_AUTO_TEST_CASE(attemptImport)
     BOOST_REQUIRE(onBadwasCalled == true);
 }
 
+BOOST_AUTO_TEST_CASE(importBlockFile)
+{
+    TestBlockChain bc(TestBlockChain::defaultGenesisBlock());
+    TestBlock block;
+    block.addTransaction(TestTransaction::defaultTransaction(1));
+    block.mine(bc);
+    bc.addBlock(block);
+    TestBlock block2;
+    block2.addTransaction(TestTransaction::defaultTransaction(2));
+    block2.mine(bc);
+    bc.addBlock(block2);
+
+    TransientDirectory tempDir;
+    std::string const file = tempDir.path() + "/blocks.rlp";
+    writeFile(file, block.bytes() + block2.bytes());
+
+    TestBlockChain bc2(TestBlockChain::defaultGenesisBlock());
+    BlockChain& bcRef = bc2.interfaceUnsafe();
+    unsigned calls = 0;
+    BulkImportProgress progress = dev::eth::importBlockFile(bcRef,
+        bc2.testGenesis().state().db(), file, 4, [&](BulkImportProgress const&) { ++calls; });
+    BOOST_CHECK_EQUAL(progress.total, 2);
+    BOOST_CHECK_EQUAL(progress.imported, 2);
+    BOOST_CHECK_EQUAL(calls, 2);
+    BOOST_CHECK_EQUAL(bcRef.number(), 2);
+    BOOST_CHECK(bcRef.currentHash() == block2.blockHeader().hash());
+
+    progress = dev::eth::importBlockFile(bcRef, bc2.testGenesis().state().db(), file, 4);
+    BOOST_CHECK_EQUAL(progress.alreadyKnown, 2);
+    BOOST_CHECK_EQUAL(progress.imported, 0);
+}
+
 BOOST_AUTO_TEST_CASE(insert)
 {
     TestBlockChain bc(TestBlockChain::defaultGenesisBlock());
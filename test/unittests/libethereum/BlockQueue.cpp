@@ -21,15 +21,91 @@
  */
 
 #include <libethereum/BlockQueue.h>
+#include <libethashseal/GenesisInfo.h>
+#include <libethcore/Exceptions.h>
+#include <libdevcore/TransientDirectory.h>
 #include <test/tools/libtesteth/TestHelper.h>
 #include <test/tools/libtesteth/BlockChainHelper.h>
 #include <test/tools/libtesteth/JsonSpiritHeaders.h>
 
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 using namespace std;
 using namespace dev;
 using namespace dev::eth;
 using namespace dev::test;
 
+namespace
+{
+/// NoProof, except that the seal of s_bad is invalid, and batch seal checks wait for open().
+class GatedSealEngine: public NoProof
+{
+public:
+    string name() const override { return "GatedSealEngine"; }
+
+    void verify(Strictness _s, BlockHeader const& _bi, BlockHeader const& _parent, bytesConstRef _block) const override
+    {
+        NoProof::verify(_s, _bi, _parent, _block);
+        if (_s == CheckEverything && _bi.hash() == s_bad)
+            BOOST_THROW_EXCEPTION(InvalidBlockNonce());
+    }
+
+    void verifySeals(vector<BlockHeader> const& _headers, unsigned _sampleEvery) const override
+    {
+        {
+            unique_lock<mutex> l(s_x);
+            ++s_waiting;
+            s_changed.notify_all();
+            s_changed.wait(l, [](){ return s_open; });
+            s_maxBatch = max(s_maxBatch, _headers.size());
+        }
+        NoProof::verifySeals(_headers, _sampleEvery);
+    }
+
+    /// Waits until @a _count batches wait for open(). @returns false on timeout.
+    static bool waitFor(size_t _count)
+    {
+        unique_lock<mutex> l(s_x);
+        return s_changed.wait_for(l, chrono::seconds(10), [&](){ return s_waiting >= _count; });
+    }
+
+    static void open()
+    {
+        lock_guard<mutex> l(s_x);
+        s_open = true;
+        s_changed.notify_all();
+    }
+
+    /// Closes the gate again for another test.
+    static void reset()
+    {
+        lock_guard<mutex> l(s_x);
+        s_bad = h256();
+        s_waiting = 0;
+        s_open = false;
+        s_maxBatch = 0;
+    }
+
+    static h256 s_bad;
+    static mutex s_x;
+    static condition_variable s_changed;
+    static size_t s_waiting;
+    static bool s_open;
+    static size_t s_maxBatch;
+};
+
+h256 GatedSealEngine::s_bad;
+mutex GatedSealEngine::s_x;
+condition_variable GatedSealEngine::s_changed;
+size_t GatedSealEngine::s_waiting = 0;
+bool GatedSealEngine::s_open = false;
+size_t GatedSealEngine::s_maxBatch = 0;
+
+ETH_REGISTER_SEAL_ENGINE(GatedSealEngine);
+}
+
 BOOST_FIXTURE_TEST_SUITE(BlockQueueSuite, MainNetworkNoProofTestFixture)
 
 BOOST_AUTO_TEST_CASE(BlockQueueImport)
@@ -100,4 +176,120 @@ BOOST_AUTO_TEST_CASE(BlockQueueImport)
     BOOST_REQUIRE_MESSAGE(res == ImportResult::UnknownParent, "Simple block import to BlockQueue should have return UnknownParent");
 }
 
+BOOST_AUTO_TEST_CASE(BlockQueueBatchWithBadSeal)
+{
+    TestBlock genesisBlock = TestBlockChain::defaultGenesisBlock();
+    TestBlockChain testBlockchain(genesisBlock);
+    ChainParams params(genesisInfo(TestBlockChain::s_sealEngineNetwork), genesisBlock.bytes(), genesisBlock.accountMap());
+    params.sealEngineName = "GatedSealEngine";
+    TransientDirectory dir;
+    BlockChain blockchain(params, dir.path(), WithExisting::Kill);
+
+    // Siblings, so that none of them is dropped for having a bad parent.
+    TestBlock mined;
+    mined.mine(testBlockchain);
+    auto sibling = [&](size_t _i) {
+        TestBlock ret = mined;
+        BlockHeader header = ret.blockHeader();
+        header.setExtraData(bytes{uint8_t(_i), uint8_t(_i >> 8)});
+        ret.setBlockHeader(header);
+        return ret;
+    };
+
+    GatedSealEngine::reset();
+    BlockQueue blockQueue;
+    blockQueue.setChain(blockchain);
+
+    // Hold every verifier on a block of its own, so that the rest queue up to be taken in batches.
+    size_t const verifiers = max(thread::hardware_concurrency(), 3u) - 2;
+    vector<h256> hashes;
+    for (size_t i = 0; i < verifiers; ++i)
+    {
+        TestBlock const block = sibling(i);
+        BOOST_REQUIRE(blockQueue.import(&block.bytes()) == ImportResult::Success);
+        hashes.push_back(block.blockHeader().hash());
+        BOOST_REQUIRE(GatedSealEngine::waitFor(i + 1));
+    }
+    size_t const count = verifiers * 4;
+    for (size_t i = verifiers; i < count; ++i)
+    {
+        TestBlock const block = sibling(i);
+        hashes.push_back(block.blockHeader().hash());
+        if (i == count - 2)
+            GatedSealEngine::s_bad = hashes.back();
+        BOOST_REQUIRE(blockQueue.import(&block.bytes()) == ImportResult::Success);
+    }
+    GatedSealEngine::open();
+
+    for (unsigned i = 0; i < 1000; ++i)
+    {
+        BlockQueueStatus const status = blockQueue.status();
+        if (!status.unverified && !status.verifying)
+            break;
+        this_thread::sleep_for(chrono::milliseconds(10));
+    }
+
+    BOOST_CHECK_GE(GatedSealEngine::s_maxBatch, 2u);
+    BOOST_CHECK_EQUAL(blockQueue.status().bad, 1u);
+    BOOST_CHECK_EQUAL(blockQueue.status().verified, count - 1);
+    for (auto const& h: hashes)
+        BOOST_CHECK(blockQueue.blockStatus(h) == (h == GatedSealEngine::s_bad ? QueueStatus::Bad : QueueStatus::Ready));
+}
+
+BOOST_AUTO_TEST_CASE(BlockQueueSamplesOnlySyncedSeals)
+{
+    TestBlock genesisBlock = TestBlockChain::defaultGenesisBlock();
+    TestBlockChain testBlockchain(genesisBlock);
+    ChainParams params(genesisInfo(TestBlockChain::s_sealEngineNetwork), genesisBlock.bytes(), genesisBlock.accountMap());
+    params.sealEngineName = "GatedSealEngine";
+    TransientDirectory dir;
+    BlockChain blockchain(params, dir.path(), WithExisting::Kill);
+
+    TestBlock mined;
+    mined.mine(testBlockchain);
+    auto sibling = [&](size_t _i) {
+        TestBlock ret = mined;
+        BlockHeader header = ret.blockHeader();
+        header.setExtraData(bytes{uint8_t(_i), uint8_t(_i >> 8)});
+        ret.setBlockHeader(header);
+        return ret;
+    };
+
+    GatedSealEngine::reset();
+    BlockQueue blockQueue;
+    blockQueue.setChain(blockchain);
+    blockQueue.setSealSampling(1000);
+
+    size_t const verifiers = max(thread::hardware_concurrency(), 3u) - 2;
+    for (size_t i = 0; i < verifiers; ++i)
+    {
+        TestBlock const block = sibling(i);
+        BOOST_REQUIRE(blockQueue.import(&block.bytes(), false, true) == ImportResult::Success);
+        BOOST_REQUIRE(GatedSealEngine::waitFor(i + 1));
+    }
+    // A propagated block with a bad seal heads the next batch, followed by synced ones, so that
+    // sampling would skip it.
+    size_t const count = verifiers * 4;
+    for (size_t i = verifiers; i < count; ++i)
+    {
+        TestBlock const block = sibling(i);
+        bool const propagated = i == verifiers;
+        if (propagated)
+            GatedSealEngine::s_bad = block.blockHeader().hash();
+        BOOST_REQUIRE(blockQueue.import(&block.bytes(), false, !propagated) == ImportResult::Success);
+    }
+    GatedSealEngine::open();
+
+    for (unsigned i = 0; i < 1000; ++i)
+    {
+        BlockQueueStatus const status = blockQueue.status();
+        if (!status.unverified && !status.verifying)
+            break;
+        this_thread::sleep_for(chrono::milliseconds(10));
+    }
+
+    BOOST_CHECK(blockQueue.blockStatus(GatedSealEngine::s_bad) == QueueStatus::Bad);
+    BOOST_CHECK_EQUAL(blockQueue.status().verified, count - 1);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -51,6 +51,8 @@ public:
 		_s.swapOut(m_bytesSent);
 	}
 
+	bool isEgressFull() const override { return false; }
+
 	int rating() const override { return 0; }
 	void addRating(int /*_r*/) override { }
 
@@ -59,7 +61,7 @@ public:
 		m_notes[_k] = _v;
 	}
 
-	PeerSessionInfo info() const override { return PeerSessionInfo{ NodeID{}, "", "", 0, std::chrono::steady_clock::duration{}, {}, 0, {}, 0 }; }
+	PeerSessionInfo info() const override { return PeerSessionInfo{ NodeID{}, "", "", 0, std::chrono::steady_clock::duration{}, {}, 0, {}, 0, false, 0, 0, 0, 0 }; }
 	std::chrono::steady_clock::time_point connectionTime() override { return std::chrono::steady_clock::time_point{}; }
 
 	void registerCapability(CapDesc const& /*_desc*/, std::shared_ptr<Capability> /*_p*/) override { }
@@ -86,6 +88,10 @@ public:
 
 	void onPeerTransactions(std::shared_ptr<EthereumPeer>, RLP const&) override {}
 
+	void onPeerTransactionHashes(std::shared_ptr<EthereumPeer>, h256s const&) override {}
+
+	void onPeerPooledTransactions(std::shared_ptr<EthereumPeer>, RLP const&) override {}
+
 	void onPeerBlockHeaders(std::shared_ptr<EthereumPeer>, RLP const&) override {}
 
 	void onPeerBlockBodies(std::shared_ptr<EthereumPeer>, RLP const&) override {}
@@ -137,6 +143,55 @@ BOOST_AUTO_TEST_CASE(EthereumPeerSuite_requestNodeData)
 	BOOST_REQUIRE_EQUAL(static_cast<h256>(rlp[0]), dataHash);
 }
 
+BOOST_AUTO_TEST_CASE(EthereumPeerSuite_requestPooledTransactions)
+{
+	h256 txHash0("0x949d991d685738352398dff73219ab19c62c06e6f8ce899fbae755d5127ed1ef");
+	h256 txHash1("0x0e4562a10381dec21b205ed72637e6b1b523bdd0e4d4d50af5cd23dd4500a217");
+	peer.requestPooledTransactions({ txHash0, txHash1 });
+
+	uint8_t code = static_cast<uint8_t>(session->m_bytesSent[0]);
+	BOOST_REQUIRE_EQUAL(code, offset + 0x09);
+
+	bytes payloadSent(session->m_bytesSent.begin() + 1, session->m_bytesSent.end());
+	RLP rlp(payloadSent);
+	BOOST_REQUIRE(rlp.isList());
+	BOOST_REQUIRE_EQUAL(rlp.itemCount(), 2);
+	BOOST_REQUIRE_EQUAL(static_cast<h256>(rlp[0]), txHash0);
+	BOOST_REQUIRE_EQUAL(static_cast<h256>(rlp[1]), txHash1);
+}
+
+BOOST_AUTO_TEST_CASE(EthereumPeerSuite_pooledTransactionsNeedEth65)
+{
+	BOOST_CHECK(!peer.supportsPooledTransactions());
+	EthereumPeer eth63(session, &hostCap, offset, { "eth", 63 });
+	BOOST_CHECK(!eth63.supportsPooledTransactions());
+	EthereumPeer eth65(session, &hostCap, offset, { "eth", c_pooledTransactionsVersion });
+	BOOST_CHECK(eth65.supportsPooledTransactions());
+}
+
+BOOST_AUTO_TEST_CASE(EthereumPeerSuite_takeRequestedTransactions)
+{
+	bytes const tx0 = rlpList(0, 1);
+	bytes const tx1 = rlpList(0, 2);
+	bytes const tx2 = rlpList(0, 3);
+	peer.requestPooledTransactions({ sha3(tx0), sha3(tx1) });
+
+	RLPStream reply(2);
+	reply.appendRaw(tx0).appendRaw(tx2);
+	unsigned unrequested = 0;
+	bytes requested = peer.takeRequestedTransactions(RLP(reply.out()), unrequested);
+	BOOST_CHECK_EQUAL(unrequested, 1u);
+	BOOST_REQUIRE_EQUAL(RLP(requested).itemCount(), 1);
+	BOOST_CHECK(RLP(requested)[0].data().toBytes() == tx0);
+
+	// The request has been answered, so a late tx1 is unrequested too.
+	RLPStream late(1);
+	late.appendRaw(tx1);
+	requested = peer.takeRequestedTransactions(RLP(late.out()), unrequested);
+	BOOST_CHECK_EQUAL(unrequested, 1u);
+	BOOST_CHECK_EQUAL(RLP(requested).itemCount(), 0);
+}
+
 BOOST_AUTO_TEST_CASE(EthereumPeerSuite_requestNodeDataSeveralHashes)
 {
 	h256 dataHash0("0x949d991d685738352398dff73219ab19c62c06e6f8ce899fbae755d5127ed1ef");
@@ -184,4 +239,18 @@ BOOST_AUTO_TEST_CASE(EthereumPeerSuite_requestReceipts)
 	BOOST_REQUIRE_EQUAL(static_cast<h256>(rlp[2]), blockHash2);
 }
 
+BOOST_AUTO_TEST_CASE(EthereumPeerSuite_requestTimeoutCountsAsFailure)
+{
+	peer.requestReceipts({ h256("0x949d991d685738352398dff73219ab19c62c06e6f8ce899fbae755d5127ed1ef") });
+	BOOST_REQUIRE_GE(peer.askDuration(), 0);
+
+	peer.noteRequestTimeout();
+
+	PeerRequestStats const stats = peer.requestStats();
+	BOOST_REQUIRE_EQUAL(stats.requests, 1);
+	BOOST_REQUIRE_EQUAL(stats.failures, 1);
+	BOOST_REQUIRE_EQUAL(stats.failureRate(), 1);
+	BOOST_REQUIRE(session->m_notes["failures"] == "1/1");
+}
+
 BOOST_AUTO_TEST_SUITE_END()
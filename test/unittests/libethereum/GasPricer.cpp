@@ -25,6 +25,7 @@
 #include <libethereum/ChainParams.h>
 #include <libethereum/GasPricer.h>
 #include <libethereum/BasicGasPricer.h>
+#include <libethereum/GasPriceOracle.h>
 #include <test/tools/libtesteth/TestHelper.h>
 #include <test/tools/libtestutils/BlockChainLoader.h>
 #include <boost/filesystem/path.hpp>
@@ -186,4 +187,44 @@ BOOST_AUTO_TEST_CASE(basicGasPricer_highGasUsage_HighestPrio)
 	u256 _expectedBid = 30000000000000;
 	dev::test::executeGasPricerTest("highGasUsage_Frontier", 30.679, 15.0, "/BlockchainTests/bcGasPricerTest/highGasUsage.json", TransactionPriority::Highest, _expectedAsk, _expectedBid, eth::Network::FrontierTest);
 }
+
+BOOST_AUTO_TEST_CASE(gasPriceOracle)
+{
+	GasPriceOracle gp(0, DefaultGasPrice, 3);
+	BOOST_CHECK_EQUAL(gp.bid(), DefaultGasPrice);
+
+	gp.noteBlock(1, {1, 2, 3, 4, 5, 6, 7, 8, 9, 10});
+	BOOST_CHECK_EQUAL(gp.percentile(0), 1);
+	BOOST_CHECK_EQUAL(gp.percentile(50), 5);
+	BOOST_CHECK_EQUAL(gp.percentile(100), 10);
+	BOOST_CHECK_EQUAL(gp.bid(TransactionPriority::Lowest), 1);
+	BOOST_CHECK_EQUAL(gp.bid(TransactionPriority::Highest), 10);
+
+	// Block 1 falls out of the window.
+	gp.noteBlock(2, {20});
+	gp.noteBlock(3, {20});
+	gp.noteBlock(4, {20});
+	BOOST_CHECK_EQUAL(gp.percentile(0), 20);
+	BOOST_CHECK_EQUAL(gp.percentile(100), 20);
+
+	// A new block 3 replaces the old blocks 3 and 4.
+	gp.noteBlock(3, {11});
+	BOOST_CHECK_EQUAL(gp.percentile(0), 11);
+	BOOST_CHECK_EQUAL(gp.percentile(100), 20);
+
+	gp.notePending(vector<u256>{30, 30});
+	BOOST_CHECK_EQUAL(gp.percentile(50), 20);
+	BOOST_CHECK_EQUAL(gp.percentile(100), 30);
+	gp.notePending(vector<u256>{});
+	BOOST_CHECK_EQUAL(gp.percentile(100), 20);
+
+	// Larger prices are rounded up by less than a sixteenth.
+	u256 const price = 20 * shannon;
+	gp.noteBlock(5, {price});
+	gp.noteBlock(6, {price});
+	gp.noteBlock(7, {price});
+	BOOST_CHECK_GE(gp.bid(), price);
+	BOOST_CHECK_LT(gp.bid(), price + price / 16);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
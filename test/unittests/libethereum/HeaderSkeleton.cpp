@@ -0,0 +1,87 @@
+// Copyright 2018 cpp-ethereum Authors.
+// Licensed under the GNU General Public License v3. See the LICENSE file.
+
+#include <libethereum/HeaderSkeleton.h>
+#include <test/tools/libtesteth/TestHelper.h>
+
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+using namespace dev::test;
+
+BOOST_FIXTURE_TEST_SUITE(HeaderSkeletonSuite, TestOutputHelperFixture)
+
+BOOST_AUTO_TEST_CASE(skeletonFill)
+{
+    unsigned const stride = HeaderSkeleton::c_stride;
+    HeaderSkeleton skeleton;
+
+    // Too close to the top to need a skeleton.
+    BOOST_CHECK(!skeleton.nextRequest(100, 100 + stride * 2));
+
+    HeaderSkeleton::Request const request = skeleton.nextRequest(100, 100 + stride * 10 + 1);
+    BOOST_REQUIRE(request);
+    BOOST_CHECK_EQUAL(request.from, 100 + stride);
+    BOOST_CHECK_EQUAL(request.count, 10u);
+    skeleton.noteRequested(request);
+
+    BOOST_CHECK(HeaderSkeleton::isInPlace(request, 2, request.from + stride * 2));
+    BOOST_CHECK(!HeaderSkeleton::isInPlace(request, 2, request.from + stride * 2 + 1));
+
+    HeaderSkeleton::Request const taken = skeleton.takeRequest(false);
+    BOOST_CHECK_EQUAL(taken.from, request.from);
+    BOOST_CHECK(!skeleton.takeRequest(false));
+    for (unsigned i = 0; i < request.count; ++i)
+        skeleton.add(request.from + i * stride);
+    BOOST_CHECK_EQUAL(skeleton.end(), request.from + (request.count - 1) * stride);
+    BOOST_CHECK(skeleton.isAnchor(request.from + stride));
+
+    // The next skeleton continues after this one.
+    HeaderSkeleton::Request const next = skeleton.nextRequest(100, 100 + stride * 20 + 1);
+    BOOST_REQUIRE(next);
+    BOOST_CHECK_EQUAL(next.from, skeleton.end() + stride);
+
+    // Importing blocks drops the anchors behind the head, dropped headers those above.
+    skeleton.prune(request.from + stride);
+    BOOST_CHECK(!skeleton.isAnchor(request.from));
+    BOOST_CHECK(!skeleton.isAnchor(request.from + stride));
+    BOOST_CHECK(skeleton.isAnchor(request.from + stride * 2));
+    skeleton.truncate(request.from + stride * 3);
+    BOOST_CHECK_EQUAL(skeleton.end(), request.from + stride * 3);
+    skeleton.prune(skeleton.end());
+    BOOST_CHECK(skeleton.empty());
+    BOOST_CHECK_EQUAL(skeleton.end(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(skeletonTimeout)
+{
+    unsigned const stride = HeaderSkeleton::c_stride;
+    HeaderSkeleton skeleton;
+
+    HeaderSkeleton::Request const first = skeleton.nextRequest(0, stride * 10);
+    skeleton.noteRequested(first);
+    skeleton.noteTimedOut();
+    BOOST_CHECK(!skeleton.takeRequest(false));
+
+    // Another peer is asked meanwhile; both answers are recognised.
+    HeaderSkeleton::Request const second = skeleton.nextRequest(stride, stride * 10);
+    skeleton.noteRequested(second);
+    HeaderSkeleton::Request const late = skeleton.takeRequest(true);
+    BOOST_CHECK_EQUAL(late.from, first.from);
+    BOOST_CHECK_EQUAL(late.count, first.count);
+    BOOST_CHECK(!skeleton.takeRequest(true));
+    BOOST_CHECK_EQUAL(skeleton.takeRequest(false).from, second.from);
+}
+
+BOOST_AUTO_TEST_CASE(skeletonMismatches)
+{
+    HeaderSkeleton skeleton;
+    for (unsigned i = 1; i < HeaderSkeleton::c_maxMismatches; ++i)
+        BOOST_CHECK(!skeleton.noteMismatch());
+    skeleton.noteLinked();
+    for (unsigned i = 1; i < HeaderSkeleton::c_maxMismatches; ++i)
+        BOOST_CHECK(!skeleton.noteMismatch());
+    BOOST_CHECK(skeleton.noteMismatch());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
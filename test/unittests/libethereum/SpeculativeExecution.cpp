@@ -0,0 +1,129 @@
+// Copyright 2018 cpp-ethereum Authors.
+// Licensed under the GNU General Public License v3. See the LICENSE file.
+
+#include <libethashseal/GenesisInfo.h>
+#include <libethereum/ChainParams.h>
+#include <libethereum/SpeculativeExecution.h>
+#include <libethereum/State.h>
+#include <test/tools/libtesteth/TestHelper.h>
+#include <test/tools/libtestutils/TestLastBlockHashes.h>
+
+using namespace std;
+using namespace dev;
+using namespace dev::eth;
+using namespace dev::test;
+
+namespace
+{
+Address const c_author{"0x8888f1f195afa192cfee860698584c030f4c9db1"};
+
+SpeculativeResult result(u256 _gasUsed, AddressHash _reads, AddressHash _writes)
+{
+    SpeculativeResult r;
+    r.valid = true;
+    r.gasUsed = _gasUsed;
+    r.reads = _reads + _writes + AddressHash{c_author};
+    r.writes = _writes + AddressHash{c_author};
+    return r;
+}
+}  // namespace
+
+BOOST_FIXTURE_TEST_SUITE(SpeculativeExecutionSuite, TestOutputHelperFixture)
+
+BOOST_AUTO_TEST_CASE(packPrefersFeesAndSkipsConflicts)
+{
+    Address const a{"aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"};
+    Address const b{"bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb"};
+    Address const c{"cccccccccccccccccccccccccccccccccccccccc"};
+    Address const d{"dddddddddddddddddddddddddddddddddddddddd"};
+    Secret const sec{"0x45a915e4d060149eb4365960e6a7a45f334393093061116b197e3240065ff2d8"};
+
+    Transaction const cheap(0, 1, 50000, a, bytes(), 0, sec);
+    Transaction const rich(0, 10, 50000, b, bytes(), 0, sec);
+    Transaction const conflicting(0, 5, 50000, c, bytes(), 0, sec);
+    Transaction const invalid(0, 100, 50000, d, bytes(), 0, sec);
+    vector<Transaction const*> const txs{&cheap, &rich, &conflicting, &invalid};
+
+    vector<SpeculativeResult> results{
+        result(21000, {}, {a}),
+        result(21000, {}, {b}),
+        result(21000, {b}, {c}),  // reads what rich writes
+        SpeculativeResult(),
+    };
+
+    // The author is written by everyone but doesn't count as a conflict.
+    BOOST_CHECK(SpeculativeBlockBuilder::pack(txs, results, c_author, 1000000) == (vector<size_t>{1, 0}));
+
+    // Only room for one.
+    BOOST_CHECK(SpeculativeBlockBuilder::pack(txs, results, c_author, 60000) == (vector<size_t>{1}));
+}
+
+BOOST_AUTO_TEST_CASE(packedConflictsMatchSerialExecution)
+{
+    Secret const secA{"0x45a915e4d060149eb4365960e6a7a45f334393093061116b197e3240065ff2d8"};
+    Secret const secB{"0x3333333333333333333333333333333333333333333333333333333333333333"};
+    Secret const secC{"0x4444444444444444444444444444444444444444444444444444444444444444"};
+    Address const store{"aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"};
+    Address const payee{"bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb"};
+
+    State base{0};
+    for (auto const& sec: {secA, secB, secC})
+        base.addBalance(toAddress(sec), ether);
+    // CALLER PUSH1 0 SSTORE: whoever calls last owns slot 0.
+    base.createContract(store);
+    base.setCode(store, bytes{0x33, 0x60, 0x00, 0x55});
+    base.commit(State::CommitBehaviour::KeepEmptyAccounts);
+
+    Transaction const a0(0, 3, 100000, store, bytes(), 0, secA);
+    Transaction const a1(1, 4, 100000, payee, bytes(), 1, secA);  // same sender, next nonce
+    Transaction const b0(0, 2, 100000, store, bytes(), 0, secB);  // same storage slot as a0
+    Transaction const c0(1, 1, 100000, payee, bytes(), 0, secC);
+    vector<Transaction const*> const txs{&a0, &a1, &b0, &c0};
+
+    unique_ptr<SealEngineFace> se(ChainParams(genesisInfo(Network::ByzantiumTest)).createSealEngine());
+    BlockHeader header;
+    header.setNumber(1);
+    header.setGasLimit(1000000);
+    header.setAuthor(c_author);
+    TestLastBlockHashes lastBlockHashes({});
+    EnvInfo const envInfo(header, lastBlockHashes, 0);
+
+    auto const results = SpeculativeBlockBuilder(4).execute(base, envInfo, *se, txs);
+    BOOST_CHECK(!results[1].valid);
+    vector<size_t> const packed = SpeculativeBlockBuilder::pack(txs, results, c_author, 1000000);
+    BOOST_REQUIRE(packed == (vector<size_t>{0, 3}));
+
+    // Packed transactions don't depend on each other's order.
+    auto run = [&](State _s, vector<Transaction const*> const& _txs) {
+        for (auto const* t: _txs)
+            _s.execute(envInfo, *se, *t, Permanence::Committed);
+        return _s.rootHash();
+    };
+    BOOST_CHECK_EQUAL(run(base, {&a0, &c0}), run(base, {&c0, &a0}));
+    BOOST_CHECK(run(base, {&a0, &b0}) != run(base, {&b0, &a0}));
+
+    // Packed first and the rest after them gives the block serial execution would.
+    BOOST_CHECK_EQUAL(run(base, {&a0, &c0, &a1, &b0}), run(base, txs));
+}
+
+BOOST_AUTO_TEST_CASE(executeStopsAtDeadline)
+{
+    Secret const sec{"0x45a915e4d060149eb4365960e6a7a45f334393093061116b197e3240065ff2d8"};
+    State base{0};
+    base.addBalance(toAddress(sec), ether);
+    base.commit(State::CommitBehaviour::KeepEmptyAccounts);
+
+    Transaction const tx(1, 1, 100000, c_author, bytes(), 0, sec);
+    unique_ptr<SealEngineFace> se(ChainParams(genesisInfo(Network::ByzantiumTest)).createSealEngine());
+    BlockHeader header;
+    header.setNumber(1);
+    header.setGasLimit(1000000);
+    TestLastBlockHashes lastBlockHashes({});
+    EnvInfo const envInfo(header, lastBlockHashes, 0);
+
+    SpeculativeBlockBuilder const builder(1);
+    BOOST_CHECK(builder.execute(base, envInfo, *se, {&tx})[0].valid);
+    BOOST_CHECK(!builder.execute(base, envInfo, *se, {&tx}, chrono::steady_clock::now() - chrono::seconds(1))[0].valid);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
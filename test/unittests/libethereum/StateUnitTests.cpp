@@ -54,6 +54,25 @@ BOOST_AUTO_TEST_CASE(LoadAccountCode)
     ));
 }
 
+BOOST_AUTO_TEST_CASE(RecordAccess)
+{
+    Address const a{"aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"};
+    Address const b{"bbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbbb"};
+    Address const c{"cccccccccccccccccccccccccccccccccccccccc"};
+    State s{0};
+    s.addBalance(a, 1);
+    s.commit(State::CommitBehaviour::KeepEmptyAccounts);
+
+    AddressHash accessed;
+    s.recordAccess(&accessed);
+    s.balance(a);
+    s.addBalance(b, 1);
+    s.recordAccess(nullptr);
+    s.balance(c);
+
+    BOOST_CHECK(accessed == (AddressHash{a, b}));
+}
+
 class AddressRangeTestFixture : public TestOutputHelperFixture
 {
 public:
@@ -28,6 +28,19 @@ using namespace std;
 using namespace dev;
 using namespace dev::eth;
 using namespace dev::test;
+namespace ut = boost::unit_test;
+
+namespace
+{
+// Transaction::operator== ignores nonce, gas price and sender, so compare hashes instead.
+h256s hashes(Transactions const& _ts)
+{
+    h256s ret;
+    for (auto const& t: _ts)
+        ret.push_back(t.sha3());
+    return ret;
+}
+}
 
 BOOST_FIXTURE_TEST_SUITE(TransactionQueueSuite, TestOutputHelperFixture)
 
@@ -129,6 +142,64 @@ BOOST_AUTO_TEST_CASE(tqPriority)
 
 }
 
+BOOST_AUTO_TEST_CASE(tqMergeOrder)
+{
+    TransactionQueue txq;
+    u256 const gas = 25000;
+    Address const dest("0x095e7baea6a6c7c4c2dfeb977efac326af552d87");
+    Secret const senderA("0x3333333333333333333333333333333333333333333333333333333333333333");
+    Secret const senderB("0x4444444444444444444444444444444444444444444444444444444444444444");
+    Transaction const a0(0, 30 * szabo, gas, dest, bytes(), 0, senderA);
+    Transaction const a1(0, 5 * szabo, gas, dest, bytes(), 1, senderA);
+    Transaction const b0(0, 20 * szabo, gas, dest, bytes(), 0, senderB);
+    Transaction const b1(0, 25 * szabo, gas, dest, bytes(), 1, senderB);
+
+    for (auto const& t: {a1, b1, a0, b0})
+        BOOST_REQUIRE(txq.import(t) == ImportResult::Success);
+
+    // A lane's next transaction competes on its own price once the one before it is taken, but
+    // never goes before it.
+    BOOST_CHECK(hashes(txq.topTransactions(256)) == (h256s{a0.sha3(), b0.sha3(), b1.sha3(), a1.sha3()}));
+    BOOST_CHECK(hashes(txq.topTransactions(3)) == (h256s{a0.sha3(), b0.sha3(), b1.sha3()}));
+    BOOST_CHECK(hashes(txq.topTransactions(256, h256Hash{b0.sha3()})) == (h256s{a0.sha3(), b1.sha3(), a1.sha3()}));
+
+    // Equal prices keep the order of arrival.
+    Secret const senderC("0x5555555555555555555555555555555555555555555555555555555555555555");
+    Transaction const c0(0, 20 * szabo, gas, dest, bytes(), 0, senderC);
+    BOOST_REQUIRE(txq.import(c0) == ImportResult::Success);
+    BOOST_CHECK(hashes(txq.topTransactions(256)) == (h256s{a0.sha3(), b0.sha3(), b1.sha3(), c0.sha3(), a1.sha3()}));
+}
+
+BOOST_AUTO_TEST_CASE(tqEvictsCheapestLane)
+{
+    TransactionQueue txq(3, 3);
+    u256 const gas = 25000;
+    Address const dest("0x095e7baea6a6c7c4c2dfeb977efac326af552d87");
+    Secret const senderA("0x3333333333333333333333333333333333333333333333333333333333333333");
+    Secret const senderB("0x4444444444444444444444444444444444444444444444444444444444444444");
+    Secret const senderC("0x5555555555555555555555555555555555555555555555555555555555555555");
+    Secret const senderD("0x6666666666666666666666666666666666666666666666666666666666666666");
+    Transaction const a0(0, 10 * szabo, gas, dest, bytes(), 0, senderA);
+    Transaction const a1(0, 40 * szabo, gas, dest, bytes(), 1, senderA);
+    Transaction const b0(0, 30 * szabo, gas, dest, bytes(), 0, senderB);
+    Transaction const c0(0, 20 * szabo, gas, dest, bytes(), 0, senderC);
+    Transaction const d0(0, 5 * szabo, gas, dest, bytes(), 0, senderD);
+
+    txq.import(a0);
+    txq.import(a1);
+    txq.import(b0);
+    BOOST_CHECK(hashes(txq.topTransactions(256)) == (h256s{b0.sha3(), a0.sha3(), a1.sha3()}));
+
+    // The lane whose head pays the least loses its last transaction, however much that one pays.
+    txq.import(c0);
+    BOOST_CHECK(hashes(txq.topTransactions(256)) == (h256s{b0.sha3(), c0.sha3(), a0.sha3()}));
+
+    // A newcomer paying less than every lane head is dropped itself.
+    txq.import(d0);
+    BOOST_CHECK(hashes(txq.topTransactions(256)) == (h256s{b0.sha3(), c0.sha3(), a0.sha3()}));
+    BOOST_CHECK_EQUAL(txq.waiting(d0.from()), 0);
+}
+
 BOOST_AUTO_TEST_CASE(tqFuture)
 {
     dev::eth::TransactionQueue txq;
@@ -304,4 +375,117 @@ BOOST_AUTO_TEST_CASE(tqEqueue)
     BOOST_REQUIRE(topTr.size() == 1);
 }
 
+BOOST_AUTO_TEST_CASE(tqEnqueueBatch)
+{
+    TransactionQueue tq;
+    unsigned const count = 40;
+    RLPStream rlpStream(count + 1);
+    for (unsigned i = 0; i < count; ++i)
+        rlpStream.appendRaw(TestTransaction::defaultTransaction(i).transaction().rlp());
+    rlpStream.appendRaw(rlpList(1, 2, 3));  // malformed
+
+    Mutex x_results;
+    vector<TransactionQueue::ImportResults> results;
+    auto importHandler = tq.onImport([&](TransactionQueue::ImportResults const& _r, h512 const&) {
+        DEV_GUARDED(x_results)
+            results.push_back(_r);
+    });
+    std::atomic<unsigned> readyCount{0};
+    auto readyHandler = tq.onReady([&]() { ++readyCount; });
+
+    tq.enqueue(RLP(rlpStream.out()), h512());
+    auto imported = [&]() {
+        Guard l(x_results);
+        return !results.empty();
+    };
+    for (unsigned i = 0; i < 50 && !imported(); ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    BOOST_REQUIRE_EQUAL(tq.topTransactions(count * 2).size(), count);
+    Guard l(x_results);
+    BOOST_REQUIRE_EQUAL(results.size(), 1u);
+    BOOST_REQUIRE_EQUAL(results[0].size(), count + 1);
+    for (unsigned i = 0; i < count; ++i)
+        BOOST_CHECK(results[0][i].second == ImportResult::Success);
+    BOOST_CHECK(results[0][count].second == ImportResult::Malformed);
+    BOOST_CHECK_EQUAL(readyCount, 1u);
+}
+
+BOOST_AUTO_TEST_CASE(tqSnapshot)
+{
+    TransactionQueue tq;
+    Transaction const tx0 = TestTransaction::defaultTransaction(0).transaction();
+    Transaction const tx1 = TestTransaction::defaultTransaction(1).transaction();
+
+    tq.import(tx0);
+    auto first = tq.snapshot();
+    BOOST_CHECK(first == tq.snapshot());
+    BOOST_REQUIRE_EQUAL(first->transactions.size(), 1u);
+    BOOST_CHECK(first->transactions[0].hash == tx0.sha3());
+
+    tq.import(tx1);
+    auto second = tq.snapshot();
+    BOOST_CHECK(second != first);
+    BOOST_CHECK(second->epoch > first->epoch);
+    BOOST_CHECK_EQUAL(first->transactions.size(), 1u);
+    BOOST_REQUIRE_EQUAL(second->transactions.size(), 2u);
+    BOOST_CHECK(second->transactions[0].transaction == first->transactions[0].transaction);
+    BOOST_CHECK(second->transactions[1].hash == tx1.sha3());
+
+    tq.drop(tx0.sha3());
+    BOOST_CHECK_EQUAL(second->transactions.size(), 2u);
+    BOOST_CHECK_EQUAL(tq.snapshot()->transactions.size(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(bench_tqLoad, *ut::label("bench"))
+{
+    if (!Options::get().all)
+    {
+        std::cout << "Skipping benchmark test because --all option is not specified.\n";
+        return;
+    }
+
+    unsigned const senders = 10000;
+    unsigned const perSender = 10;
+    unsigned const total = senders * perSender;
+    Address const dest = Address("0x095e7baea6a6c7c4c2dfeb977efac326af552d87");
+
+    // Sign and recover the senders up front so that only the queue itself is measured.
+    Transactions txs;
+    txs.reserve(total);
+    for (unsigned s = 0; s < senders; ++s)
+    {
+        Secret const secret(sha3(toBigEndian(u256(s + 1))));
+        for (unsigned n = 0; n < perSender; ++n)
+        {
+            txs.emplace_back(0, (1 + (s * 7 + n * 13) % 100) * szabo, 21000, dest, bytes(), n, secret);
+            txs.back().sender();
+        }
+    }
+
+    TransactionQueue tq(total, 1024);
+    Timer timer;
+    for (auto const& t : txs)
+        BOOST_REQUIRE(tq.import(t) == ImportResult::Success);
+    auto const importTime = timer.duration();
+
+    timer.restart();
+    Transactions const top = tq.topTransactions(total);
+    auto const topTime = timer.duration();
+    BOOST_REQUIRE_EQUAL(top.size(), total);
+
+    timer.restart();
+    for (auto const& t : top)
+        tq.dropGood(t);
+    auto const dropTime = timer.duration();
+    BOOST_REQUIRE_EQUAL(tq.status().current, 0u);
+
+    auto ms = [](std::chrono::high_resolution_clock::duration const& _d) {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(_d).count();
+    };
+    std::cout << ut::framework::current_test_case().p_name << ": " << total << " transactions from "
+              << senders << " senders: import " << ms(importTime) << " ms, topTransactions "
+              << ms(topTime) << " ms, dropGood " << ms(dropTime) << " ms\n";
+}
+
 BOOST_AUTO_TEST_SUITE_END()
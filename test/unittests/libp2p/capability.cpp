@@ -20,7 +20,9 @@ along with cpp-ethereum.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <boost/test/unit_test.hpp>
+#include <atomic>
 #include <chrono>
+#include <random>
 #include <thread>
 #include <libp2p/Common.h>
 #include <libp2p/Host.h>
@@ -48,38 +50,104 @@ public:
     virtual ~TestCapability() {}
     int countReceivedMessages() { return m_cntReceivedMessages; }
     int testSum() { return m_testSum; }
+    std::vector<int> receivedOrder() { return m_received; }
+    /// @returns when each message was received, counted over all capabilities.
+    std::vector<unsigned> receivedAt() { return m_receivedAt; }
     static std::string name() { return "test"; }
     static u256 version() { return 2; }
     static unsigned messageCount() { return UserPacket + 1; }
     void sendTestMessage(int _i) { RLPStream s; sealAndSend(prep(s, UserPacket, 1) << _i); }
 
+    /// Sends a message with @a _size bytes of incompressible padding.
+    void sendLargeTestMessage(int _i, size_t _size)
+    {
+        std::mt19937 rng(_i);
+        bytes padding(_size);
+        for (auto& b: padding)
+            b = byte(rng());
+        RLPStream s;
+        sealAndSend(prep(s, UserPacket, 2) << _i << padding);
+    }
+
 protected:
     virtual bool interpret(unsigned _id, RLP const& _r) override;
 
     int m_cntReceivedMessages;
     int m_testSum;
+    std::vector<int> m_received;
+    std::vector<unsigned> m_receivedAt;
+
+    static std::atomic<unsigned> s_receipts;
 };
 
+std::atomic<unsigned> TestCapability::s_receipts{0};
+
 bool TestCapability::interpret(unsigned _id, RLP const& _r) 
 {
     //cnote << "Capability::interpret(): custom message received";
     ++m_cntReceivedMessages;
     m_testSum += _r[0].toInt();
+    m_received.push_back(_r[0].toInt());
+    m_receivedAt.push_back(s_receipts++);
     BOOST_ASSERT(_id == UserPacket);
     return (_id == UserPacket);
 }
 
-class TestHostCapability: public HostCapability<TestCapability>, public Worker
+/// A second capability alongside TestCapability.
+class OtherTestCapability: public TestCapability
+{
+public:
+    using TestCapability::TestCapability;
+    static std::string name() { return "othertest"; }
+};
+
+template <class Cap>
+class BasicTestHostCapability: public HostCapability<Cap>, public Worker
 {
 public:
-    TestHostCapability(): Worker("test") {}
-    virtual ~TestHostCapability() {}
+    using HostCapability<Cap>::peerSessions;
+
+    explicit BasicTestHostCapability(TrafficClass _class = TrafficClass::Propagation): Worker("test"), m_class(_class) {}
+    virtual ~BasicTestHostCapability() {}
+
+    TrafficClass trafficClass(unsigned) const override { return m_class; }
 
     void sendTestMessage(NodeID const& _id, int _x)
     {
         for (auto i: peerSessions())
             if (_id == i.second->id)
-                capabilityFromSession<TestCapability>(*i.first)->sendTestMessage(_x);
+                capabilityFromSession<Cap>(*i.first)->sendTestMessage(_x);
+    }
+
+    void sendLargeTestMessage(NodeID const& _id, int _x, size_t _size)
+    {
+        for (auto i: peerSessions())
+            if (_id == i.second->id)
+                capabilityFromSession<Cap>(*i.first)->sendLargeTestMessage(_x, _size);
+    }
+
+    bool isEgressFull(NodeID const& _id)
+    {
+        for (auto i: peerSessions())
+            if (_id == i.second->id)
+                return i.first->isEgressFull();
+        return false;
+    }
+
+    std::vector<int> receivedOrder(NodeID const& _id)
+    {
+        for (auto i: peerSessions())
+            if (_id == i.second->id)
+                return capabilityFromSession<Cap>(*i.first)->receivedOrder();
+        return {};
+    }
+
+    std::vector<unsigned> receivedAt(NodeID const& _id)
+    {
+        for (auto i: peerSessions())
+            if (_id == i.second->id)
+                return capabilityFromSession<Cap>(*i.first)->receivedAt();
+        return {};
     }
 
     std::pair<int, int> retrieveTestData(NodeID const& _id)
@@ -89,28 +157,26 @@ public:
         for (auto i: peerSessions())
             if (_id == i.second->id)
             {
-                cnt += capabilityFromSession<TestCapability>(*i.first)->countReceivedMessages();
-                checksum += capabilityFromSession<TestCapability>(*i.first)->testSum();
+                cnt += capabilityFromSession<Cap>(*i.first)->countReceivedMessages();
+                checksum += capabilityFromSession<Cap>(*i.first)->testSum();
             }
 
         return std::pair<int, int>(cnt, checksum);
     }
+
+private:
+    TrafficClass const m_class;
 };
 
-BOOST_FIXTURE_TEST_SUITE(p2pCapability, P2PFixture)
+using TestHostCapability = BasicTestHostCapability<TestCapability>;
+using OtherTestHostCapability = BasicTestHostCapability<OtherTestCapability>;
 
-BOOST_AUTO_TEST_CASE(capability)
+namespace
+{
+void connectHosts(Host& host1, Host& host2)
 {
-    cnote << "Testing Capability...";
-
     int const step = 10;
     const char* const localhost = "127.0.0.1";
-    NetworkPreferences prefs1(localhost, 0, false);
-    NetworkPreferences prefs2(localhost, 0, false);
-    Host host1("Test", prefs1);
-    Host host2("Test", prefs2);
-    auto thc1 = host1.registerCapability(make_shared<TestHostCapability>());
-    auto thc2 = host2.registerCapability(make_shared<TestHostCapability>());
     host1.start();	
     host2.start();
     auto port1 = host1.listenPort();
@@ -140,6 +206,23 @@ BOOST_AUTO_TEST_CASE(capability)
     }
 
     BOOST_REQUIRE(host1.peerCount() > 0 && host2.peerCount() > 0);
+}
+}  // namespace
+
+BOOST_FIXTURE_TEST_SUITE(p2pCapability, P2PFixture)
+
+BOOST_AUTO_TEST_CASE(capability)
+{
+    cnote << "Testing Capability...";
+
+    const char* const localhost = "127.0.0.1";
+    NetworkPreferences prefs1(localhost, 0, false);
+    NetworkPreferences prefs2(localhost, 0, false);
+    Host host1("Test", prefs1);
+    Host host2("Test", prefs2);
+    auto thc1 = host1.registerCapability(make_shared<TestHostCapability>());
+    auto thc2 = host2.registerCapability(make_shared<TestHostCapability>());
+    connectHosts(host1, host2);
 
     int const target = 64;
     int checksum = 0;
@@ -152,6 +235,209 @@ BOOST_AUTO_TEST_CASE(capability)
     BOOST_REQUIRE_EQUAL(checksum, testData.second);
 }
 
+BOOST_AUTO_TEST_CASE(gatheredWritesKeepOrder)
+{
+    const char* const localhost = "127.0.0.1";
+    NetworkPreferences prefs1(localhost, 0, false);
+    NetworkPreferences prefs2(localhost, 0, false);
+    Host host1("Test", prefs1);
+    Host host2("Test", prefs2);
+    auto thc1 = host1.registerCapability(make_shared<TestHostCapability>());
+    auto thc2 = host2.registerCapability(make_shared<TestHostCapability>());
+    connectHosts(host1, host2);
+
+    // Queued faster than they are written, so that each write gathers many of them.
+    size_t const target = 2000;
+    for (size_t i = 0; i < target; ++i)
+        thc2->sendTestMessage(host1.id(), int(i));
+
+    vector<int> received;
+    for (unsigned i = 0; i < 10000 && received.size() < target; i += 10)
+    {
+        this_thread::sleep_for(chrono::milliseconds(10));
+        received = thc1->receivedOrder(host2.id());
+    }
+    BOOST_REQUIRE_EQUAL(received.size(), target);
+    for (size_t i = 0; i < target; ++i)
+        BOOST_REQUIRE_EQUAL(received[i], int(i));
+}
+
+BOOST_AUTO_TEST_CASE(egressFullAndOverflow)
+{
+    const char* const localhost = "127.0.0.1";
+    NetworkPreferences prefs1(localhost, 0, false);
+    NetworkPreferences prefs2(localhost, 0, false);
+    Host host1("Test", prefs1);
+    Host host2("Test", prefs2);
+    auto thc1 = host1.registerCapability(make_shared<TestHostCapability>());
+    auto thc2 = host2.registerCapability(make_shared<TestHostCapability>());
+    connectHosts(host1, host2);
+
+    // Capabilities are asked to hold back from 4 MB queued.
+    BOOST_CHECK(!thc2->isEgressFull(host1.id()));
+    thc2->sendLargeTestMessage(host1.id(), 1, 5 * 1024 * 1024);
+    BOOST_CHECK(thc2->isEgressFull(host1.id()));
+
+    vector<int> received;
+    for (unsigned i = 0; i < 10000 && received.empty(); i += 10)
+    {
+        this_thread::sleep_for(chrono::milliseconds(10));
+        received = thc1->receivedOrder(host2.id());
+    }
+    BOOST_REQUIRE_EQUAL(received.size(), 1);
+    BOOST_CHECK(!thc2->isEgressFull(host1.id()));
+
+    // More than 16 MB queued drops the peer.
+    thc2->sendLargeTestMessage(host1.id(), 2, 17 * 1024 * 1024);
+    for (unsigned i = 0; i < 10000 && host2.peerCount(); i += 10)
+        this_thread::sleep_for(chrono::milliseconds(10));
+    BOOST_REQUIRE_EQUAL(host2.peerCount(), 0);
+    for (auto const& peer: host2.getPeers())
+        if (peer.id == host1.id())
+            BOOST_CHECK_EQUAL(peer.lastDisconnect(), UselessPeer);
+}
+
+BOOST_AUTO_TEST_CASE(snappyRoundTrip)
+{
+    auto pool = make_shared<BufferPool>();
+    BufferPool::Buffer buffer;
+
+    RLPStream s;
+    s.append(unsigned(UserPacket)).appendList(2) << 42 << bytes(1000, 7);
+    bytes const packet = s.out();
+    bytes compressed = packet;
+    Session::compressPacket(compressed);
+    BOOST_CHECK_EQUAL(compressed[0], packet[0]);
+    BOOST_CHECK_LT(compressed.size(), packet.size());
+
+    bytesConstRef decompressed(&compressed);
+    BOOST_REQUIRE(Session::decompressPacket(decompressed, *pool, buffer));
+    BOOST_CHECK(decompressed.toBytes() == packet);
+
+    // Packets may not decompress to more than 16 MB, however well they compress.
+    bytes large(2 + 16 * 1024 * 1024);
+    large[0] = UserPacket;
+    bytes compressedLarge = large;
+    Session::compressPacket(compressedLarge);
+    BOOST_CHECK_LT(compressedLarge.size(), 1024 * 1024);
+    bytesConstRef tooLarge(&compressedLarge);
+    BOOST_CHECK(!Session::decompressPacket(tooLarge, *pool, buffer));
+}
+
+BOOST_AUTO_TEST_CASE(noCompressionWithV4Peer)
+{
+    const char* const localhost = "127.0.0.1";
+    NetworkPreferences prefs1(localhost, 0, false);
+    NetworkPreferences prefs2(localhost, 0, false);
+    Host host1("Test", prefs1);
+    Host host2("Test", prefs2);
+    host2.test_setProtocolVersion(4);
+    auto thc1 = host1.registerCapability(make_shared<TestHostCapability>());
+    auto thc2 = host2.registerCapability(make_shared<TestHostCapability>());
+    connectHosts(host1, host2);
+
+    int const target = 16;
+    for (int i = 0; i < target; ++i)
+    {
+        thc1->sendTestMessage(host2.id(), i);
+        thc2->sendTestMessage(host1.id(), i);
+    }
+    for (unsigned i = 0; i < 10000 && (thc1->retrieveTestData(host2.id()).first < target ||
+                                          thc2->retrieveTestData(host1.id()).first < target);
+         i += 10)
+        this_thread::sleep_for(chrono::milliseconds(10));
+    BOOST_REQUIRE_EQUAL(thc1->retrieveTestData(host2.id()).first, target);
+    BOOST_REQUIRE_EQUAL(thc2->retrieveTestData(host1.id()).first, target);
+
+    // Neither side compresses, as one of them only speaks v4.
+    auto const infos1 = host1.peerSessionInfo();
+    auto const infos2 = host2.peerSessionInfo();
+    BOOST_REQUIRE_EQUAL(infos1.size(), 1);
+    BOOST_REQUIRE_EQUAL(infos2.size(), 1);
+    BOOST_CHECK_EQUAL(infos1[0].protocolVersion, 4u);
+    for (auto const& info: {infos1[0], infos2[0]})
+    {
+        BOOST_CHECK_GT(info.sentBytes, 0u);
+        BOOST_CHECK_EQUAL(info.sentWireBytes, info.sentBytes);
+        BOOST_CHECK_EQUAL(info.receivedWireBytes, info.receivedBytes);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(largePacketsAreInterleaved)
+{
+    const char* const localhost = "127.0.0.1";
+    NetworkPreferences prefs1(localhost, 0, false);
+    NetworkPreferences prefs2(localhost, 0, false);
+    Host host1("Test", prefs1);
+    Host host2("Test", prefs2);
+    auto thc1 = host1.registerCapability(make_shared<TestHostCapability>());
+    auto thc2 = host2.registerCapability(make_shared<TestHostCapability>());
+    auto other1 = host1.registerCapability(make_shared<OtherTestHostCapability>());
+    auto other2 = host2.registerCapability(make_shared<OtherTestHostCapability>());
+    connectHosts(host1, host2);
+
+    // The large message goes out in chunks, so the other capability's messages sent after it
+    // overtake it, while those of its own capability keep their order.
+    thc2->sendLargeTestMessage(host1.id(), 1, 4 * 1024 * 1024);
+    thc2->sendTestMessage(host1.id(), 2);
+    thc2->sendLargeTestMessage(host1.id(), 3, 100 * 1024);
+    other2->sendTestMessage(host1.id(), 10);
+    other2->sendLargeTestMessage(host1.id(), 11, 100 * 1024);
+
+    vector<int> received;
+    vector<int> otherReceived;
+    for (unsigned i = 0; i < 10000 && (received.size() < 3 || otherReceived.size() < 2); i += 10)
+    {
+        this_thread::sleep_for(chrono::milliseconds(10));
+        received = thc1->receivedOrder(host2.id());
+        otherReceived = other1->receivedOrder(host2.id());
+    }
+    BOOST_REQUIRE_EQUAL(received.size(), 3u);
+    BOOST_REQUIRE_EQUAL(otherReceived.size(), 2u);
+    BOOST_CHECK(received == vector<int>({1, 2, 3}));
+    BOOST_CHECK(otherReceived == vector<int>({10, 11}));
+
+    vector<unsigned> const receivedAt = thc1->receivedAt(host2.id());
+    vector<unsigned> const otherReceivedAt = other1->receivedAt(host2.id());
+    BOOST_REQUIRE_EQUAL(receivedAt.size(), 3u);
+    BOOST_REQUIRE_EQUAL(otherReceivedAt.size(), 2u);
+    BOOST_CHECK_LT(otherReceivedAt[1], receivedAt[0]);
+}
+
+BOOST_AUTO_TEST_CASE(classUploadLimit)
+{
+    const char* const localhost = "127.0.0.1";
+    unsigned const limit = 256 * 1024;
+    size_t const messageSize = 64 * 1024;
+    NetworkPreferences prefs1(localhost, 0, false);
+    NetworkPreferences prefs2(localhost, 0, false);
+    prefs2.classUploadLimits[unsigned(TrafficClass::SyncServing)] = limit;
+    Host host1("Test", prefs1);
+    Host host2("Test", prefs2);
+    auto thc1 = host1.registerCapability(make_shared<TestHostCapability>());
+    auto thc2 = host2.registerCapability(make_shared<TestHostCapability>(TrafficClass::SyncServing));
+    connectHosts(host1, host2);
+
+    auto const start = chrono::steady_clock::now();
+    for (int i = 1; i <= 4; ++i)
+        thc2->sendLargeTestMessage(host1.id(), i, messageSize);
+
+    vector<int> received;
+    for (unsigned i = 0; i < 10000 && received.size() < 4; i += 10)
+    {
+        this_thread::sleep_for(chrono::milliseconds(10));
+        received = thc1->receivedOrder(host2.id());
+    }
+    BOOST_REQUIRE_EQUAL(received.size(), 4);
+
+    // All but the first quarter second's worth has to wait for the limit.
+    BOOST_CHECK(chrono::steady_clock::now() - start >= chrono::milliseconds(500));
+    TrafficClassInfo const info = host2.trafficClasses()[unsigned(TrafficClass::SyncServing)];
+    BOOST_CHECK_EQUAL(info.limit, limit);
+    BOOST_CHECK_GE(info.sentBytes, 4 * messageSize);
+    BOOST_CHECK_GT(info.throttled, 0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 
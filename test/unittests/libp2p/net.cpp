@@ -35,6 +35,7 @@ using namespace dev::test;
 using namespace dev::p2p;
 namespace ba = boost::asio;
 namespace bi = ba::ip;
+namespace ut = boost::unit_test;
 
 struct NetFixture: public TestOutputHelperFixture
 {
@@ -150,6 +151,25 @@ struct TestNodeTable: public NodeTable
         return -1;
     }
 
+    // add _count random nodes without pinging them; each bucket keeps the first ones to reach it
+    void populateRandomNodes(unsigned _count)
+    {
+        bi::address ourIp = bi::address::from_string("127.0.0.1");
+        for (unsigned i = 0; i < _count; ++i)
+        {
+            auto node = make_shared<NodeEntry>(
+                m_node.id, Public::random(), NodeIPEndpoint(ourIp, 30000, 30000));
+            node->pending = false;
+            DEV_GUARDED(x_nodes)
+                m_nodes[node->id] = node;
+
+            Guard l(x_state);
+            auto& nodes = m_state[node->distance - 1].nodes;
+            if (!nodes.full())
+                nodes.push_back(node);
+        }
+    }
+
     void reset()
     {
         Guard l(x_state);
@@ -160,7 +180,9 @@ struct TestNodeTable: public NodeTable
     using NodeTable::m_nodes;
     using NodeTable::m_socket;
     using NodeTable::m_state;
+    using NodeTable::nearestNodeEntries;
     using NodeTable::noteActiveNode;
+    using NodeTable::s_bucketSize;
 };
 
 /**
@@ -423,6 +445,63 @@ BOOST_AUTO_TEST_CASE(noteActiveNodeReplacesNodeInFullBucketWhenEndpointChanged)
     BOOST_CHECK_EQUAL(nodes.back().lock(), nodeWithNewEndpoint);
 }
 
+BOOST_AUTO_TEST_CASE(nearestNodeEntriesAreNearest)
+{
+    TestNodeTableHost nodeTableHost(0);
+    auto nodeTable = nodeTableHost.nodeTable;
+    nodeTable->populateRandomNodes(1000);
+    size_t const bucketSize = TestNodeTable::s_bucketSize;
+
+    for (unsigned t = 0; t < 20; ++t)
+    {
+        NodeID const target = NodeID::random();
+        h256 const targetHash = sha3(target);
+        vector<h256> distances;
+        for (auto const& bucket: nodeTable->m_state)
+            for (auto const& n: bucket.nodes)
+                distances.push_back(n.lock()->hash ^ targetHash);
+        sort(distances.begin(), distances.end());
+
+        auto nearest = nodeTable->nearestNodeEntries(target);
+        BOOST_REQUIRE_EQUAL(nearest.size(), min(distances.size(), bucketSize));
+        for (size_t i = 0; i < nearest.size(); ++i)
+            BOOST_CHECK_EQUAL(nearest[i]->hash ^ targetHash, distances[i]);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(bench_nodeTable, *ut::label("bench"))
+{
+    if (!Options::get().all)
+    {
+        std::cout << "Skipping benchmark test because --all option is not specified.\n";
+        return;
+    }
+
+    TestNodeTableHost nodeTableHost(0);
+    auto nodeTable = nodeTableHost.nodeTable;
+    unsigned const c_nodes = 100000;
+    auto start = chrono::steady_clock::now();
+    nodeTable->populateRandomNodes(c_nodes);
+    auto populated = chrono::steady_clock::now();
+
+    unsigned const c_lookups = 100000;
+    vector<NodeID> targets(c_lookups);
+    for (auto& t: targets)
+        t = NodeID::random();
+    size_t found = 0;
+    auto lookupStart = chrono::steady_clock::now();
+    for (auto const& t: targets)
+        found += nodeTable->nearestNodeEntries(t).size();
+    auto done = chrono::steady_clock::now();
+
+    std::cout << ut::framework::current_test_case().p_name << ": " << c_nodes << " nodes added in "
+              << chrono::duration_cast<chrono::milliseconds>(populated - start).count()
+              << " ms, " << c_lookups / chrono::duration<double>(done - lookupStart).count()
+              << " lookups/s\n";
+    BOOST_CHECK_EQUAL(nodeTable->count(), c_nodes);
+    BOOST_CHECK_EQUAL(found, size_t(c_lookups) * TestNodeTable::s_bucketSize);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 BOOST_FIXTURE_TEST_SUITE(netTypes, TestOutputHelperFixture)
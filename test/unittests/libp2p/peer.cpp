@@ -26,6 +26,7 @@
 #include <libp2p/Capability.h>
 #include <libp2p/HostCapability.h>
 #include <chrono>
+#include <future>
 #include <thread>
 #include <boost/test/unit_test.hpp>
 
@@ -60,17 +61,19 @@ public:
     virtual ~TestHostCap() {}
 };
 
-BOOST_AUTO_TEST_SUITE(libp2p)
-BOOST_FIXTURE_TEST_SUITE(p2p, P2PPeerFixture)
-
-BOOST_AUTO_TEST_CASE(host)
+namespace
+{
+void connectHosts(unsigned _ioThreads)
 {
-    Host host1("Test", NetworkPreferences("127.0.0.1", 0, false));
+    NetworkPreferences prefs("127.0.0.1", 0, false);
+    prefs.ioThreads = _ioThreads;
+
+    Host host1("Test", prefs);
     host1.start();
     auto host1port = host1.listenPort();
     BOOST_REQUIRE(host1port);
 
-    Host host2("Test", NetworkPreferences("127.0.0.1", 0, false));
+    Host host2("Test", prefs);
     host2.start();
     auto host2port = host2.listenPort();
     BOOST_REQUIRE(host2port);
@@ -117,6 +120,121 @@ BOOST_AUTO_TEST_CASE(host)
 
     BOOST_REQUIRE_EQUAL(host1.peerCount(), 1);
     BOOST_REQUIRE_EQUAL(host2.peerCount(), 1);
+
+    // Both announce the Snappy version, and each session starts with a compressed ping.
+    auto infos = host1.peerSessionInfo();
+    BOOST_REQUIRE_EQUAL(infos.size(), 1);
+    BOOST_CHECK_EQUAL(infos[0].protocolVersion, c_snappyProtocolVersion);
+    BOOST_CHECK_GT(infos[0].sentBytes, 0);
+    BOOST_CHECK_GT(infos[0].sentWireBytes, 0);
+}
+}  // namespace
+
+namespace
+{
+/// Appends a peer record at @a _address as saveNetwork() writes it, without the items added in
+/// protocol version 5 if @a _legacy is set.
+void appendPeerRecord(RLPStream& _s, NodeID const& _id, string const& _address, bool _legacy,
+    unsigned _failedAttempts, DisconnectReason _lastDisconnect, unsigned _handshakes = 0,
+    uint64_t _servedBytes = 0)
+{
+    // Attempted just now, so that the host doesn't dial it while the test runs.
+    auto const now = chrono::duration_cast<chrono::seconds>(
+        chrono::system_clock::now().time_since_epoch()).count();
+    _s.appendList(_legacy ? 11 : 15);
+    NodeIPEndpoint(bi::address::from_string(_address), 30303, 30303)
+        .streamRLP(_s, NodeIPEndpoint::StreamInline);
+    _s << _id << false << now << now << _failedAttempts << unsigned(_lastDisconnect) << 0 << 0;
+    if (!_legacy)
+        _s << _handshakes << 0 << _servedBytes << CapDescs{};
+}
+
+/// @returns a saved network holding the @a _count records in @a _records.
+bytes savedNetwork(RLPStream const& _records, unsigned _count)
+{
+    RLPStream ret(3);
+    ret << c_protocolVersion << KeyPair::create().secret().ref();
+    ret.appendList(_count);
+    ret.appendRaw(_records.out(), _count);
+    return ret.out();
+}
+
+/// @returns the peers of @a _host once restoring its network has added @a _count of them.
+Peers restoredPeers(Host& _host, size_t _count)
+{
+    Peers ret;
+    for (unsigned i = 0; i < 3000 && ret.size() < _count; i += 10)
+    {
+        this_thread::sleep_for(chrono::milliseconds(10));
+        ret = _host.getPeers();
+    }
+    return ret;
+}
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(libp2p)
+BOOST_FIXTURE_TEST_SUITE(p2p, P2PPeerFixture)
+
+BOOST_AUTO_TEST_CASE(host)
+{
+    connectHosts(1);
+}
+
+BOOST_AUTO_TEST_CASE(hostWithIOThreads)
+{
+    connectHosts(4);
+}
+
+BOOST_AUTO_TEST_CASE(handshakeWorkers)
+{
+    HandshakeWorkers workers(1);
+
+    // Hold the only worker until everything is queued.
+    promise<void> release;
+    shared_future<void> released = release.get_future().share();
+    BOOST_REQUIRE(workers.enqueue(HandshakeWorkers::High, [released]() { released.wait(); }));
+
+    Mutex x_order;
+    vector<int> order;
+    for (size_t i = 0; i < HandshakeWorkers::c_maxQueued; ++i)
+        BOOST_REQUIRE(workers.enqueue(HandshakeWorkers::Normal, [&]() { DEV_GUARDED(x_order) order.push_back(0); }));
+    BOOST_CHECK(!workers.enqueue(HandshakeWorkers::Normal, []() {}));
+    BOOST_CHECK(workers.enqueue(HandshakeWorkers::High, [&]() { DEV_GUARDED(x_order) order.push_back(1); }));
+
+    release.set_value();
+    size_t done = 0;
+    for (unsigned i = 0; i < 5000 && done <= HandshakeWorkers::c_maxQueued; i += 10)
+    {
+        this_thread::sleep_for(chrono::milliseconds(10));
+        DEV_GUARDED(x_order)
+            done = order.size();
+    }
+
+    Guard l(x_order);
+    BOOST_REQUIRE_EQUAL(order.size(), HandshakeWorkers::c_maxQueued + 1);
+    BOOST_CHECK_EQUAL(order.front(), 1);
+
+    unsigned admitted = 0;
+    while (workers.admitIngress() && admitted <= HandshakeWorkers::c_ingressPerSecond)
+        ++admitted;
+    BOOST_CHECK_EQUAL(admitted, HandshakeWorkers::c_ingressPerSecond);
+}
+
+BOOST_AUTO_TEST_CASE(tokenBucket)
+{
+    TokenBucket unlimited;
+    unlimited.consume(1 << 30);
+    BOOST_CHECK(unlimited.ready());
+
+    unsigned const rate = 100000;
+    TokenBucket bucket(rate);
+    BOOST_REQUIRE(bucket.ready());
+
+    // A write may overdraw the bucket; the next one waits until the 50ms of debt are paid off.
+    bucket.consume(rate * TokenBucket::c_burstSeconds + rate / 20);
+    BOOST_CHECK(!bucket.ready());
+    this_thread::sleep_for(chrono::milliseconds(100));
+    BOOST_CHECK(bucket.ready());
 }
 
 BOOST_AUTO_TEST_CASE(networkConfig)
@@ -178,11 +296,20 @@ BOOST_AUTO_TEST_CASE(saveNodes)
     BOOST_REQUIRE_EQUAL(r[1].toBytes().size(), 32); // secret
     BOOST_REQUIRE(r[2].itemCount() >= c_nodes);
     
+    unsigned scoredPeers = 0;
     for (auto i: r[2])
     {
-        BOOST_REQUIRE(i.itemCount() == 4 || i.itemCount() == 11);
+        BOOST_REQUIRE(i.itemCount() == 4 || i.itemCount() == 15);
         BOOST_REQUIRE(i[0].size() == 4 || i[0].size() == 16);
+        if (i.itemCount() == 15)
+        {
+            // Each peer has had a session, in which it had our capability.
+            BOOST_CHECK_GE(i[11].toInt<unsigned>(), 1);
+            BOOST_CHECK(!i[14].toVector<CapDesc>().empty());
+            ++scoredPeers;
+        }
     }
+    BOOST_CHECK_EQUAL(scoredPeers, c_peers);
 
     for (auto host: hosts)
         delete host;
@@ -260,6 +387,63 @@ BOOST_AUTO_TEST_CASE(requirePeer)
     BOOST_REQUIRE_EQUAL(host2peerCount, 1);
 }
 
+BOOST_AUTO_TEST_CASE(restoreLegacyPeerRecords)
+{
+    NodeID const kept = KeyPair::create().pub();
+    RLPStream records;
+    appendPeerRecord(records, kept, "1.1.1.1", true, 2, ClientQuit);
+    // Too many failures without ever a handshake, and the wrong network.
+    appendPeerRecord(records, KeyPair::create().pub(), "1.1.1.2", true, 5, TCPError);
+    appendPeerRecord(records, KeyPair::create().pub(), "1.1.1.3", true, 0, IncompatibleProtocol);
+    bytes const network = savedNetwork(records, 3);
+
+    NetworkPreferences prefs("127.0.0.1", 0, false);
+    prefs.discovery = false;
+    Host host("Test", prefs, bytesConstRef(&network));
+    host.start();
+
+    Peers const peers = restoredPeers(host, 1);
+    BOOST_REQUIRE_EQUAL(peers.size(), 1u);
+    BOOST_CHECK_EQUAL(peers[0].id, kept);
+    BOOST_CHECK_EQUAL(peers[0].failedAttempts(), 2);
+    BOOST_CHECK_EQUAL(peers[0].lastDisconnect(), ClientQuit);
+
+    // It is saved again in the current format.
+    bytes const saved = host.saveNetwork();
+    RLP const r(saved);
+    BOOST_REQUIRE_EQUAL(r[2].itemCount(), 1u);
+    BOOST_CHECK_EQUAL(r[2][0].itemCount(), 15u);
+    BOOST_CHECK(r[2][0][3].toHash<NodeID>() == kept);
+    BOOST_CHECK_EQUAL(r[2][0][11].toInt<unsigned>(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(savedPeersByDialScore)
+{
+    NodeID const few = KeyPair::create().pub();
+    NodeID const most = KeyPair::create().pub();
+    NodeID const some = KeyPair::create().pub();
+    RLPStream records;
+    appendPeerRecord(records, few, "1.1.1.1", false, 0, ClientQuit, 1);
+    appendPeerRecord(records, most, "1.1.1.2", false, 0, ClientQuit, 7, 1024 * 1024);
+    appendPeerRecord(records, some, "1.1.1.3", false, 0, ClientQuit, 3);
+    // Handshakes buy more tries, but not endless ones.
+    appendPeerRecord(records, KeyPair::create().pub(), "1.1.1.4", false, 15, TCPError, 20);
+    bytes const network = savedNetwork(records, 4);
+
+    NetworkPreferences prefs("127.0.0.1", 0, false);
+    prefs.discovery = false;
+    Host host("Test", prefs, bytesConstRef(&network));
+    host.start();
+    BOOST_REQUIRE_EQUAL(restoredPeers(host, 3).size(), 3u);
+
+    bytes const saved = host.saveNetwork();
+    RLP const r(saved);
+    BOOST_REQUIRE_EQUAL(r[2].itemCount(), 3u);
+    BOOST_CHECK(r[2][0][3].toHash<NodeID>() == most);
+    BOOST_CHECK(r[2][1][3].toHash<NodeID>() == some);
+    BOOST_CHECK(r[2][2][3].toHash<NodeID>() == few);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 BOOST_FIXTURE_TEST_SUITE(peerTypes, TestOutputHelperFixture)
@@ -28,18 +28,23 @@
 #include <cryptopp/keccak.h>
 #include <cryptopp/modes.h>
 #include <cryptopp/sha.h>
+#include <chrono>
 #include <libdevcore/Common.h>
 #include <libdevcore/RLP.h>
 #include <libdevcore/Log.h>
 #include <libdevcore/SHA3.h>
 #include <libdevcrypto/CryptoPP.h>
+#include <libp2p/BufferPool.h>
+#include <libp2p/RLPXCipher.h>
 #include <libp2p/RLPxHandshake.h>
+#include <test/tools/libtesteth/Options.h>
 #include <test/tools/libtesteth/TestOutputHelper.h>
 
 using namespace std;
 using namespace dev;
 using namespace dev::p2p;
 using namespace dev::test;
+namespace ut = boost::unit_test;
 
 struct RLPXTestFixture: public TestOutputHelperFixture {
 	RLPXTestFixture() : s_secp256k1(crypto::Secp256k1PP::get()) {}
@@ -459,4 +464,124 @@ BOOST_AUTO_TEST_CASE(ecies_interop_test_primitives)
 	BOOST_REQUIRE(plainTest3 == expectedPlain3);
 }
 
+BOOST_AUTO_TEST_CASE(bufferPoolReuse)
+{
+	auto pool = make_shared<BufferPool>();
+	byte* data;
+	{
+		auto b = pool->acquire(10 * 1024 * 1024 + 1);
+		BOOST_REQUIRE_GE(b.capacity(), 10 * 1024 * 1024 + 1);
+		data = b.data();
+		BOOST_CHECK_EQUAL(pool->pooledBytes(), 0);
+	}
+	BOOST_CHECK_EQUAL(pool->pooledBytes(), 16 * 1024 * 1024);
+
+	// Any size of the same class gets the buffer back.
+	auto b = pool->acquire(9 * 1024 * 1024);
+	BOOST_CHECK_EQUAL(b.data(), data);
+	BOOST_CHECK_EQUAL(pool->pooledBytes(), 0);
+
+	// Buffers outliving their pool are just freed.
+	pool.reset();
+	b = BufferPool::Buffer();
+	BOOST_CHECK(!b.data());
+}
+
+BOOST_AUTO_TEST_CASE(rlpxAESMatchesCryptoPP)
+{
+	// NIST SP 800-38A, F.5.5 CTR-AES256.Encrypt.
+	bytes key = fromHex("603deb1015ca71be2b73aef0857d77811f352c073b6108d72d9810a30914dff4");
+	h128 iv("f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff");
+	bytes plain = fromHex("6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51");
+	bytes cipher(plain.size());
+	RLPXAES aes{bytesConstRef(&key), iv};
+	aes.processCTR(cipher.data(), plain.data(), 5);
+	aes.processCTR(cipher.data() + 5, plain.data() + 5, plain.size() - 5);
+	BOOST_CHECK_EQUAL(toHex(cipher), "601ec313775789a5b7a7f504bbf3d2285e1ddde8b60a7bcd93fc1f6b5d1b3f8b");
+
+	// Long runs, in pieces that start and stop mid-block, against Crypto++.
+	bytes data(4099);
+	for (size_t i = 0; i < data.size(); ++i)
+		data[i] = byte(i * 7);
+	bytes expected(data.size());
+	CryptoPP::CTR_Mode<CryptoPP::AES>::Encryption reference;
+	reference.SetKeyWithIV(key.data(), key.size(), h128().data());
+	reference.ProcessData(expected.data(), data.data(), data.size());
+	RLPXAES ctr{bytesConstRef(&key)};
+	for (size_t done = 0, step = 1; done < data.size(); done += step, step = step * 3 % 257)
+	{
+		step = min(step, data.size() - done);
+		ctr.processCTR(data.data() + done, data.data() + done, step);
+	}
+	BOOST_CHECK(data == expected);
+
+	h128 block("00112233445566778899aabbccddeeff");
+	h128 expectedBlock;
+	CryptoPP::ECB_Mode<CryptoPP::AES>::Encryption ecb;
+	ecb.SetKey(key.data(), key.size());
+	ecb.ProcessData(expectedBlock.data(), block.data(), h128::size);
+	ctr.encryptBlock(block);
+	BOOST_CHECK_EQUAL(block, expectedBlock);
+}
+
+BOOST_AUTO_TEST_CASE(rlpxMACMatchesSha3)
+{
+	bytes data(1000);
+	for (size_t i = 0; i < data.size(); ++i)
+		data[i] = byte(i * 13);
+	RLPXMAC mac;
+	BOOST_CHECK_EQUAL(mac.digest(), h128(sha3(bytesConstRef()).ref().cropped(0, h128::size)));
+	for (size_t done = 0, step = 1; done < data.size(); done += step, step = step * 5 % 211)
+	{
+		step = min(step, data.size() - done);
+		mac.update(bytesConstRef(&data).cropped(done, step));
+		h256 const expected = sha3(bytesConstRef(&data).cropped(0, done + step));
+		BOOST_REQUIRE_EQUAL(mac.digest(), h128(expected.ref().cropped(0, h128::size)));
+	}
+}
+
+BOOST_AUTO_TEST_CASE(bench_rlpxFrameCoder, *ut::label("bench"))
+{
+	if (!Options::get().all)
+	{
+		std::cout << "Skipping benchmark test because --all option is not specified.\n";
+		return;
+	}
+
+	KeyPair initiator = KeyPair::create();
+	KeyPair recipient = KeyPair::create();
+	h256 initiatorNonce = h256::random();
+	h256 recipientNonce = h256::random();
+	bytes auth = sha3("auth").asBytes();
+	bytes ack = sha3("ack").asBytes();
+	RLPXFrameCoder egress(true, recipient.pub(), recipientNonce, initiator, initiatorNonce, &ack, &auth);
+	RLPXFrameCoder ingress(false, initiator.pub(), initiatorNonce, recipient, recipientNonce, &ack, &auth);
+
+	std::cout << "AES-NI: " << (RLPXAES::hardwareAccelerated() ? "yes" : "no") << "\n";
+	size_t const total = 256 * 1024 * 1024;
+	for (size_t frameSize: {128, 1024, 16 * 1024, 1024 * 1024, 10 * 1024 * 1024})
+	{
+		bytes payload(frameSize, 0x5a);
+		bytes frame;
+		chrono::steady_clock::duration writeTime{};
+		chrono::steady_clock::duration readTime{};
+		size_t const frames = max<size_t>(total / frameSize, 1);
+		for (size_t i = 0; i < frames; ++i)
+		{
+			auto start = chrono::steady_clock::now();
+			egress.writeFrame(0, &payload, frame);
+			auto written = chrono::steady_clock::now();
+			BOOST_REQUIRE(ingress.authAndDecryptHeader(bytesRef(frame.data(), h256::size)));
+			BOOST_REQUIRE(ingress.authAndDecryptFrame(bytesRef(&frame).cropped(h256::size)));
+			readTime += chrono::steady_clock::now() - written;
+			writeTime += written - start;
+		}
+
+		double const megabytes = double(frames * frameSize) / (1024 * 1024);
+		std::cout << ut::framework::current_test_case().p_name << "/" << frameSize << " B: write "
+				  << megabytes / chrono::duration<double>(writeTime).count() << " MB/s, read "
+				  << megabytes / chrono::duration<double>(readTime).count() << " MB/s\n";
+	}
+}
+
 BOOST_AUTO_TEST_SUITE_END()